@@ -4,6 +4,7 @@
 #include <cstring>
 #include <string>
 #include <vector>
+#include <memory>
 
 typedef struct VideoFrame
 {
@@ -13,6 +14,10 @@ typedef struct VideoFrame
     uint32_t m_nLength;
     uint32_t m_nFrameType;
     uint64_t m_lPTS;
+    int32_t m_nDmaBufFd;
+    std::shared_ptr<void> m_pBufferRef;
+    uint8_t* m_pPlane[3];
+    int32_t m_nLineSize[3];
 
     VideoFrame()
     {
@@ -22,11 +27,41 @@ typedef struct VideoFrame
         m_nLength = 0;
         m_nFrameType = 0;
         m_lPTS = 0;
+        m_nDmaBufFd = -1;
+        m_pBufferRef = nullptr;
+        for (int i = 0; i < 3; i++)
+        {
+            m_pPlane[i] = nullptr;
+            m_nLineSize[i] = 0;
+        }
+    }
+
+    void SetPackedPlanes()
+    {
+        m_pPlane[0] = m_pData;
+        m_pPlane[1] = m_pData + (m_nWidth * m_nHeight);
+        m_pPlane[2] = m_pData + (m_nWidth * m_nHeight * 5 / 4);
+        m_nLineSize[0] = m_nWidth;
+        m_nLineSize[1] = m_nWidth / 2;
+        m_nLineSize[2] = m_nWidth / 2;
+    }
+
+    void SetPackedNV12Planes()
+    {
+        m_pPlane[0] = m_pData;
+        m_pPlane[1] = m_pData + (m_nWidth * m_nHeight);
+        m_pPlane[2] = nullptr;
+        m_nLineSize[0] = m_nWidth;
+        m_nLineSize[1] = m_nWidth;
+        m_nLineSize[2] = 0;
     }
 
     ~VideoFrame()
     {
-        free(m_pData);
+        if (m_pBufferRef == nullptr)
+        {
+            free(m_pData);
+        }
     }
 }VideoFrame;
 
@@ -86,6 +121,7 @@ typedef struct VideoPacket
     uint32_t m_nFrameType;
     uint64_t m_lPTS;
     uint64_t m_lDTS;
+    std::shared_ptr<void> m_pBufferRef;
 
     VideoPacket()
     {
@@ -94,28 +130,50 @@ typedef struct VideoPacket
         m_nFrameType = 0;
         m_lPTS = 0;
         m_lDTS = 0;
+        m_pBufferRef = nullptr;
     }
 
     ~VideoPacket()
     {
-        free(m_pData);
+        if (m_pBufferRef == nullptr)
+        {
+            free(m_pData);
+        }
     }
 }VideoPacket, MediaPacket;
 
+//how much of the stream is lost with the packet,set by the packetizer
+typedef enum PacketPriority
+{
+    PACKET_PRIORITY_LOW = 0,        //non-reference slice,only its own frame
+    PACKET_PRIORITY_NORMAL,         //reference slice,the rest of the GOP
+    PACKET_PRIORITY_HIGH,           //IDR slice,SPS,PPS,the whole GOP
+    PACKET_PRIORITY_NUM
+}PacketPriority;
+
 typedef struct Packet
 {
     uint8_t* m_pData;
     uint32_t m_nLength;
+    uint8_t m_nPriority;
+    uint64_t m_lArrivalTime;        //media time the kernel received it,0 unknown
+    std::shared_ptr<void> m_pBufferRef;
 
     Packet()
     {
         m_pData = nullptr;
         m_nLength = 0;
+        m_nPriority = PACKET_PRIORITY_NORMAL;
+        m_lArrivalTime = 0;
+        m_pBufferRef = nullptr;
     }
 
     ~Packet()
     {
-        free(m_pData);
+        if (m_pBufferRef == nullptr)
+        {
+            free(m_pData);
+        }
     }
 }Packet;
 
@@ -0,0 +1,201 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include <condition_variable>
+
+template<typename T>
+class BoundedQueue
+{
+public:
+    typedef enum OverflowPolicy
+    {
+        DROP_OLDEST = 0,
+        DROP_NEWEST
+    }OverflowPolicy;
+
+    typedef struct QueueStats
+    {
+        uint64_t m_nPushed = 0;
+        uint64_t m_nPopped = 0;
+        uint64_t m_nDropped = 0;
+        uint32_t m_nSize = 0;
+        uint32_t m_nHighWater = 0;
+    }QueueStats;
+
+public:
+    BoundedQueue(uint32_t capacity, OverflowPolicy policy);
+    ~BoundedQueue();
+
+    bool Push(const T& item);                   //return false if an item was dropped
+    bool Pop(T& item, int64_t milliseconds);    //return false on timeout or closed
+    uint32_t PopBatch(std::vector<T>& items, uint32_t maxNum, int64_t milliseconds);    //waits for the first,appends what is there
+    void Close();
+    void Open();
+    void Clear();
+    uint32_t Size();
+    QueueStats GetStats();
+    void ResetStats();
+
+private:
+    std::mutex m_QueueLock;
+    std::condition_variable m_ConditionVariable;
+    std::deque<T> m_Queue;
+    uint32_t m_nCapacity;
+    OverflowPolicy m_ePolicy;
+    bool m_bClosed;
+    QueueStats m_Stats;
+};
+
+template<typename T>
+BoundedQueue<T>::BoundedQueue(uint32_t capacity, OverflowPolicy policy)
+{
+    m_nCapacity = capacity > 0 ? capacity : 1;
+    m_ePolicy = policy;
+    m_bClosed = false;
+}
+
+template<typename T>
+BoundedQueue<T>::~BoundedQueue()
+{
+    Close();
+    Clear();
+}
+
+template<typename T>
+bool BoundedQueue<T>::Push(const T& item)
+{
+    T dropped = T();
+    bool bDropped = false;
+
+    {
+        std::lock_guard<std::mutex> lock(m_QueueLock);
+        if (m_bClosed)
+        {
+            m_Stats.m_nDropped++;
+            return false;
+        }
+
+        if (m_Queue.size() >= m_nCapacity)
+        {
+            m_Stats.m_nDropped++;
+            bDropped = true;
+            if (m_ePolicy == DROP_NEWEST)
+            {
+                return false;
+            }
+            dropped = m_Queue.front();
+            m_Queue.pop_front();
+        }
+
+        m_Queue.push_back(item);
+        m_Stats.m_nPushed++;
+        if (m_Queue.size() > m_Stats.m_nHighWater)
+        {
+            m_Stats.m_nHighWater = m_Queue.size();
+        }
+    }
+    m_ConditionVariable.notify_one();
+
+    //dropped is released here, outside the lock
+    return !bDropped;
+}
+
+template<typename T>
+bool BoundedQueue<T>::Pop(T& item, int64_t milliseconds)
+{
+    std::unique_lock<std::mutex> lock(m_QueueLock);
+    if (!m_ConditionVariable.wait_for(lock, std::chrono::milliseconds(milliseconds), [this] { return m_bClosed || !m_Queue.empty(); }))
+    {
+        return false;
+    }
+
+    if (m_bClosed || m_Queue.empty())
+    {
+        return false;
+    }
+
+    item = m_Queue.front();
+    m_Queue.pop_front();
+    m_Stats.m_nPopped++;
+
+    return true;
+}
+
+template<typename T>
+uint32_t BoundedQueue<T>::PopBatch(std::vector<T>& items, uint32_t maxNum, int64_t milliseconds)
+{
+    std::unique_lock<std::mutex> lock(m_QueueLock);
+    if (!m_ConditionVariable.wait_for(lock, std::chrono::milliseconds(milliseconds), [this] { return m_bClosed || !m_Queue.empty(); }))
+    {
+        return 0;
+    }
+
+    if (m_bClosed)
+    {
+        return 0;
+    }
+
+    uint32_t num = 0;
+    while (num < maxNum && !m_Queue.empty())
+    {
+        items.push_back(m_Queue.front());
+        m_Queue.pop_front();
+        num++;
+    }
+    m_Stats.m_nPopped += num;
+
+    return num;
+}
+
+template<typename T>
+void BoundedQueue<T>::Close()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_QueueLock);
+        m_bClosed = true;
+    }
+    m_ConditionVariable.notify_all();
+}
+
+template<typename T>
+void BoundedQueue<T>::Open()
+{
+    std::lock_guard<std::mutex> lock(m_QueueLock);
+    m_bClosed = false;
+}
+
+template<typename T>
+void BoundedQueue<T>::Clear()
+{
+    std::deque<T> items;
+    {
+        std::lock_guard<std::mutex> lock(m_QueueLock);
+        items.swap(m_Queue);
+    }
+}
+
+template<typename T>
+uint32_t BoundedQueue<T>::Size()
+{
+    std::lock_guard<std::mutex> lock(m_QueueLock);
+    return m_Queue.size();
+}
+
+template<typename T>
+typename BoundedQueue<T>::QueueStats BoundedQueue<T>::GetStats()
+{
+    std::lock_guard<std::mutex> lock(m_QueueLock);
+    QueueStats stats = m_Stats;
+    stats.m_nSize = m_Queue.size();
+    return stats;
+}
+
+template<typename T>
+void BoundedQueue<T>::ResetStats()
+{
+    std::lock_guard<std::mutex> lock(m_QueueLock);
+    m_Stats = QueueStats();
+}
\ No newline at end of file
@@ -0,0 +1,374 @@
+#include <vector>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include "EventReactor.h"
+#include "TimeCounter.h"
+#include "Log/Log.h"
+
+#define MAX_REACTOR_EVENTS (64)
+#define MAX_REACTOR_WAIT (1000)         //ms,with no timer due
+#define WAKEUP_HANDLER_ID (0)
+
+EventReactor::EventReactor()
+{
+    m_nEpollfd = -1;
+    m_nWakeupfd = -1;
+    m_bStopReactor = true;
+    m_pReactorThread = nullptr;
+    m_lNextHandlerId = WAKEUP_HANDLER_ID + 1;
+    m_nNextTimerId = 1;
+}
+
+EventReactor::~EventReactor()
+{
+    ReleaseAll();
+}
+
+int32_t EventReactor::ReleaseAll()
+{
+    Stop();
+
+    if (m_nWakeupfd != -1)
+    {
+        close(m_nWakeupfd);
+        m_nWakeupfd = -1;
+    }
+    if (m_nEpollfd != -1)
+    {
+        close(m_nEpollfd);
+        m_nEpollfd = -1;
+    }
+
+    std::lock_guard<std::mutex> lock(m_ReactorLock);
+    m_Handlers.clear();
+    m_HandlerIds.clear();
+    m_Timers.clear();
+
+    return 0;
+}
+
+uint64_t EventReactor::GetTime()
+{
+    return TimeCounter::GetMediaTime() * 1000 / MEDIA_CLOCK_RATE;
+}
+
+int32_t EventReactor::Start()
+{
+    if (m_pReactorThread != nullptr)
+    {
+        Error("[%p][EventReactor::Start] already start", this);
+        return -1;
+    }
+
+    if (m_nEpollfd == -1)
+    {
+        m_nEpollfd = epoll_create1(EPOLL_CLOEXEC);
+        if (m_nEpollfd == -1)
+        {
+            Error("[%p][EventReactor::Start] epoll_create1 fail,errno:%d", this, errno);
+            return -2;
+        }
+
+        m_nWakeupfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        struct epoll_event event;
+        event.events = EPOLLIN;
+        event.data.u64 = WAKEUP_HANDLER_ID;
+        if (m_nWakeupfd == -1 || epoll_ctl(m_nEpollfd, EPOLL_CTL_ADD, m_nWakeupfd, &event) != 0)
+        {
+            Error("[%p][EventReactor::Start] create wakeup fd fail,errno:%d", this, errno);
+            ReleaseAll();
+            return -3;
+        }
+    }
+
+    m_bStopReactor = false;
+    m_pReactorThread = new std::thread(&EventReactor::ReactorThread, this);
+
+    return 0;
+}
+
+int32_t EventReactor::Stop()
+{
+    m_bStopReactor = true;
+    if (m_pReactorThread != nullptr)
+    {
+        Wakeup();
+        if (m_pReactorThread->joinable())
+        {
+            m_pReactorThread->join();
+        }
+        delete m_pReactorThread;
+        m_pReactorThread = nullptr;
+    }
+
+    return 0;
+}
+
+void EventReactor::Wakeup()
+{
+    uint64_t value = 1;
+    if (m_nWakeupfd != -1 && write(m_nWakeupfd, &value, sizeof(value)) < 0 && errno != EAGAIN)
+    {
+        Warn("[%p][EventReactor::Wakeup] write fail,errno:%d", this, errno);
+    }
+}
+
+int32_t EventReactor::AddSocket(int32_t fd, uint32_t events, EventCallback callback)
+{
+    if (fd < 0 || callback == nullptr)
+    {
+        Error("[%p][EventReactor::AddSocket] fd:%d or callback err", this, fd);
+        return -1;
+    }
+    if (m_nEpollfd == -1)
+    {
+        Error("[%p][EventReactor::AddSocket] not start", this);
+        return -2;
+    }
+
+    std::lock_guard<std::mutex> lock(m_ReactorLock);
+    if (m_HandlerIds.find(fd) != m_HandlerIds.end())
+    {
+        Error("[%p][EventReactor::AddSocket] fd:%d already added", this, fd);
+        return -3;
+    }
+
+    std::shared_ptr<Handler> handler = std::make_shared<Handler>();
+    handler->m_nfd = fd;
+    handler->m_nEvents = events;
+    handler->m_pCallback = callback;
+    uint64_t id = m_lNextHandlerId++;
+
+    struct epoll_event event;
+    event.events = events;
+    event.data.u64 = id;
+    if (epoll_ctl(m_nEpollfd, EPOLL_CTL_ADD, fd, &event) != 0)
+    {
+        Error("[%p][EventReactor::AddSocket] add fd:%d fail,errno:%d", this, fd, errno);
+        return -4;
+    }
+    m_Handlers[id] = handler;
+    m_HandlerIds[fd] = id;
+
+    return 0;
+}
+
+int32_t EventReactor::ModifySocket(int32_t fd, uint32_t events)
+{
+    std::lock_guard<std::mutex> lock(m_ReactorLock);
+    auto it = m_HandlerIds.find(fd);
+    if (it == m_HandlerIds.end())
+    {
+        return -1;
+    }
+
+    std::shared_ptr<Handler>& handler = m_Handlers[it->second];
+    if (handler->m_nEvents == events)
+    {
+        return 0;
+    }
+
+    struct epoll_event event;
+    event.events = events;
+    event.data.u64 = it->second;
+    if (epoll_ctl(m_nEpollfd, EPOLL_CTL_MOD, fd, &event) != 0)
+    {
+        Error("[%p][EventReactor::ModifySocket] modify fd:%d fail,errno:%d", this, fd, errno);
+        return -2;
+    }
+    handler->m_nEvents = events;
+
+    return 0;
+}
+
+int32_t EventReactor::RemoveSocket(int32_t fd)
+{
+    std::shared_ptr<Handler> handler = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(m_ReactorLock);
+        auto it = m_HandlerIds.find(fd);
+        if (it == m_HandlerIds.end())
+        {
+            return -1;
+        }
+
+        handler = m_Handlers[it->second];
+        m_Handlers.erase(it->second);
+        m_HandlerIds.erase(it);
+        if (epoll_ctl(m_nEpollfd, EPOLL_CTL_DEL, fd, nullptr) != 0)
+        {
+            Warn("[%p][EventReactor::RemoveSocket] remove fd:%d fail,errno:%d", this, fd, errno);
+        }
+    }
+
+    //the callback may hold what its owner is tearing down,release it outside the lock
+    return 0;
+}
+
+int32_t EventReactor::AddTimer(uint32_t milliseconds, bool repeat, TimerCallback callback)
+{
+    if (callback == nullptr || (repeat && milliseconds == 0))
+    {
+        Error("[%p][EventReactor::AddTimer] interval:%u or callback err", this, milliseconds);
+        return -1;
+    }
+
+    int32_t id = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_ReactorLock);
+        id = m_nNextTimerId++;
+        m_nNextTimerId = m_nNextTimerId > 0 ? m_nNextTimerId : 1;
+
+        Timer timer;
+        timer.m_lDueTime = GetTime() + milliseconds;
+        timer.m_nInterval = milliseconds;
+        timer.m_bRepeat = repeat;
+        timer.m_pCallback = std::make_shared<TimerCallback>(callback);
+        m_Timers[id] = timer;
+    }
+
+    if (!IsReactorThread())
+    {
+        Wakeup();
+    }
+
+    return id;
+}
+
+int32_t EventReactor::RemoveTimer(int32_t id)
+{
+    std::shared_ptr<TimerCallback> callback = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(m_ReactorLock);
+        auto it = m_Timers.find(id);
+        if (it == m_Timers.end())
+        {
+            return -1;
+        }
+        callback = it->second.m_pCallback;
+        m_Timers.erase(it);
+    }
+
+    return 0;
+}
+
+int32_t EventReactor::GetWaitTime()
+{
+    std::lock_guard<std::mutex> lock(m_ReactorLock);
+    uint64_t now = GetTime();
+    int32_t wait = MAX_REACTOR_WAIT;
+    for (auto& it : m_Timers)
+    {
+        if (it.second.m_lDueTime <= now)
+        {
+            return 0;
+        }
+        if (it.second.m_lDueTime - now < (uint64_t)wait)
+        {
+            wait = (int32_t)(it.second.m_lDueTime - now);
+        }
+    }
+
+    return wait;
+}
+
+void EventReactor::DispatchEvent(uint64_t id, uint32_t events)
+{
+    std::shared_ptr<Handler> handler = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(m_ReactorLock);
+        auto it = m_Handlers.find(id);
+        if (it == m_Handlers.end())
+        {
+            //removed by an earlier callback of the same round
+            return;
+        }
+        handler = it->second;
+    }
+
+    handler->m_pCallback(events);
+}
+
+void EventReactor::RunTimers()
+{
+    uint64_t now = GetTime();
+    std::vector<int32_t> due;
+    {
+        std::lock_guard<std::mutex> lock(m_ReactorLock);
+        for (auto& it : m_Timers)
+        {
+            if (it.second.m_lDueTime <= now)
+            {
+                due.push_back(it.first);
+            }
+        }
+    }
+
+    for (int32_t id : due)
+    {
+        std::shared_ptr<TimerCallback> callback = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(m_ReactorLock);
+            auto it = m_Timers.find(id);
+            if (it == m_Timers.end())
+            {
+                continue;
+            }
+
+            callback = it->second.m_pCallback;
+            if (it->second.m_bRepeat)
+            {
+                //a late round is not made up for
+                Timer& timer = it->second;
+                timer.m_lDueTime += timer.m_nInterval;
+                timer.m_lDueTime = timer.m_lDueTime > now ? timer.m_lDueTime : now + timer.m_nInterval;
+            }
+            else
+            {
+                m_Timers.erase(it);
+            }
+        }
+
+        (*callback)();
+    }
+}
+
+void EventReactor::ReactorThread()
+{
+    Trace("[%p][EventReactor::ReactorThread] start ReactorThread", this);
+
+    struct epoll_event events[MAX_REACTOR_EVENTS];
+    while (!m_bStopReactor)
+    {
+        int num = epoll_wait(m_nEpollfd, events, MAX_REACTOR_EVENTS, GetWaitTime());
+        if (num < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            Error("[%p][EventReactor::ReactorThread] epoll_wait fail,errno:%d", this, errno);
+            break;
+        }
+
+        for (int i = 0; i < num && !m_bStopReactor; i++)
+        {
+            if (events[i].data.u64 == WAKEUP_HANDLER_ID)
+            {
+                uint64_t value;
+                while (read(m_nWakeupfd, &value, sizeof(value)) > 0);
+                continue;
+            }
+            DispatchEvent(events[i].data.u64, events[i].events);
+        }
+
+        if (!m_bStopReactor)
+        {
+            RunTimers();
+        }
+    }
+
+    Trace("[%p][EventReactor::ReactorThread] exit ReactorThread", this);
+}
\ No newline at end of file
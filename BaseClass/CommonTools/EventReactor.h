@@ -0,0 +1,69 @@
+#pragma once
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <cstdint>
+#include <functional>
+
+//One epoll thread serving many sockets and timers.Callbacks run on it one at a time,so state touched only
+//from callbacks needs no lock.A socket or timer removed from the reactor thread gets no callback after the
+//call returns,even for an event already fetched;from another thread only remove while it is stopped.
+//Timers have millisecond resolution.
+class EventReactor
+{
+public:
+    typedef std::function<void(uint32_t events)> EventCallback;     //EPOLLIN,EPOLLOUT,EPOLLERR,EPOLLHUP
+    typedef std::function<void()> TimerCallback;
+
+public:
+    EventReactor();
+    ~EventReactor();
+
+    int32_t Start();
+    int32_t Stop();
+    int32_t AddSocket(int32_t fd, uint32_t events, EventCallback callback);
+    int32_t ModifySocket(int32_t fd, uint32_t events);
+    int32_t RemoveSocket(int32_t fd);
+    int32_t AddTimer(uint32_t milliseconds, bool repeat, TimerCallback callback);      //id,negative on failure
+    int32_t RemoveTimer(int32_t id);
+    inline bool IsReactorThread() { return m_pReactorThread != nullptr && m_pReactorThread->get_id() == std::this_thread::get_id(); };
+
+private:
+    typedef struct Handler
+    {
+        int32_t m_nfd = -1;
+        uint32_t m_nEvents = 0;
+        EventCallback m_pCallback;
+    }Handler;
+
+    typedef struct Timer
+    {
+        uint64_t m_lDueTime = 0;        //ms
+        uint32_t m_nInterval = 0;
+        bool m_bRepeat = false;
+        std::shared_ptr<TimerCallback> m_pCallback;
+    }Timer;
+
+    int32_t ReleaseAll();
+    void ReactorThread();
+    void DispatchEvent(uint64_t id, uint32_t events);
+    void RunTimers();
+    int32_t GetWaitTime();
+    void Wakeup();
+    static uint64_t GetTime();
+
+private:
+    int32_t m_nEpollfd;
+    int32_t m_nWakeupfd;                //eventfd,breaks epoll_wait for Stop and for timers added from other threads
+    std::atomic<bool> m_bStopReactor;
+    std::thread* m_pReactorThread;
+
+    std::mutex m_ReactorLock;
+    uint64_t m_lNextHandlerId;          //epoll data,never reused,so a stale event can not reach a new socket on the same fd
+    std::map<uint64_t, std::shared_ptr<Handler>> m_Handlers;
+    std::map<int32_t, uint64_t> m_HandlerIds;
+    int32_t m_nNextTimerId;
+    std::map<int32_t, Timer> m_Timers;
+};
\ No newline at end of file
@@ -0,0 +1,181 @@
+#include <stdlib.h>
+#include "FramePool.h"
+#include "TimeCounter.h"
+
+#define POOL_BUFF_ALIGN (64)
+#define POOL_BUFF_PADDING (64)
+#define POOL_MIN_POW2_SIZE (4096)
+#define FRAME_POOL_MAX_FREE (4)
+#define PACKET_POOL_MAX_FREE (16)
+#define POOL_IDLE_TIME (5000)               //ms,e.g. the frame size before a resolution change
+#define POOL_IDLE_CHECK_CYCLE (1000)        //ms
+
+FramePool::FramePool(SizePolicy policy, uint32_t maxFreePerSize)
+{
+    m_ePolicy = policy;
+    m_nMaxFreePerSize = maxFreePerSize;
+    m_lNextIdleCheckTime = 0;
+}
+
+FramePool::~FramePool()
+{
+    Trim();
+}
+
+std::shared_ptr<FramePool> FramePool::GetFramePool()
+{
+    static std::shared_ptr<FramePool> pool = std::make_shared<FramePool>(SIZE_EXACT, FRAME_POOL_MAX_FREE);
+    return pool;
+}
+
+std::shared_ptr<FramePool> FramePool::GetPacketPool()
+{
+    static std::shared_ptr<FramePool> pool = std::make_shared<FramePool>(SIZE_POW2, PACKET_POOL_MAX_FREE);
+    return pool;
+}
+
+uint32_t FramePool::GetBucketSize(uint32_t size)
+{
+    if (m_ePolicy == SIZE_EXACT)
+    {
+        return size;
+    }
+
+    uint32_t bucket = POOL_MIN_POW2_SIZE;
+    while (bucket < size && bucket < 0x80000000)
+    {
+        bucket <<= 1;
+    }
+    return bucket;
+}
+
+std::shared_ptr<void> FramePool::GetBuffer(uint32_t size)
+{
+    if (size == 0)
+    {
+        return nullptr;
+    }
+
+    uint32_t bucket = GetBucketSize(size);
+    void* data = nullptr;
+    std::list<void*> idleBuffers;
+    {
+        std::lock_guard<std::mutex> lock(m_PoolLock);
+        uint64_t now = TimeCounter::GetMediaTime();
+        FreeList& freeList = m_FreeBuffers[bucket];
+        freeList.m_lLastGetTime = now;
+        if (!freeList.m_Buffers.empty())
+        {
+            data = freeList.m_Buffers.front();
+            freeList.m_Buffers.pop_front();
+            m_Stats.m_nReuseNum++;
+            m_Stats.m_nFreeBuffers--;
+            m_Stats.m_nFreeBytes -= bucket;
+        }
+        if (now >= m_lNextIdleCheckTime)
+        {
+            m_lNextIdleCheckTime = now + (uint64_t)POOL_IDLE_CHECK_CYCLE * MEDIA_CLOCK_RATE / 1000;
+            TakeIdleBuffers(now, idleBuffers);
+        }
+    }
+    for (void* idle : idleBuffers)
+    {
+        free(idle);
+    }
+
+    if (data == nullptr)
+    {
+        if (posix_memalign(&data, POOL_BUFF_ALIGN, (size_t)bucket + POOL_BUFF_PADDING) != 0)
+        {
+            return nullptr;
+        }
+        std::lock_guard<std::mutex> lock(m_PoolLock);
+        m_Stats.m_nAllocNum++;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_PoolLock);
+        m_Stats.m_nOutstanding++;
+        m_Stats.m_nOutstandingBytes += bucket;
+        if (m_Stats.m_nOutstanding > m_Stats.m_nOutstandingHighWater)
+        {
+            m_Stats.m_nOutstandingHighWater = m_Stats.m_nOutstanding;
+        }
+        if (m_Stats.m_nOutstandingBytes > m_Stats.m_nOutstandingBytesHighWater)
+        {
+            m_Stats.m_nOutstandingBytesHighWater = m_Stats.m_nOutstandingBytes;
+        }
+    }
+
+    std::shared_ptr<FramePool> pool = shared_from_this();
+    return std::shared_ptr<void>(data, [pool, bucket](void* p) { pool->ReturnBuffer(p, bucket); });
+}
+
+void FramePool::ReturnBuffer(void* data, uint32_t bucket)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_PoolLock);
+        m_Stats.m_nOutstanding--;
+        m_Stats.m_nOutstandingBytes -= bucket;
+
+        //a size dropped as idle is not cached again
+        auto it = m_FreeBuffers.find(bucket);
+        if (it != m_FreeBuffers.end() && it->second.m_Buffers.size() < m_nMaxFreePerSize)
+        {
+            it->second.m_Buffers.push_back(data);
+            m_Stats.m_nFreeBuffers++;
+            m_Stats.m_nFreeBytes += bucket;
+            return;
+        }
+        m_Stats.m_nReleaseNum++;
+    }
+
+    free(data);
+}
+
+FramePool::PoolStats FramePool::GetStats()
+{
+    std::lock_guard<std::mutex> lock(m_PoolLock);
+    return m_Stats;
+}
+
+//with the lock held,the caller frees them
+void FramePool::TakeIdleBuffers(uint64_t now, std::list<void*>& buffers)
+{
+    uint64_t idle = (uint64_t)POOL_IDLE_TIME * MEDIA_CLOCK_RATE / 1000;
+    for (auto it = m_FreeBuffers.begin(); it != m_FreeBuffers.end();)
+    {
+        if (now - it->second.m_lLastGetTime < idle)
+        {
+            it++;
+            continue;
+        }
+
+        uint32_t num = (uint32_t)it->second.m_Buffers.size();
+        m_Stats.m_nReleaseNum += num;
+        m_Stats.m_nFreeBuffers -= num;
+        m_Stats.m_nFreeBytes -= (uint64_t)num * it->first;
+        buffers.splice(buffers.end(), it->second.m_Buffers);
+        it = m_FreeBuffers.erase(it);
+    }
+}
+
+void FramePool::Trim()
+{
+    std::map<uint32_t, FreeList> freeBuffers;
+    {
+        std::lock_guard<std::mutex> lock(m_PoolLock);
+        freeBuffers.swap(m_FreeBuffers);
+        m_Stats.m_nReleaseNum += m_Stats.m_nFreeBuffers;
+        m_Stats.m_nFreeBuffers = 0;
+        m_Stats.m_nFreeBytes = 0;
+    }
+
+    for (auto& it : freeBuffers)
+    {
+        for (void* data : it.second.m_Buffers)
+        {
+            free(data);
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,59 @@
+#pragma once
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+
+class FramePool : public std::enable_shared_from_this<FramePool>
+{
+public:
+    typedef enum SizePolicy
+    {
+        SIZE_EXACT = 0,     //one free list per exact size,e.g. per resolution
+        SIZE_POW2           //sizes rounded up to a power of two,for variable length payloads
+    }SizePolicy;
+
+    typedef struct PoolStats
+    {
+        uint64_t m_nAllocNum = 0;
+        uint64_t m_nReuseNum = 0;
+        uint64_t m_nReleaseNum = 0;
+        uint32_t m_nOutstanding = 0;
+        uint32_t m_nOutstandingHighWater = 0;
+        uint64_t m_nOutstandingBytes = 0;
+        uint64_t m_nOutstandingBytesHighWater = 0;
+        uint32_t m_nFreeBuffers = 0;
+        uint64_t m_nFreeBytes = 0;
+    }PoolStats;
+
+public:
+    FramePool(SizePolicy policy, uint32_t maxFreePerSize);
+    ~FramePool();
+
+    std::shared_ptr<void> GetBuffer(uint32_t size);
+    PoolStats GetStats();
+    void Trim();
+
+    static std::shared_ptr<FramePool> GetFramePool();
+    static std::shared_ptr<FramePool> GetPacketPool();
+
+private:
+    typedef struct FreeList
+    {
+        std::list<void*> m_Buffers;
+        uint64_t m_lLastGetTime = 0;        //media time
+    }FreeList;
+
+    uint32_t GetBucketSize(uint32_t size);
+    void ReturnBuffer(void* data, uint32_t bucket);
+    void TakeIdleBuffers(uint64_t now, std::list<void*>& buffers);
+
+private:
+    SizePolicy m_ePolicy;
+    uint32_t m_nMaxFreePerSize;
+    std::mutex m_PoolLock;
+    std::map<uint32_t, FreeList> m_FreeBuffers;     //a size not asked for in POOL_IDLE_TIME is dropped
+    uint64_t m_lNextIdleCheckTime;
+    PoolStats m_Stats;
+};
\ No newline at end of file
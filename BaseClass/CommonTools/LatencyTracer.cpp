@@ -0,0 +1,373 @@
+#include <stdio.h>
+#include <algorithm>
+#include "LatencyTracer.h"
+#include "TimeCounter.h"
+#include "Log/Log.h"
+
+#define DEFAULT_REPORT_INTERVAL (10*1000)
+#define CLOCK_OFFSET_UNSET (UINT64_MAX)
+
+LatencyTracer::LatencyTracer()
+{
+    m_bEnable = true;
+    m_bRemoteClock = false;
+    m_nRepairPayloadType = -1;
+    m_lClockOffset = CLOCK_OFFSET_UNSET;
+    m_nReportInterval = DEFAULT_REPORT_INTERVAL;
+    m_lNextReportTime = 0;
+
+    for (int i = 0; i < GAUGE_NUM; i++)
+    {
+        m_GaugeValue[i] = 0;
+        m_GaugeMax[i] = 0;
+    }
+    Reset();
+}
+
+LatencyTracer::~LatencyTracer()
+{
+}
+
+LatencyTracer* LatencyTracer::GetTracer()
+{
+    static LatencyTracer tracer;
+    return &tracer;
+}
+
+const char* LatencyTracer::GetStageName(Stage stage)
+{
+    switch (stage)
+    {
+    case STAGE_CAPTURE:
+        return "capture";
+    case STAGE_DECODED:
+        return "decoded";
+    case STAGE_OSD:
+        return "osd";
+    case STAGE_ENCODED:
+        return "encoded";
+    case STAGE_PACKETIZED:
+        return "packetized";
+    case STAGE_FEC:
+        return "fec";
+    case STAGE_SENT:
+        return "sent";
+    case STAGE_CLIENT_RECV:
+        return "recv";
+    case STAGE_CLIENT_FEC:
+        return "fec out";
+    case STAGE_CLIENT_DEPACKETIZED:
+        return "depacketized";
+    case STAGE_CLIENT_DECODED:
+        return "decoded";
+    default:
+        return "unknow";
+    }
+}
+
+const char* LatencyTracer::GetGaugeName(Gauge gauge)
+{
+    switch (gauge)
+    {
+    case GAUGE_CAPTURE_QUEUE:
+        return "capture queue";
+    case GAUGE_DECODED_QUEUE:
+        return "decoded queue";
+    case GAUGE_ENCODED_QUEUE:
+        return "encoded queue";
+    case GAUGE_SEND_QUEUE:
+        return "send queue";
+    case GAUGE_PACING_DELAY:
+        return "pacing delay ms";
+    case GAUGE_TCP_BACKLOG:
+        return "tcp backlog ms";
+    default:
+        return "unknow";
+    }
+}
+
+void LatencyTracer::SetEnable(bool enable)
+{
+    m_bEnable = enable;
+}
+
+void LatencyTracer::SetReportInterval(uint32_t milliseconds)
+{
+    m_nReportInterval = milliseconds;
+    m_lNextReportTime = 0;
+}
+
+void LatencyTracer::SetRemoteClock(bool remote)
+{
+    m_bRemoteClock = remote;
+    m_lClockOffset = CLOCK_OFFSET_UNSET;
+}
+
+void LatencyTracer::SetRepairPayloadType(int32_t pt)
+{
+    m_nRepairPayloadType = pt;
+}
+
+void LatencyTracer::Record(Stage stage, uint64_t pts)
+{
+    if (!m_bEnable || stage >= STAGE_NUM)
+    {
+        return;
+    }
+
+    //only the low 32 bits are compared so RTP timestamps and unwrapped PTS give the same result
+    uint32_t delay = (uint32_t)TimeCounter::GetMediaTime() - (uint32_t)pts;
+    RecordDelay(stage, delay);
+    ReportIfNeed();
+}
+
+void LatencyTracer::RecordRtp(Stage stage, const uint8_t* rtp, uint32_t size)
+{
+    if (rtp == nullptr || size < 12 || (rtp[1] & 0x7f) == m_nRepairPayloadType)
+    {
+        return;
+    }
+
+    uint32_t timestamp = (rtp[4] << 24) | (rtp[5] << 16) | (rtp[6] << 8) | rtp[7];
+    Record(stage, timestamp);
+}
+
+//With a remote clock the raw delay also holds the unknown offset between the two clocks.The smallest
+//delay seen is taken as the offset,so client stages read as time spent beyond the fastest packet.
+void LatencyTracer::RecordDelay(Stage stage, uint32_t delay)
+{
+    int64_t latency = (int32_t)delay;
+    if (m_bRemoteClock)
+    {
+        uint64_t offset = m_lClockOffset;
+        while (offset == CLOCK_OFFSET_UNSET || (int32_t)(delay - (uint32_t)offset) < 0)
+        {
+            if (m_lClockOffset.compare_exchange_weak(offset, delay))
+            {
+                offset = delay;
+                break;
+            }
+        }
+        latency = (int32_t)(delay - (uint32_t)offset);
+    }
+
+    if (latency < 0)
+    {
+        latency = 0;
+    }
+    uint64_t us = (uint64_t)latency * 1000000 / MEDIA_CLOCK_RATE;
+
+    Histogram& histogram = m_Histograms[stage];
+    histogram.m_Buckets[GetBucketIndex(us)].fetch_add(1, std::memory_order_relaxed);
+    histogram.m_nCount.fetch_add(1, std::memory_order_relaxed);
+    uint64_t max = histogram.m_lMax.load(std::memory_order_relaxed);
+    while (us > max && !histogram.m_lMax.compare_exchange_weak(max, us, std::memory_order_relaxed))
+    {
+    }
+}
+
+void LatencyTracer::SetGauge(Gauge gauge, uint32_t value)
+{
+    if (!m_bEnable || gauge >= GAUGE_NUM)
+    {
+        return;
+    }
+
+    m_GaugeValue[gauge].store(value, std::memory_order_relaxed);
+    UpdateGaugeMax(gauge, value);
+}
+
+void LatencyTracer::AddGauge(Gauge gauge, int32_t delta)
+{
+    if (gauge >= GAUGE_NUM)
+    {
+        return;
+    }
+
+    //kept up to date while disabled,the owners only report changes
+    uint32_t value = m_GaugeValue[gauge].fetch_add((uint32_t)delta, std::memory_order_relaxed) + (uint32_t)delta;
+    if (m_bEnable)
+    {
+        UpdateGaugeMax(gauge, value);
+    }
+}
+
+void LatencyTracer::UpdateGaugeMax(Gauge gauge, uint32_t value)
+{
+    uint32_t max = m_GaugeMax[gauge].load(std::memory_order_relaxed);
+    while (value > max && !m_GaugeMax[gauge].compare_exchange_weak(max, value, std::memory_order_relaxed))
+    {
+    }
+}
+
+//log-linear buckets:values below 8us are exact,above that each power of two is split in eight(<12.5% error)
+uint32_t LatencyTracer::GetBucketIndex(uint64_t us)
+{
+    if (us < 8)
+    {
+        return (uint32_t)us;
+    }
+
+    uint32_t msb = 63 - __builtin_clzll(us);
+    uint32_t index = msb * 8 + ((us >> (msb - 3)) & 7);
+    return index < LATENCY_BUCKET_NUM ? index : LATENCY_BUCKET_NUM - 1;
+}
+
+uint64_t LatencyTracer::GetBucketUpperBound(uint32_t index)
+{
+    if (index < 8)
+    {
+        return index;
+    }
+
+    uint32_t msb = index / 8;
+    uint64_t step = 1ULL << (msb - 3);
+    return (8 + (index % 8)) * step + step - 1;
+}
+
+LatencyTracer::StageStats LatencyTracer::GetStageStats(Stage stage)
+{
+    StageStats stats;
+    if (stage >= STAGE_NUM)
+    {
+        return stats;
+    }
+
+    Histogram& histogram = m_Histograms[stage];
+    uint32_t buckets[LATENCY_BUCKET_NUM];
+    uint64_t count = 0;
+    for (int i = 0; i < LATENCY_BUCKET_NUM; i++)
+    {
+        buckets[i] = histogram.m_Buckets[i].load(std::memory_order_relaxed);
+        count += buckets[i];
+    }
+    stats.m_nCount = count;
+    stats.m_lMax = histogram.m_lMax.load(std::memory_order_relaxed);
+    if (count == 0)
+    {
+        return stats;
+    }
+
+    uint64_t p50 = (count * 50 + 99) / 100;
+    uint64_t p95 = (count * 95 + 99) / 100;
+    uint64_t p99 = (count * 99 + 99) / 100;
+    uint64_t sum = 0;
+    for (int i = 0; i < LATENCY_BUCKET_NUM; i++)
+    {
+        if (buckets[i] == 0)
+        {
+            continue;
+        }
+        uint64_t lastSum = sum;
+        sum += buckets[i];
+        uint64_t bound = std::min(GetBucketUpperBound(i), stats.m_lMax);
+        if (lastSum < p50 && sum >= p50)
+        {
+            stats.m_lP50 = bound;
+        }
+        if (lastSum < p95 && sum >= p95)
+        {
+            stats.m_lP95 = bound;
+        }
+        if (lastSum < p99 && sum >= p99)
+        {
+            stats.m_lP99 = bound;
+        }
+    }
+
+    return stats;
+}
+
+LatencyTracer::GaugeStats LatencyTracer::GetGaugeStats(Gauge gauge)
+{
+    GaugeStats stats;
+    if (gauge >= GAUGE_NUM)
+    {
+        return stats;
+    }
+
+    stats.m_nValue = m_GaugeValue[gauge].load(std::memory_order_relaxed);
+    stats.m_nMax = m_GaugeMax[gauge].load(std::memory_order_relaxed);
+    return stats;
+}
+
+std::string LatencyTracer::FormatStats()
+{
+    std::string result;
+    char buff[160];
+    for (int i = 0; i < STAGE_NUM; i++)
+    {
+        StageStats stats = GetStageStats((Stage)i);
+        if (stats.m_nCount == 0)
+        {
+            continue;
+        }
+        snprintf(buff, sizeof(buff), "%s[n:%llu p50:%llu p95:%llu p99:%llu max:%llu] ", GetStageName((Stage)i),
+            (unsigned long long)stats.m_nCount, (unsigned long long)stats.m_lP50, (unsigned long long)stats.m_lP95,
+            (unsigned long long)stats.m_lP99, (unsigned long long)stats.m_lMax);
+        result += buff;
+    }
+
+    for (int i = 0; i < GAUGE_NUM; i++)
+    {
+        GaugeStats stats = GetGaugeStats((Gauge)i);
+        if (stats.m_nMax == 0)
+        {
+            continue;
+        }
+        snprintf(buff, sizeof(buff), "%s[%u max:%u] ", GetGaugeName((Gauge)i), stats.m_nValue, stats.m_nMax);
+        result += buff;
+    }
+
+    return result;
+}
+
+void LatencyTracer::Reset()
+{
+    for (int i = 0; i < STAGE_NUM; i++)
+    {
+        for (int j = 0; j < LATENCY_BUCKET_NUM; j++)
+        {
+            m_Histograms[i].m_Buckets[j].store(0, std::memory_order_relaxed);
+        }
+        m_Histograms[i].m_nCount.store(0, std::memory_order_relaxed);
+        m_Histograms[i].m_lMax.store(0, std::memory_order_relaxed);
+    }
+
+    for (int i = 0; i < GAUGE_NUM; i++)
+    {
+        m_GaugeMax[i].store(m_GaugeValue[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+
+    //relearn the offset each window so clock drift between the two ends does not accumulate
+    m_lClockOffset = CLOCK_OFFSET_UNSET;
+}
+
+void LatencyTracer::ReportIfNeed()
+{
+    uint32_t interval = m_nReportInterval;
+    if (interval == 0)
+    {
+        return;
+    }
+
+    uint64_t now = TimeCounter::GetMediaTime();
+    uint64_t next = m_lNextReportTime;
+    if (now < next)
+    {
+        return;
+    }
+
+    //whoever wins the exchange writes the report,the other threads keep recording
+    uint64_t newNext = now + (uint64_t)interval * MEDIA_CLOCK_RATE / 1000;
+    if (!m_lNextReportTime.compare_exchange_strong(next, newNext))
+    {
+        return;
+    }
+
+    if (next != 0)
+    {
+        Trace("[%p][LatencyTracer::ReportIfNeed] latency(us) %s", this, FormatStats().c_str());
+    }
+    Reset();
+}
\ No newline at end of file
@@ -0,0 +1,105 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#define LATENCY_BUCKET_NUM (192)     //up to ~16s
+
+//Per-stage latency of the video pipeline.Every stage is measured against the frame PTS (capture time in
+//MEDIA_CLOCK_RATE units),so no per-frame state is kept and recording is lock free.
+class LatencyTracer
+{
+public:
+    typedef enum Stage
+    {
+        STAGE_CAPTURE = 0,
+        STAGE_DECODED,
+        STAGE_OSD,
+        STAGE_ENCODED,
+        STAGE_PACKETIZED,
+        STAGE_FEC,
+        STAGE_SENT,
+        STAGE_CLIENT_RECV,
+        STAGE_CLIENT_FEC,
+        STAGE_CLIENT_DEPACKETIZED,
+        STAGE_CLIENT_DECODED,
+        STAGE_NUM
+    }Stage;
+
+    typedef enum Gauge
+    {
+        GAUGE_CAPTURE_QUEUE = 0,
+        GAUGE_DECODED_QUEUE,
+        GAUGE_ENCODED_QUEUE,
+        GAUGE_SEND_QUEUE,               //summed over the sessions,see AddGauge
+        GAUGE_PACING_DELAY,             //ms,worst of the last second
+        GAUGE_TCP_BACKLOG,              //ms a TCP viewer is behind,socket and writer queue
+        GAUGE_NUM
+    }Gauge;
+
+    typedef struct StageStats
+    {
+        uint64_t m_nCount = 0;
+        uint64_t m_lP50 = 0;        //microseconds
+        uint64_t m_lP95 = 0;
+        uint64_t m_lP99 = 0;
+        uint64_t m_lMax = 0;
+    }StageStats;
+
+    typedef struct GaugeStats
+    {
+        uint32_t m_nValue = 0;
+        uint32_t m_nMax = 0;
+    }GaugeStats;
+
+public:
+    LatencyTracer();
+    ~LatencyTracer();
+
+    static LatencyTracer* GetTracer();
+    static const char* GetStageName(Stage stage);
+    static const char* GetGaugeName(Gauge gauge);
+
+    void SetEnable(bool enable);
+    inline bool IsEnable() { return m_bEnable; };
+    void SetReportInterval(uint32_t milliseconds);      //0 disables the periodic log
+    void SetRemoteClock(bool remote);                   //PTS come from the sender's clock,see RecordDelay
+    void SetRepairPayloadType(int32_t pt);              //FEC repair packets carry no usable timestamp,-1 for none
+
+    void Record(Stage stage, uint64_t pts);
+    void RecordRtp(Stage stage, const uint8_t* rtp, uint32_t size);
+    void SetGauge(Gauge gauge, uint32_t value);
+    void AddGauge(Gauge gauge, int32_t delta);          //for a gauge several owners contribute to
+
+    //statistics since the last periodic report or Reset
+    StageStats GetStageStats(Stage stage);
+    GaugeStats GetGaugeStats(Gauge gauge);
+    std::string FormatStats();
+    void Reset();
+
+private:
+    typedef struct Histogram
+    {
+        std::atomic<uint32_t> m_Buckets[LATENCY_BUCKET_NUM];
+        std::atomic<uint64_t> m_nCount;
+        std::atomic<uint64_t> m_lMax;
+    }Histogram;
+
+    void RecordDelay(Stage stage, uint32_t delay);
+    void UpdateGaugeMax(Gauge gauge, uint32_t value);
+    void ReportIfNeed();
+    static uint32_t GetBucketIndex(uint64_t us);
+    static uint64_t GetBucketUpperBound(uint32_t index);
+
+private:
+    std::atomic<bool> m_bEnable;
+    std::atomic<bool> m_bRemoteClock;
+    std::atomic<int32_t> m_nRepairPayloadType;
+    std::atomic<uint64_t> m_lClockOffset;
+    std::atomic<uint32_t> m_nReportInterval;
+    std::atomic<uint64_t> m_lNextReportTime;
+
+    Histogram m_Histograms[STAGE_NUM];
+    std::atomic<uint32_t> m_GaugeValue[GAUGE_NUM];
+    std::atomic<uint32_t> m_GaugeMax[GAUGE_NUM];
+};
\ No newline at end of file
@@ -0,0 +1,134 @@
+#include "PacketRing.h"
+#include "Log/Log.h"
+
+#define MIN_RING_SLOT_NUM (16)
+
+PacketRing::PacketRing()
+{
+    m_pSlots = nullptr;
+    m_pBuffer = nullptr;
+    m_nSlotSize = 0;
+    m_nMask = 0;
+}
+
+PacketRing::~PacketRing()
+{
+    ReleaseAll();
+}
+
+int32_t PacketRing::ReleaseAll()
+{
+    delete[] m_pSlots;
+    m_pSlots = nullptr;
+    free(m_pBuffer);
+    m_pBuffer = nullptr;
+    m_nSlotSize = 0;
+    m_nMask = 0;
+
+    return 0;
+}
+
+int32_t PacketRing::Init(uint32_t budget, uint32_t maxPacketSize)
+{
+    if (m_pSlots != nullptr)
+    {
+        Error("[%p][PacketRing::Init] already init", this);
+        return -1;
+    }
+    if (maxPacketSize < 12 || maxPacketSize > 0xffff)
+    {
+        Error("[%p][PacketRing::Init] max packet size:%u err", this, maxPacketSize);
+        return -2;
+    }
+
+    //the ring has to wrap evenly inside the 16 bit seq space,and holds a few packets whatever the budget
+    uint32_t num = MIN_RING_SLOT_NUM;
+    while (num * 2 <= budget / maxPacketSize && num * 2 <= 0x8000)
+    {
+        num *= 2;
+    }
+
+    m_pBuffer = (uint8_t*)malloc((size_t)num * maxPacketSize);
+    if (m_pBuffer == nullptr)
+    {
+        Error("[%p][PacketRing::Init] malloc %u slots of %u fail", this, num, maxPacketSize);
+        return -3;
+    }
+    m_pSlots = new Slot[num];
+    m_nSlotSize = maxPacketSize;
+    m_nMask = num - 1;
+    Trace("[%p][PacketRing::Init] budget:%u -> %u slots of %u", this, budget, num, maxPacketSize);
+
+    return 0;
+}
+
+int32_t PacketRing::Store(const std::shared_ptr<Packet>& packet, uint64_t time)
+{
+    if (m_pSlots == nullptr)
+    {
+        return -1;
+    }
+    if (packet->m_nLength < 12 || packet->m_nLength > m_nSlotSize)
+    {
+        return -2;
+    }
+
+    uint16_t seq = (packet->m_pData[2] << 8) | packet->m_pData[3];
+    uint32_t index = seq & m_nMask;
+    Slot& slot = m_pSlots[index];
+    uint32_t version = slot.m_nVersion.load(std::memory_order_relaxed);
+    slot.m_nVersion.store(version + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot.m_nSeq = seq;
+    slot.m_nLength = packet->m_nLength;
+    slot.m_lTime = time;
+    memcpy(m_pBuffer + (size_t)index * m_nSlotSize, packet->m_pData, packet->m_nLength);
+
+    slot.m_nVersion.store(version + 2, std::memory_order_release);
+    return 0;
+}
+
+std::shared_ptr<Packet> PacketRing::Lookup(uint16_t seq, uint64_t& time)
+{
+    if (m_pSlots == nullptr)
+    {
+        return nullptr;
+    }
+
+    uint32_t index = seq & m_nMask;
+    Slot& slot = m_pSlots[index];
+    uint32_t version = slot.m_nVersion.load(std::memory_order_acquire);
+    if (version == 0 || (version & 1) != 0 || slot.m_nSeq != seq)
+    {
+        return nullptr;
+    }
+
+    uint32_t length = slot.m_nLength;
+    uint64_t stored = slot.m_lTime;
+    if (length > m_nSlotSize)
+    {
+        return nullptr;
+    }
+    uint8_t* data = (uint8_t*)malloc(length);
+    if (data == nullptr)
+    {
+        Error("[%p][PacketRing::Lookup] malloc size:%u fail", this, length);
+        return nullptr;
+    }
+    memcpy(data, m_pBuffer + (size_t)index * m_nSlotSize, length);
+
+    //the producer went round the ring meanwhile,the copy may be torn
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.m_nVersion.load(std::memory_order_relaxed) != version)
+    {
+        free(data);
+        return nullptr;
+    }
+
+    std::shared_ptr<Packet> packet = std::make_shared<Packet>();
+    packet->m_pData = data;
+    packet->m_nLength = length;
+    time = stored;
+    return packet;
+}
\ No newline at end of file
@@ -0,0 +1,38 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <cstdint>
+#include "Common.h"
+
+//Fixed ring of RTP packets indexed by seq & mask,for answering NACKs.The bytes are copied into
+//slots allocated once,so storing costs no allocation.One thread stores,any thread looks up:
+//a slot's version is odd while it is written,and a reader keeps its copy only if the version
+//did not move during the copy.
+class PacketRing
+{
+public:
+    PacketRing();
+    ~PacketRing();
+
+    int32_t Init(uint32_t budget, uint32_t maxPacketSize);     //budget in bytes,slots rounded down to a power of two
+    int32_t Store(const std::shared_ptr<Packet>& packet, uint64_t time);       //single producer
+    std::shared_ptr<Packet> Lookup(uint16_t seq, uint64_t& time);       //a copy,nullptr when never stored or overwritten
+    inline uint32_t GetCapacity() { return m_nMask + 1; };
+
+private:
+    typedef struct Slot
+    {
+        std::atomic<uint32_t> m_nVersion{ 0 };      //0 never written
+        uint16_t m_nSeq = 0;
+        uint16_t m_nLength = 0;
+        uint64_t m_lTime = 0;
+    }Slot;
+
+    int32_t ReleaseAll();
+
+private:
+    Slot* m_pSlots;
+    uint8_t* m_pBuffer;
+    uint32_t m_nSlotSize;
+    uint32_t m_nMask;
+};
\ No newline at end of file
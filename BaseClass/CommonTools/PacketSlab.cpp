@@ -0,0 +1,86 @@
+#include <stdlib.h>
+#include "PacketSlab.h"
+#include "Log/Log.h"
+
+#define SLAB_SLOT_ALIGN (64)
+
+PacketSlab::PacketSlab()
+{
+    m_pBuffer = nullptr;
+    m_nSlotSize = 0;
+    m_nSlotNum = 0;
+}
+
+PacketSlab::~PacketSlab()
+{
+    ReleaseAll();
+}
+
+int32_t PacketSlab::ReleaseAll()
+{
+    free(m_pBuffer);
+    m_pBuffer = nullptr;
+    m_nSlotSize = 0;
+    m_nSlotNum = 0;
+    m_FreeSlots.clear();
+
+    return 0;
+}
+
+int32_t PacketSlab::Init(uint32_t slotNum, uint32_t slotSize)
+{
+    if (m_pBuffer != nullptr)
+    {
+        Error("[%p][PacketSlab::Init] already init", this);
+        return -1;
+    }
+    if (slotNum == 0 || slotSize == 0)
+    {
+        Error("[%p][PacketSlab::Init] slot num:%u size:%u err", this, slotNum, slotSize);
+        return -2;
+    }
+
+    //keep every slot on its own cache lines
+    slotSize = (slotSize + SLAB_SLOT_ALIGN - 1) / SLAB_SLOT_ALIGN * SLAB_SLOT_ALIGN;
+    void* buffer = nullptr;
+    if (posix_memalign(&buffer, SLAB_SLOT_ALIGN, (size_t)slotNum * slotSize) != 0)
+    {
+        Error("[%p][PacketSlab::Init] alloc %u slots of %u fail", this, slotNum, slotSize);
+        return -3;
+    }
+
+    m_pBuffer = (uint8_t*)buffer;
+    m_nSlotSize = slotSize;
+    m_nSlotNum = slotNum;
+    m_FreeSlots.reserve(slotNum);
+    for (uint32_t i = slotNum; i > 0; i--)
+    {
+        m_FreeSlots.push_back(i - 1);
+    }
+    Trace("[%p][PacketSlab::Init] %u slots of %u", this, slotNum, slotSize);
+
+    return 0;
+}
+
+std::shared_ptr<void> PacketSlab::GetSlot()
+{
+    uint32_t index = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_SlabLock);
+        if (m_FreeSlots.empty())
+        {
+            return nullptr;
+        }
+        index = m_FreeSlots.back();
+        m_FreeSlots.pop_back();
+    }
+
+    std::shared_ptr<PacketSlab> slab = shared_from_this();
+    return std::shared_ptr<void>(m_pBuffer + (size_t)index * m_nSlotSize, [slab, index](void*) { slab->ReturnSlot(index); });
+}
+
+void PacketSlab::ReturnSlot(uint32_t index)
+{
+    std::lock_guard<std::mutex> lock(m_SlabLock);
+    m_FreeSlots.push_back(index);
+}
\ No newline at end of file
@@ -0,0 +1,30 @@
+#pragma once
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <cstdint>
+
+//Fixed size receive buffers carved out of one allocation,for reading datagrams straight into the
+//Packet that carries them on.A slot goes back to the free stack when the last reference to it drops,
+//whichever thread that is;the slab itself lives until its last slot is returned.
+class PacketSlab : public std::enable_shared_from_this<PacketSlab>
+{
+public:
+    PacketSlab();
+    ~PacketSlab();
+
+    int32_t Init(uint32_t slotNum, uint32_t slotSize);
+    std::shared_ptr<void> GetSlot();        //nullptr when every slot is out
+    inline uint32_t GetSlotSize() { return m_nSlotSize; };
+
+private:
+    int32_t ReleaseAll();
+    void ReturnSlot(uint32_t index);
+
+private:
+    uint8_t* m_pBuffer;
+    uint32_t m_nSlotSize;
+    uint32_t m_nSlotNum;
+    std::mutex m_SlabLock;
+    std::vector<uint32_t> m_FreeSlots;
+};
\ No newline at end of file
@@ -19,4 +19,15 @@ double TimeCounter::GetDuration()
     std::chrono::steady_clock::time_point nowTime = std::chrono::steady_clock::now();
     std::chrono::duration<double> timeInterval = std::chrono::duration_cast<std::chrono::duration<double>>(nowTime - m_LastTimePoint);
     return timeInterval.count() * 1000;
+}
+
+uint64_t TimeCounter::GetMediaTime()
+{
+    std::chrono::microseconds now = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch());
+    return MicrosecondsToMediaTime(now.count());
+}
+
+uint64_t TimeCounter::MicrosecondsToMediaTime(uint64_t us)
+{
+    return (us / 1000000) * MEDIA_CLOCK_RATE + (us % 1000000) * MEDIA_CLOCK_RATE / 1000000;
 }
\ No newline at end of file
@@ -1,5 +1,8 @@
 #pragma once
 #include <chrono>
+#include <cstdint>
+
+#define MEDIA_CLOCK_RATE (90000)
 
 class TimeCounter
 {
@@ -10,6 +13,9 @@ public:
     void MakeTimePoint();
     double GetDuration();
 
+    static uint64_t GetMediaTime();     //CLOCK_MONOTONIC in MEDIA_CLOCK_RATE units
+    static uint64_t MicrosecondsToMediaTime(uint64_t us);
+
 private:
     std::chrono::steady_clock::time_point m_LastTimePoint;
 };
\ No newline at end of file
@@ -1,12 +1,33 @@
 #include "FEC2DTable.h"
+#include "XORKernel.h"
 #include "Log/Log.h"
 
+//when a table may close early,align=frame or delay= in a=x-fec,every repair grows past the RFC 8627
+//header by the number of packets in its table(2),0 while the table is still open,and the media ssrc(4);
+//the R and F bits keep their RFC meaning
+#define FEC_HEADER_SIZE (24)
+#define SIZED_FEC_HEADER_SIZE (30)
+
 FEC2DTable::FEC2DTable(uint8_t pt)
 {
     m_nPayloadType = pt;
     m_nBaseSeq = -1;
     m_nRowNum = 0;
     m_nColumnNum = 0;
+    m_bFrameAligned = false;
+    m_bSizeField = false;
+    m_nTableSourceNum = 0;
+    memset(m_LastTimestamp, 0, sizeof(m_LastTimestamp));
+    memset(m_MediaSSRC, 0, sizeof(m_MediaSSRC));
+    for (int i = 0; i < PACKET_PRIORITY_NUM; i++)
+    {
+        m_bRowRepair[i] = true;
+        m_bColumnRepair[i] = true;
+        m_bNextRowRepair[i] = true;
+        m_bNextColumnRepair[i] = true;
+    }
+    m_bAnyRowRepair = true;
+    m_bAnyColumnRepair = true;
 }
 
 FEC2DTable::~FEC2DTable()
@@ -28,6 +49,12 @@ int32_t FEC2DTable::ReleaseAll()
     m_pRowRepairPacket.clear();
     m_pColumnRepairPacket.clear();
 
+    m_pRowMask.clear();
+    m_pRowPriority.clear();
+    m_pColumnPriority.clear();
+    m_RowParity.clear();
+    m_ColumnParity.clear();
+
     m_nRowNum = 0;
     m_nColumnNum = 0;
     m_nBaseSeq = -1;
@@ -77,6 +104,12 @@ int32_t FEC2DTable::Init(uint8_t row, uint8_t column)
         m_pColumnRepairPacket.push_back(nullptr);
     }
 
+    m_pRowMask.assign(m_nRowNum, 0);
+    m_pRowPriority.assign(m_nRowNum, PACKET_PRIORITY_LOW);
+    m_pColumnPriority.assign(m_nColumnNum, PACKET_PRIORITY_LOW);
+    m_RowParity.resize(m_nRowNum);
+    m_ColumnParity.resize(m_nColumnNum);
+
     return 0;
 fail:
     ReleaseAll();
@@ -111,13 +144,67 @@ void FEC2DTable::ClearTable()
         item = nullptr;
     }
 
+    for (auto& item : m_pRowMask)
+    {
+        item = 0;
+    }
+    for (auto& item : m_pRowPriority)
+    {
+        item = PACKET_PRIORITY_LOW;
+    }
+    for (auto& item : m_pColumnPriority)
+    {
+        item = PACKET_PRIORITY_LOW;
+    }
+    for (auto& item : m_RowParity)
+    {
+        ResetParity(item);
+    }
+    for (auto& item : m_ColumnParity)
+    {
+        ResetParity(item);
+    }
+
+    m_pEvictedPackets.clear();
     m_nBaseSeq = -1;
+    m_nTableSourceNum = 0;
     m_Range1.max = INT32_MIN;
     m_Range1.min = INT32_MAX;
     m_Range2.max = INT32_MIN;
     m_Range2.min = INT32_MAX;
 }
 
+void FEC2DTable::SetFrameAligned(bool aligned)
+{
+    m_bFrameAligned = aligned;
+}
+
+void FEC2DTable::SetSizeField(bool enable)
+{
+    m_bSizeField = enable;
+}
+
+void FEC2DTable::SetRepairDirection(uint8_t priority, bool row, bool column)
+{
+    if (priority >= PACKET_PRIORITY_NUM)
+    {
+        return;
+    }
+
+    m_bNextRowRepair[priority] = row;
+    m_bNextColumnRepair[priority] = column;
+}
+
+float FEC2DTable::GetRepairOverhead(bool row, bool column)
+{
+    if (m_nRowNum == 0 || m_nColumnNum == 0)
+    {
+        return 0;
+    }
+
+    return (row ? 1.0f / m_nColumnNum : 0) + (column ? 1.0f / m_nRowNum : 0);
+}
+
 bool FEC2DTable::SetFECPacketCallback(FECPacketCallback callback)
 {
     m_pFECPacketCallback = callback;
@@ -141,10 +228,12 @@ bool FEC2DTable::IsSeqInRange(uint16_t seq)
     return ret1 || ret2;
 }
 
-void FEC2DTable::UpdataRange(uint16_t seq)
+void FEC2DTable::UpdataRange(uint16_t seq, uint32_t num)
 {
     m_nBaseSeq = seq;
-    int32_t nMaxSeq = m_nBaseSeq + (m_nRowNum * m_nColumnNum) - 1;
+    int32_t nMaxSeq = m_nBaseSeq + num - 1;
+    m_Range2.max = INT32_MIN;
+    m_Range2.min = INT32_MAX;
     m_Range1.min = seq;
     if (nMaxSeq < 65536)
     {
@@ -170,12 +259,68 @@ void FEC2DTable::CalculateRowAndColumn(uint16_t seq, uint32_t& row, uint32_t& co
     col = n % m_nColumnNum;
 }
 
+//decoder,the table is shorter than row*column,packets past its end belong to the next table and are
+//handed back through TakeEvictedPackets
+void FEC2DTable::SetShortTableSize(uint32_t num)
+{
+    m_nTableSourceNum = num;
+    UpdataRange(m_nBaseSeq, num);
+    for (uint32_t n = num; n < (uint32_t)(m_nRowNum * m_nColumnNum); n++)
+    {
+        uint32_t row = n / m_nColumnNum;
+        uint32_t col = n % m_nColumnNum;
+        if (m_pFecTable[row][col] != nullptr)
+        {
+            m_pEvictedPackets.push_back(m_pFecTable[row][col]);
+            m_pFecTable[row][col] = nullptr;
+            m_pRowCounter[row]--;
+            m_pColumnCounter[col]--;
+        }
+    }
+}
+
+uint32_t FEC2DTable::GetRowSize(uint32_t row)
+{
+    if (m_nTableSourceNum == 0)
+    {
+        return m_nColumnNum;
+    }
+
+    uint32_t nStart = row * m_nColumnNum;
+    if (nStart >= m_nTableSourceNum)
+    {
+        return 0;
+    }
+    return m_nTableSourceNum - nStart < m_nColumnNum ? m_nTableSourceNum - nStart : m_nColumnNum;
+}
+
+uint32_t FEC2DTable::GetColumnSize(uint32_t col)
+{
+    if (m_nTableSourceNum == 0)
+    {
+        return m_nRowNum;
+    }
+
+    return m_nTableSourceNum / m_nColumnNum + (col < m_nTableSourceNum % m_nColumnNum ? 1 : 0);
+}
+
 int32_t FEC2DTable::RecvPacketAndMakeRepair(const std::shared_ptr<Packet>& packet)
 {
     uint16_t seq = (packet->m_pData[2] << 8) | packet->m_pData[3];
     if (m_nBaseSeq == -1)
     {
-        UpdataRange(seq);
+        UpdataRange(seq, m_nRowNum * m_nColumnNum);
+        m_bAnyRowRepair = false;
+        m_bAnyColumnRepair = false;
+        for (int i = 0; i < PACKET_PRIORITY_NUM; i++)
+        {
+            m_bRowRepair[i] = m_bNextRowRepair[i];
+            m_bColumnRepair[i] = m_bNextColumnRepair[i];
+            m_bAnyRowRepair = m_bAnyRowRepair || m_bRowRepair[i];
+            m_bAnyColumnRepair = m_bAnyColumnRepair || m_bColumnRepair[i];
+        }
+        memcpy(m_MediaSSRC, packet->m_pData + 8, 4);
+        m_TableTimer.MakeTimePoint();
     }
 
     if (IsSeqInRange(seq))
@@ -184,40 +329,73 @@ int32_t FEC2DTable::RecvPacketAndMakeRepair(const std::shared_ptr<Packet>& packe
         uint32_t col = 0;
         CalculateRowAndColumn(seq, row, col);
 
-        if (m_pFecTable[row][col] == nullptr)
+        //the packet is folded into its row and column parity here and not kept
+        if ((m_pRowMask[row] & (1u << col)) == 0)
         {
-            m_pFecTable[row][col] = packet;
+            m_pRowMask[row] |= 1u << col;
             m_pRowCounter[row]++;
             m_pColumnCounter[col]++;
+            if (row * m_nColumnNum + col + 1 > m_nTableSourceNum)
+            {
+                m_nTableSourceNum = row * m_nColumnNum + col + 1;
+                memcpy(m_LastTimestamp, packet->m_pData + 4, 4);
+            }
+            uint8_t priority = packet->m_nPriority < PACKET_PRIORITY_NUM ? packet->m_nPriority : (uint8_t)PACKET_PRIORITY_NORMAL;
+            m_pRowPriority[row] = m_pRowPriority[row] > priority ? m_pRowPriority[row] : priority;
+            m_pColumnPriority[col] = m_pColumnPriority[col] > priority ? m_pColumnPriority[col] : priority;
 
-            if (m_pRowCounter[row] == m_nColumnNum)
+            //a line is accumulated if any class may want it,the most important packet in it decides
+            if (m_bAnyRowRepair)
             {
-                std::shared_ptr<Packet> pRepairPacket = CreateRepairPacketByRow(row);
-                if (pRepairPacket == nullptr)
+                AccumulateParity(m_RowParity[row], packet, col == (uint32_t)(m_nColumnNum - 1));
+                if (m_pRowCounter[row] == m_nColumnNum && !m_bRowRepair[m_pRowPriority[row]])
                 {
-                    Error("[%p][FEC2DTable::RecvPacketAndMakeRepair] create repair packet by row:%d fail", this, row);
+                    ResetParity(m_RowParity[row]);
                 }
-                else
+                else if (m_pRowCounter[row] == m_nColumnNum)
                 {
-                    m_pRowRepairPacket[row] = pRepairPacket;
-                    OutputFECPacket(pRepairPacket);
+                    std::shared_ptr<Packet> pRepairPacket = TakeRepairPacket(m_RowParity[row], 0);
+                    if (pRepairPacket == nullptr)
+                    {
+                        Error("[%p][FEC2DTable::RecvPacketAndMakeRepair] create repair packet by row:%d fail", this, row);
+                    }
+                    else
+                    {
+                        pRepairPacket->m_pData[22] = m_nColumnNum + 1;
+                        pRepairPacket->m_pData[23] = row + 1;
+                        OutputFECPacket(pRepairPacket);
+                    }
                 }
             }
 
-            if (m_pColumnCounter[col] == m_nRowNum)
+            if (m_bAnyColumnRepair)
             {
-                std::shared_ptr<Packet> pRepairPacket = CreateRepairPacketByColumn(col);
-                if (pRepairPacket == nullptr)
+                AccumulateParity(m_ColumnParity[col], packet, row == (uint32_t)(m_nRowNum - 1));
+                if (m_pColumnCounter[col] == m_nRowNum && !m_bColumnRepair[m_pColumnPriority[col]])
                 {
-                    Error("[%p][FEC2DTable::RecvPacketAndMakeRepair] create repair packet by col:%d fail", this, col);
+                    ResetParity(m_ColumnParity[col]);
                 }
-                else
+                else if (m_pColumnCounter[col] == m_nRowNum)
                 {
-                    m_pColumnRepairPacket[col] = pRepairPacket;
-                    OutputFECPacket(pRepairPacket);
+                    std::shared_ptr<Packet> pRepairPacket = TakeRepairPacket(m_ColumnParity[col], 0);
+                    if (pRepairPacket == nullptr)
+                    {
+                        Error("[%p][FEC2DTable::RecvPacketAndMakeRepair] create repair packet by col:%d fail", this, col);
+                    }
+                    else
+                    {
+                        pRepairPacket->m_pData[22] = col + 1;
+                        pRepairPacket->m_pData[23] = m_nRowNum + 1;
+                        OutputFECPacket(pRepairPacket);
+                    }
                 }
             }
         }
+
+        if (m_bFrameAligned && (packet->m_pData[1] & 0x80) == 0x80)
+        {
+            CloseBlock();
+        }
     }
     else
     {
@@ -228,164 +406,151 @@ int32_t FEC2DTable::RecvPacketAndMakeRepair(const std::shared_ptr<Packet>& packe
     return 0;
 }
 
-std::shared_ptr<Packet> FEC2DTable::CreateRepairPacket(uint8_t** data, uint16_t* size, uint32_t nPackNum, uint32_t nMaxLen)
+//rows and columns still open get their repair now,a full table has sent them all already
+void FEC2DTable::CloseBlock()
 {
-    std::shared_ptr<Packet> pRepairPacket = nullptr;
-    size_t nRepairPacketSize = nMaxLen + 12;
-    uint8_t* pRepairPacketData = (uint8_t*)malloc(nRepairPacketSize);
-    if (pRepairPacketData == nullptr)
-    {
-        Error("[%p][FEC2DTable::CreateRepairPacketByRow] malloc repair packet fail", this);
-        return pRepairPacket;
-    }
-    memset(pRepairPacketData, 0, nRepairPacketSize);
-
-    //RTP Head
-    pRepairPacketData[0] = 0x80;
-    //pRepairPacketData[1]
-    //pRepairPacketData[2]
-    //pRepairPacketData[3]
-    pRepairPacketData[4] = data[nPackNum - 1][4];
-    pRepairPacketData[5] = data[nPackNum - 1][5];
-    pRepairPacketData[6] = data[nPackNum - 1][6];
-    pRepairPacketData[7] = data[nPackNum - 1][7];
-    //pRepairPacketData[8]
-    //pRepairPacketData[9] 
-    //pRepairPacketData[10]
-    //pRepairPacketData[11]
-
-    //FEC Head
-    uint8_t nTempByte = 0;
-    for (uint32_t i = 0; i < nPackNum; i++)
-    {
-        nTempByte ^= data[i][0];
-        pRepairPacketData[13] ^= data[i][1];
-        pRepairPacketData[16] ^= data[i][4];
-        pRepairPacketData[17] ^= data[i][5];
-        pRepairPacketData[18] ^= data[i][6];
-        pRepairPacketData[19] ^= data[i][7];
-    }
-    pRepairPacketData[12] = 0x40 | (nTempByte & 0x3f);
-    uint16_t nTempSize = 0;
-    for (uint32_t i = 0; i < nPackNum; i++)
+    if (m_nBaseSeq == -1)
     {
-        nTempSize ^= size[i];
+        return;
     }
-    pRepairPacketData[14] = nTempSize >> 8;
-    pRepairPacketData[15] = nTempSize & 0xff;
-    pRepairPacketData[20] = m_nBaseSeq >> 8;
-    pRepairPacketData[21] = m_nBaseSeq & 0xff;
-    // L(columns) and D(rows) be filled in outside
-    //pRepairPacketData[22];
-    //pRepairPacketData[23];
 
-    //FEC Repair Payload
-    for (uint32_t i = 0; i < nPackNum; i++)
+    //the repair of a row or column of one packet is a plain copy of it,a whole packet to cover one loss,
+    //so neither direction sends it;the other direction still covers that packet when it has company there
+    //without the size field a short repair would be taken for one of a full line,the open lines go unprotected
+    if (m_bSizeField && m_nTableSourceNum < (uint32_t)(m_nRowNum * m_nColumnNum))
     {
-        for (uint32_t j = 12; j < nMaxLen; j++)
+        if (m_bAnyRowRepair)
         {
-            if (j >= size[i])
+            for (uint32_t row = 0; row < m_nRowNum; row++)
             {
-                continue;
+                if (m_pRowCounter[row] > 1 && m_pRowCounter[row] < m_nColumnNum && m_bRowRepair[m_pRowPriority[row]])
+                {
+                    OutputShortRepairPacket(m_RowParity[row], m_nColumnNum + 1, row + 1);
+                }
             }
+        }
 
-            pRepairPacketData[j + 12] ^= data[i][j];
+        if (m_bAnyColumnRepair)
+        {
+            for (uint32_t col = 0; col < m_nColumnNum; col++)
+            {
+                if (m_pColumnCounter[col] > 1 && m_pColumnCounter[col] < m_nRowNum && m_bColumnRepair[m_pColumnPriority[col]])
+                {
+                    OutputShortRepairPacket(m_ColumnParity[col], col + 1, m_nRowNum + 1);
+                }
+            }
         }
     }
 
-    pRepairPacket = std::make_shared<Packet>();
-    pRepairPacket->m_nLength = nRepairPacketSize;
-    pRepairPacket->m_pData = pRepairPacketData;
+    ClearTable();
+}
 
-    return pRepairPacket;
+double FEC2DTable::GetBlockAge()
+{
+    return m_nBaseSeq == -1 ? 0 : m_TableTimer.GetDuration();
 }
 
-std::shared_ptr<Packet> FEC2DTable::CreateRepairPacketByRow(uint32_t row)
+void FEC2DTable::OutputShortRepairPacket(ParityAccumulator& parity, uint8_t L, uint8_t D)
 {
-    if (m_pRowRepairPacket[row] != nullptr)
+    std::shared_ptr<Packet> pRepairPacket = TakeRepairPacket(parity, m_nTableSourceNum);
+    if (pRepairPacket == nullptr)
     {
-        return nullptr;
+        Error("[%p][FEC2DTable::OutputShortRepairPacket] create repair packet L:%d D:%d fail", this, L, D);
+        return;
     }
 
-    uint32_t nMaxLen = 0;
-    uint32_t nPackNum = 0;
-    uint8_t* data[MAX_FEC_LINE] = { 0 };
-    uint16_t size[MAX_FEC_LINE] = { 0 };
+    memcpy(pRepairPacket->m_pData + 4, m_LastTimestamp, 4);
+    pRepairPacket->m_pData[22] = L;
+    pRepairPacket->m_pData[23] = D;
+    OutputFECPacket(pRepairPacket);
+}
 
-    for (uint8_t col = 0; col < m_nColumnNum; col++)
+//the parity buffer is laid out like the repair packet,so taking it is a copy plus the header bits
+void FEC2DTable::AccumulateParity(ParityAccumulator& parity, const std::shared_ptr<Packet>& packet, bool isLast)
+{
+    uint8_t* data = packet->m_pData;
+    uint32_t size = packet->m_nLength;
+    if (parity.m_pBuffer.size() < size + 12)
     {
-        std::shared_ptr<Packet> packet = m_pFecTable[row][col];
-        if (packet != nullptr)
-        {
-            if (nMaxLen < packet->m_nLength)
-            {
-                nMaxLen = packet->m_nLength;
-            }
-            data[nPackNum] = packet->m_pData;
-            size[nPackNum] = packet->m_nLength;
-            nPackNum++;
-        }
-        else
-        {
-            break;
-        }
+        parity.m_pBuffer.resize(size + 12, 0);
     }
-    if (nPackNum < m_nColumnNum)
+    if (parity.m_nMaxLen < size)
     {
-        return nullptr;
+        parity.m_nMaxLen = size;
     }
 
-    std::shared_ptr<Packet> pRepairPacket = CreateRepairPacket(data, size, nPackNum, nMaxLen);
-    if (pRepairPacket != nullptr)
+    uint8_t* pParity = parity.m_pBuffer.data();
+    if (isLast)
     {
-        pRepairPacket->m_pData[22] = m_nColumnNum + 1;
-        pRepairPacket->m_pData[23] = row + 1;
+        //the repair packet carries the timestamp of the last packet it protects
+        pParity[4] = data[4];
+        pParity[5] = data[5];
+        pParity[6] = data[6];
+        pParity[7] = data[7];
     }
 
-    return pRepairPacket;
-}
+    //FEC Head
+    pParity[12] ^= data[0];
+    pParity[13] ^= data[1];
+    pParity[14] ^= size >> 8;
+    pParity[15] ^= size & 0xff;
+    pParity[16] ^= data[4];
+    pParity[17] ^= data[5];
+    pParity[18] ^= data[6];
+    pParity[19] ^= data[7];
 
-std::shared_ptr<Packet> FEC2DTable::CreateRepairPacketByColumn(uint32_t col)
-{
-    if (m_pColumnRepairPacket[col] != nullptr)
+    //FEC Repair Payload,bytes past a packet's end count as zero
+    if (size > 12)
     {
-        return nullptr;
+        XORKernel::XOR(pParity + 24, data + 12, size - 12);
     }
+}
 
-    uint32_t nMaxLen = 0;
-    uint32_t nPackNum = 0;
-    uint8_t* data[MAX_FEC_LINE] = { 0 };
-    uint16_t size[MAX_FEC_LINE] = { 0 };
-
-    for (uint8_t row = 0; row < m_nRowNum; row++)
+std::shared_ptr<Packet> FEC2DTable::TakeRepairPacket(ParityAccumulator& parity, uint32_t tableSize)
+{
+    std::shared_ptr<Packet> pRepairPacket = nullptr;
+    uint32_t nHeaderSize = m_bSizeField ? SIZED_FEC_HEADER_SIZE : FEC_HEADER_SIZE;
+    size_t nRepairPacketSize = parity.m_nMaxLen + nHeaderSize - 12;
+    uint8_t* pRepairPacketData = (uint8_t*)malloc(nRepairPacketSize);
+    if (pRepairPacketData == nullptr)
     {
-        std::shared_ptr<Packet> packet = m_pFecTable[row][col];
-        if (packet != nullptr)
-        {
-            if (nMaxLen < packet->m_nLength)
-            {
-                nMaxLen = packet->m_nLength;
-            }
-            data[nPackNum] = packet->m_pData;
-            size[nPackNum] = packet->m_nLength;
-            nPackNum++;
-        }
-        else
-        {
-            break;
-        }
+        Error("[%p][FEC2DTable::TakeRepairPacket] malloc repair packet fail", this);
+        ResetParity(parity);
+        return pRepairPacket;
     }
-
-    std::shared_ptr<Packet> pRepairPacket = CreateRepairPacket(data, size, nPackNum, nMaxLen);
-    if (pRepairPacket != nullptr)
+    memcpy(pRepairPacketData, parity.m_pBuffer.data(), FEC_HEADER_SIZE);
+    memcpy(pRepairPacketData + nHeaderSize, parity.m_pBuffer.data() + FEC_HEADER_SIZE, parity.m_nMaxLen - 12);
+    if (m_bSizeField)
     {
-        pRepairPacket->m_pData[22] = col + 1;
-        pRepairPacket->m_pData[23] = m_nRowNum + 1;
+        pRepairPacketData[24] = tableSize >> 8;
+        pRepairPacketData[25] = tableSize & 0xff;
+        memcpy(pRepairPacketData + 26, m_MediaSSRC, 4);
     }
 
+    //RTP Head,pt seq and ssrc be filled in outside
+    pRepairPacketData[0] = 0x80;
+    //FEC Head,L(columns) and D(rows) be filled in outside
+    pRepairPacketData[12] = 0x40 | (pRepairPacketData[12] & 0x3f);
+    pRepairPacketData[20] = m_nBaseSeq >> 8;
+    pRepairPacketData[21] = m_nBaseSeq & 0xff;
+    ResetParity(parity);
+
+    pRepairPacket = std::make_shared<Packet>();
+    pRepairPacket->m_nLength = nRepairPacketSize;
+    pRepairPacket->m_pData = pRepairPacketData;
+
     return pRepairPacket;
 }
 
+void FEC2DTable::ResetParity(ParityAccumulator& parity)
+{
+    if (parity.m_nMaxLen > 0)
+    {
+        memset(parity.m_pBuffer.data(), 0, parity.m_nMaxLen + 12);
+        parity.m_nMaxLen = 0;
+    }
+}
+
 void FEC2DTable::OutputFECPacket(const std::shared_ptr<Packet>& packet)
 {
     if (m_pFECPacketCallback != nullptr)
@@ -420,7 +585,23 @@ int32_t FEC2DTable::RecvPacketAndTryRepair(const std::shared_ptr<Packet>& packet
         if (m_nBaseSeq == -1)
         {
             uint16_t seq = (packet->m_pData[12 + 8] << 8) | (packet->m_pData[12 + 9]);
-            UpdataRange(seq);
+            UpdataRange(seq, m_nRowNum * m_nColumnNum);
+        }
+
+        //0 until the sender knew the size,a full table needs nothing more
+        if (m_bSizeField)
+        {
+            uint32_t num = packet->m_nLength < SIZED_FEC_HEADER_SIZE ? UINT32_MAX : (packet->m_pData[24] << 8) | packet->m_pData[25];
+            if (num > (uint32_t)(m_nRowNum * m_nColumnNum))
+            {
+                Error("[%p][FEC2DTable::RecvPacketAndTryRepair] short table size:%d is illage,table col:%d row:%d",
+                    this, num, m_nColumnNum, m_nRowNum);
+                return -5;
+            }
+            if (num > 0 && num < (uint32_t)(m_nRowNum * m_nColumnNum) && m_nTableSourceNum == 0)
+            {
+                SetShortTableSize(num);
+            }
         }
 
         col = packet->m_pData[22] - 1;
@@ -518,6 +699,31 @@ int32_t FEC2DTable::TryRepair()
     return 0;
 }
 
+//the decoder does not know which directions the sender protects,a loss counts as given up once
+//both its row and its column repair came without rebuilding it
+FECBlock::RepairState FEC2DTable::GetRepairState(uint16_t seq)
+{
+    if (m_nBaseSeq == -1 || !IsSeqInRange(seq))
+    {
+        return REPAIR_STATE_NONE;
+    }
+
+    uint32_t row = 0;
+    uint32_t col = 0;
+    CalculateRowAndColumn(seq, row, col);
+    if (m_pFecTable[row][col] != nullptr)
+    {
+        return REPAIR_STATE_NONE;
+    }
+
+    return m_pRowRepairPacket[row] != nullptr && m_pColumnRepairPacket[col] != nullptr ? REPAIR_STATE_FAILED : REPAIR_STATE_PENDING;
+}
+
+void FEC2DTable::TakeEvictedPackets(std::list<std::shared_ptr<Packet>>& packets)
+{
+    packets.splice(packets.end(), m_pEvictedPackets);
+}
+
 bool FEC2DTable::IsCanRecvPacket(const std::shared_ptr<Packet>& packet)
 {
     uint8_t pt = packet->m_pData[1] & 0x7f;
@@ -551,14 +757,20 @@ bool FEC2DTable::IsCanRecvPacket(const std::shared_ptr<Packet>& packet)
 std::shared_ptr<Packet> FEC2DTable::TryRepairByRow(uint32_t row)
 {
     std::shared_ptr<Packet> packet = nullptr;
-    if (m_pRowCounter[row] == (m_nRowNum - 1) && m_pRowRepairPacket[row] != nullptr)
+    if (row >= m_nRowNum)
+    {
+        return packet;
+    }
+
+    uint32_t nRowSize = GetRowSize(row);
+    if (nRowSize > 0 && m_pRowCounter[row] == (nRowSize - 1) && m_pRowRepairPacket[row] != nullptr)
     {
         uint32_t nPackNum = 0;
         uint8_t* data[MAX_FEC_LINE] = { 0 };
         uint16_t size[MAX_FEC_LINE] = { 0 };
         uint16_t seq = 0;
 
-        for (uint8_t col = 0; col < m_nColumnNum; col++)
+        for (uint8_t col = 0; col < nRowSize; col++)
         {
             if (m_pFecTable[row][col] != nullptr)
             {
@@ -572,7 +784,7 @@ std::shared_ptr<Packet> FEC2DTable::TryRepairByRow(uint32_t row)
             }
         }
 
-        if (nPackNum == (m_nColumnNum - 1))
+        if (nPackNum == (nRowSize - 1))
         {
             packet = Repair(data, size, nPackNum, m_pRowRepairPacket[row]);
             if (packet != nullptr)
@@ -590,14 +802,20 @@ std::shared_ptr<Packet> FEC2DTable::TryRepairByRow(uint32_t row)
 std::shared_ptr<Packet> FEC2DTable::TryRepairByColumn(uint32_t col)
 {
     std::shared_ptr<Packet> packet = nullptr;
-    if (m_pColumnCounter[col] == (m_nColumnNum - 1) && m_pColumnRepairPacket[col] != nullptr)
+    if (col >= m_nColumnNum)
+    {
+        return packet;
+    }
+
+    uint32_t nColumnSize = GetColumnSize(col);
+    if (nColumnSize > 0 && m_pColumnCounter[col] == (nColumnSize - 1) && m_pColumnRepairPacket[col] != nullptr)
     {
         uint32_t nPackNum = 0;
         uint8_t* data[MAX_FEC_LINE] = { 0 };
         uint16_t size[MAX_FEC_LINE] = { 0 };
         uint16_t seq = 0;
 
-        for (uint8_t row = 0; row < m_nRowNum; row++)
+        for (uint8_t row = 0; row < nColumnSize; row++)
         {
             if (m_pFecTable[row][col] != nullptr)
             {
@@ -611,7 +829,7 @@ std::shared_ptr<Packet> FEC2DTable::TryRepairByColumn(uint32_t col)
             }
         }
 
-        if (nPackNum == (m_nRowNum - 1))
+        if (nPackNum == (nColumnSize - 1))
         {
             packet = Repair(data, size, nPackNum, m_pColumnRepairPacket[col]);
             if (packet != nullptr)
@@ -635,11 +853,13 @@ std::shared_ptr<Packet> FEC2DTable::Repair(uint8_t** data, uint16_t* size, uint3
     }
     uint16_t nRepairSize = (repair->m_pData[14] << 8) | repair->m_pData[15];
     nPacketSize ^= nRepairSize;
-    if (nPacketSize + 12 > repair->m_nLength)
+    uint32_t nHeaderSize = m_bSizeField ? SIZED_FEC_HEADER_SIZE : FEC_HEADER_SIZE;
+    if (nPacketSize < 12 || nPacketSize + nHeaderSize - 12 > repair->m_nLength || (nPackNum == 0 && !m_bSizeField))
     {
-        Error("[%p][FEC2DTable::Repair] repair size:%d > repair packet size:%d - 12", this, nPacketSize, repair->m_nLength);
+        Error("[%p][FEC2DTable::Repair] repair size:%d > repair packet size:%d - %d", this, nPacketSize, repair->m_nLength, nHeaderSize - 12);
         return nullptr;
     }
+    const uint8_t* ssrc = nPackNum > 0 ? data[0] + 8 : repair->m_pData + 26;
 
     uint8_t* pPacketData = (uint8_t*)malloc(nPacketSize);
     if (pPacketData == nullptr)
@@ -677,27 +897,23 @@ std::shared_ptr<Packet> FEC2DTable::Repair(uint8_t** data, uint16_t* size, uint3
     pPacketData[5] = nTSBytes[1];
     pPacketData[6] = nTSBytes[2];
     pPacketData[7] = nTSBytes[3];
-    pPacketData[8] = data[0][8];
-    pPacketData[9] = data[0][9];
-    pPacketData[10] = data[0][10];
-    pPacketData[11] = data[0][11];
+    pPacketData[8] = ssrc[0];
+    pPacketData[9] = ssrc[1];
+    pPacketData[10] = ssrc[2];
+    pPacketData[11] = ssrc[3];
 
     for (uint32_t i = 0; i < nPackNum; i++)
     {
-        for (uint16_t j = 12; j < nPacketSize; j++)
+        uint16_t nLen = size[i] < nPacketSize ? size[i] : nPacketSize;
+        if (nLen > 12)
         {
-            if (j >= size[i])
-            {
-                continue;
-            }
-
-            pPacketData[j] ^= data[i][j];
+            XORKernel::XOR(pPacketData + 12, data[i] + 12, nLen - 12);
         }
     }
 
-    for (int i = 12; i < nPacketSize; i++)
+    if (nPacketSize > 12)
     {
-        pPacketData[i] ^= repair->m_pData[i + 12];
+        XORKernel::XOR(pPacketData + 12, repair->m_pData + nHeaderSize, nPacketSize - 12);
     }
 
     std::shared_ptr<Packet> packet = std::make_shared<Packet>();
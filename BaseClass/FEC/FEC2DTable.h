@@ -1,9 +1,13 @@
 #pragma once
+#include <atomic>
+#include <list>
 #include <memory>
 #include <cstdint>
 #include <functional>
 #include <unordered_set>
 #include "Common.h"
+#include "FECBlock.h"
+#include "CommonTools/TimeCounter.h"
 #define MAX_FEC_LINE 32		//FEC/
 
 typedef struct NackItem
@@ -18,38 +22,53 @@ typedef struct NackItem
     }
 }NackItem;
 
-class FEC2DTable
+class FEC2DTable : public FECBlock
 {
 public:
-    typedef std::function<void(const std::shared_ptr<Packet>&)> FECPacketCallback;
-    typedef std::function<void(const std::shared_ptr<Packet>&, bool)> RTPPacketCallback;
     typedef struct Range
     {
         int32_t min = INT32_MAX;
         int32_t max = INT32_MIN;
     }Range;
+    typedef struct ParityAccumulator
+    {
+        std::vector<uint8_t> m_pBuffer;     //repair packet layout,grows to the longest member
+        uint32_t m_nMaxLen = 0;
+    }ParityAccumulator;
 
 public:
     FEC2DTable(uint8_t pt);
-    ~FEC2DTable();
+    virtual ~FEC2DTable();
 
     int32_t Init(uint8_t row, uint8_t column);
-    bool SetFECPacketCallback(FECPacketCallback callback);
-    bool SetRTPPacketCallback(RTPPacketCallback callback);
-    void ClearTable();
-    int32_t RecvPacketAndMakeRepair(const std::shared_ptr<Packet>& packet);
-    int32_t RecvPacketAndTryRepair(const std::shared_ptr<Packet>& packet, bool isRepair = true);
-    bool IsCanRecvPacket(const std::shared_ptr<Packet>& packet);
-    int32_t TryRepair();
+    void SetFrameAligned(bool aligned);     //encoder,close the table at the RTP marker bit
+    void SetSizeField(bool enable);         //both ends,repairs carry the table size,see FECBlock::CreateBlock
+    virtual bool SetFECPacketCallback(FECPacketCallback callback);
+    virtual bool SetRTPPacketCallback(RTPPacketCallback callback);
+    virtual void ClearTable();
+    virtual void SetRepairDirection(uint8_t priority, bool row, bool column);     //takes effect from the next table
+    virtual float GetRepairOverhead(bool row, bool column);
+    virtual int32_t RecvPacketAndMakeRepair(const std::shared_ptr<Packet>& packet);
+    virtual int32_t RecvPacketAndTryRepair(const std::shared_ptr<Packet>& packet, bool isRepair = true);
+    virtual bool IsCanRecvPacket(const std::shared_ptr<Packet>& packet);
+    virtual int32_t TryRepair();
+    virtual void CloseBlock();
+    virtual double GetBlockAge();
+    virtual RepairState GetRepairState(uint16_t seq);
+    virtual void TakeEvictedPackets(std::list<std::shared_ptr<Packet>>& packets);
 
 private:
     int32_t ReleaseAll();
     bool IsSeqInRange(uint16_t seq);
-    void UpdataRange(uint16_t seq);
+    void UpdataRange(uint16_t seq, uint32_t num);
     void CalculateRowAndColumn(uint16_t seq, uint32_t& row, uint32_t& col);
-    std::shared_ptr<Packet> CreateRepairPacketByRow(uint32_t row);
-    std::shared_ptr<Packet> CreateRepairPacketByColumn(uint32_t col);
-    std::shared_ptr<Packet> CreateRepairPacket(uint8_t** data, uint16_t* size, uint32_t nPackNum, uint32_t nMaxLen);
+    void SetShortTableSize(uint32_t num);
+    uint32_t GetRowSize(uint32_t row);
+    uint32_t GetColumnSize(uint32_t col);
+    void AccumulateParity(ParityAccumulator& parity, const std::shared_ptr<Packet>& packet, bool isLast);
+    std::shared_ptr<Packet> TakeRepairPacket(ParityAccumulator& parity, uint32_t tableSize);
+    void OutputShortRepairPacket(ParityAccumulator& parity, uint8_t L, uint8_t D);
+    void ResetParity(ParityAccumulator& parity);
     void OutputFECPacket(const std::shared_ptr<Packet>& packet);
     void OutputRTPPacket(const std::shared_ptr<Packet>& packet);
     std::shared_ptr<Packet> TryRepairByRow(uint32_t row);
@@ -69,9 +88,32 @@ private:
     std::vector<std::shared_ptr<Packet>> m_pRowRepairPacket;
     std::vector<std::shared_ptr<Packet>> m_pColumnRepairPacket;
 
+    //encoder side,packets are not kept,only their running parity
+    std::vector<uint32_t> m_pRowMask;       //bit per column already accumulated
+    std::vector<uint8_t> m_pRowPriority;    //highest PacketPriority in the line,it picks the line's repair
+    std::vector<uint8_t> m_pColumnPriority;
+    std::vector<ParityAccumulator> m_RowParity;
+    std::vector<ParityAccumulator> m_ColumnParity;
+
+    std::list<std::shared_ptr<Packet>> m_pEvictedPackets;   //decoder,past the end of a short table
+
     Range m_Range1;
     Range m_Range2;
 
+    bool m_bFrameAligned;
+    bool m_bSizeField;
+    uint32_t m_nTableSourceNum;         //encoder:packets so far,decoder:size of a short table,0 while unknown
+    uint8_t m_LastTimestamp[4];
+    uint8_t m_MediaSSRC[4];
+    TimeCounter m_TableTimer;
+
+    bool m_bRowRepair[PACKET_PRIORITY_NUM];
+    bool m_bColumnRepair[PACKET_PRIORITY_NUM];
+    bool m_bAnyRowRepair;
+    bool m_bAnyColumnRepair;
+    std::atomic<bool> m_bNextRowRepair[PACKET_PRIORITY_NUM];        //set from the control thread
+    std::atomic<bool> m_bNextColumnRepair[PACKET_PRIORITY_NUM];
+
     FECPacketCallback m_pFECPacketCallback;
     RTPPacketCallback m_pRTPPacketCallback;
 };
\ No newline at end of file
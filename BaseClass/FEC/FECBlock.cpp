@@ -0,0 +1,194 @@
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "FECBlock.h"
+#include "FEC2DTable.h"
+#include "FECRSBlock.h"
+#include "Log/Log.h"
+
+#define MIN_DYNAMIC_PAYLOAD_TYPE (96)
+#define MAX_TABLE_NUM (32)
+
+extern void split(const std::string& src, std::vector<std::string>& result, const std::string& c);
+
+FECBlock* FECBlock::CreateBlock(const Config& config, uint8_t pt)
+{
+    int32_t ret = 0;
+    if (config.m_eScheme == SCHEME_RS)
+    {
+        FECRSBlock* pBlock = new FECRSBlock(pt);
+        ret = pBlock->Init(config.m_nSourceNum, config.m_nRepairNum);
+        if (ret != 0)
+        {
+            Error("[FECBlock::CreateBlock] Init FECRSBlock k:%d m:%d fail,return:%d", config.m_nSourceNum, config.m_nRepairNum, ret);
+            delete pBlock;
+            return nullptr;
+        }
+        return pBlock;
+    }
+
+    FEC2DTable* pTable = new FEC2DTable(pt);
+    ret = pTable->Init(config.m_nRow, config.m_nColumn);
+    if (ret != 0)
+    {
+        Error("[FECBlock::CreateBlock] Init FEC2DTable row:%d col:%d fail,return:%d", config.m_nRow, config.m_nColumn, ret);
+        delete pTable;
+        return nullptr;
+    }
+    pTable->SetFrameAligned(config.m_bFrameAligned);
+    pTable->SetSizeField(config.m_bFrameAligned || config.m_nMaxBlockDelay > 0);
+    return pTable;
+}
+
+const char* FECBlock::GetSchemeName(Scheme scheme)
+{
+    return scheme == SCHEME_RS ? "rs" : "2d-xor";
+}
+
+//scheme=rs;pt=109;k=20;m=5;depth=5 or scheme=2d-xor;pt=109;row=7;col=7[;dim=1][;align=frame];depth=5,
+//then [;delay=40][;uep=-1,0,1]
+std::string FECBlock::MakeSdpAttribute(const Config& config)
+{
+    std::string attribute = "scheme=";
+    attribute += GetSchemeName(config.m_eScheme);
+    attribute += ";pt=" + std::to_string(config.m_nPayloadType);
+    if (config.m_eScheme == SCHEME_RS)
+    {
+        attribute += ";k=" + std::to_string(config.m_nSourceNum);
+        attribute += ";m=" + std::to_string(config.m_nRepairNum);
+    }
+    else
+    {
+        attribute += ";row=" + std::to_string(config.m_nRow);
+        attribute += ";col=" + std::to_string(config.m_nColumn);
+        if (config.m_nDimension == 1)
+        {
+            attribute += ";dim=1";
+        }
+        if (config.m_bFrameAligned)
+        {
+            attribute += ";align=frame";
+        }
+    }
+    attribute += ";depth=" + std::to_string(config.m_nTableNum);
+    if (config.m_nMaxBlockDelay > 0)
+    {
+        attribute += ";delay=" + std::to_string(config.m_nMaxBlockDelay);
+    }
+    Config defaults;
+    if (memcmp(config.m_PriorityOffset, defaults.m_PriorityOffset, sizeof(defaults.m_PriorityOffset)) != 0)
+    {
+        attribute += ";uep=";
+        for (int i = 0; i < PACKET_PRIORITY_NUM; i++)
+        {
+            attribute += (i > 0 ? "," : "") + std::to_string(config.m_PriorityOffset[i]);
+        }
+    }
+
+    return attribute;
+}
+
+//keys the attribute leaves out keep their value in config,config is untouched when it is invalid
+int32_t FECBlock::ParseSdpAttribute(const std::string& attribute, Config& config)
+{
+    Config result = config;
+    std::vector<std::string> items;
+    split(attribute, items, ";");
+    for (auto& item : items)
+    {
+        size_t pos = item.find('=');
+        if (pos == std::string::npos)
+        {
+            continue;
+        }
+
+        std::string key = item.substr(0, pos);
+        std::string value = item.substr(pos + 1);
+        int32_t number = atoi(value.c_str());
+        if (key == "scheme")
+        {
+            if (value == GetSchemeName(SCHEME_RS))
+            {
+                result.m_eScheme = SCHEME_RS;
+            }
+            else if (value == GetSchemeName(SCHEME_2D_XOR))
+            {
+                result.m_eScheme = SCHEME_2D_XOR;
+            }
+            else
+            {
+                Error("[FECBlock::ParseSdpAttribute] unknown scheme:%s", value.c_str());
+                return -1;
+            }
+        }
+        else if (key == "k" || key == "m" || key == "row" || key == "col")
+        {
+            int32_t limit = key == "k" ? MAX_RS_SOURCE_NUM : key == "m" ? MAX_RS_REPAIR_NUM : MAX_FEC_LINE;
+            if (number <= 0 || number > limit)
+            {
+                Error("[FECBlock::ParseSdpAttribute] %s:%s out of range", key.c_str(), value.c_str());
+                return -2;
+            }
+            uint8_t& field = key == "k" ? result.m_nSourceNum : key == "m" ? result.m_nRepairNum :
+                key == "row" ? result.m_nRow : result.m_nColumn;
+            field = number;
+        }
+        else if (key == "pt")
+        {
+            if (number < MIN_DYNAMIC_PAYLOAD_TYPE || number > 0x7f)
+            {
+                Error("[FECBlock::ParseSdpAttribute] pt:%s is not a dynamic payload type", value.c_str());
+                return -5;
+            }
+            result.m_nPayloadType = number;
+        }
+        else if (key == "depth")
+        {
+            if (number <= 0 || number > MAX_TABLE_NUM)
+            {
+                Error("[FECBlock::ParseSdpAttribute] depth:%s out of range", value.c_str());
+                return -6;
+            }
+            result.m_nTableNum = number;
+        }
+        else if (key == "dim")
+        {
+            if (number != 1 && number != 2)
+            {
+                Error("[FECBlock::ParseSdpAttribute] dim:%s is neither 1 nor 2", value.c_str());
+                return -7;
+            }
+            result.m_nDimension = number;
+        }
+        else if (key == "align")
+        {
+            result.m_bFrameAligned = value == "frame";
+        }
+        else if (key == "delay")
+        {
+            if (number < 0 || number > 0xffff)
+            {
+                Error("[FECBlock::ParseSdpAttribute] delay:%s out of range", value.c_str());
+                return -3;
+            }
+            result.m_nMaxBlockDelay = number;
+        }
+        else if (key == "uep")
+        {
+            std::vector<std::string> offsets;
+            split(value, offsets, ",");
+            if (offsets.size() != PACKET_PRIORITY_NUM)
+            {
+                Error("[FECBlock::ParseSdpAttribute] uep:%s needs %d offsets", value.c_str(), PACKET_PRIORITY_NUM);
+                return -4;
+            }
+            for (int i = 0; i < PACKET_PRIORITY_NUM; i++)
+            {
+                result.m_PriorityOffset[i] = atoi(offsets[i].c_str());
+            }
+        }
+    }
+
+    config = result;
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,69 @@
+#pragma once
+#include <list>
+#include <memory>
+#include <string>
+#include <cstdint>
+#include <functional>
+#include "Common.h"
+
+//One FEC block on either side of the link.The encoder feeds media packets and gets repair packets out,
+//the decoder feeds media and repair packets and gets the recovered media packets out.
+class FECBlock
+{
+public:
+    typedef std::function<void(const std::shared_ptr<Packet>&)> FECPacketCallback;
+    typedef std::function<void(const std::shared_ptr<Packet>&, bool)> RTPPacketCallback;
+
+    typedef enum Scheme
+    {
+        SCHEME_2D_XOR = 0,      //RFC 8627 row/column parity,one loss per row or column
+        SCHEME_RS               //systematic Cauchy Reed-Solomon over GF(2^8),any m losses out of k+m
+    }Scheme;
+
+    typedef enum RepairState
+    {
+        REPAIR_STATE_NONE = 0,      //the packet is not missing from this block
+        REPAIR_STATE_PENDING,       //repairs that may rebuild it are still to come
+        REPAIR_STATE_FAILED         //the repairs that cover it are in and could not,only a retransmission helps
+    }RepairState;
+
+    //negotiated in the SDP as a=x-fec:,the server may move to another geometry mid-stream,see RTCPPacket::MakeFECConfig
+    typedef struct Config
+    {
+        Scheme m_eScheme = SCHEME_2D_XOR;
+        uint8_t m_nPayloadType = 109;   //repair packets,fixed for the session
+        uint8_t m_nRow = 7;
+        uint8_t m_nColumn = 7;
+        uint8_t m_nDimension = 2;       //2D only,1 sends column repairs alone whatever the link allows
+        uint8_t m_nSourceNum = 20;      //k,a block also closes at the end of a frame
+        uint8_t m_nRepairNum = 5;       //m for a full block
+        bool m_bFrameAligned = false;   //2D only,close the table at the marker bit,RS blocks always do;this or a delay
+                                        //makes 2D repairs carry the size of their table,a closed table may be short
+        uint16_t m_nMaxBlockDelay = 0;  //ms a block may stay open before its repairs are sent,0 no limit
+        int8_t m_PriorityOffset[PACKET_PRIORITY_NUM] = { -1, 0, 1 };     //repair level of each class against the link's
+        uint8_t m_nTableNum = 5;        //decoder blocks open at once,more rides out deeper reordering
+        uint32_t m_nCacheSize = 2 * 1024 * 1024;    //sender only,not in the SDP:bytes kept for retransmission
+    }Config;
+
+public:
+    virtual ~FECBlock() {};
+
+    virtual bool SetFECPacketCallback(FECPacketCallback callback) = 0;
+    virtual bool SetRTPPacketCallback(RTPPacketCallback callback) = 0;
+    virtual void ClearTable() = 0;
+    virtual void SetRepairDirection(uint8_t priority, bool row, bool column) = 0;     //takes effect from the next block
+    virtual float GetRepairOverhead(bool row, bool column) = 0;     //repair packets per media packet of a full block
+    virtual int32_t RecvPacketAndMakeRepair(const std::shared_ptr<Packet>& packet) = 0;
+    virtual int32_t RecvPacketAndTryRepair(const std::shared_ptr<Packet>& packet, bool isRepair = true) = 0;
+    virtual bool IsCanRecvPacket(const std::shared_ptr<Packet>& packet) = 0;
+    virtual int32_t TryRepair() = 0;
+    virtual void CloseBlock() = 0;          //send the repairs of the open block now
+    virtual double GetBlockAge() = 0;       //ms since the first packet of the open block,0 when none is open
+    virtual RepairState GetRepairState(uint16_t seq) = 0;      //decoder
+    virtual void TakeEvictedPackets(std::list<std::shared_ptr<Packet>>&) {};      //decoder,media taken before the block knew it was short
+
+    static FECBlock* CreateBlock(const Config& config, uint8_t pt);
+    static const char* GetSchemeName(Scheme scheme);
+    static std::string MakeSdpAttribute(const Config& config);
+    static int32_t ParseSdpAttribute(const std::string& attribute, Config& config);
+};
\ No newline at end of file
@@ -1,24 +1,31 @@
 #include "FECDecoder.h"
 #include "Log/Log.h"
-#include "CommonTools/TimeCounter.h"
+#include "RTCP/RTCPPacket.h"
 
 #define MAX_CACHE_NUM 50
-#define MAX_WAIT_TIME 40.0				//ȴʱ
-#define MAX_SKIP_NUM 100					//Ծ
-#define NACK_TICK 10.0							//NACK
-#define MAX_TOLERATED_JUMP 100		//̰Ծ
-
+#define JITTER_BUFFER_SIZE (1024)
+#define NACK_INTERVAL (10.0)                //ms between scans of the jitter buffer holes
+#define MIN_NACK_RETRY_INTERVAL (20.0)      //ms
+#define MAX_NACK_RETRY_NUM (3)
+#define MAX_NACK_STATE_AGE (1000)           //ms a request is remembered to tell a late answer
+#define MAX_REPAIR_SILENCE (1000.0)         //ms without a repair before the sender is taken to send none
 
 RFC8627FECDecoder::RFC8627FECDecoder()
 {
     m_nPayloadType = 99;
     m_nSSRC = 0x33445566;
-    m_bRecvFirstPacket = false;
-    m_nExpOutSeq = 0;
-    m_nLastRecvSeq = 0;
-    m_nLastOutSeq = 0;
-    m_bStopOutPacket = true;
-    m_pOutPacketThread = nullptr;
+    m_nBlockSourceNum = 0;
+    m_nMaxBlockDelay = 0;
+    m_bRecvRepair = false;
+    m_bHasPendingConfig = false;
+    m_nPendingSSRC = 0;
+    m_nUseTick = 0;
+    m_pJitterBuffer = nullptr;
+    m_nMediaSSRC = 0;
+    m_fRoundTripTime = 0;
+    m_nNackSentNum = 0;
+    m_nNackRecvNum = 0;
+    m_nNackLateNum = 0;
 }
 
 RFC8627FECDecoder::~RFC8627FECDecoder()
@@ -28,73 +35,46 @@ RFC8627FECDecoder::~RFC8627FECDecoder()
 
 int32_t RFC8627FECDecoder::ReleaseAll()
 {
-    m_bStopOutPacket = true;
-    if (m_pOutPacketThread != nullptr)
-    {
-        if (m_pOutPacketThread->joinable())
-        {
-            m_pOutPacketThread->join();
-        }
-        delete m_pOutPacketThread;
-        m_pOutPacketThread = nullptr;
-    }
+    delete m_pJitterBuffer;
+    m_pJitterBuffer = nullptr;
 
-    for (auto item : m_pTableList)
+    for (auto item : m_pBlocks)
     {
         delete item;
     }
-    m_pTableList.clear();
+    m_pBlocks.clear();
+    m_pBlockLastUse.clear();
+    m_nUseTick = 0;
 
     m_pCachePacketList.clear();
-    m_bRecvFirstPacket = false;
-    m_nExpOutSeq = 0;
-    m_nLastRecvSeq = 0;
-    m_nLastOutSeq = 0;
-
-    {
-        std::lock_guard<std::mutex> lock(m_pRTPSortArrayLock);
-        for (auto& item : m_pRTPSortArray)
-        {
-            item = nullptr;
-        }
-    }
+    m_NackStates.clear();
+    m_bHasPendingConfig = false;
 
     return 0;
 }
 
 int32_t RFC8627FECDecoder::Init(uint8_t row, uint8_t col, uint8_t tableNum)
 {
-    Trace("[%p][RFC8627FECDecoder::Init] Init col:%d row:%d num:%d", this, row, col, tableNum);
-
-    int32_t ret = 0;
-    if (tableNum == 0)
-    {
-        Error("[%p][RFC8627FECDecoder::Init] num:%d err", this, tableNum);
-        ret = -1;
-        goto fail;
-    }
+    FECBlock::Config config;
+    config.m_eScheme = FECBlock::SCHEME_2D_XOR;
+    config.m_nRow = row;
+    config.m_nColumn = col;
+    config.m_nTableNum = tableNum;
+    return Init(config);
+}
 
-    for (uint8_t i = 0; i < tableNum; i++)
-    {
-        FEC2DTable* pFEC2DTable = new FEC2DTable(m_nPayloadType);
-        m_pTableList.push_back(pFEC2DTable);
-        ret = pFEC2DTable->Init(row, col);
-        if (ret != 0)
-        {
-            Error("[%p][RFC8627FECDecoder::Init] Init FEC2DTable err,return:%d", this, ret);
-            ret = -2;
-            goto fail;
-        }
-        pFEC2DTable->SetRTPPacketCallback(std::bind(&RFC8627FECDecoder::OnRTPPacket, this, std::placeholders::_1, std::placeholders::_2));
-    }
+int32_t RFC8627FECDecoder::Init(const FECBlock::Config& config)
+{
+    Trace("[%p][RFC8627FECDecoder::Init] Init scheme:%s", this, FECBlock::MakeSdpAttribute(config).c_str());
 
+    int32_t ret = CreateBlocks(config, m_pBlocks);
+    if (ret != 0)
     {
-        std::lock_guard<std::mutex> lock(m_pRTPSortArrayLock);
-        for (int i = 0; i < 65536; i++)
-        {
-            m_pRTPSortArray.push_back(nullptr);
-        }
+        goto fail;
     }
+    m_pBlockLastUse.assign(m_pBlocks.size(), 0);
+    m_nBlockSourceNum = config.m_eScheme == FECBlock::SCHEME_RS ? config.m_nSourceNum : config.m_nRow * config.m_nColumn;
+    m_nMaxBlockDelay = config.m_nMaxBlockDelay;
 
     if (m_pDecoderPacketCallback == nullptr)
     {
@@ -109,8 +89,15 @@ int32_t RFC8627FECDecoder::Init(uint8_t row, uint8_t col, uint8_t tableNum)
         goto fail;
     }
 
-    m_bStopOutPacket = false;
-    m_pOutPacketThread = new std::thread(&RFC8627FECDecoder::OutPacketThread, this);
+    m_pJitterBuffer = new JitterBuffer();
+    m_pJitterBuffer->SetPacketCallback(m_pDecoderPacketCallback);
+    ret = m_pJitterBuffer->Init(JITTER_BUFFER_SIZE, MEDIA_CLOCK_RATE);
+    if (ret != 0)
+    {
+        Error("[%p][RFC8627FECDecoder::Init] init JitterBuffer fail,return:%d", this, ret);
+        ret = -5;
+        goto fail;
+    }
 
     return 0;
 fail:
@@ -118,64 +105,118 @@ fail:
     return ret;
 }
 
-bool RFC8627FECDecoder::IsHasRecvPacket(uint16_t seq)
+//all of them or none
+int32_t RFC8627FECDecoder::CreateBlocks(const FECBlock::Config& config, std::vector<FECBlock*>& blocks)
 {
-    if (m_pRTPSortArray[seq] == nullptr)
+    if (config.m_nTableNum == 0)
     {
-        return false;
+        Error("[%p][RFC8627FECDecoder::CreateBlocks] num:%d err", this, config.m_nTableNum);
+        return -1;
     }
 
-    if (m_nLastRecvSeq >= MAX_TOLERATED_JUMP)
+    for (uint8_t i = 0; i < config.m_nTableNum; i++)
     {
-        if (seq <= m_nLastRecvSeq)
+        FECBlock* pFECBlock = FECBlock::CreateBlock(config, m_nPayloadType);
+        if (pFECBlock == nullptr)
         {
-            return true;
+            Error("[%p][RFC8627FECDecoder::CreateBlocks] create FECBlock fail", this);
+            for (auto item : blocks)
+            {
+                delete item;
+            }
+            blocks.clear();
+            return -2;
         }
+        pFECBlock->SetRTPPacketCallback(std::bind(&RFC8627FECDecoder::OnRTPPacket, this, std::placeholders::_1, std::placeholders::_2));
+        blocks.push_back(pFECBlock);
     }
-    else
+
+    return 0;
+}
+
+//the payload type is bound to the session,only the geometry moves
+int32_t RFC8627FECDecoder::SetConfig(const FECBlock::Config& config, uint32_t ssrc)
+{
+    if (ssrc == m_nSSRC || (m_bHasPendingConfig && ssrc == m_nPendingSSRC))
     {
-        if (seq <= m_nLastRecvSeq || seq > (65535 - (MAX_TOLERATED_JUMP - m_nLastRecvSeq)))
-        {
-            return true;
-        }
+        return 0;
+    }
+    if (config.m_nPayloadType != m_nPayloadType)
+    {
+        Error("[%p][RFC8627FECDecoder::SetConfig] pt:%d of ssrc:%08x is not the session's %d", this, config.m_nPayloadType, ssrc, m_nPayloadType);
+        return -1;
     }
 
-    return false;
+    Trace("[%p][RFC8627FECDecoder::SetConfig] fec:%s from ssrc:%08x", this, FECBlock::MakeSdpAttribute(config).c_str(), ssrc);
+    m_PendingConfig = config;
+    m_nPendingSSRC = ssrc;
+    m_bHasPendingConfig = true;
+
+    return 0;
 }
 
-void RFC8627FECDecoder::OnRTPPacket(const std::shared_ptr<Packet>& packet, bool isOutByRepair)
+//a repair made with another geometry would rebuild garbage in these blocks,the first one of the
+//announced SSRC swaps the blocks,one of an SSRC not announced yet is dropped
+bool RFC8627FECDecoder::CheckRepairSSRC(const std::shared_ptr<Packet>& packet)
 {
-    uint16_t seq = (packet->m_pData[2] << 8) | packet->m_pData[3];
+    if (packet->m_nLength < 12)
     {
-        std::lock_guard<std::mutex> lock(m_pRTPSortArrayLock);
-        if (m_bRecvFirstPacket)
-        {
-            if (abs(seq - m_nLastRecvSeq) > MAX_TOLERATED_JUMP)
-            {
-                Warn("[%p][RFC8627FECDecoder::OnRTPPacket] seq jump,%d->%d", this, m_nLastRecvSeq, seq);
-                m_nExpOutSeq = seq;
-                goto AddToArray;
-            }
+        return false;
+    }
 
-            if (IsHasRecvPacket(seq))
-            {
-                if (!isOutByRepair)
-                {
-                    Warn("[%p][RFC8627FECDecoder::OnRTPPacket] packet:%d has recved,discare", this, seq);
-                }
-                return;
-            }
-        }
-        else
-        {
-            m_bRecvFirstPacket = true;
-            m_nExpOutSeq = seq;
-        }
+    uint32_t ssrc = (packet->m_pData[8] << 24) | (packet->m_pData[9] << 16) | (packet->m_pData[10] << 8) | packet->m_pData[11];
+    if (ssrc == m_nSSRC)
+    {
+        return true;
+    }
+    if (!m_bHasPendingConfig || ssrc != m_nPendingSSRC)
+    {
+        Debug("[%p][RFC8627FECDecoder::CheckRepairSSRC] repair ssrc:%08x is not %08x,discard", this, ssrc, m_nSSRC);
+        return false;
+    }
+
+    m_bHasPendingConfig = false;
+    std::vector<FECBlock*> blocks;
+    int32_t ret = CreateBlocks(m_PendingConfig, blocks);
+    if (ret != 0)
+    {
+        Error("[%p][RFC8627FECDecoder::CheckRepairSSRC] create blocks fail,return:%d", this, ret);
+        return false;
+    }
+
+    for (auto item : m_pBlocks)
+    {
+        delete item;
+    }
+    m_pBlocks.swap(blocks);
+    m_pBlockLastUse.assign(m_pBlocks.size(), 0);
+    m_nBlockSourceNum = m_PendingConfig.m_eScheme == FECBlock::SCHEME_RS ? m_PendingConfig.m_nSourceNum : m_PendingConfig.m_nRow * m_PendingConfig.m_nColumn;
+    m_nMaxBlockDelay = m_PendingConfig.m_nMaxBlockDelay;
+    m_nSSRC = ssrc;
+    Trace("[%p][RFC8627FECDecoder::CheckRepairSSRC] switch to fec:%s ssrc:%08x", this, FECBlock::MakeSdpAttribute(m_PendingConfig).c_str(), ssrc);
+
+    return true;
+}
+
+void RFC8627FECDecoder::OnRTPPacket(const std::shared_ptr<Packet>& packet, bool isOutByRepair)
+{
+    int32_t ret = m_pJitterBuffer->InsertPacket(packet, isOutByRepair);
+    if (isOutByRepair)
+    {
+        return;
+    }
 
-    AddToArray:
-        m_pRTPSortArray[seq] = packet;
-        m_nLastRecvSeq = seq;
-        //Debug("[%p][RFC8627FECDecoder::OnRTPPacket] m_nLastRecvSeq:%d", this, m_nLastRecvSeq);
+    uint16_t seq = (packet->m_pData[2] << 8) | packet->m_pData[3];
+    m_nMediaSSRC = (packet->m_pData[8] << 24) | (packet->m_pData[9] << 16) | (packet->m_pData[10] << 8) | packet->m_pData[11];
+    auto it = m_NackStates.find(seq);
+    if (it != m_NackStates.end() && ret >= 0)
+    {
+        ret == 0 ? m_nNackRecvNum++ : m_nNackLateNum++;
+        m_NackStates.erase(it);
+    }
+    if (ret == 1)
+    {
+        Warn("[%p][RFC8627FECDecoder::OnRTPPacket] packet:%d has recved or is late,discare", this, seq);
     }
 }
 
@@ -209,14 +250,45 @@ bool RFC8627FECDecoder::SetSSRC(uint32_t ssrc)
     return true;
 }
 
-void RFC8627FECDecoder::RecvCachePacket(FEC2DTable* pFEC2DTable)
+void RFC8627FECDecoder::GetNackStatistics(uint32_t& sent, uint32_t& recv, uint32_t& late)
+{
+    sent = m_nNackSentNum;
+    recv = m_nNackRecvNum;
+    late = m_nNackLateNum;
+}
+
+void RFC8627FECDecoder::SetRoundTripTime(double rtt)
+{
+    m_fRoundTripTime = rtt > 0 ? rtt : 0;
+    if (m_pJitterBuffer != nullptr)
+    {
+        m_pJitterBuffer->SetRoundTripTime(rtt);
+    }
+}
+
+//a handful of blocks,a scan is cheaper than keeping them ordered
+FECBlock* RFC8627FECDecoder::FindBlock(const std::shared_ptr<Packet>& packet)
+{
+    for (size_t i = 0; i < m_pBlocks.size(); i++)
+    {
+        if (m_pBlocks[i]->IsCanRecvPacket(packet))
+        {
+            m_pBlockLastUse[i] = ++m_nUseTick;
+            return m_pBlocks[i];
+        }
+    }
+
+    return nullptr;
+}
+
+void RFC8627FECDecoder::RecvCachePacket(FECBlock* pFECBlock)
 {
     bool bHasRecv = false;
     for (auto it = m_pCachePacketList.begin(); it != m_pCachePacketList.cend();)
     {
-        if (pFEC2DTable->IsCanRecvPacket(*it))
+        if (pFECBlock->IsCanRecvPacket(*it))
         {
-            pFEC2DTable->RecvPacketAndTryRepair(*it, false);
+            pFECBlock->RecvPacketAndTryRepair(*it, false);
             it = m_pCachePacketList.erase(it);
             bHasRecv = true;
         }
@@ -228,279 +300,225 @@ void RFC8627FECDecoder::RecvCachePacket(FEC2DTable* pFEC2DTable)
 
     if (bHasRecv)
     {
-        pFEC2DTable->TryRepair();
+        pFECBlock->TryRepair();
     }
 }
 
+//media a short table took past its end goes to the block it belongs to,or waits for it like any other
+void RFC8627FECDecoder::RehomeEvictedPackets(FECBlock* pFECBlock)
+{
+    std::list<std::shared_ptr<Packet>> packets;
+    pFECBlock->TakeEvictedPackets(packets);
+    for (auto& packet : packets)
+    {
+        FECBlock* pBlock = FindBlock(packet);
+        if (pBlock != nullptr)
+        {
+            pBlock->RecvPacketAndTryRepair(packet);
+        }
+        else
+        {
+            m_pCachePacketList.push_back(packet);
+        }
+    }
+}
+
+//recovery runs as packets arrive,a block repairs once its repair packets and enough media are in
 int32_t RFC8627FECDecoder::RecvPacket(const std::shared_ptr<Packet>& packet)
 {
+    if (m_pJitterBuffer == nullptr)
+    {
+        Error("[%p][RFC8627FECDecoder::RecvPacket] not init", this);
+        return -1;
+    }
+
     uint8_t pt = packet->m_pData[1] & 0x7f;
     bool bIsRepair = pt == m_nPayloadType ? true : false;
-
-    uint16_t seq = (packet->m_pData[2] << 8) | packet->m_pData[3];
-    if (bIsRepair)
+    if (!bIsRepair)
     {
-        //Debug("[%p]recv repair rtp seq:%d pt:%d", this, seq, pt);
+        OnRTPPacket(packet);
     }
-    else
+    else if (!CheckRepairSSRC(packet))
     {
-        //Debug("[%p]recv rtp seq:%d pt:%d", this, seq, pt);
-        OnRTPPacket(packet);
+        OutNackPacketIfNeed();
+        return 0;
     }
-
-    FEC2DTable* pFEC2DTable = nullptr;
-    for (auto it = m_pTableList.begin(); it != m_pTableList.cend();)
+    else
     {
-        if ((*it) != nullptr && (*it)->IsCanRecvPacket(packet))
-        {
-            pFEC2DTable = (*it);
-            it = m_pTableList.erase(it);
-            break;
-        }
-        else
-        {
-            ++it;
-        }
+        m_bRecvRepair = true;
+        m_RepairTimer.MakeTimePoint();
     }
 
-    if (pFEC2DTable != nullptr)
+    FECBlock* pFECBlock = FindBlock(packet);
+    if (pFECBlock != nullptr)
     {
-        pFEC2DTable->RecvPacketAndTryRepair(packet);
-        RecvCachePacket(pFEC2DTable);
-        m_pTableList.push_front(pFEC2DTable);
+        pFECBlock->RecvPacketAndTryRepair(packet);
+        RehomeEvictedPackets(pFECBlock);
+        RecvCachePacket(pFECBlock);
     }
     else
     {
-        if (pt == m_nPayloadType)
+        if (bIsRepair)
         {
-            pFEC2DTable = m_pTableList.back();
-            m_pTableList.pop_back();
-            m_pTableList.push_front(pFEC2DTable);
+            size_t nOldest = 0;
+            for (size_t i = 1; i < m_pBlocks.size(); i++)
+            {
+                if (m_pBlockLastUse[i] < m_pBlockLastUse[nOldest])
+                {
+                    nOldest = i;
+                }
+            }
+            pFECBlock = m_pBlocks[nOldest];
+            m_pBlockLastUse[nOldest] = ++m_nUseTick;
 
-            pFEC2DTable->ClearTable();
-            pFEC2DTable->RecvPacketAndTryRepair(packet);
-            RecvCachePacket(pFEC2DTable);
+            pFECBlock->ClearTable();
+            pFECBlock->RecvPacketAndTryRepair(packet);
+            RehomeEvictedPackets(pFECBlock);
+            RecvCachePacket(pFECBlock);
         }
         else
         {
-            if (m_pCachePacketList.size() > MAX_CACHE_NUM)
+            //a block's media all come before its first column repair,keep that of the one closing and the next
+            size_t nMaxCacheNum = m_nBlockSourceNum * 2 > MAX_CACHE_NUM ? m_nBlockSourceNum * 2 : MAX_CACHE_NUM;
+            if (m_pCachePacketList.size() >= nMaxCacheNum)
             {
-                while (m_pCachePacketList.size() > 0)
-                {
-                    m_pCachePacketList.pop_front();
-                }
-                Trace("[%p][RFC8627FECDecoder::RecvPacket] cache packet list size > MAX_CACHE_NUM clear", this);
+                m_pCachePacketList.pop_front();
+                Debug("[%p][RFC8627FECDecoder::RecvPacket] cache packet list size > %d,drop the oldest", this, (int)nMaxCacheNum);
             }
 
             m_pCachePacketList.push_back(packet);
         }
     }
 
+    OutNackPacketIfNeed();
+
     return 0;
 }
 
-void RFC8627FECDecoder::OutPacketThread()
+//only holes FEC has given up on,or that FEC takes longer than usual on,and that a retransmission
+//can still fill before the jitter buffer skips them
+bool RFC8627FECDecoder::IsNeedNack(const JitterBuffer::LostPacket& lost, double wait, double recoverDelay, uint64_t now)
 {
-    //ȴһ
-    while (!m_bStopOutPacket)
+    double rtt = m_fRoundTripTime;
+    if (lost.m_fAge + rtt >= wait)
     {
-        if (m_bRecvFirstPacket)
-        {
-            break;
-        }
-
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        return false;
     }
 
-    TimeCounter lostWaitTimer;
-    lostWaitTimer.MakeTimePoint();
-    TimeCounter nackTimer;
-    nackTimer.MakeTimePoint();
-    std::shared_ptr<Packet> pOutPacket = nullptr;
-    bool bNeedWait = false;
-
-    while (!m_bStopOutPacket)
+    FECBlock::RepairState state = GetRepairState(lost.m_nSeq);
+    if (state != FECBlock::REPAIR_STATE_FAILED && lost.m_fAge < recoverDelay)
     {
-        pOutPacket = nullptr;
-        bNeedWait = false;
-
-        {
-            std::lock_guard<std::mutex> lock(m_pRTPSortArrayLock);
-            if (m_pRTPSortArray[m_nExpOutSeq] != nullptr)
-            {
-                pOutPacket = m_pRTPSortArray[m_nExpOutSeq];
-                m_pRTPSortArray[m_nExpOutSeq] = nullptr;
-            }
-
-            //ҵһҪİ
-            if (pOutPacket != nullptr)
-            {
-                lostWaitTimer.MakeTimePoint();
-                m_pDecoderPacketCallback(pOutPacket);
-                m_nLastOutSeq = m_nExpOutSeq;
-                m_nExpOutSeq++;
-                continue;
-            }
-
-            //δҵһҪİȴʱȴ
-            if (lostWaitTimer.GetDuration() > MAX_WAIT_TIME)
-            {
-                lostWaitTimer.MakeTimePoint();
-                if (!SkipPackets())
-                {
-                    bNeedWait = true;
-                }
-            }
-            else
-            {
-                bNeedWait = true;
-            }
-
-            if (nackTimer.GetDuration() > NACK_TICK)
-            {
-                nackTimer.MakeTimePoint();
-                //OutNackPacketIfNeed();
-            }
-        }
+        return false;
+    }
 
-        if (bNeedWait)
-        {
-            std::this_thread::sleep_for(std::chrono::milliseconds(5));
-        }
+    NackState& nack = m_NackStates[lost.m_nSeq];
+    double interval = rtt * 1.5 > MIN_NACK_RETRY_INTERVAL ? rtt * 1.5 : MIN_NACK_RETRY_INTERVAL;
+    if (nack.m_nSendNum >= MAX_NACK_RETRY_NUM ||
+        (nack.m_nSendNum > 0 && now - nack.m_lLastSend < (uint64_t)(interval * MEDIA_CLOCK_RATE / 1000)))
+    {
+        return false;
     }
+
+    nack.m_nSendNum++;
+    nack.m_lLastSend = now;
+    return true;
 }
 
-bool RFC8627FECDecoder::SkipPackets()
+//column repairs only come when the block closes,often after the usual wait for a hole near its start.
+//A hole is held the usual wait from each scan while its block has not failed and cannot have closed at
+//the sender yet:fewer packets after it than a block covers,and not older than the sender lets a block get.
+//One no repair has come for yet is held only while the sender sends repairs at all.Past that the last
+//hold lapses on its own,leaving the repairs time to arrive
+void RFC8627FECDecoder::HoldIfRepairPending(const JitterBuffer::LostPacket& lost, double wait)
 {
-    std::shared_ptr<Packet> pOutPacket = nullptr;
+    FECBlock::RepairState state = GetRepairState(lost.m_nSeq);
+    if (state == FECBlock::REPAIR_STATE_FAILED)
     {
-        //std::lock_guard<std::mutex> lock(m_pRTPSortArrayLock);
-        for (int i = 0; i < MAX_SKIP_NUM; i++)
-        {
-            //յһ
-            if (m_nLastRecvSeq + 1 == m_nExpOutSeq)
-            {
-                break;
-            }
-            m_nExpOutSeq++;
-
-            if (m_pRTPSortArray[m_nExpOutSeq] != nullptr)
-            {
-                pOutPacket = m_pRTPSortArray[m_nExpOutSeq];
-                m_pRTPSortArray[m_nExpOutSeq] = nullptr;
-                break;
-            }
-        }
+        m_pJitterBuffer->HoldPacket(lost.m_nSeq, 0);
+        return;
     }
-
-    if (pOutPacket == nullptr)
+    if (lost.m_nLaterNum >= m_nBlockSourceNum || (m_nMaxBlockDelay > 0 && lost.m_fAge >= m_nMaxBlockDelay + wait))
     {
-        if (m_nExpOutSeq != m_nLastRecvSeq + 1)
-        {
-            m_nExpOutSeq = m_nLastRecvSeq + 1;
-            Warn("[%p][RFC8627FECDecoder::SkipPackets1] skip packet:%d->%d", this, m_nLastOutSeq, m_nLastRecvSeq);
-        }
+        return;
     }
-    else
+    if (state == FECBlock::REPAIR_STATE_NONE && (!m_bRecvRepair || m_RepairTimer.GetDuration() > MAX_REPAIR_SILENCE))
     {
-        uint16_t seq = m_nLastOutSeq;
-        m_pDecoderPacketCallback(pOutPacket);
-        m_nLastOutSeq = m_nExpOutSeq;
-        m_nExpOutSeq++;
-        Warn("[%p][RFC8627FECDecoder::SkipPackets2] skip packet:%d->%d", this, seq, m_nLastOutSeq - 1);
-        pOutPacket = nullptr;
-        return true;
+        return;
     }
 
-    return false;
+    m_pJitterBuffer->HoldPacket(lost.m_nSeq, wait);
 }
 
-int32_t RFC8627FECDecoder::OutNackPacketIfNeed()
+FECBlock::RepairState RFC8627FECDecoder::GetRepairState(uint16_t seq)
 {
-    if (m_pNackPacketCallback != nullptr)
+    for (auto item : m_pBlocks)
     {
-        std::shared_ptr<Packet>nack = MakeNackPacket();
-        if (nack != nullptr)
+        FECBlock::RepairState state = item->GetRepairState(seq);
+        if (state != FECBlock::REPAIR_STATE_NONE)
         {
-            m_pNackPacketCallback(nack);
+            return state;
         }
     }
 
-    return 0;
+    return FECBlock::REPAIR_STATE_NONE;
 }
 
-std::shared_ptr<Packet> RFC8627FECDecoder::MakeNackPacket()
+int32_t RFC8627FECDecoder::OutNackPacketIfNeed()
 {
-    std::list<NackItem> nackItems;
-    std::shared_ptr<Packet> nack = nullptr;
- 
+    if (m_NackTimer.GetDuration() < NACK_INTERVAL)
     {
-        //std::lock_guard<std::mutex> lock(m_pRTPSortArrayLock);
-        uint16_t seq = m_nLastOutSeq + 1;
+        return 0;
+    }
+    m_NackTimer.MakeTimePoint();
 
-        while (seq < m_nLastRecvSeq)
+    uint64_t now = TimeCounter::GetMediaTime();
+    uint64_t keep = (uint64_t)MAX_NACK_STATE_AGE * MEDIA_CLOCK_RATE / 1000;
+    for (auto it = m_NackStates.begin(); it != m_NackStates.end();)
+    {
+        if (now - it->second.m_lLastSend > keep)
         {
-            if (m_pRTPSortArray[seq] == nullptr)
-            {
-                NackItem item;
-                item.PID = seq;
-
-                for (int i = 0; i < 16; i++)
-                {
-                    seq++;
-                    if (seq == m_nLastRecvSeq)
-                    {
-                        break;
-                    }
-                    if (m_pRTPSortArray[seq] == nullptr)
-                    {
-                        item.BLP |= (1 << (15 - i));
-                    }
-                }
-                nackItems.push_back(item);
-            }
-            seq++;
+            it = m_NackStates.erase(it);
+        }
+        else
+        {
+            ++it;
         }
     }
 
-    size_t itemCount = nackItems.size();
-    if (itemCount > 0)
+    std::list<JitterBuffer::LostPacket> lost;
+    m_pJitterBuffer->GetLostPackets(lost);
+    if (lost.empty())
     {
-        size_t nNackPacketSize = itemCount * 4 + 12;
-        uint8_t* nackData = (uint8_t*)malloc(nNackPacketSize);
-        if (nackData == nullptr)
-        {
-            Error("[%p][RFC8627FECDecoder::MakeNackPacket] malloc nack data fail,size:%d", nNackPacketSize);
-            return nullptr;
-        }
+        return 0;
+    }
 
-        nackData[0] = 0x81;
-        nackData[1] = 0xcd;
-        nackData[2] = (itemCount + 2) >> 8;
-        nackData[3] = (itemCount + 2) & 0xff;
-        nackData[4] = m_nSSRC >> 24;
-        nackData[5] = (m_nSSRC >> 16) & 0xff;
-        nackData[6] = (m_nSSRC >> 8) & 0xff;
-        nackData[7] = m_nSSRC & 0xff;
-        nackData[8] = 0;
-        nackData[9] = 0;
-        nackData[10] = 0;
-        nackData[11] = 0;
-
-        int i = 0;
-        for (auto& item : nackItems)
+    double wait = m_pJitterBuffer->GetWaitTime();
+    double recoverDelay = m_pJitterBuffer->GetRecoverDelay();
+    std::list<uint16_t> request;
+    for (auto& item : lost)
+    {
+        HoldIfRepairPending(item, wait);
+        if (IsNeedNack(item, wait, recoverDelay, now))
         {
-            nackData[12 + (i * 4)] = item.PID >> 8;
-            nackData[13 + (i * 4)] = item.PID & 0xff;
-            nackData[14 + (i * 4)] = item.BLP >> 8;
-            nackData[15 + (i * 4)] = item.BLP & 0xff;
-            i++;
+            request.push_back(item.m_nSeq);
         }
+    }
+    if (request.empty())
+    {
+        return 0;
+    }
 
-        nack = std::make_shared<Packet>();
-        nack->m_pData = nackData;
-        nack->m_nLength = nNackPacketSize;
+    std::shared_ptr<Packet> nack = RTCPPacket::MakeGenericNack(m_nSSRC, m_nMediaSSRC, request);
+    if (nack == nullptr)
+    {
+        Error("[%p][RFC8627FECDecoder::OutNackPacketIfNeed] MakeGenericNack fail", this);
+        return -1;
     }
 
-    return nack;
-}
+    m_nNackSentNum += request.size();
+    Debug("[%p][RFC8627FECDecoder::OutNackPacketIfNeed] nack:%d from:%d,sent:%u recv:%u late:%u", this, (int)request.size(),
+        request.front(), m_nNackSentNum, m_nNackRecvNum, m_nNackLateNum);
+    m_pNackPacketCallback(nack);
+
+    return 0;
+}
\ No newline at end of file
@@ -1,9 +1,12 @@
 #pragma once
 #include <list>
-#include <mutex>
-#include <thread>
+#include <atomic>
+#include <vector>
+#include <unordered_map>
 #include "Common.h"
 #include "FEC2DTable.h"
+#include "JitterBuffer.h"
+#include "CommonTools/TimeCounter.h"
 
 class RFC8627FECDecoder
 {
@@ -15,38 +18,60 @@ public:
     RFC8627FECDecoder();
     ~RFC8627FECDecoder();
     int32_t Init(uint8_t row, uint8_t col, uint8_t tableNum);
+    int32_t Init(const FECBlock::Config& config);
+    int32_t SetConfig(const FECBlock::Config& config, uint32_t ssrc);      //the repairs from ssrc on,same thread as RecvPacket
     bool SetDecoderPacketCallback(FECDecoderPacketCallback callback);
     bool SetNackPacketCallback(NackPacketCallback callback);
     bool SetPayloadType(uint8_t pt);
     bool SetSSRC(uint32_t ssrc);
     int32_t RecvPacket(const std::shared_ptr<Packet>& packet);
+    void SetRoundTripTime(double rtt);      //ms,a retransmission takes that long to fill a hole
+    void GetNackStatistics(uint32_t& sent, uint32_t& recv, uint32_t& late);
 
 private:
+    typedef struct NackState
+    {
+        uint32_t m_nSendNum = 0;
+        uint64_t m_lLastSend = 0;           //media time
+    }NackState;
+
     int32_t ReleaseAll();
+    int32_t CreateBlocks(const FECBlock::Config& config, std::vector<FECBlock*>& blocks);
+    bool CheckRepairSSRC(const std::shared_ptr<Packet>& packet);     //false to drop it
     int32_t OutNackPacketIfNeed();
-    std::shared_ptr<Packet> MakeNackPacket();
+    bool IsNeedNack(const JitterBuffer::LostPacket& lost, double wait, double recoverDelay, uint64_t now);
+    void HoldIfRepairPending(const JitterBuffer::LostPacket& lost, double wait);
+    FECBlock::RepairState GetRepairState(uint16_t seq);
     void OnRTPPacket(const std::shared_ptr<Packet>& packet, bool isOutByRepair = false);
-    void OutPacketThread();
-    bool SkipPackets();
-    bool IsHasRecvPacket(uint16_t seq);
-    void RecvCachePacket(FEC2DTable* pFEC2DTable);
+    FECBlock* FindBlock(const std::shared_ptr<Packet>& packet);
+    void RecvCachePacket(FECBlock* pFECBlock);
+    void RehomeEvictedPackets(FECBlock* pFECBlock);
 
 private:
     uint8_t m_nPayloadType;
-    uint32_t m_nSSRC;
+    uint32_t m_nSSRC;                       //of the repairs the blocks are built for
+    uint32_t m_nBlockSourceNum;             //media packets a full block of the blocks covers
+    uint16_t m_nMaxBlockDelay;              //ms the sender keeps a block open,0 no limit
+    bool m_bRecvRepair;
+    TimeCounter m_RepairTimer;              //since the last repair
+    bool m_bHasPendingConfig;
+    FECBlock::Config m_PendingConfig;
+    uint32_t m_nPendingSSRC;
 
-    std::list<FEC2DTable*> m_pTableList;
+    std::vector<FECBlock*> m_pBlocks;
+    std::vector<uint32_t> m_pBlockLastUse;  //the least recently used block takes a new one
+    uint32_t m_nUseTick;
     std::list<std::shared_ptr<Packet>> m_pCachePacketList;
     FECDecoderPacketCallback m_pDecoderPacketCallback;
     NackPacketCallback m_pNackPacketCallback;
 
-    bool m_bRecvFirstPacket;
-    uint16_t m_nExpOutSeq;
-    uint16_t m_nLastRecvSeq;
-    uint16_t m_nLastOutSeq;
-    std::mutex m_pRTPSortArrayLock;
-    std::vector< std::shared_ptr<Packet>>m_pRTPSortArray;
+    JitterBuffer* m_pJitterBuffer;
 
-    bool m_bStopOutPacket;
-    std::thread* m_pOutPacketThread;
+    uint32_t m_nMediaSSRC;
+    std::atomic<double> m_fRoundTripTime;
+    TimeCounter m_NackTimer;
+    std::unordered_map<uint16_t, NackState> m_NackStates;
+    uint32_t m_nNackSentNum;                //seqs asked for
+    uint32_t m_nNackRecvNum;                //asked for and came before the hole was skipped
+    uint32_t m_nNackLateNum;                //asked for and came after it was skipped or rebuilt
 };
@@ -1,16 +1,32 @@
-#include <list>
+#include <string.h>
 #include "FECEncoder.h"
 #include "Log/Log.h"
+#include "CommonTools/TimeCounter.h"
 
-#define MAX_CACHE_NAM 200
+#define MAX_CACHE_PACKET_SIZE (1536)
+#define BUDGET_CHECK_INTERVAL (64)
+#define BUDGET_WINDOW (1024)
+#define MAX_PENALTY (REPAIR_MODE_ROW_AND_COLUMN)
 
 RFC8627FECEncoder::RFC8627FECEncoder()
 {
     m_nPayloadType = 99;
     m_nSeq = 0;
     m_nSSRC = 0x55667788;
-    m_pFEC2DTable = nullptr;
+    m_eRepairMode = REPAIR_MODE_ROW_AND_COLUMN;
+    m_ePendingRepairMode = REPAIR_MODE_ROW_AND_COLUMN;
+    m_eMaxRepairMode = REPAIR_MODE_ROW_AND_COLUMN;
+    m_nMaxBlockDelay = 0;
+    FECBlock::Config config;
+    memcpy(m_PriorityOffset, config.m_PriorityOffset, sizeof(m_PriorityOffset));
+    m_nPenalty = 0;
+    m_nMediaPacketNum = 0;
+    m_nRepairPacketNum = 0;
+    m_pFECBlock = nullptr;
+    m_pPendingBlock = nullptr;
+    m_bHasPendingConfig = false;
     m_pEncoderPacketCallback = nullptr;
+    m_pCachePacketRing = nullptr;
 }
 
 RFC8627FECEncoder::~RFC8627FECEncoder()
@@ -20,47 +36,131 @@ RFC8627FECEncoder::~RFC8627FECEncoder()
 
 int32_t RFC8627FECEncoder::ReleaseAll()
 {
-    delete m_pFEC2DTable;
-    m_pFEC2DTable = nullptr;
+    delete m_pFECBlock;
+    m_pFECBlock = nullptr;
+    delete m_pPendingBlock;
+    m_pPendingBlock = nullptr;
+    m_bHasPendingConfig = false;
 
-    {
-        std::lock_guard<std::mutex> lock(m_cCachePacketLock);
-        m_cCacheList.clear();
-        m_cCacheMap.clear();
-    }
+    delete m_pCachePacketRing;
+    m_pCachePacketRing = nullptr;
 
     return 0;
 }
 
 int32_t RFC8627FECEncoder::Init(uint8_t row, uint8_t col)
 {
-    Trace("[%p][RFC8627FECEncoder::Init] Init col:%d row:%d", this, row, col);
+    FECBlock::Config config;
+    config.m_eScheme = FECBlock::SCHEME_2D_XOR;
+    config.m_nRow = row;
+    config.m_nColumn = col;
+    return Init(config);
+}
 
-    int32_t nFailRet = 0;
-    if (m_pFEC2DTable != nullptr)
+int32_t RFC8627FECEncoder::Init(const FECBlock::Config& config)
+{
+    Trace("[%p][RFC8627FECEncoder::Init] Init scheme:%s", this, FECBlock::MakeSdpAttribute(config).c_str());
+
+    if (m_pFECBlock != nullptr)
     {
-        Error("[%p][RFC8627FECEncoder::Init] FEC2DTable is not null", this);
+        Error("[%p][RFC8627FECEncoder::Init] FECBlock is not null", this);
         return -1;
     }
 
-    m_pFEC2DTable = new FEC2DTable(m_nPayloadType);
-    int32_t ret = m_pFEC2DTable->Init(row, col);
+    m_pFECBlock = FECBlock::CreateBlock(config, m_nPayloadType);
+    if (m_pFECBlock == nullptr)
+    {
+        Error("[%p][RFC8627FECEncoder::Init] create FECBlock fail", this);
+        ReleaseAll();
+        return -2;
+    }
+
+    m_pCachePacketRing = new PacketRing();
+    int32_t ret = m_pCachePacketRing->Init(config.m_nCacheSize, MAX_CACHE_PACKET_SIZE);
     if (ret != 0)
     {
-        Error("[%p][RFC8627FECEncoder::Init] Init FEC2DTable err,return:%d", this, ret);
-        nFailRet = -2;
-        goto fail;
+        Error("[%p][RFC8627FECEncoder::Init] init PacketRing size:%u fail,return:%d", this, config.m_nCacheSize, ret);
+        ReleaseAll();
+        return -3;
+    }
+
+    UseConfig(config, m_nSSRC);
+
+    return 0;
+}
+
+//the new geometry goes out under the next repair SSRC,so a decoder can tell which one a repair packet was made with
+int32_t RFC8627FECEncoder::SetConfig(const FECBlock::Config& config)
+{
+    if (m_pFECBlock == nullptr)
+    {
+        Error("[%p][RFC8627FECEncoder::SetConfig] not init", this);
+        return -1;
     }
 
-    m_pFEC2DTable->SetFECPacketCallback(std::bind(&RFC8627FECEncoder::OnFECPacket, this, std::placeholders::_1));
-    m_pFEC2DTable->SetRTPPacketCallback(std::bind(&RFC8627FECEncoder::OnRTPPacket, this, std::placeholders::_1));
+    FECBlock* pFECBlock = FECBlock::CreateBlock(config, m_nPayloadType);
+    if (pFECBlock == nullptr)
+    {
+        Error("[%p][RFC8627FECEncoder::SetConfig] create FECBlock fail", this);
+        return -2;
+    }
 
-    m_cCacheMap.reserve(MAX_CACHE_NAM);
+    std::lock_guard<std::mutex> lock(m_ConfigLock);
+    delete m_pPendingBlock;
+    m_pPendingBlock = pFECBlock;
+    m_PendingConfig = config;
+    m_bHasPendingConfig = true;
 
     return 0;
-fail:
-    ReleaseAll();
-    return ret;
+}
+
+void RFC8627FECEncoder::GetConfig(FECBlock::Config& config, uint32_t& ssrc)
+{
+    std::lock_guard<std::mutex> lock(m_ConfigLock);
+    config = m_Config;
+    ssrc = m_nSSRC;
+}
+
+void RFC8627FECEncoder::ApplyPendingConfig()
+{
+    FECBlock* pFECBlock = nullptr;
+    FECBlock::Config config;
+    {
+        std::lock_guard<std::mutex> lock(m_ConfigLock);
+        m_bHasPendingConfig = false;
+        pFECBlock = m_pPendingBlock;
+        m_pPendingBlock = nullptr;
+        config = m_PendingConfig;
+    }
+    if (pFECBlock == nullptr)
+    {
+        return;
+    }
+
+    //the open block still goes out whole,under the old SSRC
+    m_pFECBlock->CloseBlock();
+    delete m_pFECBlock;
+    m_pFECBlock = pFECBlock;
+    UseConfig(config, m_nSSRC + 1);
+    Trace("[%p][RFC8627FECEncoder::ApplyPendingConfig] fec:%s ssrc:%08x", this, FECBlock::MakeSdpAttribute(m_Config).c_str(), m_nSSRC);
+}
+
+void RFC8627FECEncoder::UseConfig(const FECBlock::Config& config, uint32_t ssrc)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_ConfigLock);
+        m_Config = config;
+        m_nSSRC = ssrc;
+    }
+    m_eMaxRepairMode = config.m_eScheme == FECBlock::SCHEME_2D_XOR && config.m_nDimension == 1 ? REPAIR_MODE_COLUMN : REPAIR_MODE_ROW_AND_COLUMN;
+    m_nMaxBlockDelay = config.m_nMaxBlockDelay;
+    memcpy(m_PriorityOffset, config.m_PriorityOffset, sizeof(m_PriorityOffset));
+    m_nPenalty = 0;
+    m_nMediaPacketNum = 0;
+    m_nRepairPacketNum = 0;
+    ApplyRepairDirection();
+    m_pFECBlock->SetFECPacketCallback(std::bind(&RFC8627FECEncoder::OnFECPacket, this, std::placeholders::_1));
+    m_pFECBlock->SetRTPPacketCallback(std::bind(&RFC8627FECEncoder::OnRTPPacket, this, std::placeholders::_1));
 }
 
 bool RFC8627FECEncoder::SetFECEncoderPacketCallback(FECEncoderPacketCallback callback)
@@ -80,15 +180,29 @@ int32_t RFC8627FECEncoder::RecvRTPPacket(const std::shared_ptr<Packet>& packet)
 {
     OnRTPPacket(packet);
 
-    if (m_pFEC2DTable == nullptr)
+    if (m_pFECBlock == nullptr)
     {
-        Error("[%p][RFC8627FECEncoder::RecvPacket] FEC2DTable is not null", this);
+        Error("[%p][RFC8627FECEncoder::RecvPacket] FECBlock is null", this);
         return -1;
     }
+    if (m_bHasPendingConfig)
+    {
+        ApplyPendingConfig();
+    }
+    if (m_ePendingRepairMode != m_eRepairMode)
+    {
+        ApplyPendingRepairMode();
+    }
 
     CacheRTPPacket(packet);
+    CheckBlockDeadline();
+    m_nMediaPacketNum++;
+    if (m_nMediaPacketNum % BUDGET_CHECK_INTERVAL == 0)
+    {
+        CheckRepairBudget();
+    }
 
-    int32_t ret = m_pFEC2DTable->RecvPacketAndMakeRepair(packet);
+    int32_t ret = m_pFECBlock->RecvPacketAndMakeRepair(packet);
     if (ret != 0)
     {
         Error("[%p][RFC8627FECEncoder::RecvPacket] RecvPacketAndMakeRepair fail,return:%d", this, ret);
@@ -98,45 +212,38 @@ int32_t RFC8627FECEncoder::RecvRTPPacket(const std::shared_ptr<Packet>& packet)
     return 0;
 }
 
-int32_t RFC8627FECEncoder::RecvNackPacket(const std::shared_ptr<Packet>& packet)
+//a frame whose marker bit never comes still gets its repairs within the delay
+int32_t RFC8627FECEncoder::CheckBlockDeadline()
 {
-    uint8_t* nack = packet->m_pData;
-    uint16_t itemCount = (nack[2] << 8) | nack[3];
-    if (((itemCount + 3) * 4) > packet->m_nLength)
+    if (m_pFECBlock == nullptr || m_nMaxBlockDelay == 0)
     {
-        Error("[%p][RFC8627FECEncoder::RecvNackPacket] nack packet item:%d size:%d error", this, itemCount, packet->m_nLength);
-        return -1;
+        return 0;
     }
 
-    std::list<uint16_t> lost;
-    for (int i = 0; i < itemCount; i++)
+    double age = m_pFECBlock->GetBlockAge();
+    if (age > m_nMaxBlockDelay)
     {
-        uint16_t PID = (nack[12 + (4 * i)] << 8) | nack[13 + (4 * i)];
-        uint16_t BLP = (nack[14 + (4 * i)] << 8) | nack[15 + (4 * i)];
-
-        lost.push_back(PID);
-        for (int i = 0; i < 16; i++)
-        {
-            if ((BLP & 0x80) == 0x80)
-            {
-                lost.push_back(PID + i + 1);
-            }
-            BLP <<= 1;
-        }
+        Debug("[%p][RFC8627FECEncoder::CheckBlockDeadline] block open for %.1fms,close it", this, age);
+        m_pFECBlock->CloseBlock();
     }
 
+    return 0;
+}
+
+std::shared_ptr<Packet> RFC8627FECEncoder::GetCachedPacket(uint16_t seq, double& age)
+{
+    if (m_pCachePacketRing == nullptr)
     {
-        std::lock_guard<std::mutex> lock(m_cCachePacketLock);
-        for (auto& seq : lost)
-        {
-            if (m_cCacheMap.find(seq) != m_cCacheMap.end())
-            {
-                OnRTPPacket(m_cCacheMap.at(seq));
-            }
-        }
+        return nullptr;
     }
 
-    return 0;
+    uint64_t time = 0;
+    std::shared_ptr<Packet> packet = m_pCachePacketRing->Lookup(seq, time);
+    if (packet != nullptr)
+    {
+        age = (double)(TimeCounter::GetMediaTime() - time) * 1000 / MEDIA_CLOCK_RATE;
+    }
+    return packet;
 }
 
 bool RFC8627FECEncoder::SetPayloadType(uint8_t pt)
@@ -157,6 +264,96 @@ bool RFC8627FECEncoder::SetSSRC(uint32_t ssrc)
     return true;
 }
 
+//the decoder repairs with whatever repair packets arrive,so the mode needs no signalling
+int32_t RFC8627FECEncoder::SetRepairMode(RepairMode mode)
+{
+    if (mode < REPAIR_MODE_NONE || mode > REPAIR_MODE_ROW_AND_COLUMN)
+    {
+        Error("[%p][RFC8627FECEncoder::SetRepairMode] mode:%d err", this, mode);
+        return -1;
+    }
+
+    //the block may be swapped or deleted by the packet thread at any time,so it only ever touches it
+    m_ePendingRepairMode = mode;
+
+    return 0;
+}
+
+void RFC8627FECEncoder::ApplyPendingRepairMode()
+{
+    RepairMode mode = m_ePendingRepairMode;
+    Trace("[%p][RFC8627FECEncoder::ApplyPendingRepairMode] repair mode:%d->%d", this, m_eRepairMode, mode);
+    m_eRepairMode = mode;
+    ApplyRepairDirection();
+}
+
+//each class repairs at the link's level plus its offset,a link that needs no repair gets none for any class
+void RFC8627FECEncoder::ApplyRepairDirection()
+{
+    if (m_pFECBlock == nullptr)
+    {
+        return;
+    }
+
+    RepairMode mode = m_eRepairMode < m_eMaxRepairMode ? m_eRepairMode : m_eMaxRepairMode;
+    for (int i = 0; i < PACKET_PRIORITY_NUM; i++)
+    {
+        int32_t level = mode;
+        if (mode != REPAIR_MODE_NONE)
+        {
+            level += m_PriorityOffset[i] - (i != PACKET_PRIORITY_HIGH ? m_nPenalty.load() : 0);
+            level = level < REPAIR_MODE_NONE ? REPAIR_MODE_NONE : level > m_eMaxRepairMode ? m_eMaxRepairMode : level;
+        }
+        m_pFECBlock->SetRepairDirection(i, level == REPAIR_MODE_ROW_AND_COLUMN, level != REPAIR_MODE_NONE);
+    }
+}
+
+//the boosted classes must not push the repairs over what the link's mode alone would send,
+//when they do the other classes give up a level until the total fits again
+void RFC8627FECEncoder::CheckRepairBudget()
+{
+    //at the top level no class can go above the link,so there is nothing to pay for
+    RepairMode mode = m_eRepairMode < m_eMaxRepairMode ? m_eRepairMode : m_eMaxRepairMode;
+    bool bBoosted = false;
+    for (int i = 0; i < PACKET_PRIORITY_NUM; i++)
+    {
+        bBoosted = bBoosted || m_PriorityOffset[i] > 0;
+    }
+    bBoosted = bBoosted && mode != REPAIR_MODE_NONE && mode != m_eMaxRepairMode;
+
+    uint8_t penalty = m_nPenalty;
+    if (!bBoosted)
+    {
+        penalty = 0;
+    }
+    else
+    {
+        float allowed = m_pFECBlock->GetRepairOverhead(mode == REPAIR_MODE_ROW_AND_COLUMN, mode != REPAIR_MODE_NONE) * m_nMediaPacketNum;
+        if (m_nRepairPacketNum > allowed * 1.125f && penalty < MAX_PENALTY)
+        {
+            penalty++;
+        }
+        else if (m_nRepairPacketNum < allowed * 0.8f && penalty > 0)
+        {
+            penalty--;
+        }
+    }
+
+    if (penalty != m_nPenalty)
+    {
+        Debug("[%p][RFC8627FECEncoder::CheckRepairBudget] media:%u repair:%u penalty:%d->%d", this,
+            m_nMediaPacketNum, m_nRepairPacketNum, m_nPenalty.load(), penalty);
+        m_nPenalty = penalty;
+        ApplyRepairDirection();
+    }
+
+    if (m_nMediaPacketNum >= BUDGET_WINDOW)
+    {
+        m_nMediaPacketNum /= 2;
+        m_nRepairPacketNum /= 2;
+    }
+}
+
 void RFC8627FECEncoder::OnFECPacket(const std::shared_ptr<Packet>& packet)
 {
     uint8_t* pRepairPacketData = packet->m_pData;
@@ -168,6 +365,7 @@ void RFC8627FECEncoder::OnFECPacket(const std::shared_ptr<Packet>& packet)
     pRepairPacketData[10] = (m_nSSRC >> 8) & 0xff;
     pRepairPacketData[11] = m_nSSRC & 0xff;
     m_nSeq++;
+    m_nRepairPacketNum++;
 
     if (m_pEncoderPacketCallback != nullptr)
     {
@@ -185,20 +383,8 @@ void RFC8627FECEncoder::OnRTPPacket(const std::shared_ptr<Packet>& packet)
 
 void RFC8627FECEncoder::CacheRTPPacket(const std::shared_ptr<Packet>& packet)
 {
-    uint16_t seq = (packet->m_pData[2] << 8) | packet->m_pData[3];
+    if (m_pCachePacketRing->Store(packet, TimeCounter::GetMediaTime()) != 0)
     {
-        std::lock_guard<std::mutex> lock(m_cCachePacketLock);
-        if (m_cCacheMap.find(seq) == m_cCacheMap.end())
-        {
-            m_cCacheMap.insert({ seq ,packet });
-            m_cCacheList.push_back(seq);
-
-            while (m_cCacheList.size() > MAX_CACHE_NAM)
-            {
-                uint16_t nRemoveSeq = m_cCacheList.front();
-                m_cCacheList.pop_front();
-                m_cCacheMap.erase(nRemoveSeq);
-            }
-        }
+        Warn("[%p][RFC8627FECEncoder::CacheRTPPacket] packet size:%d not cached", this, packet->m_nLength);
     }
 }
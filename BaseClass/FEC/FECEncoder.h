@@ -1,39 +1,67 @@
 #pragma once
-#include <list>
 #include <mutex>
-#include <unordered_map>
+#include <atomic>
 #include "Common.h"
-#include "FEC2DTable.h"
+#include "FECBlock.h"
+#include "CommonTools/PacketRing.h"
 
 class RFC8627FECEncoder
 {
 public:
     typedef std::function<void(const std::shared_ptr<Packet>&)> FECEncoderPacketCallback;
+    typedef enum RepairMode
+    {
+        REPAIR_MODE_NONE = 0,
+        REPAIR_MODE_COLUMN,             //one repair per column,covers bursts up to the row count
+        REPAIR_MODE_ROW_AND_COLUMN
+    }RepairMode;
 
 public:
     RFC8627FECEncoder();
     ~RFC8627FECEncoder();
     int32_t Init(uint8_t row, uint8_t col);
+    int32_t Init(const FECBlock::Config& config);
+    int32_t SetConfig(const FECBlock::Config& config);      //any thread,the blocks after the open one use it
+    void GetConfig(FECBlock::Config& config, uint32_t& ssrc);      //in use and the repair SSRC that carries it
     int32_t RecvRTPPacket(const std::shared_ptr<Packet>& packet);
-    int32_t RecvNackPacket(const std::shared_ptr<Packet>& packet);
+    std::shared_ptr<Packet> GetCachedPacket(uint16_t seq, double& age);     //age ms since it was sent,nullptr when gone
+    int32_t CheckBlockDeadline();       //same thread as RecvRTPPacket
     bool SetFECEncoderPacketCallback(FECEncoderPacketCallback callback);
     bool SetPayloadType(uint8_t pt);
     bool SetSSRC(uint32_t ssrc);
+    int32_t SetRepairMode(RepairMode mode);         //any thread,the packet thread applies it
+    inline RepairMode GetRepairMode() { return m_ePendingRepairMode; };
 
 private:
     int32_t ReleaseAll();
     void OnFECPacket(const std::shared_ptr<Packet>& packet);
     void OnRTPPacket(const std::shared_ptr<Packet>& packet);
     void CacheRTPPacket(const std::shared_ptr<Packet>& packet);
+    void ApplyPendingConfig();
+    void UseConfig(const FECBlock::Config& config, uint32_t ssrc);
+    void ApplyPendingRepairMode();
+    void ApplyRepairDirection();
+    void CheckRepairBudget();
 
 private:
     uint8_t m_nPayloadType;
     uint16_t m_nSeq;
     uint32_t m_nSSRC;
-    FEC2DTable* m_pFEC2DTable;
+    RepairMode m_eRepairMode;           //packet thread
+    std::atomic<RepairMode> m_ePendingRepairMode;
+    RepairMode m_eMaxRepairMode;        //1D geometry stops at the columns
+    uint16_t m_nMaxBlockDelay;
+    int8_t m_PriorityOffset[PACKET_PRIORITY_NUM];
+    std::atomic<uint8_t> m_nPenalty;    //levels taken off the non-IDR classes to pay for the IDR ones
+    uint32_t m_nMediaPacketNum;
+    uint32_t m_nRepairPacketNum;
+    FECBlock* m_pFECBlock;
+    std::mutex m_ConfigLock;
+    FECBlock::Config m_Config;
+    FECBlock* m_pPendingBlock;          //built by SetConfig,swapped in by the packet thread
+    FECBlock::Config m_PendingConfig;
+    std::atomic<bool> m_bHasPendingConfig;
     FECEncoderPacketCallback m_pEncoderPacketCallback;
 
-    std::list<uint16_t> m_cCacheList;
-    std::unordered_map<uint16_t, std::shared_ptr<Packet>> m_cCacheMap;
-    std::mutex m_cCachePacketLock;
+    PacketRing* m_pCachePacketRing;     //sent media packets,read from the NACK path
 };
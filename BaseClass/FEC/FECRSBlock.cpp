@@ -0,0 +1,499 @@
+#include <string.h>
+#include "FECRSBlock.h"
+#include "GF256.h"
+#include "Log/Log.h"
+
+#define RS_HEADER_SIZE (24)     //RTP header + RS header
+#define SYMBOL_HEADER_SIZE (8)
+
+FECRSBlock::FECRSBlock(uint8_t pt)
+{
+    m_nPayloadType = pt;
+    m_nSourceNum = 0;
+    m_nRepairNum = 0;
+    m_nBaseSeq = -1;
+    m_nBlockSourceNum = 0;
+    m_nBlockRepairNum = 0;
+    m_nMaxSymbolLen = 0;
+    m_nActiveRepairNum = 0;
+    memset(m_ClassRepairNum, 0, sizeof(m_ClassRepairNum));
+    m_nBlockPriority = PACKET_PRIORITY_LOW;
+    memset(m_LastTimestamp, 0, sizeof(m_LastTimestamp));
+    memset(m_MediaSSRC, 0, sizeof(m_MediaSSRC));
+    for (int i = 0; i < PACKET_PRIORITY_NUM; i++)
+    {
+        m_bNextRowRepair[i] = true;
+        m_bNextColumnRepair[i] = true;
+    }
+    m_nSourceRecvNum = 0;
+    m_nRepairRecvNum = 0;
+}
+
+FECRSBlock::~FECRSBlock()
+{
+    ReleaseAll();
+}
+
+int32_t FECRSBlock::ReleaseAll()
+{
+    m_pCoefficient.clear();
+    m_pRepairSymbol.clear();
+    m_pSourcePacket.clear();
+    m_pRepairPacket.clear();
+    m_nSourceNum = 0;
+    m_nRepairNum = 0;
+    m_nBaseSeq = -1;
+
+    return 0;
+}
+
+int32_t FECRSBlock::Init(uint8_t k, uint8_t m)
+{
+    if (k == 0 || m == 0 || k > MAX_RS_SOURCE_NUM || m > MAX_RS_REPAIR_NUM)
+    {
+        Error("[%p][FECRSBlock::Init] param k:%d or m:%d err", this, k, m);
+        return -1;
+    }
+
+    m_nSourceNum = k;
+    m_nRepairNum = m;
+    m_pCoefficient.resize(m * k);
+    for (uint32_t j = 0; j < m; j++)
+    {
+        for (uint32_t i = 0; i < k; i++)
+        {
+            m_pCoefficient[j * k + i] = GF256::Inv((255 - j) ^ i);
+        }
+    }
+
+    m_pRepairSymbol.resize(m);
+    m_pSourcePacket.resize(k);
+    m_pRepairPacket.resize(m);
+    ClearTable();
+
+    return 0;
+}
+
+bool FECRSBlock::SetFECPacketCallback(FECPacketCallback callback)
+{
+    m_pFECPacketCallback = callback;
+    return true;
+}
+
+bool FECRSBlock::SetRTPPacketCallback(RTPPacketCallback callback)
+{
+    m_pRTPPacketCallback = callback;
+    return true;
+}
+
+void FECRSBlock::ClearTable()
+{
+    for (auto& item : m_pRepairSymbol)
+    {
+        if (!item.empty())
+        {
+            memset(item.data(), 0, item.size() < m_nMaxSymbolLen ? item.size() : m_nMaxSymbolLen);
+        }
+    }
+    m_nMaxSymbolLen = 0;
+
+    for (auto& item : m_pSourcePacket)
+    {
+        item = nullptr;
+    }
+    for (auto& item : m_pRepairPacket)
+    {
+        item = nullptr;
+    }
+    m_nSourceRecvNum = 0;
+    m_nRepairRecvNum = 0;
+
+    m_nBaseSeq = -1;
+    m_nBlockSourceNum = 0;
+    m_nBlockRepairNum = 0;
+    m_nBlockPriority = PACKET_PRIORITY_LOW;
+}
+
+void FECRSBlock::SetRepairDirection(uint8_t priority, bool row, bool column)
+{
+    if (priority >= PACKET_PRIORITY_NUM)
+    {
+        return;
+    }
+
+    m_bNextRowRepair[priority] = row;
+    m_bNextColumnRepair[priority] = column;
+}
+
+float FECRSBlock::GetRepairOverhead(bool row, bool column)
+{
+    if (m_nSourceNum == 0)
+    {
+        return 0;
+    }
+
+    return (float)GetRepairNum(row, column) / m_nSourceNum;
+}
+
+//symbol += c * (length | byte 0 | byte 1 | timestamp | payload)
+void FECRSBlock::MulAddSymbol(uint8_t* symbol, const std::shared_ptr<Packet>& packet, uint8_t c)
+{
+    const uint8_t* data = packet->m_pData;
+    uint8_t head[SYMBOL_HEADER_SIZE] = { (uint8_t)(packet->m_nLength >> 8), (uint8_t)(packet->m_nLength & 0xff),
+        data[0], data[1], data[4], data[5], data[6], data[7] };
+    GF256::MulAdd(symbol, head, c, SYMBOL_HEADER_SIZE);
+    GF256::MulAdd(symbol + SYMBOL_HEADER_SIZE, data + 12, c, packet->m_nLength - 12);
+}
+
+int32_t FECRSBlock::RecvPacketAndMakeRepair(const std::shared_ptr<Packet>& packet)
+{
+    if (packet->m_nLength < 12 || packet->m_nLength > 0xffff)
+    {
+        Error("[%p][FECRSBlock::RecvPacketAndMakeRepair] packet size:%d err", this, packet->m_nLength);
+        return -1;
+    }
+
+    uint16_t seq = (packet->m_pData[2] << 8) | packet->m_pData[3];
+    if (m_nBaseSeq != -1 && (uint16_t)(seq - m_nBaseSeq) != m_nBlockSourceNum)
+    {
+        //the packetizer numbers packets back to back,a gap means it restarted
+        CloseBlock();
+    }
+    if (m_nBaseSeq == -1)
+    {
+        m_nBaseSeq = seq;
+        m_nActiveRepairNum = 0;
+        for (int i = 0; i < PACKET_PRIORITY_NUM; i++)
+        {
+            m_ClassRepairNum[i] = GetRepairNum(m_bNextRowRepair[i], m_bNextColumnRepair[i]);
+            m_nActiveRepairNum = m_nActiveRepairNum > m_ClassRepairNum[i] ? m_nActiveRepairNum : m_ClassRepairNum[i];
+        }
+        memcpy(m_MediaSSRC, packet->m_pData + 8, 4);
+        m_BlockTimer.MakeTimePoint();
+    }
+
+    uint32_t nSymbolLen = packet->m_nLength - 12 + SYMBOL_HEADER_SIZE;
+    if (m_nActiveRepairNum > 0 && m_nMaxSymbolLen < nSymbolLen)
+    {
+        for (uint32_t j = 0; j < m_nActiveRepairNum; j++)
+        {
+            if (m_pRepairSymbol[j].size() < nSymbolLen)
+            {
+                m_pRepairSymbol[j].resize(nSymbolLen, 0);
+            }
+        }
+        m_nMaxSymbolLen = nSymbolLen;
+    }
+
+    //folded into every repair right away,the packet itself is not kept
+    for (uint32_t j = 0; j < m_nActiveRepairNum; j++)
+    {
+        MulAddSymbol(m_pRepairSymbol[j].data(), packet, GetCoefficient(j, m_nBlockSourceNum));
+    }
+    memcpy(m_LastTimestamp, packet->m_pData + 4, 4);
+    m_nBlockSourceNum++;
+    if (packet->m_nPriority < PACKET_PRIORITY_NUM && packet->m_nPriority > m_nBlockPriority)
+    {
+        m_nBlockPriority = packet->m_nPriority;
+    }
+
+    //close at a frame end,but not before the block is worth protecting,a burst eats a tiny block whole
+    bool bIsFrameEnd = (packet->m_pData[1] & 0x80) == 0x80;
+    if ((bIsFrameEnd && m_nBlockSourceNum >= (m_nSourceNum + 1) / 2) || m_nBlockSourceNum == m_nSourceNum)
+    {
+        CloseBlock();
+    }
+
+    return 0;
+}
+
+void FECRSBlock::CloseBlock()
+{
+    if (m_nBaseSeq == -1 || m_nBlockSourceNum == 0)
+    {
+        return;
+    }
+
+    //every class got its repairs accumulated,send as many as the most important packet in the block asks
+    uint32_t nRepairNum = (m_ClassRepairNum[m_nBlockPriority] * m_nBlockSourceNum + m_nSourceNum - 1) / m_nSourceNum;
+    for (uint32_t j = 0; j < nRepairNum; j++)
+    {
+        uint32_t nRepairPacketSize = RS_HEADER_SIZE + m_nMaxSymbolLen;
+        uint8_t* pRepairPacketData = (uint8_t*)malloc(nRepairPacketSize);
+        if (pRepairPacketData == nullptr)
+        {
+            Error("[%p][FECRSBlock::CloseBlock] malloc repair packet fail", this);
+            break;
+        }
+
+        //RTP Head,pt seq and ssrc be filled in outside
+        memset(pRepairPacketData, 0, RS_HEADER_SIZE);
+        pRepairPacketData[0] = 0x80;
+        memcpy(pRepairPacketData + 4, m_LastTimestamp, 4);
+        //RS Head
+        pRepairPacketData[12] = m_nBaseSeq >> 8;
+        pRepairPacketData[13] = m_nBaseSeq & 0xff;
+        pRepairPacketData[14] = m_nBlockSourceNum;
+        pRepairPacketData[15] = nRepairNum;
+        pRepairPacketData[16] = j;
+        memcpy(pRepairPacketData + 20, m_MediaSSRC, 4);
+        memcpy(pRepairPacketData + RS_HEADER_SIZE, m_pRepairSymbol[j].data(), m_nMaxSymbolLen);
+
+        std::shared_ptr<Packet> pRepairPacket = std::make_shared<Packet>();
+        pRepairPacket->m_nLength = nRepairPacketSize;
+        pRepairPacket->m_pData = pRepairPacketData;
+        OutputFECPacket(pRepairPacket);
+    }
+
+    ClearTable();
+}
+
+double FECRSBlock::GetBlockAge()
+{
+    return m_nBaseSeq == -1 ? 0 : m_BlockTimer.GetDuration();
+}
+
+//the block is only known once a repair packet came,and every repair sent may still come until all did
+FECBlock::RepairState FECRSBlock::GetRepairState(uint16_t seq)
+{
+    uint16_t index = seq - m_nBaseSeq;
+    if (m_nBaseSeq == -1 || index >= m_nBlockSourceNum || m_pSourcePacket[index] != nullptr)
+    {
+        return REPAIR_STATE_NONE;
+    }
+
+    return m_nRepairRecvNum < m_nBlockRepairNum ? REPAIR_STATE_PENDING : REPAIR_STATE_FAILED;
+}
+
+bool FECRSBlock::IsCanRecvPacket(const std::shared_ptr<Packet>& packet)
+{
+    uint8_t pt = packet->m_pData[1] & 0x7f;
+    if (pt == m_nPayloadType)
+    {
+        if (m_nBaseSeq == -1)
+        {
+            return true;
+        }
+
+        uint16_t baseSeq = (packet->m_pData[12] << 8) | packet->m_pData[13];
+        return m_nBaseSeq == baseSeq;
+    }
+
+    if (m_nBaseSeq == -1)
+    {
+        return false;
+    }
+
+    uint16_t seq = (packet->m_pData[2] << 8) | packet->m_pData[3];
+    return (uint16_t)(seq - m_nBaseSeq) < m_nBlockSourceNum;
+}
+
+int32_t FECRSBlock::RecvPacketAndTryRepair(const std::shared_ptr<Packet>& packet, bool isRepair)
+{
+    if (!IsCanRecvPacket(packet))
+    {
+        Error("[%p][FECRSBlock::RecvPacketAndTryRepair] block can not recv this packet", this);
+        return -1;
+    }
+
+    uint8_t pt = packet->m_pData[1] & 0x7f;
+    if (pt == m_nPayloadType)
+    {
+        if (packet->m_nLength < RS_HEADER_SIZE + SYMBOL_HEADER_SIZE)
+        {
+            Error("[%p][FECRSBlock::RecvPacketAndTryRepair] repair packet size:%d err", this, packet->m_nLength);
+            return -2;
+        }
+
+        uint8_t k = packet->m_pData[14];
+        uint8_t n = packet->m_pData[15];
+        uint8_t index = packet->m_pData[16];
+        if (k == 0 || k > m_nSourceNum || n == 0 || n > m_nRepairNum || index >= n)
+        {
+            Error("[%p][FECRSBlock::RecvPacketAndTryRepair] k:%d repairs:%d index:%d is illage,block k:%d m:%d",
+                this, k, n, index, m_nSourceNum, m_nRepairNum);
+            return -3;
+        }
+
+        if (m_nBaseSeq == -1)
+        {
+            m_nBaseSeq = (packet->m_pData[12] << 8) | packet->m_pData[13];
+            m_nBlockSourceNum = k;
+            m_nBlockRepairNum = n;
+        }
+        if (m_pRepairPacket[index] == nullptr)
+        {
+            m_pRepairPacket[index] = packet;
+            m_nRepairRecvNum++;
+        }
+    }
+    else
+    {
+        uint16_t seq = (packet->m_pData[2] << 8) | packet->m_pData[3];
+        uint16_t index = seq - m_nBaseSeq;
+        if (m_pSourcePacket[index] == nullptr)
+        {
+            m_pSourcePacket[index] = packet;
+            m_nSourceRecvNum++;
+        }
+    }
+
+    if (!isRepair)
+    {
+        return 0;
+    }
+
+    return TryRepair();
+}
+
+int32_t FECRSBlock::TryRepair()
+{
+    if (m_nBaseSeq == -1 || m_nSourceRecvNum >= m_nBlockSourceNum || m_nSourceRecvNum + m_nRepairRecvNum < m_nBlockSourceNum)
+    {
+        return 0;
+    }
+
+    //lost packets and as many repairs
+    uint32_t nLostNum = m_nBlockSourceNum - m_nSourceRecvNum;
+    std::vector<uint32_t> lost;
+    std::vector<uint32_t> repairs;
+    for (uint32_t i = 0; i < m_nBlockSourceNum; i++)
+    {
+        if (m_pSourcePacket[i] == nullptr)
+        {
+            lost.push_back(i);
+        }
+    }
+    uint32_t nSymbolLen = 0;
+    for (uint32_t j = 0; j < m_nBlockRepairNum && repairs.size() < nLostNum; j++)
+    {
+        if (m_pRepairPacket[j] != nullptr)
+        {
+            if (nSymbolLen == 0)
+            {
+                nSymbolLen = m_pRepairPacket[j]->m_nLength - RS_HEADER_SIZE;
+            }
+            else if (m_pRepairPacket[j]->m_nLength - RS_HEADER_SIZE != nSymbolLen)
+            {
+                Error("[%p][FECRSBlock::TryRepair] repair packet size of block:%d differ", this, m_nBaseSeq);
+                return -1;
+            }
+            repairs.push_back(j);
+        }
+    }
+
+    //take the received packets out of each repair,what is left only depends on the lost ones
+    std::vector<std::vector<uint8_t>> remain(nLostNum);
+    for (uint32_t r = 0; r < nLostNum; r++)
+    {
+        remain[r].assign(m_pRepairPacket[repairs[r]]->m_pData + RS_HEADER_SIZE,
+            m_pRepairPacket[repairs[r]]->m_pData + RS_HEADER_SIZE + nSymbolLen);
+        for (uint32_t i = 0; i < m_nBlockSourceNum; i++)
+        {
+            const std::shared_ptr<Packet>& packet = m_pSourcePacket[i];
+            if (packet == nullptr)
+            {
+                continue;
+            }
+            if (packet->m_nLength < 12 || packet->m_nLength - 12 + SYMBOL_HEADER_SIZE > nSymbolLen)
+            {
+                Error("[%p][FECRSBlock::TryRepair] packet size:%d > symbol size:%d", this, packet->m_nLength, nSymbolLen);
+                return -2;
+            }
+            MulAddSymbol(remain[r].data(), packet, GetCoefficient(repairs[r], i));
+        }
+    }
+
+    std::vector<uint8_t> matrix(nLostNum * nLostNum);
+    for (uint32_t r = 0; r < nLostNum; r++)
+    {
+        for (uint32_t e = 0; e < nLostNum; e++)
+        {
+            matrix[r * nLostNum + e] = GetCoefficient(repairs[r], lost[e]);
+        }
+    }
+    if (!GF256::InvertMatrix(matrix.data(), nLostNum))
+    {
+        Error("[%p][FECRSBlock::TryRepair] matrix of block:%d is singular", this, m_nBaseSeq);
+        return -3;
+    }
+
+    std::vector<uint8_t> symbol(nSymbolLen);
+    for (uint32_t e = 0; e < nLostNum; e++)
+    {
+        memset(symbol.data(), 0, nSymbolLen);
+        for (uint32_t r = 0; r < nLostNum; r++)
+        {
+            GF256::MulAdd(symbol.data(), remain[r].data(), matrix[e * nLostNum + r], nSymbolLen);
+        }
+
+        std::shared_ptr<Packet> packet = MakeRecoveredPacket(symbol.data(), nSymbolLen, lost[e]);
+        if (packet == nullptr)
+        {
+            continue;
+        }
+        Debug("[%p][FECRSBlock::TryRepair] repair:%d", this, (uint16_t)(m_nBaseSeq + lost[e]));
+        m_pSourcePacket[lost[e]] = packet;
+        m_nSourceRecvNum++;
+        OutputRTPPacket(packet);
+    }
+
+    return 0;
+}
+
+std::shared_ptr<Packet> FECRSBlock::MakeRecoveredPacket(const uint8_t* symbol, uint32_t size, uint32_t index)
+{
+    uint32_t nPacketSize = (symbol[0] << 8) | symbol[1];
+    if (nPacketSize < 12 || nPacketSize - 12 + SYMBOL_HEADER_SIZE > size)
+    {
+        Error("[%p][FECRSBlock::MakeRecoveredPacket] recovered size:%d err,symbol size:%d", this, nPacketSize, size);
+        return nullptr;
+    }
+
+    uint8_t* pPacketData = (uint8_t*)malloc(nPacketSize);
+    if (pPacketData == nullptr)
+    {
+        Error("[%p][FECRSBlock::MakeRecoveredPacket] malloc packet data err,size:%d", this, nPacketSize);
+        return nullptr;
+    }
+
+    uint16_t seq = m_nBaseSeq + index;
+    const uint8_t* ssrc = nullptr;
+    for (auto& item : m_pRepairPacket)
+    {
+        if (item != nullptr)
+        {
+            ssrc = item->m_pData + 20;
+            break;
+        }
+    }
+    pPacketData[0] = symbol[2];
+    pPacketData[1] = symbol[3];
+    pPacketData[2] = seq >> 8;
+    pPacketData[3] = seq & 0xff;
+    memcpy(pPacketData + 4, symbol + 4, 4);
+    memcpy(pPacketData + 8, ssrc, 4);
+    memcpy(pPacketData + 12, symbol + SYMBOL_HEADER_SIZE, nPacketSize - 12);
+
+    std::shared_ptr<Packet> packet = std::make_shared<Packet>();
+    packet->m_pData = pPacketData;
+    packet->m_nLength = nPacketSize;
+
+    return packet;
+}
+
+void FECRSBlock::OutputFECPacket(const std::shared_ptr<Packet>& packet)
+{
+    if (m_pFECPacketCallback != nullptr)
+    {
+        m_pFECPacketCallback(packet);
+    }
+}
+
+void FECRSBlock::OutputRTPPacket(const std::shared_ptr<Packet>& packet)
+{
+    if (m_pRTPPacketCallback != nullptr)
+    {
+        m_pRTPPacketCallback(packet, true);
+    }
+}
\ No newline at end of file
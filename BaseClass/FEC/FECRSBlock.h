@@ -0,0 +1,76 @@
+#pragma once
+#include <atomic>
+#include <vector>
+#include "FECBlock.h"
+#include "CommonTools/TimeCounter.h"
+
+#define MAX_RS_SOURCE_NUM 128
+#define MAX_RS_REPAIR_NUM 64
+
+//Systematic Cauchy Reed-Solomon block over GF(2^8).The sender closes a block after k packets,or at the
+//RTP marker bit once it holds at least half of k,so small frames share a block and a frame's tail does
+//not wait for the next frame;a short block of k' packets gets ceil(m*k'/k) repairs.
+//Any k' of the k'+repairs packets rebuild the block.
+//
+//repair packet:RTP header(12) | base seq(2) k'(1) repairs(1) index(1) reserved(3) media ssrc(4) | symbol
+//symbol of a media packet:length(2) | byte 0(1) | byte 1(1) | timestamp(4) | payload,zero padded
+class FECRSBlock : public FECBlock
+{
+public:
+    FECRSBlock(uint8_t pt);
+    virtual ~FECRSBlock();
+
+    int32_t Init(uint8_t k, uint8_t m);
+    virtual bool SetFECPacketCallback(FECPacketCallback callback);
+    virtual bool SetRTPPacketCallback(RTPPacketCallback callback);
+    virtual void ClearTable();
+    virtual void SetRepairDirection(uint8_t priority, bool row, bool column);     //column only sends half the repairs
+    virtual float GetRepairOverhead(bool row, bool column);
+    virtual int32_t RecvPacketAndMakeRepair(const std::shared_ptr<Packet>& packet);
+    virtual int32_t RecvPacketAndTryRepair(const std::shared_ptr<Packet>& packet, bool isRepair = true);
+    virtual bool IsCanRecvPacket(const std::shared_ptr<Packet>& packet);
+    virtual int32_t TryRepair();
+    virtual void CloseBlock();
+    virtual double GetBlockAge();
+    virtual RepairState GetRepairState(uint16_t seq);
+
+private:
+    int32_t ReleaseAll();
+    inline uint8_t GetCoefficient(uint32_t repair, uint32_t source) { return m_pCoefficient[repair * m_nSourceNum + source]; };
+    inline uint8_t GetRepairNum(bool row, bool column) { return !column ? 0 : row ? m_nRepairNum : (m_nRepairNum + 1) / 2; };
+    void MulAddSymbol(uint8_t* symbol, const std::shared_ptr<Packet>& packet, uint8_t c);
+    std::shared_ptr<Packet> MakeRecoveredPacket(const uint8_t* symbol, uint32_t size, uint32_t index);
+    void OutputFECPacket(const std::shared_ptr<Packet>& packet);
+    void OutputRTPPacket(const std::shared_ptr<Packet>& packet);
+
+private:
+    uint8_t m_nPayloadType;
+    uint8_t m_nSourceNum;
+    uint8_t m_nRepairNum;
+    std::vector<uint8_t> m_pCoefficient;    //m x k,1/(x_j + y_i) with x_j = 255 - j,y_i = i
+
+    int32_t m_nBaseSeq;
+    uint8_t m_nBlockSourceNum;              //k' of the current block
+    uint8_t m_nBlockRepairNum;
+
+    //encoder
+    uint32_t m_nMaxSymbolLen;
+    uint8_t m_nActiveRepairNum;             //repairs accumulated,enough for the most protected class
+    uint8_t m_ClassRepairNum[PACKET_PRIORITY_NUM];
+    uint8_t m_nBlockPriority;               //highest PacketPriority in the block,it picks the repairs sent
+    uint8_t m_LastTimestamp[4];
+    uint8_t m_MediaSSRC[4];
+    TimeCounter m_BlockTimer;
+    std::vector<std::vector<uint8_t>> m_pRepairSymbol;
+    std::atomic<bool> m_bNextRowRepair[PACKET_PRIORITY_NUM];
+    std::atomic<bool> m_bNextColumnRepair[PACKET_PRIORITY_NUM];
+
+    //decoder
+    std::vector<std::shared_ptr<Packet>> m_pSourcePacket;
+    std::vector<std::shared_ptr<Packet>> m_pRepairPacket;
+    uint32_t m_nSourceRecvNum;
+    uint32_t m_nRepairRecvNum;
+
+    FECPacketCallback m_pFECPacketCallback;
+    RTPPacketCallback m_pRTPPacketCallback;
+};
\ No newline at end of file
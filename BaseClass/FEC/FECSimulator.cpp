@@ -0,0 +1,514 @@
+#include <time.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include "FECSimulator.h"
+#include "FECDecoder.h"
+#include "Log/Log.h"
+#include "CommonTools/TimeCounter.h"
+
+#define SIM_MEDIA_PT (96)
+#define SIM_MJPEG_PT (26)
+#define SIM_REPAIR_PT (109)
+#define SIM_MEDIA_SSRC (0x12345678)
+#define SIM_REPAIR_SSRC (0x23456789)
+#define SIM_RTP_HEADER_SIZE (12)
+#define SIM_MAX_PAYLOAD (1200)
+#define SIM_IDR_FRAME_SCALE (3)
+#define SIM_MAX_PACKET_NUM (60000)      //seq is the index into the run,it must not wrap
+#define SIM_DRAIN_TIME (500)            //ms after the last arrival for the jitter buffer to let go
+
+FECSimulator::FECSimulator(const Stream& stream, const Channel& channel)
+{
+    m_Stream = stream;
+    m_Channel = channel;
+    m_nRandom = channel.m_nSeed;
+    m_bBadState = false;
+    m_lNow = 0;
+    m_lLastArrival = 0;
+    m_lStart = 0;
+    m_nOrder = 0;
+}
+
+FECSimulator::~FECSimulator()
+{
+}
+
+static void MakeRtpHeader(uint8_t* header, uint8_t pt, bool marker, uint16_t seq, uint32_t timestamp, uint32_t ssrc)
+{
+    header[0] = 0x80;
+    header[1] = (marker ? 0x80 : 0) | pt;
+    header[2] = seq >> 8;
+    header[3] = seq & 0xff;
+    header[4] = timestamp >> 24;
+    header[5] = (timestamp >> 16) & 0xff;
+    header[6] = (timestamp >> 8) & 0xff;
+    header[7] = timestamp & 0xff;
+    header[8] = ssrc >> 24;
+    header[9] = (ssrc >> 16) & 0xff;
+    header[10] = (ssrc >> 8) & 0xff;
+    header[11] = ssrc & 0xff;
+}
+
+//the same classes the H264 packetizer gives,read back from the RTP payload
+static uint8_t GetH264Priority(const uint8_t* payload, uint32_t size)
+{
+    if (size < 2)
+    {
+        return PACKET_PRIORITY_NORMAL;
+    }
+
+    uint8_t type = payload[0] & 0x1f;
+    if (type == 28)
+    {
+        type = payload[1] & 0x1f;
+    }
+    if (type == 5 || type == 7 || type == 8 || type == 24)
+    {
+        return PACKET_PRIORITY_HIGH;
+    }
+    return (payload[0] & 0x60) == 0 ? PACKET_PRIORITY_LOW : PACKET_PRIORITY_NORMAL;
+}
+
+static uint64_t GetSteadyTime()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static double GetThreadCpuTime()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1000000.0 + ts.tv_nsec / 1000.0;
+}
+
+static const char* GetRepairModeName(RFC8627FECEncoder::RepairMode mode)
+{
+    return mode == RFC8627FECEncoder::REPAIR_MODE_ROW_AND_COLUMN ? "row+col" :
+        mode == RFC8627FECEncoder::REPAIR_MODE_COLUMN ? "col" : "none";
+}
+
+//LCG from Numerical Recipes,the same seed always drops the same packets
+uint32_t FECSimulator::NextRandom()
+{
+    m_nRandom = m_nRandom * 1664525 + 1013904223;
+    return m_nRandom;
+}
+
+double FECSimulator::NextUniform()
+{
+    return (NextRandom() >> 8) / (double)(1 << 24);
+}
+
+uint64_t FECSimulator::GetElapsed()
+{
+    return GetSteadyTime() - m_lStart;
+}
+
+int32_t FECSimulator::LoadStream()
+{
+    m_Source.clear();
+    int32_t ret = m_Stream.m_strRecordPath.empty() ? MakeSyntheticStream() : LoadRecordedStream();
+    if (ret != 0)
+    {
+        return ret;
+    }
+    if (m_Source.empty())
+    {
+        Error("[%p][FECSimulator::LoadStream] stream is empty", this);
+        return -1;
+    }
+
+    return 0;
+}
+
+//frame sizes as in LinkSimulator:IDR frames are larger and the P frames make up for it
+int32_t FECSimulator::MakeSyntheticStream()
+{
+    uint32_t fps = std::max(m_Stream.m_nFPS, 1U);
+    uint32_t gop = std::max(m_Stream.m_nGOP, (uint32_t)SIM_IDR_FRAME_SCALE + 1);
+    uint64_t average = (uint64_t)m_Stream.m_nBitRate / 8 / fps;
+    uint32_t frameNum = (uint32_t)((uint64_t)m_Stream.m_nDuration * fps / 1000);
+    uint32_t random = 0x12345678;
+    uint16_t seq = 0;
+
+    for (uint32_t frame = 0; frame < frameNum && m_Source.size() < SIM_MAX_PACKET_NUM; frame++)
+    {
+        bool bIsIDR = frame % gop == 0;
+        uint64_t frameBytes = bIsIDR ? average * SIM_IDR_FRAME_SCALE : average * (gop - SIM_IDR_FRAME_SCALE) / (gop - 1);
+        uint64_t time = (uint64_t)frame * 1000000 / fps;
+        uint32_t timestamp = (uint32_t)(time * MEDIA_CLOCK_RATE / 1000000);
+        while (frameBytes > 0 && m_Source.size() < SIM_MAX_PACKET_NUM)
+        {
+            uint32_t payload = (uint32_t)std::min(frameBytes, (uint64_t)SIM_MAX_PAYLOAD);
+            frameBytes -= payload;
+
+            std::shared_ptr<Packet> packet = std::make_shared<Packet>();
+            packet->m_nLength = payload + SIM_RTP_HEADER_SIZE;
+            packet->m_pData = (uint8_t*)malloc(packet->m_nLength);
+            if (packet->m_pData == nullptr)
+            {
+                Error("[%p][FECSimulator::MakeSyntheticStream] malloc size:%d fail", this, packet->m_nLength);
+                return -1;
+            }
+            MakeRtpHeader(packet->m_pData, SIM_MEDIA_PT, frameBytes == 0, seq++, timestamp, SIM_MEDIA_SSRC);
+            for (uint32_t i = SIM_RTP_HEADER_SIZE; i < packet->m_nLength; i++)
+            {
+                random = random * 1103515245 + 12345;
+                packet->m_pData[i] = random >> 24;
+            }
+            packet->m_nPriority = bIsIDR ? PACKET_PRIORITY_HIGH : PACKET_PRIORITY_NORMAL;
+
+            SimPacket item;
+            item.m_lTime = time;
+            item.m_pPacket = packet;
+            m_Source.push_back(item);
+        }
+    }
+
+    return 0;
+}
+
+//repair packets in the dump are left out,the media packets are renumbered from 0 so the seq is the index
+int32_t FECSimulator::LoadRecordedStream()
+{
+    FILE* file = fopen(m_Stream.m_strRecordPath.c_str(), "rb");
+    if (file == nullptr)
+    {
+        Error("[%p][FECSimulator::LoadRecordedStream] open %s fail", this, m_Stream.m_strRecordPath.c_str());
+        return -1;
+    }
+
+    int32_t ret = 0;
+    bool bHasFirst = false;
+    uint32_t firstTimestamp = 0;
+    uint64_t lastTime = 0;
+    uint8_t header[4];
+    while (m_Source.size() < SIM_MAX_PACKET_NUM && fread(header, 1, sizeof(header), file) == sizeof(header))
+    {
+        if (header[0] != '$')
+        {
+            Error("[%p][FECSimulator::LoadRecordedStream] %s is not an interleaved dump", this, m_Stream.m_strRecordPath.c_str());
+            ret = -2;
+            break;
+        }
+
+        uint32_t size = (header[2] << 8) | header[3];
+        std::shared_ptr<Packet> packet = std::make_shared<Packet>();
+        packet->m_pData = (uint8_t*)malloc(size > 0 ? size : 1);
+        if (packet->m_pData == nullptr || fread(packet->m_pData, 1, size, file) != size)
+        {
+            break;
+        }
+        packet->m_nLength = size;
+
+        uint8_t* data = packet->m_pData;
+        uint8_t pt = size >= SIM_RTP_HEADER_SIZE ? data[1] & 0x7f : 0;
+        if (header[1] != 0 || size < SIM_RTP_HEADER_SIZE || pt == SIM_REPAIR_PT)
+        {
+            continue;
+        }
+
+        uint32_t timestamp = (data[4] << 24) | (data[5] << 16) | (data[6] << 8) | data[7];
+        if (!bHasFirst)
+        {
+            bHasFirst = true;
+            firstTimestamp = timestamp;
+        }
+        uint64_t time = (uint64_t)(uint32_t)(timestamp - firstTimestamp) * 1000000 / MEDIA_CLOCK_RATE;
+        lastTime = std::max(lastTime, time);
+
+        uint16_t seq = m_Source.size();
+        data[2] = seq >> 8;
+        data[3] = seq & 0xff;
+        packet->m_nPriority = pt == SIM_MJPEG_PT ? (uint8_t)PACKET_PRIORITY_NORMAL : GetH264Priority(data + SIM_RTP_HEADER_SIZE, size - SIM_RTP_HEADER_SIZE);
+
+        SimPacket item;
+        item.m_lTime = lastTime;
+        item.m_pPacket = packet;
+        m_Source.push_back(item);
+    }
+
+    fclose(file);
+    return ret;
+}
+
+bool FECSimulator::IsChannelLost()
+{
+    switch (m_Channel.m_eLossModel)
+    {
+    case LOSS_MODEL_BERNOULLI:
+        return NextUniform() < m_Channel.m_fLossRate;
+    case LOSS_MODEL_GILBERT_ELLIOTT:
+        m_bBadState = m_bBadState ? NextUniform() >= m_Channel.m_fBadToGood : NextUniform() < m_Channel.m_fGoodToBad;
+        return NextUniform() < (m_bBadState ? m_Channel.m_fBadLossRate : m_Channel.m_fLossRate);
+    default:
+        return false;
+    }
+}
+
+//media and repair packets both come out of the encoder here,in the order they are sent
+void FECSimulator::OnEncoderPacket(const std::shared_ptr<Packet>& packet)
+{
+    bool bIsRepair = (packet->m_pData[1] & 0x7f) == SIM_REPAIR_PT;
+    if (bIsRepair)
+    {
+        m_Result.m_nRepairNum++;
+        m_Result.m_lRepairBytes += packet->m_nLength;
+    }
+    else
+    {
+        m_Result.m_nMediaNum++;
+        m_Result.m_lMediaBytes += packet->m_nLength;
+    }
+
+    if (IsChannelLost())
+    {
+        return;
+    }
+
+    //a reordered packet is held back and the ones after it overtake it
+    SimPacket item;
+    item.m_lTime = m_lNow + m_Channel.m_nDelay * 1000 + (uint64_t)(NextUniform() * m_Channel.m_nJitter * 1000);
+    if (NextUniform() < m_Channel.m_fReorderRate)
+    {
+        item.m_lTime += m_Channel.m_nReorderDelay * 1000;
+    }
+    else
+    {
+        item.m_lTime = std::max(item.m_lTime, m_lLastArrival);
+        m_lLastArrival = item.m_lTime;
+    }
+    item.m_nOrder = m_nOrder++;
+    item.m_pPacket = packet;
+    m_InFlight.push(item);
+
+    if (NextUniform() < m_Channel.m_fDuplicateRate)
+    {
+        item.m_lTime += (uint64_t)(NextUniform() * m_Channel.m_nJitter * 1000);
+        item.m_nOrder = m_nOrder++;
+        m_InFlight.push(item);
+    }
+}
+
+void FECSimulator::OnDecoderPacket(const std::shared_ptr<Packet>& packet)
+{
+    uint64_t now = GetElapsed();
+    uint16_t seq = (packet->m_pData[2] << 8) | packet->m_pData[3];
+
+    std::lock_guard<std::mutex> lock(m_ResultLock);
+    if (seq >= m_Source.size() || m_bDelivered[seq])
+    {
+        return;
+    }
+    m_bDelivered[seq] = true;
+
+    const SimPacket& source = m_Source[seq];
+    if (packet->m_nLength != source.m_pPacket->m_nLength || memcmp(packet->m_pData, source.m_pPacket->m_pData, packet->m_nLength) != 0)
+    {
+        m_Result.m_nCorruptNum++;
+    }
+    m_AddedLatency.push_back(((double)now - source.m_lTime - m_Channel.m_nDelay * 1000.0) / 1000);
+}
+
+int32_t FECSimulator::Run(const FECBlock::Config& config, RFC8627FECEncoder::RepairMode mode, Result& result)
+{
+    if (m_Source.empty() && LoadStream() != 0)
+    {
+        return -1;
+    }
+
+    m_Result = Result();
+    m_bArrived.assign(m_Source.size(), false);
+    m_bDelivered.assign(m_Source.size(), false);
+    m_AddedLatency.clear();
+    m_nRandom = m_Channel.m_nSeed;
+    m_bBadState = false;
+    m_lLastArrival = 0;
+    m_nOrder = 0;
+    m_InFlight = std::priority_queue<SimPacket, std::vector<SimPacket>, LaterFirst>();
+
+    RFC8627FECEncoder encoder;
+    encoder.SetPayloadType(SIM_REPAIR_PT);
+    encoder.SetSSRC(SIM_REPAIR_SSRC);
+    encoder.SetFECEncoderPacketCallback(std::bind(&FECSimulator::OnEncoderPacket, this, std::placeholders::_1));
+    int32_t ret = encoder.Init(config);
+    if (ret != 0)
+    {
+        Error("[%p][FECSimulator::Run] init encoder fail,return:%d", this, ret);
+        return -2;
+    }
+    encoder.SetRepairMode(mode);
+
+    RFC8627FECDecoder decoder;
+    decoder.SetPayloadType(SIM_REPAIR_PT);
+    decoder.SetSSRC(SIM_REPAIR_SSRC);
+    decoder.SetDecoderPacketCallback(std::bind(&FECSimulator::OnDecoderPacket, this, std::placeholders::_1));
+    decoder.SetNackPacketCallback([](const std::shared_ptr<Packet>&) {});
+    ret = decoder.Init(config);
+    if (ret != 0)
+    {
+        Error("[%p][FECSimulator::Run] init decoder fail,return:%d", this, ret);
+        return -3;
+    }
+    decoder.SetRoundTripTime(m_Channel.m_nDelay * 2.0);
+
+    //sends and arrivals in time order,each when the wall clock gets there
+    double encodeTime = 0;
+    double decodeTime = 0;
+    uint32_t decodeNum = 0;
+    m_lStart = GetSteadyTime();
+    size_t next = 0;
+    while (next < m_Source.size() || !m_InFlight.empty())
+    {
+        bool bIsSend = next < m_Source.size() && (m_InFlight.empty() || m_Source[next].m_lTime <= m_InFlight.top().m_lTime);
+        uint64_t time = bIsSend ? m_Source[next].m_lTime : m_InFlight.top().m_lTime;
+        uint64_t elapsed = GetElapsed();
+        if (time > elapsed)
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(time - elapsed));
+        }
+
+        double cpu = GetThreadCpuTime();
+        if (bIsSend)
+        {
+            m_lNow = time;
+            encoder.RecvRTPPacket(m_Source[next].m_pPacket);
+            encodeTime += GetThreadCpuTime() - cpu;
+            next++;
+            continue;
+        }
+
+        std::shared_ptr<Packet> packet = m_InFlight.top().m_pPacket;
+        m_InFlight.pop();
+        if ((packet->m_pData[1] & 0x7f) != SIM_REPAIR_PT)
+        {
+            uint16_t seq = (packet->m_pData[2] << 8) | packet->m_pData[3];
+            std::lock_guard<std::mutex> lock(m_ResultLock);
+            m_bArrived[seq] = true;
+        }
+        decoder.RecvPacket(packet);
+        decodeTime += GetThreadCpuTime() - cpu;
+        decodeNum++;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(SIM_DRAIN_TIME));
+
+    std::lock_guard<std::mutex> lock(m_ResultLock);
+    for (size_t i = 0; i < m_Source.size(); i++)
+    {
+        m_Result.m_nChannelLostNum += m_bArrived[i] ? 0 : 1;
+        m_Result.m_nRecoveredNum += !m_bArrived[i] && m_bDelivered[i] ? 1 : 0;
+        m_Result.m_nResidualLostNum += m_bDelivered[i] ? 0 : 1;
+    }
+    if (!m_AddedLatency.empty())
+    {
+        double sum = 0;
+        for (auto latency : m_AddedLatency)
+        {
+            sum += latency;
+        }
+        m_Result.m_fAvgAddedLatency = sum / m_AddedLatency.size();
+        std::sort(m_AddedLatency.begin(), m_AddedLatency.end());
+        m_Result.m_fP95AddedLatency = m_AddedLatency[m_AddedLatency.size() * 95 / 100];
+    }
+    m_Result.m_fEncodeTime = m_Result.m_nMediaNum > 0 ? encodeTime / m_Result.m_nMediaNum : 0;
+    m_Result.m_fDecodeTime = decodeNum > 0 ? decodeTime / decodeNum : 0;
+    result = m_Result;
+
+    return 0;
+}
+
+std::vector<FECSimulator::Channel> FECSimulator::GetBuiltinChannels()
+{
+    std::vector<Channel> channels;
+
+    Channel random1;
+    random1.m_strName = "bernoulli 1%";
+    random1.m_eLossModel = LOSS_MODEL_BERNOULLI;
+    random1.m_fLossRate = 0.01f;
+    random1.m_nJitter = 2;
+    channels.push_back(random1);
+
+    Channel random5;
+    random5.m_strName = "bernoulli 5%";
+    random5.m_eLossModel = LOSS_MODEL_BERNOULLI;
+    random5.m_fLossRate = 0.05f;
+    random5.m_nJitter = 2;
+    random5.m_nSeed = 5;
+    channels.push_back(random5);
+
+    //p/(p+r) of the packets in the bad state,all of them lost
+    Channel burst;
+    burst.m_strName = "gilbert-elliott 3%,burst 4";
+    burst.m_eLossModel = LOSS_MODEL_GILBERT_ELLIOTT;
+    burst.m_fGoodToBad = 0.0077f;
+    burst.m_fBadToGood = 0.25f;
+    burst.m_nJitter = 2;
+    burst.m_nSeed = 3;
+    channels.push_back(burst);
+
+    Channel rough;
+    rough.m_strName = "loss 2%,jitter 15ms,reorder 2%,dup 1%";
+    rough.m_eLossModel = LOSS_MODEL_BERNOULLI;
+    rough.m_fLossRate = 0.02f;
+    rough.m_nJitter = 15;
+    rough.m_fReorderRate = 0.02f;
+    rough.m_nReorderDelay = 10;
+    rough.m_fDuplicateRate = 0.01f;
+    rough.m_nSeed = 7;
+    channels.push_back(rough);
+
+    return channels;
+}
+
+int32_t FECSimulator::RunBuiltinScenarios(FILE* out, const std::string& recordPath)
+{
+    typedef struct Setting
+    {
+        FECBlock::Config m_Config;
+        RFC8627FECEncoder::RepairMode m_eMode;
+    }Setting;
+
+    std::vector<Setting> settings;
+    FECBlock::Config config;
+    settings.push_back({ config, RFC8627FECEncoder::REPAIR_MODE_NONE });
+    for (uint8_t size : { 5, 7, 10 })
+    {
+        config.m_nRow = size;
+        config.m_nColumn = size;
+        settings.push_back({ config, RFC8627FECEncoder::REPAIR_MODE_COLUMN });
+        settings.push_back({ config, RFC8627FECEncoder::REPAIR_MODE_ROW_AND_COLUMN });
+    }
+    config = FECBlock::Config();
+    config.m_eScheme = FECBlock::SCHEME_RS;
+    settings.push_back({ config, RFC8627FECEncoder::REPAIR_MODE_COLUMN });
+    settings.push_back({ config, RFC8627FECEncoder::REPAIR_MODE_ROW_AND_COLUMN });
+
+    Stream stream;
+    stream.m_strRecordPath = recordPath;
+    for (auto& channel : GetBuiltinChannels())
+    {
+        FECSimulator simulator(stream, channel);
+        fprintf(out, "== %s ==\n", channel.m_strName.c_str());
+        fprintf(out, "%-28s %7s %9s %6s %7s %9s %7s %7s %7s %7s %7s\n", "fec", "mode", "overhead%", "lost", "recover", "residual%",
+            "lat", "p95", "enc(us)", "dec(us)", "corrupt");
+        for (auto& setting : settings)
+        {
+            Result result;
+            if (simulator.Run(setting.m_Config, setting.m_eMode, result) != 0)
+            {
+                return -1;
+            }
+
+            fprintf(out, "%-28s %7s %9.1f %6u %7u %9.2f %7.1f %7.1f %7.2f %7.2f %7u\n", FECBlock::MakeSdpAttribute(setting.m_Config).c_str(),
+                GetRepairModeName(setting.m_eMode), result.m_lMediaBytes > 0 ? result.m_lRepairBytes * 100.0 / result.m_lMediaBytes : 0,
+                result.m_nChannelLostNum, result.m_nRecoveredNum, result.m_nMediaNum > 0 ? result.m_nResidualLostNum * 100.0 / result.m_nMediaNum : 0,
+                result.m_fAvgAddedLatency, result.m_fP95AddedLatency, result.m_fEncodeTime, result.m_fDecodeTime, result.m_nCorruptNum);
+            fflush(out);
+        }
+        fprintf(out, "\n");
+    }
+
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,119 @@
+#pragma once
+#include <mutex>
+#include <queue>
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "FECBlock.h"
+#include "FECEncoder.h"
+
+//Offline evaluation of RFC8627FECEncoder -> channel -> RFC8627FECDecoder,for picking FEC parameters and
+//catching regressions without a flight.The stream is synthetic or an RTSP interleaved dump,the channel
+//drops(Bernoulli or Gilbert-Elliott),reorders,duplicates and delays packets from a seeded generator.
+//The decoder's jitter buffer waits on the wall clock,so a run takes as long as the stream it plays.
+class FECSimulator
+{
+public:
+    typedef enum LossModel
+    {
+        LOSS_MODEL_NONE = 0,
+        LOSS_MODEL_BERNOULLI,
+        LOSS_MODEL_GILBERT_ELLIOTT      //two state Markov chain,the losses come in bursts
+    }LossModel;
+
+    typedef struct Channel
+    {
+        std::string m_strName;
+        LossModel m_eLossModel = LOSS_MODEL_NONE;
+        float m_fLossRate = 0;          //Bernoulli,or Gilbert-Elliott loss in the good state
+        float m_fGoodToBad = 0;         //Gilbert-Elliott p
+        float m_fBadToGood = 1;         //Gilbert-Elliott r,a burst lasts 1/r packets on average
+        float m_fBadLossRate = 1;       //Gilbert-Elliott loss in the bad state
+        float m_fReorderRate = 0;
+        uint32_t m_nReorderDelay = 0;   //ms a reordered packet is held back
+        float m_fDuplicateRate = 0;
+        uint32_t m_nDelay = 20;         //ms one way
+        uint32_t m_nJitter = 0;         //ms,uniform on top of the delay,packets keep their order
+        uint32_t m_nSeed = 1;
+    }Channel;
+
+    typedef struct Stream
+    {
+        std::string m_strRecordPath;    //$ channel length packet records,channel 0 is played;empty for synthetic
+        uint32_t m_nDuration = 5000;    //ms,synthetic only
+        uint32_t m_nFPS = 30;
+        uint32_t m_nBitRate = 4000000;
+        uint32_t m_nGOP = 60;
+    }Stream;
+
+    typedef struct Result
+    {
+        uint32_t m_nMediaNum = 0;
+        uint32_t m_nRepairNum = 0;
+        uint64_t m_lMediaBytes = 0;
+        uint64_t m_lRepairBytes = 0;
+        uint32_t m_nChannelLostNum = 0;     //media packets the channel dropped
+        uint32_t m_nRecoveredNum = 0;       //of those,delivered anyway
+        uint32_t m_nResidualLostNum = 0;    //media packets never delivered
+        uint32_t m_nCorruptNum = 0;
+        double m_fAvgAddedLatency = 0;      //ms from send plus the one way delay to leaving the decoder
+        double m_fP95AddedLatency = 0;
+        double m_fEncodeTime = 0;           //us of CPU per media packet
+        double m_fDecodeTime = 0;           //us of CPU per packet off the channel
+    }Result;
+
+public:
+    FECSimulator(const Stream& stream, const Channel& channel);
+    ~FECSimulator();
+
+    int32_t Run(const FECBlock::Config& config, RFC8627FECEncoder::RepairMode mode, Result& result);
+
+    static std::vector<Channel> GetBuiltinChannels();
+    static int32_t RunBuiltinScenarios(FILE* out, const std::string& recordPath);
+
+private:
+    typedef struct SimPacket
+    {
+        uint64_t m_lTime = 0;           //us from the start
+        uint32_t m_nOrder = 0;          //keeps packets of the same time in order
+        std::shared_ptr<Packet> m_pPacket;
+    }SimPacket;
+
+    typedef struct LaterFirst
+    {
+        bool operator()(const SimPacket& a, const SimPacket& b) const
+        {
+            return a.m_lTime != b.m_lTime ? a.m_lTime > b.m_lTime : a.m_nOrder > b.m_nOrder;
+        }
+    }LaterFirst;
+
+    int32_t LoadStream();
+    int32_t MakeSyntheticStream();
+    int32_t LoadRecordedStream();
+    uint32_t NextRandom();
+    double NextUniform();
+    bool IsChannelLost();
+    void OnEncoderPacket(const std::shared_ptr<Packet>& packet);
+    void OnDecoderPacket(const std::shared_ptr<Packet>& packet);
+    uint64_t GetElapsed();
+
+private:
+    Stream m_Stream;
+    Channel m_Channel;
+    std::vector<SimPacket> m_Source;        //seq is the index
+
+    uint32_t m_nRandom;
+    bool m_bBadState;
+    uint64_t m_lNow;                    //us,time of the packet being sent
+    uint64_t m_lLastArrival;            //us,jitter alone does not let a packet pass the one before
+    uint64_t m_lStart;                  //steady clock us at the start of the run
+    uint32_t m_nOrder;
+    std::priority_queue<SimPacket, std::vector<SimPacket>, LaterFirst> m_InFlight;
+
+    std::mutex m_ResultLock;            //the decoder delivers on its jitter buffer thread
+    Result m_Result;
+    std::vector<bool> m_bArrived;
+    std::vector<bool> m_bDelivered;
+    std::vector<double> m_AddedLatency;
+};
\ No newline at end of file
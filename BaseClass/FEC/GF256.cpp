@@ -0,0 +1,291 @@
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include "GF256.h"
+#include "XORKernel.h"
+#include "Log/Log.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define GF256_X86
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define GF256_NEON
+#if !defined(__aarch64__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+#endif
+
+#define GF256_POLYNOMIAL (0x11d)
+
+//products of c with every low nibble and every high nibble,c * x = low[x & 0xf] ^ high[x >> 4]
+static void MakeNibbleTables(uint8_t c, uint8_t* low, uint8_t* high)
+{
+    const uint8_t* row = GF256::GetMulRow(c);
+    for (int i = 0; i < 16; i++)
+    {
+        low[i] = row[i];
+        high[i] = row[i << 4];
+    }
+}
+
+static void MulAddTable(uint8_t* dst, const uint8_t* src, uint8_t c, uint32_t len)
+{
+    const uint8_t* row = GF256::GetMulRow(c);
+    for (uint32_t i = 0; i < len; i++)
+    {
+        dst[i] ^= row[src[i]];
+    }
+}
+
+#ifdef GF256_X86
+__attribute__((target("ssse3")))
+static void MulAddSSSE3(uint8_t* dst, const uint8_t* src, uint8_t c, uint32_t len)
+{
+    uint8_t low[16];
+    uint8_t high[16];
+    MakeNibbleTables(c, low, high);
+    __m128i tableLow = _mm_loadu_si128((const __m128i*)low);
+    __m128i tableHigh = _mm_loadu_si128((const __m128i*)high);
+    __m128i mask = _mm_set1_epi8(0x0f);
+
+    uint32_t i = 0;
+    for (; i + 16 <= len; i += 16)
+    {
+        __m128i s = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i l = _mm_shuffle_epi8(tableLow, _mm_and_si128(s, mask));
+        __m128i h = _mm_shuffle_epi8(tableHigh, _mm_and_si128(_mm_srli_epi64(s, 4), mask));
+        __m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_xor_si128(d, _mm_xor_si128(l, h)));
+    }
+    MulAddTable(dst + i, src + i, c, len - i);
+}
+
+__attribute__((target("avx2")))
+static void MulAddAVX2(uint8_t* dst, const uint8_t* src, uint8_t c, uint32_t len)
+{
+    uint8_t low[16];
+    uint8_t high[16];
+    MakeNibbleTables(c, low, high);
+    __m256i tableLow = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)low));
+    __m256i tableHigh = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)high));
+    __m256i mask = _mm256_set1_epi8(0x0f);
+
+    uint32_t i = 0;
+    for (; i + 32 <= len; i += 32)
+    {
+        __m256i s = _mm256_loadu_si256((const __m256i*)(src + i));
+        __m256i l = _mm256_shuffle_epi8(tableLow, _mm256_and_si256(s, mask));
+        __m256i h = _mm256_shuffle_epi8(tableHigh, _mm256_and_si256(_mm256_srli_epi64(s, 4), mask));
+        __m256i d = _mm256_loadu_si256((const __m256i*)(dst + i));
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_xor_si256(d, _mm256_xor_si256(l, h)));
+    }
+    MulAddTable(dst + i, src + i, c, len - i);
+}
+#endif
+
+#ifdef GF256_NEON
+static void MulAddNEON(uint8_t* dst, const uint8_t* src, uint8_t c, uint32_t len)
+{
+    uint8_t low[16];
+    uint8_t high[16];
+    MakeNibbleTables(c, low, high);
+    uint32_t i = 0;
+#if defined(__aarch64__)
+    uint8x16_t tableLow = vld1q_u8(low);
+    uint8x16_t tableHigh = vld1q_u8(high);
+    uint8x16_t mask = vdupq_n_u8(0x0f);
+    for (; i + 16 <= len; i += 16)
+    {
+        uint8x16_t s = vld1q_u8(src + i);
+        uint8x16_t l = vqtbl1q_u8(tableLow, vandq_u8(s, mask));
+        uint8x16_t h = vqtbl1q_u8(tableHigh, vshrq_n_u8(s, 4));
+        vst1q_u8(dst + i, veorq_u8(vld1q_u8(dst + i), veorq_u8(l, h)));
+    }
+#else
+    uint8x8x2_t tableLow = { { vld1_u8(low), vld1_u8(low + 8) } };
+    uint8x8x2_t tableHigh = { { vld1_u8(high), vld1_u8(high + 8) } };
+    uint8x8_t mask = vdup_n_u8(0x0f);
+    for (; i + 8 <= len; i += 8)
+    {
+        uint8x8_t s = vld1_u8(src + i);
+        uint8x8_t l = vtbl2_u8(tableLow, vand_u8(s, mask));
+        uint8x8_t h = vtbl2_u8(tableHigh, vshr_n_u8(s, 4));
+        vst1_u8(dst + i, veor_u8(vld1_u8(dst + i), veor_u8(l, h)));
+    }
+#endif
+    MulAddTable(dst + i, src + i, c, len - i);
+}
+#endif
+
+const GF256::Tables& GF256::GetTables()
+{
+    static const Tables* tables = []() {
+        Tables* t = new Tables();
+        uint32_t x = 1;
+        for (int i = 0; i < 255; i++)
+        {
+            t->m_Exp[i] = x;
+            t->m_Exp[i + 255] = x;
+            t->m_Log[x] = i;
+            x <<= 1;
+            if (x & 0x100)
+            {
+                x ^= GF256_POLYNOMIAL;
+            }
+        }
+        t->m_Exp[510] = t->m_Exp[0];
+        t->m_Exp[511] = t->m_Exp[1];
+        t->m_Log[0] = 0;
+
+        for (int a = 0; a < 256; a++)
+        {
+            t->m_Mul[a][0] = 0;
+            t->m_Mul[0][a] = 0;
+        }
+        for (int a = 1; a < 256; a++)
+        {
+            for (int b = 1; b < 256; b++)
+            {
+                t->m_Mul[a][b] = t->m_Exp[t->m_Log[a] + t->m_Log[b]];
+            }
+        }
+        return t;
+    }();
+
+    return *tables;
+}
+
+const GF256::Dispatch& GF256::GetDispatch()
+{
+    static const Dispatch dispatch = []() {
+        Dispatch best = { "table", MulAddTable };
+#ifdef GF256_X86
+        if (__builtin_cpu_supports("avx2"))
+        {
+            best = { "avx2", MulAddAVX2 };
+        }
+        else if (__builtin_cpu_supports("ssse3"))
+        {
+            best = { "ssse3", MulAddSSSE3 };
+        }
+#endif
+#ifdef GF256_NEON
+#if defined(__aarch64__)
+        best = { "neon", MulAddNEON };
+#else
+        if (getauxval(AT_HWCAP) & HWCAP_NEON)
+        {
+            best = { "neon", MulAddNEON };
+        }
+#endif
+#endif
+        Trace("[GF256::GetDispatch] use %s kernel", best.m_strName);
+        return best;
+    }();
+
+    return dispatch;
+}
+
+uint8_t GF256::Mul(uint8_t a, uint8_t b)
+{
+    return GetTables().m_Mul[a][b];
+}
+
+uint8_t GF256::Div(uint8_t a, uint8_t b)
+{
+    if (a == 0)
+    {
+        return 0;
+    }
+
+    const Tables& tables = GetTables();
+    return tables.m_Exp[tables.m_Log[a] + 255 - tables.m_Log[b]];
+}
+
+uint8_t GF256::Inv(uint8_t a)
+{
+    return Div(1, a);
+}
+
+const uint8_t* GF256::GetMulRow(uint8_t c)
+{
+    return GetTables().m_Mul[c];
+}
+
+void GF256::MulAdd(uint8_t* dst, const uint8_t* src, uint8_t c, uint32_t len)
+{
+    if (c == 0)
+    {
+        return;
+    }
+    if (c == 1)
+    {
+        XORKernel::XOR(dst, src, len);
+        return;
+    }
+
+    GetDispatch().m_pFunction(dst, src, c, len);
+}
+
+const char* GF256::GetKernelName()
+{
+    return GetDispatch().m_strName;
+}
+
+bool GF256::InvertMatrix(uint8_t* matrix, uint32_t n)
+{
+    std::vector<uint8_t> inverse(n * n, 0);
+    for (uint32_t i = 0; i < n; i++)
+    {
+        inverse[i * n + i] = 1;
+    }
+
+    for (uint32_t col = 0; col < n; col++)
+    {
+        uint32_t pivot = col;
+        while (pivot < n && matrix[pivot * n + col] == 0)
+        {
+            pivot++;
+        }
+        if (pivot == n)
+        {
+            return false;
+        }
+        if (pivot != col)
+        {
+            for (uint32_t i = 0; i < n; i++)
+            {
+                std::swap(matrix[pivot * n + i], matrix[col * n + i]);
+                std::swap(inverse[pivot * n + i], inverse[col * n + i]);
+            }
+        }
+
+        uint8_t scale = Inv(matrix[col * n + col]);
+        for (uint32_t i = 0; i < n; i++)
+        {
+            matrix[col * n + i] = Mul(matrix[col * n + i], scale);
+            inverse[col * n + i] = Mul(inverse[col * n + i], scale);
+        }
+
+        for (uint32_t row = 0; row < n; row++)
+        {
+            uint8_t factor = matrix[row * n + col];
+            if (row == col || factor == 0)
+            {
+                continue;
+            }
+            for (uint32_t i = 0; i < n; i++)
+            {
+                matrix[row * n + i] ^= Mul(factor, matrix[col * n + i]);
+                inverse[row * n + i] ^= Mul(factor, inverse[col * n + i]);
+            }
+        }
+    }
+
+    memcpy(matrix, inverse.data(), n * n);
+    return true;
+}
\ No newline at end of file
@@ -0,0 +1,39 @@
+#pragma once
+#include <cstdint>
+
+//GF(2^8) with the 0x11d polynomial.MulAdd() is bound once to the widest table lookup kernel the CPU supports
+class GF256
+{
+public:
+    typedef void (*MulAddFunction)(uint8_t* dst, const uint8_t* src, uint8_t c, uint32_t len);
+
+public:
+    static uint8_t Mul(uint8_t a, uint8_t b);
+    static uint8_t Div(uint8_t a, uint8_t b);       //b must not be 0
+    static uint8_t Inv(uint8_t a);                  //a must not be 0
+    static const uint8_t* GetMulRow(uint8_t c);     //256 products c * x
+
+    //dst ^= c * src over len bytes
+    static void MulAdd(uint8_t* dst, const uint8_t* src, uint8_t c, uint32_t len);
+    static const char* GetKernelName();
+
+    //in place Gauss-Jordan on a n x n row-major matrix,false when singular
+    static bool InvertMatrix(uint8_t* matrix, uint32_t n);
+
+private:
+    typedef struct Tables
+    {
+        uint8_t m_Exp[512];
+        uint8_t m_Log[256];
+        uint8_t m_Mul[256][256];
+    }Tables;
+
+    typedef struct Dispatch
+    {
+        const char* m_strName;
+        MulAddFunction m_pFunction;
+    }Dispatch;
+
+    static const Tables& GetTables();
+    static const Dispatch& GetDispatch();
+};
\ No newline at end of file
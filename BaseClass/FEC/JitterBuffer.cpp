@@ -0,0 +1,373 @@
+#include <math.h>
+#include "JitterBuffer.h"
+#include "Log/Log.h"
+#include "CommonTools/TimeCounter.h"
+
+#define MIN_WAIT_TIME (5.0)             //ms
+#define MAX_WAIT_TIME (300.0)
+#define INIT_FILL_DELAY (40.0)          //ms,until a hole has been filled once
+#define MAX_TOLERATED_JUMP (100)        //a packet this far behind the next out means the sender restarted
+
+JitterBuffer::JitterBuffer()
+{
+    m_nMask = 0;
+    m_nClockRate = MEDIA_CLOCK_RATE;
+    m_bRecvFirstPacket = false;
+    m_nHeadSeq = 0;
+    m_nHighestSeq = 0;
+    m_bHasTransit = false;
+    m_lLastTransit = 0;
+    m_fJitter = 0;
+    m_fFillDelay = INIT_FILL_DELAY;
+    m_fRecoverDelay = INIT_FILL_DELAY;
+    m_fRoundTripTime = 0;
+    m_pPacketCallback = nullptr;
+    m_bStopOutPacket = true;
+    m_pOutPacketThread = nullptr;
+}
+
+JitterBuffer::~JitterBuffer()
+{
+    ReleaseAll();
+}
+
+int32_t JitterBuffer::ReleaseAll()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_BufferLock);
+        m_bStopOutPacket = true;
+    }
+    m_BufferCondition.notify_all();
+    if (m_pOutPacketThread != nullptr)
+    {
+        if (m_pOutPacketThread->joinable())
+        {
+            m_pOutPacketThread->join();
+        }
+        delete m_pOutPacketThread;
+        m_pOutPacketThread = nullptr;
+    }
+
+    m_pRing.clear();
+    m_nMask = 0;
+    m_bRecvFirstPacket = false;
+
+    return 0;
+}
+
+int32_t JitterBuffer::Init(uint32_t size, uint32_t clockRate)
+{
+    if (size == 0 || size > 0x8000 || (size & (size - 1)) != 0)
+    {
+        Error("[%p][JitterBuffer::Init] size:%d is not a power of two up to 32768", this, size);
+        return -1;
+    }
+    if (clockRate == 0)
+    {
+        Error("[%p][JitterBuffer::Init] clock rate:%d err", this, clockRate);
+        return -2;
+    }
+    if (m_pPacketCallback == nullptr)
+    {
+        Error("[%p][JitterBuffer::Init] not set packet callback", this);
+        return -3;
+    }
+    if (m_pOutPacketThread != nullptr)
+    {
+        Error("[%p][JitterBuffer::Init] already init", this);
+        return -4;
+    }
+
+    m_pRing.resize(size);
+    m_nMask = size - 1;
+    m_nClockRate = clockRate;
+    m_bStopOutPacket = false;
+    m_pOutPacketThread = new std::thread(&JitterBuffer::OutPacketThread, this);
+
+    return 0;
+}
+
+bool JitterBuffer::SetPacketCallback(PacketCallback callback)
+{
+    m_pPacketCallback = callback;
+    return true;
+}
+
+void JitterBuffer::SetRoundTripTime(double rtt)
+{
+    std::lock_guard<std::mutex> lock(m_BufferLock);
+    m_fRoundTripTime = rtt > 0 ? rtt : 0;
+}
+
+double JitterBuffer::GetWaitTime()
+{
+    std::lock_guard<std::mutex> lock(m_BufferLock);
+    return CalcWaitTime();
+}
+
+double JitterBuffer::GetRecoverDelay()
+{
+    std::lock_guard<std::mutex> lock(m_BufferLock);
+    return m_fRecoverDelay;
+}
+
+double JitterBuffer::CalcWaitTime()
+{
+    double wait = m_fJitter * 4 + (m_fRoundTripTime > m_fFillDelay ? m_fRoundTripTime : m_fFillDelay);
+    return wait < MIN_WAIT_TIME ? MIN_WAIT_TIME : wait > MAX_WAIT_TIME ? MAX_WAIT_TIME : wait;
+}
+
+//drops whatever is held,the stream starts over at seq
+void JitterBuffer::Reset(uint16_t seq)
+{
+    for (auto& slot : m_pRing)
+    {
+        slot.m_pPacket = nullptr;
+        slot.m_lMissingSince = 0;
+        slot.m_lHoldUntil = 0;
+    }
+    m_nHeadSeq = seq;
+    m_nHighestSeq = seq;
+    m_bHasTransit = false;
+}
+
+//RFC 3550 A.8,only for packets as they came off the wire
+void JitterBuffer::UpdateJitter(const std::shared_ptr<Packet>& packet, uint64_t arrival)
+{
+    const uint8_t* data = packet->m_pData;
+    uint32_t timestamp = (data[4] << 24) | (data[5] << 16) | (data[6] << 8) | data[7];
+    int64_t transit = (int64_t)(arrival * m_nClockRate / MEDIA_CLOCK_RATE) - timestamp;
+    if (m_bHasTransit)
+    {
+        int64_t d = (int32_t)(transit - m_lLastTransit);
+        double ms = fabs((double)d) * 1000 / m_nClockRate;
+        m_fJitter += (ms - m_fJitter) / 16;
+    }
+    m_lLastTransit = transit;
+    m_bHasTransit = true;
+}
+
+//up fast,down slow:a hole skipped too early costs a frame,one waited too long only latency
+void JitterBuffer::UpdateFillDelay(uint64_t delay, bool isRecovered)
+{
+    double ms = (double)delay * 1000 / MEDIA_CLOCK_RATE;
+    m_fFillDelay += (ms - m_fFillDelay) / (ms > m_fFillDelay ? 4 : 16);
+    if (isRecovered)
+    {
+        m_fRecoverDelay += (ms - m_fRecoverDelay) / (ms > m_fRecoverDelay ? 4 : 16);
+    }
+}
+
+int32_t JitterBuffer::InsertPacket(const std::shared_ptr<Packet>& packet, bool isRecovered)
+{
+    if (packet->m_nLength < 12)
+    {
+        Error("[%p][JitterBuffer::InsertPacket] packet size:%d err", this, packet->m_nLength);
+        return -1;
+    }
+
+    uint16_t seq = (packet->m_pData[2] << 8) | packet->m_pData[3];
+    uint64_t now = TimeCounter::GetMediaTime();
+    bool bNeedNotify = false;
+    {
+        std::lock_guard<std::mutex> lock(m_BufferLock);
+        if (m_pRing.empty())
+        {
+            return -2;
+        }
+
+        if (!m_bRecvFirstPacket)
+        {
+            m_bRecvFirstPacket = true;
+            Reset(seq);
+        }
+
+        int32_t diff = SeqDiff(seq, m_nHeadSeq);
+        if (diff > (int32_t)m_nMask || (diff < -MAX_TOLERATED_JUMP && !isRecovered))
+        {
+            Warn("[%p][JitterBuffer::InsertPacket] seq jump,%d->%d", this, m_nHighestSeq, seq);
+            Reset(seq);
+            diff = 0;
+        }
+        else if (diff < 0)
+        {
+            Slot& slot = m_pRing[seq & m_nMask];
+            if (slot.m_nSeq == seq && slot.m_lMissingSince != 0)
+            {
+                //skipped before it came,wait longer next time
+                UpdateFillDelay(now - slot.m_lMissingSince, isRecovered);
+                slot.m_lMissingSince = 0;
+            }
+            return 1;
+        }
+
+        Slot& slot = m_pRing[seq & m_nMask];
+        if (slot.m_pPacket != nullptr && slot.m_nSeq == seq)
+        {
+            return 1;
+        }
+
+        if (SeqDiff(seq, m_nHighestSeq) > 0)
+        {
+            for (uint16_t hole = m_nHighestSeq + 1; hole != seq; hole++)
+            {
+                Slot& missing = m_pRing[hole & m_nMask];
+                missing.m_pPacket = nullptr;
+                missing.m_nSeq = hole;
+                missing.m_lMissingSince = now;
+                missing.m_lHoldUntil = 0;
+            }
+            m_nHighestSeq = seq;
+        }
+        else if (slot.m_nSeq == seq && slot.m_lMissingSince != 0)
+        {
+            UpdateFillDelay(now - slot.m_lMissingSince, isRecovered);
+        }
+
+        if (!isRecovered)
+        {
+            UpdateJitter(packet, packet->m_lArrivalTime != 0 ? packet->m_lArrivalTime : now);
+        }
+
+        slot.m_pPacket = packet;
+        slot.m_nSeq = seq;
+        slot.m_lMissingSince = 0;
+        slot.m_lHoldUntil = 0;
+        bNeedNotify = seq == m_nHeadSeq || diff > 0;
+    }
+
+    if (bNeedNotify)
+    {
+        m_BufferCondition.notify_one();
+    }
+
+    return 0;
+}
+
+void JitterBuffer::GetLostPackets(std::list<LostPacket>& lost)
+{
+    std::lock_guard<std::mutex> lock(m_BufferLock);
+    if (!m_bRecvFirstPacket)
+    {
+        return;
+    }
+
+    uint64_t now = TimeCounter::GetMediaTime();
+    for (uint16_t seq = m_nHeadSeq; SeqDiff(seq, m_nHighestSeq) < 0; seq++)
+    {
+        const Slot& slot = m_pRing[seq & m_nMask];
+        if (slot.m_pPacket == nullptr || slot.m_nSeq != seq)
+        {
+            LostPacket item;
+            item.m_nSeq = seq;
+            item.m_fAge = slot.m_nSeq == seq && slot.m_lMissingSince != 0 ? (double)(now - slot.m_lMissingSince) * 1000 / MEDIA_CLOCK_RATE : 0;
+            item.m_nLaterNum = (uint16_t)SeqDiff(m_nHighestSeq, seq);
+            lost.push_back(item);
+        }
+    }
+}
+
+//a longer hold is seen the next time the out thread wakes for the hole,a dropped one may end the wait now
+void JitterBuffer::HoldPacket(uint16_t seq, double ms)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_BufferLock);
+        if (!m_bRecvFirstPacket || SeqDiff(seq, m_nHeadSeq) < 0 || SeqDiff(seq, m_nHighestSeq) >= 0)
+        {
+            return;
+        }
+
+        Slot& slot = m_pRing[seq & m_nMask];
+        if (slot.m_nSeq != seq || slot.m_pPacket != nullptr || slot.m_lMissingSince == 0)
+        {
+            return;
+        }
+
+        if (ms > 0)
+        {
+            slot.m_lHoldUntil = TimeCounter::GetMediaTime() + (uint64_t)(ms * MEDIA_CLOCK_RATE / 1000);
+            return;
+        }
+        if (slot.m_lHoldUntil == 0)
+        {
+            return;
+        }
+        slot.m_lHoldUntil = 0;
+    }
+
+    m_BufferCondition.notify_one();
+}
+
+void JitterBuffer::OutPacketThread()
+{
+    std::vector<std::shared_ptr<Packet>> out;
+    std::unique_lock<std::mutex> lock(m_BufferLock);
+    while (!m_bStopOutPacket)
+    {
+        if (!m_bRecvFirstPacket)
+        {
+            m_BufferCondition.wait(lock);
+            continue;
+        }
+
+        //everything in order goes out at once
+        while (true)
+        {
+            Slot& slot = m_pRing[m_nHeadSeq & m_nMask];
+            if (slot.m_pPacket == nullptr || slot.m_nSeq != m_nHeadSeq)
+            {
+                break;
+            }
+            out.push_back(slot.m_pPacket);
+            slot.m_pPacket = nullptr;
+            m_nHeadSeq++;
+        }
+
+        if (out.empty() && SeqDiff(m_nHighestSeq, m_nHeadSeq) >= 0)
+        {
+            //a hole at the head,wait for it from when a later packet showed it
+            const Slot& slot = m_pRing[m_nHeadSeq & m_nMask];
+            uint64_t since = slot.m_nSeq == m_nHeadSeq && slot.m_lMissingSince != 0 ? slot.m_lMissingSince : TimeCounter::GetMediaTime();
+            uint64_t deadline = since + (uint64_t)(CalcWaitTime() * MEDIA_CLOCK_RATE / 1000);
+            if (slot.m_nSeq == m_nHeadSeq && slot.m_lHoldUntil > deadline)
+            {
+                uint64_t limit = since + (uint64_t)(MAX_WAIT_TIME * MEDIA_CLOCK_RATE / 1000);
+                deadline = slot.m_lHoldUntil < limit ? slot.m_lHoldUntil : limit;
+            }
+            uint64_t now = TimeCounter::GetMediaTime();
+            if (now < deadline)
+            {
+                m_BufferCondition.wait_for(lock, std::chrono::microseconds((deadline - now) * 1000000 / MEDIA_CLOCK_RATE));
+                continue;
+            }
+
+            uint16_t from = m_nHeadSeq;
+            while (SeqDiff(m_nHighestSeq, m_nHeadSeq) > 0)
+            {
+                const Slot& next = m_pRing[m_nHeadSeq & m_nMask];
+                if (next.m_pPacket != nullptr && next.m_nSeq == m_nHeadSeq)
+                {
+                    break;
+                }
+                m_nHeadSeq++;
+            }
+            Warn("[%p][JitterBuffer::OutPacketThread] skip packet:%d->%d after %.1fms", this, from, m_nHeadSeq - 1,
+                (double)(now - since) * 1000 / MEDIA_CLOCK_RATE);
+            continue;
+        }
+
+        if (out.empty())
+        {
+            m_BufferCondition.wait(lock);
+            continue;
+        }
+
+        lock.unlock();
+        for (auto& packet : out)
+        {
+            m_pPacketCallback(packet);
+        }
+        out.clear();
+        lock.lock();
+    }
+}
\ No newline at end of file
@@ -0,0 +1,77 @@
+#pragma once
+#include <list>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+#include "Common.h"
+
+//Receive side reorder buffer of one RTP stream.Packets sit in a ring indexed by seq & mask and go out
+//as soon as they are in order.A hole is waited for 4 x the interarrival jitter plus the longer of
+//the rtt and the time late packets(FEC recovered or retransmitted) have been taking,then skipped.
+//The owner may hold a hole FEC can still fill past that,never longer than MAX_WAIT_TIME from it showing.
+class JitterBuffer
+{
+public:
+    typedef std::function<void(const std::shared_ptr<Packet>&)> PacketCallback;
+    typedef struct LostPacket
+    {
+        uint16_t m_nSeq = 0;
+        double m_fAge = 0;                  //ms since a later packet showed the hole
+        uint16_t m_nLaterNum = 0;           //packets after it up to the newest
+    }LostPacket;
+
+public:
+    JitterBuffer();
+    ~JitterBuffer();
+
+    int32_t Init(uint32_t size, uint32_t clockRate);    //size a power of two,the widest seq span held
+    bool SetPacketCallback(PacketCallback callback);
+    int32_t InsertPacket(const std::shared_ptr<Packet>& packet, bool isRecovered = false);     //1 duplicate or late
+    void SetRoundTripTime(double rtt);
+    double GetWaitTime();
+    double GetRecoverDelay();               //ms FEC has been taking to fill a hole
+    void GetLostPackets(std::list<LostPacket>& lost);   //holes between the next out and the newest packet
+    void HoldPacket(uint16_t seq, double ms);           //wait for the hole until ms from now if longer,0 back to the usual wait
+
+    static inline int16_t SeqDiff(uint16_t a, uint16_t b) { return (int16_t)(a - b); };
+
+private:
+    typedef struct Slot
+    {
+        std::shared_ptr<Packet> m_pPacket;
+        uint16_t m_nSeq = 0;
+        uint64_t m_lMissingSince = 0;           //media time a later packet showed the hole,0 not missing
+        uint64_t m_lHoldUntil = 0;              //media time,0 no hold
+    }Slot;
+
+    int32_t ReleaseAll();
+    void Reset(uint16_t seq);
+    void UpdateJitter(const std::shared_ptr<Packet>& packet, uint64_t arrival);
+    void UpdateFillDelay(uint64_t delay, bool isRecovered);
+    double CalcWaitTime();
+    void OutPacketThread();
+
+private:
+    std::mutex m_BufferLock;
+    std::condition_variable m_BufferCondition;
+    std::vector<Slot> m_pRing;
+    uint32_t m_nMask;
+    uint32_t m_nClockRate;
+
+    bool m_bRecvFirstPacket;
+    uint16_t m_nHeadSeq;                //next to go out
+    uint16_t m_nHighestSeq;
+
+    bool m_bHasTransit;
+    int64_t m_lLastTransit;
+    double m_fJitter;                   //ms,RFC 3550 A.8
+    double m_fFillDelay;                //ms from a hole showing to it being filled,smoothed
+    double m_fRecoverDelay;             //the same for holes FEC filled
+    double m_fRoundTripTime;            //ms,0 unknown
+
+    PacketCallback m_pPacketCallback;
+    bool m_bStopOutPacket;
+    std::thread* m_pOutPacketThread;
+};
\ No newline at end of file
@@ -0,0 +1,267 @@
+#include <string.h>
+#include <chrono>
+#include <vector>
+#include "XORKernel.h"
+#include "Log/Log.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define XOR_KERNEL_X86
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define XOR_KERNEL_NEON
+#if !defined(__aarch64__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+#endif
+
+#define BENCHMARK_PACKET_SIZE (1400)
+#define BENCHMARK_PACKET_NUM (7)
+#define BENCHMARK_MIN_TIME (200)        //ms per kernel
+
+static void XORScalar(uint8_t* dst, const uint8_t* src, uint32_t len)
+{
+    uint32_t i = 0;
+    for (; i + 8 <= len; i += 8)
+    {
+        uint64_t a, b;
+        memcpy(&a, dst + i, 8);
+        memcpy(&b, src + i, 8);
+        a ^= b;
+        memcpy(dst + i, &a, 8);
+    }
+    for (; i < len; i++)
+    {
+        dst[i] ^= src[i];
+    }
+}
+
+#ifdef XOR_KERNEL_X86
+__attribute__((target("sse2")))
+static void XORSSE2(uint8_t* dst, const uint8_t* src, uint32_t len)
+{
+    uint32_t i = 0;
+    for (; i + 32 <= len; i += 32)
+    {
+        __m128i a0 = _mm_loadu_si128((const __m128i*)(dst + i));
+        __m128i a1 = _mm_loadu_si128((const __m128i*)(dst + i + 16));
+        __m128i b0 = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i b1 = _mm_loadu_si128((const __m128i*)(src + i + 16));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_xor_si128(a0, b0));
+        _mm_storeu_si128((__m128i*)(dst + i + 16), _mm_xor_si128(a1, b1));
+    }
+    for (; i + 16 <= len; i += 16)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i*)(dst + i));
+        __m128i b = _mm_loadu_si128((const __m128i*)(src + i));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_xor_si128(a, b));
+    }
+    XORScalar(dst + i, src + i, len - i);
+}
+
+__attribute__((target("avx2")))
+static void XORAVX2(uint8_t* dst, const uint8_t* src, uint32_t len)
+{
+    uint32_t i = 0;
+    for (; i + 64 <= len; i += 64)
+    {
+        __m256i a0 = _mm256_loadu_si256((const __m256i*)(dst + i));
+        __m256i a1 = _mm256_loadu_si256((const __m256i*)(dst + i + 32));
+        __m256i b0 = _mm256_loadu_si256((const __m256i*)(src + i));
+        __m256i b1 = _mm256_loadu_si256((const __m256i*)(src + i + 32));
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_xor_si256(a0, b0));
+        _mm256_storeu_si256((__m256i*)(dst + i + 32), _mm256_xor_si256(a1, b1));
+    }
+    for (; i + 32 <= len; i += 32)
+    {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(dst + i));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(src + i));
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_xor_si256(a, b));
+    }
+    for (; i + 16 <= len; i += 16)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i*)(dst + i));
+        __m128i b = _mm_loadu_si128((const __m128i*)(src + i));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_xor_si128(a, b));
+    }
+    XORScalar(dst + i, src + i, len - i);
+}
+#endif
+
+#ifdef XOR_KERNEL_NEON
+static void XORNEON(uint8_t* dst, const uint8_t* src, uint32_t len)
+{
+    uint32_t i = 0;
+    for (; i + 32 <= len; i += 32)
+    {
+        uint8x16_t a0 = vld1q_u8(dst + i);
+        uint8x16_t a1 = vld1q_u8(dst + i + 16);
+        uint8x16_t b0 = vld1q_u8(src + i);
+        uint8x16_t b1 = vld1q_u8(src + i + 16);
+        vst1q_u8(dst + i, veorq_u8(a0, b0));
+        vst1q_u8(dst + i + 16, veorq_u8(a1, b1));
+    }
+    for (; i + 16 <= len; i += 16)
+    {
+        vst1q_u8(dst + i, veorq_u8(vld1q_u8(dst + i), vld1q_u8(src + i)));
+    }
+    XORScalar(dst + i, src + i, len - i);
+}
+#endif
+
+const char* XORKernel::GetKernelName(KernelType type)
+{
+    switch (type)
+    {
+    case KERNEL_SSE2:
+        return "sse2";
+    case KERNEL_AVX2:
+        return "avx2";
+    case KERNEL_NEON:
+        return "neon";
+    default:
+        return "scalar";
+    }
+}
+
+XORKernel::XORFunction XORKernel::GetKernel(KernelType type)
+{
+    switch (type)
+    {
+    case KERNEL_SCALAR:
+        return XORScalar;
+#ifdef XOR_KERNEL_X86
+    case KERNEL_SSE2:
+        return __builtin_cpu_supports("sse2") ? XORSSE2 : nullptr;
+    case KERNEL_AVX2:
+        return __builtin_cpu_supports("avx2") ? XORAVX2 : nullptr;
+#endif
+#ifdef XOR_KERNEL_NEON
+    case KERNEL_NEON:
+#if defined(__aarch64__)
+        return XORNEON;
+#else
+        return (getauxval(AT_HWCAP) & HWCAP_NEON) ? XORNEON : nullptr;
+#endif
+#endif
+    default:
+        return nullptr;
+    }
+}
+
+const XORKernel::Dispatch& XORKernel::GetDispatch()
+{
+    static const Dispatch dispatch = []() {
+        Dispatch best = { KERNEL_SCALAR, XORScalar };
+        KernelType preference[] = { KERNEL_AVX2,KERNEL_NEON,KERNEL_SSE2 };
+        for (KernelType type : preference)
+        {
+            XORFunction function = GetKernel(type);
+            if (function != nullptr)
+            {
+                best.m_eType = type;
+                best.m_pFunction = function;
+                break;
+            }
+        }
+        Trace("[XORKernel::GetDispatch] use %s kernel", GetKernelName(best.m_eType));
+        return best;
+    }();
+
+    return dispatch;
+}
+
+//the loop FEC2DTable had before the kernels,kept as the baseline
+static void XORBytewise(uint8_t** data, uint16_t* size, uint32_t nPackNum, uint8_t* repair, uint32_t nMaxLen)
+{
+    for (uint32_t i = 0; i < nPackNum; i++)
+    {
+        for (uint32_t j = 12; j < nMaxLen; j++)
+        {
+            if (j >= size[i])
+            {
+                continue;
+            }
+
+            repair[j + 12] ^= data[i][j];
+        }
+    }
+}
+
+int32_t XORKernel::RunBenchmark(FILE* out)
+{
+    //one row of a 7x7 table,sizes vary like the tail packets of video frames
+    std::vector<std::vector<uint8_t>> packets(BENCHMARK_PACKET_NUM);
+    uint8_t* data[BENCHMARK_PACKET_NUM];
+    uint16_t size[BENCHMARK_PACKET_NUM];
+    uint32_t nMaxLen = 0;
+    uint32_t seed = 0x12345678;
+    for (uint32_t i = 0; i < BENCHMARK_PACKET_NUM; i++)
+    {
+        size[i] = BENCHMARK_PACKET_SIZE - (i % 3) * 211;
+        packets[i].resize(size[i]);
+        for (auto& byte : packets[i])
+        {
+            seed = seed * 1103515245 + 12345;
+            byte = seed >> 24;
+        }
+        data[i] = packets[i].data();
+        nMaxLen = nMaxLen < size[i] ? size[i] : nMaxLen;
+    }
+
+    std::vector<uint8_t> reference(nMaxLen + 12, 0);
+    XORBytewise(data, size, BENCHMARK_PACKET_NUM, reference.data(), nMaxLen);
+    std::vector<uint8_t> repair(nMaxLen + 12, 0);
+
+    fprintf(out, "%-10s %10s %8s %s\n", "kernel", "GB/s", "speedup", "result");
+    double baseline = 0;
+    int32_t ret = 0;
+    for (int32_t k = -1; k < KERNEL_NUM; k++)
+    {
+        XORFunction function = k < 0 ? nullptr : GetKernel((KernelType)k);
+        if (k >= 0 && function == nullptr)
+        {
+            fprintf(out, "%-10s %10s %8s %s\n", GetKernelName((KernelType)k), "-", "-", "not supported");
+            continue;
+        }
+
+        uint64_t bytes = 0;
+        auto start = std::chrono::steady_clock::now();
+        std::chrono::duration<double> elapsed(0);
+        do
+        {
+            for (uint32_t n = 0; n < 1000; n++)
+            {
+                memset(repair.data(), 0, repair.size());
+                if (function == nullptr)
+                {
+                    XORBytewise(data, size, BENCHMARK_PACKET_NUM, repair.data(), nMaxLen);
+                }
+                else
+                {
+                    for (uint32_t i = 0; i < BENCHMARK_PACKET_NUM; i++)
+                    {
+                        function(repair.data() + 24, data[i] + 12, size[i] - 12);
+                    }
+                }
+                for (uint32_t i = 0; i < BENCHMARK_PACKET_NUM; i++)
+                {
+                    bytes += size[i] - 12;
+                }
+            }
+            elapsed = std::chrono::steady_clock::now() - start;
+        } while (elapsed.count() * 1000 < BENCHMARK_MIN_TIME);
+
+        double rate = bytes / elapsed.count() / 1e9;
+        baseline = k < 0 ? rate : baseline;
+        bool match = memcmp(repair.data(), reference.data(), repair.size()) == 0;
+        ret = match ? ret : -1;
+        fprintf(out, "%-10s %10.2f %7.1fx %s%s\n", k < 0 ? "bytewise" : GetKernelName((KernelType)k), rate, rate / baseline,
+            match ? "ok" : "MISMATCH", k >= 0 && (KernelType)k == GetKernelType() ? " (selected)" : "");
+    }
+
+    return ret;
+}
\ No newline at end of file
@@ -0,0 +1,38 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+
+//dst ^= src over len bytes,no alignment needed.Repair generation and recovery both go through XOR(),
+//which is bound once to the widest kernel the CPU supports.
+class XORKernel
+{
+public:
+    typedef void (*XORFunction)(uint8_t* dst, const uint8_t* src, uint32_t len);
+
+    typedef enum KernelType
+    {
+        KERNEL_SCALAR = 0,      //64 bit words
+        KERNEL_SSE2,
+        KERNEL_AVX2,
+        KERNEL_NEON,
+        KERNEL_NUM
+    }KernelType;
+
+public:
+    static inline void XOR(uint8_t* dst, const uint8_t* src, uint32_t len) { GetDispatch().m_pFunction(dst, src, len); };
+    static inline KernelType GetKernelType() { return GetDispatch().m_eType; };
+    static const char* GetKernelName(KernelType type);
+    static XORFunction GetKernel(KernelType type);      //nullptr when not built in or not supported by this CPU
+
+    //GB/s of every usable kernel against the old byte loop,on one FEC row of packets
+    static int32_t RunBenchmark(FILE* out);
+
+private:
+    typedef struct Dispatch
+    {
+        KernelType m_eType;
+        XORFunction m_pFunction;
+    }Dispatch;
+
+    static const Dispatch& GetDispatch();
+};
\ No newline at end of file
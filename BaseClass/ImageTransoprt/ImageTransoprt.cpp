@@ -1,14 +1,24 @@
+#include <algorithm>
 #include <linux/videodev2.h>
 #include "ImageTransoprt.h"
 #include "Log/Log.h"
 #include "RTPPacketizer/H264RTPpacketizer.h"
 #include "RTPPacketizer/MJPEGRTPpacketizer.h"
+#include "CommonTools/FramePool.h"
+#include "CommonTools/LatencyTracer.h"
+#include "CommonTools/TimeCounter.h"
 
 #define MAX_CAPTURE_VIDEO_NUM (1)
+#define MAX_DECODED_FRAME_NUM (2)
+#define MAX_ENCODED_PACKET_NUM (3)
+#define STAGE_WAIT_TIME (100)
 int g_nCaptureWidth = 1280;
 int g_nCaptureHeight = 720;
 
-ImageTransoprt::ImageTransoprt(bool enableFec)
+ImageTransoprt::ImageTransoprt(bool enableFec) :
+    m_CaptureVideoQueue(MAX_CAPTURE_VIDEO_NUM, BoundedQueue<std::shared_ptr<VideoFrame>>::DROP_OLDEST),
+    m_DecodedFrameQueue(MAX_DECODED_FRAME_NUM, BoundedQueue<std::shared_ptr<VideoFrame>>::DROP_OLDEST),
+    m_EncodedPacketQueue(MAX_ENCODED_PACKET_NUM, BoundedQueue<std::shared_ptr<VideoPacket>>::DROP_OLDEST)
 {
     m_bEnableFec = enableFec;
     m_bEnableOSD = false;
@@ -25,6 +35,17 @@ ImageTransoprt::ImageTransoprt(bool enableFec)
 
     m_pRtpPacketCallbaclk = nullptr;
     m_eVideoType = VIDEO_TYPE_NONE;
+    m_eCaptureMode = VideoCapture::CAPTURE_MODE_MMAP;
+    m_eCapturePath = CAPTURE_PATH_NONE;
+    m_nBitRate = 0;
+    m_eRateControl = VideoEncoder::RATE_CONTROL_VBR;
+    m_nPeakBitRate = 0;
+    m_nGOP = 0;
+    m_nTargetFPS = 0;
+    m_nEncodeFPS = 0;
+    m_lNextEncodePTS = 0;
+    m_eRepairMode = RFC8627FECEncoder::REPAIR_MODE_ROW_AND_COLUMN;
+    m_bResolutionChanged = false;
 }
 
 ImageTransoprt::~ImageTransoprt()
@@ -35,6 +56,10 @@ ImageTransoprt::~ImageTransoprt()
 int32_t ImageTransoprt::ReleaseAll()
 {
     m_bStopTransoprt = true;
+    m_CaptureVideoQueue.Close();
+    m_DecodedFrameQueue.Close();
+    m_EncodedPacketQueue.Close();
+
     if (m_pTransoprtThread != nullptr)
     {
         if (m_pTransoprtThread->joinable())
@@ -76,36 +101,32 @@ int32_t ImageTransoprt::ReleaseAll()
     delete m_pRTPPacketizer;
     m_pRTPPacketizer = nullptr;
 
+    if (m_eVideoType != VIDEO_TYPE_NONE)
     {
-        std::lock_guard<std::mutex> lock(m_CaptureVideoListLock);
-        for (auto& pVideo : m_CaptureVideoList)
-        {
-            pVideo = nullptr;
-        }
-        m_CaptureVideoList.clear();
-    }
-
-    {
-        std::lock_guard<std::mutex> lock(m_DecodedFrameListLock);
-        for (auto& pVideo : m_DecodedFrameList)
-        {
-            pVideo = nullptr;
-        }
-        m_DecodedFrameList.clear();
+        BoundedQueue<std::shared_ptr<VideoFrame>>::QueueStats capture = m_CaptureVideoQueue.GetStats();
+        BoundedQueue<std::shared_ptr<VideoFrame>>::QueueStats decoded = m_DecodedFrameQueue.GetStats();
+        BoundedQueue<std::shared_ptr<VideoPacket>>::QueueStats encoded = m_EncodedPacketQueue.GetStats();
+        Trace("[%p][ImageTransoprt::ReleaseAll] capture push:%llu drop:%llu,decoded push:%llu drop:%llu,encoded push:%llu drop:%llu", this,
+            capture.m_nPushed, capture.m_nDropped, decoded.m_nPushed, decoded.m_nDropped, encoded.m_nPushed, encoded.m_nDropped);
+
+        FramePool::PoolStats frame = FramePool::GetFramePool()->GetStats();
+        FramePool::PoolStats packet = FramePool::GetPacketPool()->GetStats();
+        Trace("[%p][ImageTransoprt::ReleaseAll] frame pool alloc:%llu reuse:%llu high water:%u/%llu bytes,packet pool alloc:%llu reuse:%llu high water:%u/%llu bytes", this,
+            frame.m_nAllocNum, frame.m_nReuseNum, frame.m_nOutstandingHighWater, frame.m_nOutstandingBytesHighWater,
+            packet.m_nAllocNum, packet.m_nReuseNum, packet.m_nOutstandingHighWater, packet.m_nOutstandingBytesHighWater);
     }
+    m_CaptureVideoQueue.Clear();
+    m_DecodedFrameQueue.Clear();
+    m_EncodedPacketQueue.Clear();
+    m_CaptureVideoQueue.ResetStats();
+    m_DecodedFrameQueue.ResetStats();
+    m_EncodedPacketQueue.ResetStats();
 
-    {
-        std::lock_guard<std::mutex> lock(m_EncodedPacketListLock);
-        for (auto& pVideo : m_EncodedPacketList)
-        {
-            pVideo = nullptr;
-        }
-        m_EncodedPacketList.clear();
-    }
-
-    m_pRtpPacketCallbaclk = nullptr;
     m_bEnableOSD = false;
     m_eVideoType = VIDEO_TYPE_NONE;
+    m_eCapturePath = CAPTURE_PATH_NONE;
+    m_lNextEncodePTS = 0;
+    m_bResolutionChanged = false;
 
     return 0;
 }
@@ -155,37 +176,40 @@ int32_t ImageTransoprt::StartTransoprtH264(std::string device, const VideoCaptur
     m_pVideoCapture = new VideoCapture();
     VideoCapture::CaptureVideoCallbaclk pCaptureVideoCallbaclk = std::bind(&ImageTransoprt::OnCaptureVideo, this, std::placeholders::_1);
     m_pVideoCapture->SetCaptureVideoCallbaclk(pCaptureVideoCallbaclk);
+    m_pVideoCapture->SetCaptureMode(m_eCaptureMode);
 
-    if (capability.m_nVideoType != V4L2_PIX_FMT_YUV420)
+    VideoCapture::VideoCaptureCapability cap = capability;
+    NegotiateCapturePath(device, cap);
+    if (m_eCapturePath != CAPTURE_PATH_RAW)
     {
-        m_pVideoDecoder = new VideoDecoder();
-
-        VideoInfo info;
-        info.m_nCodecID = AV_CODEC_ID_MJPEG;
-        info.m_nWidth = capability.m_nWidth;
-        info.m_nHight = capability.m_nHeight;
-
-        int32_t ret = m_pVideoDecoder->AddVideoStream(info);
+        int32_t ret = OpenMJPEGDecoder(cap.m_nWidth, cap.m_nHeight);
         if (ret < 0)
         {
-            Error("[%p][ImageTransoprt::StartTransoprt] AddVideoStream fail,return:%d", this, ret);
+            Error("[%p][ImageTransoprt::StartTransoprt] OpenMJPEGDecoder fail,return:%d", this, ret);
             ReleaseAll();
             return -2;
         }
-
-        VideoDecoder::VideoFrameCallbaclk pVideoDecoderFrameCallbaclk = std::bind(&ImageTransoprt::OnRecvDecodedFrame, this, std::placeholders::_1);
-        m_pVideoDecoder->SetVideoFrameCallBack(pVideoDecoderFrameCallbaclk);
     }
+    Trace("[%p][ImageTransoprt::StartTransoprt] capture path:%s", this, GetCapturePathName(m_eCapturePath));
 
     m_pVideoEncoder = new VideoEncoder();
     VideoEncoder::VideoPacketCallbaclk pVideoPacketCallbaclk = std::bind(&ImageTransoprt::OnRecvEncodedPacket, this, std::placeholders::_1);
     m_pVideoEncoder->SetVideoPacketCallback(pVideoPacketCallbaclk);
 
     VideoEncoder::EncodParam encodParam;
-    encodParam.m_nBitRate = 6 * 1024 * 1024;
+    encodParam.m_nBitRate = m_nBitRate > 0 ? m_nBitRate.load() : 6 * 1024 * 1024;
+    encodParam.m_eRateControl = m_eRateControl;
+    encodParam.m_nPeakBitRate = m_nPeakBitRate;
+    encodParam.m_nGOP = m_nGOP > 0 ? m_nGOP.load() : encodParam.m_nGOP;
     encodParam.m_nHeight = capability.m_nHeight;
     encodParam.m_nWidth = capability.m_nWidth;
+    encodParam.m_nFPS = capability.m_nFPS > 0 ? capability.m_nFPS : 25;
     encodParam.m_nCodecID = AV_CODEC_ID_H264;
+    encodParam.m_nPixelFormat = cap.m_nVideoType == V4L2_PIX_FMT_NV12 ? AV_PIX_FMT_NV12 : AV_PIX_FMT_YUV420P;
+    {
+        std::lock_guard<std::mutex> lock(m_EncodParamLock);
+        m_EncodParam = encodParam;
+    }
 
     int32_t ret = m_pVideoEncoder->OpenEncoder(encodParam);
     if (ret < 0)
@@ -205,15 +229,16 @@ int32_t ImageTransoprt::StartTransoprtH264(std::string device, const VideoCaptur
     }
     m_pRTPPacketizer->SetPaylodaType(96);
     m_pRTPPacketizer->SetSSRC(0x12345678);
-    RTPPacketizer::RtpPacketCallbaclk pRtpPacketCallbaclk = std::bind(&ImageTransoprt::OnRecvRtpPacket, this, std::placeholders::_1, std::placeholders::_2);
+    RTPPacketizer::RtpPacketCallbaclk pRtpPacketCallbaclk = std::bind(&ImageTransoprt::OnRecvRtpPacket, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
     m_pRTPPacketizer->SetRtpPacketCallbaclk(pRtpPacketCallbaclk);
 
     if (m_bEnableFec)
     {
         m_pFECEncoder = new RFC8627FECEncoder();
-        m_pFECEncoder->SetPayloadType(109);
+        m_pFECEncoder->SetPayloadType(m_FECConfig.m_nPayloadType);
+        LatencyTracer::GetTracer()->SetRepairPayloadType(m_FECConfig.m_nPayloadType);
         m_pFECEncoder->SetSSRC(0x23456789);
-        ret = m_pFECEncoder->Init(7, 7);
+        ret = m_pFECEncoder->Init(m_FECConfig);
         if (ret < 0)
         {
             Error("[%p][ImageTransoprt::StartTransoprt] init RFC8627FECEncoder fail,return:%d", this, ret);
@@ -222,6 +247,7 @@ int32_t ImageTransoprt::StartTransoprtH264(std::string device, const VideoCaptur
         }
         RFC8627FECEncoder::FECEncoderPacketCallback pFECEncoderPacketCallback = std::bind(&ImageTransoprt::OnRecvFECEncoderPacket, this, std::placeholders::_1);
         m_pFECEncoder->SetFECEncoderPacketCallback(pFECEncoderPacketCallback);
+        m_pFECEncoder->SetRepairMode(m_eRepairMode);
     }
 
     {
@@ -242,7 +268,10 @@ int32_t ImageTransoprt::StartTransoprtH264(std::string device, const VideoCaptur
     }
 
     m_bStopTransoprt = false;
-    ret = m_pVideoCapture->StartCapture(device, capability);
+    m_CaptureVideoQueue.Open();
+    m_DecodedFrameQueue.Open();
+    m_EncodedPacketQueue.Open();
+    ret = m_pVideoCapture->StartCapture(device, cap);
     {
         if (ret < 0)
         {
@@ -260,6 +289,86 @@ int32_t ImageTransoprt::StartTransoprtH264(std::string device, const VideoCaptur
     return 0;
 }
 
+//prefer frames the encoder can take as-is,then MJPEG through the decoder
+void ImageTransoprt::NegotiateCapturePath(std::string& device, VideoCapture::VideoCaptureCapability& capability)
+{
+    std::list<VideoCapture::VideoCaptureCapability*>* capabilities = VideoCapture::GetDeviceCapabilities(device, capability.m_nWidth, capability.m_nHeight);
+    if (capabilities == nullptr)
+    {
+        Warn("[%p][ImageTransoprt::NegotiateCapturePath] GetDeviceCapabilities fail,keep video type:%u", this, capability.m_nVideoType);
+        m_eCapturePath = capability.m_nVideoType == V4L2_PIX_FMT_YUV420 ? CAPTURE_PATH_RAW : CAPTURE_PATH_NONE;
+        return;
+    }
+
+    uint32_t videoTypes[] = { V4L2_PIX_FMT_YUV420,V4L2_PIX_FMT_NV12 };
+    for (uint32_t videoType : videoTypes)
+    {
+        if (VideoCapture::FindCapability(capabilities, videoType, capability.m_nWidth, capability.m_nHeight) != nullptr)
+        {
+            capability.m_nVideoType = videoType;
+            m_eCapturePath = CAPTURE_PATH_RAW;
+            break;
+        }
+    }
+
+    if (m_eCapturePath != CAPTURE_PATH_RAW)
+    {
+        if (VideoCapture::FindCapability(capabilities, V4L2_PIX_FMT_MJPEG, capability.m_nWidth, capability.m_nHeight) == nullptr)
+        {
+            Warn("[%p][ImageTransoprt::NegotiateCapturePath] device not report %ux%u,try MJPEG anyway", this, capability.m_nWidth, capability.m_nHeight);
+        }
+        capability.m_nVideoType = V4L2_PIX_FMT_MJPEG;
+    }
+
+    for (auto& it : *capabilities)
+    {
+        delete it;
+    }
+    delete capabilities;
+
+    Trace("[%p][ImageTransoprt::NegotiateCapturePath] %ux%u video type:%c%c%c%c", this, capability.m_nWidth, capability.m_nHeight,
+        capability.m_nVideoType & 0xFF, (capability.m_nVideoType >> 8) & 0xFF, (capability.m_nVideoType >> 16) & 0xFF, (capability.m_nVideoType >> 24) & 0xFF);
+}
+
+int32_t ImageTransoprt::OpenMJPEGDecoder(uint32_t width, uint32_t height)
+{
+    m_pVideoDecoder = new VideoDecoder();
+
+    VideoInfo info;
+    info.m_nCodecID = AV_CODEC_ID_MJPEG;
+    info.m_nWidth = width;
+    info.m_nHight = height;
+
+    int32_t ret = m_pVideoDecoder->AddVideoStream(info);
+    if (ret < 0)
+    {
+        Error("[%p][ImageTransoprt::OpenMJPEGDecoder] AddVideoStream fail,return:%d", this, ret);
+        return -1;
+    }
+
+    VideoDecoder::VideoFrameCallbaclk pVideoDecoderFrameCallbaclk = std::bind(&ImageTransoprt::OnRecvDecodedFrame, this, std::placeholders::_1);
+    m_pVideoDecoder->SetVideoFrameCallBack(pVideoDecoderFrameCallbaclk);
+    m_pVideoDecoder->SetWritableFrame(m_bEnableOSD);
+    m_eCapturePath = m_pVideoDecoder->IsHardwareDecoder() ? CAPTURE_PATH_HW_DECODE : CAPTURE_PATH_SW_DECODE;
+
+    return 0;
+}
+
+const char* ImageTransoprt::GetCapturePathName(CapturePath path)
+{
+    switch (path)
+    {
+    case CAPTURE_PATH_RAW:
+        return "raw";
+    case CAPTURE_PATH_HW_DECODE:
+        return "hw decode";
+    case CAPTURE_PATH_SW_DECODE:
+        return "sw decode";
+    default:
+        return "none";
+    }
+}
+
 int32_t ImageTransoprt::StartTransoprtMJPEG(std::string device, const VideoCapture::VideoCaptureCapability& capability)
 {
     Trace("[%p][ImageTransoprt::StartTransoprtMJPEG] StartTransoprtMJPEG", this);
@@ -276,26 +385,21 @@ int32_t ImageTransoprt::StartTransoprtMJPEG(std::string device, const VideoCaptu
     m_pVideoCapture = new VideoCapture();
     VideoCapture::CaptureVideoCallbaclk pCaptureVideoCallbaclk = std::bind(&ImageTransoprt::OnCaptureVideo, this, std::placeholders::_1);
     m_pVideoCapture->SetCaptureVideoCallbaclk(pCaptureVideoCallbaclk);
+    m_pVideoCapture->SetCaptureMode(m_eCaptureMode);
 
     if (capability.m_nVideoType != V4L2_PIX_FMT_YUV420)
     {
-        m_pVideoDecoder = new VideoDecoder();
-
-        VideoInfo info;
-        info.m_nCodecID = AV_CODEC_ID_MJPEG;
-        info.m_nWidth = g_nCaptureWidth;
-        info.m_nHight = g_nCaptureHeight;
-
-        int32_t ret = m_pVideoDecoder->AddVideoStream(info);
+        int32_t ret = OpenMJPEGDecoder(g_nCaptureWidth, g_nCaptureHeight);
         if (ret < 0)
         {
-            Error("[%p][ImageTransoprt::StartTransoprt] AddVideoStream fail,return:%d", this, ret);
+            Error("[%p][ImageTransoprt::StartTransoprtMJPEG] OpenMJPEGDecoder fail,return:%d", this, ret);
             ReleaseAll();
             return -2;
         }
-
-        VideoDecoder::VideoFrameCallbaclk pVideoDecoderFrameCallbaclk = std::bind(&ImageTransoprt::OnRecvDecodedFrame, this, std::placeholders::_1);
-        m_pVideoDecoder->SetVideoFrameCallBack(pVideoDecoderFrameCallbaclk);
+    }
+    else
+    {
+        m_eCapturePath = CAPTURE_PATH_RAW;
     }
 
     m_pVideoEncoder = new VideoEncoder();
@@ -304,10 +408,15 @@ int32_t ImageTransoprt::StartTransoprtMJPEG(std::string device, const VideoCaptu
 
 
     VideoEncoder::EncodParam encodParam;
-    encodParam.m_nBitRate = 1 * 1024 * 1024;
+    encodParam.m_nBitRate = m_nBitRate > 0 ? m_nBitRate.load() : 1 * 1024 * 1024;
     encodParam.m_nHeight = capability.m_nHeight;
     encodParam.m_nWidth = capability.m_nWidth;
+    encodParam.m_nFPS = capability.m_nFPS > 0 ? capability.m_nFPS : 25;
     encodParam.m_nCodecID = AV_CODEC_ID_MJPEG;
+    {
+        std::lock_guard<std::mutex> lock(m_EncodParamLock);
+        m_EncodParam = encodParam;
+    }
     int32_t ret = m_pVideoEncoder->OpenEncoder(encodParam);
     if (ret < 0)
     {
@@ -326,15 +435,16 @@ int32_t ImageTransoprt::StartTransoprtMJPEG(std::string device, const VideoCaptu
     }
     m_pRTPPacketizer->SetPaylodaType(97);
     m_pRTPPacketizer->SetSSRC(0x12345678);
-    RTPPacketizer::RtpPacketCallbaclk pRtpPacketCallbaclk = std::bind(&ImageTransoprt::OnRecvRtpPacket, this, std::placeholders::_1, std::placeholders::_2);
+    RTPPacketizer::RtpPacketCallbaclk pRtpPacketCallbaclk = std::bind(&ImageTransoprt::OnRecvRtpPacket, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
     m_pRTPPacketizer->SetRtpPacketCallbaclk(pRtpPacketCallbaclk);
 
     if (m_bEnableFec)
     {
         m_pFECEncoder = new RFC8627FECEncoder();
-        m_pFECEncoder->SetPayloadType(109);
+        m_pFECEncoder->SetPayloadType(m_FECConfig.m_nPayloadType);
+        LatencyTracer::GetTracer()->SetRepairPayloadType(m_FECConfig.m_nPayloadType);
         m_pFECEncoder->SetSSRC(0x23456789);
-        ret = m_pFECEncoder->Init(7, 7);
+        ret = m_pFECEncoder->Init(m_FECConfig);
         if (ret < 0)
         {
             Error("[%p][ImageTransoprt::StartTransoprt] init RFC8627FECEncoder fail,return:%d", this, ret);
@@ -343,9 +453,13 @@ int32_t ImageTransoprt::StartTransoprtMJPEG(std::string device, const VideoCaptu
         }
         RFC8627FECEncoder::FECEncoderPacketCallback pFECEncoderPacketCallback = std::bind(&ImageTransoprt::OnRecvFECEncoderPacket, this, std::placeholders::_1);
         m_pFECEncoder->SetFECEncoderPacketCallback(pFECEncoderPacketCallback);
+        m_pFECEncoder->SetRepairMode(m_eRepairMode);
     }
 
     m_bStopTransoprt = false;
+    m_CaptureVideoQueue.Open();
+    m_DecodedFrameQueue.Open();
+    m_EncodedPacketQueue.Open();
     cap.m_nWidth = g_nCaptureWidth;
     cap.m_nHeight = g_nCaptureHeight;
     ret = m_pVideoCapture->StartCapture(device, cap);
@@ -369,50 +483,44 @@ int32_t ImageTransoprt::StartTransoprtMJPEG(std::string device, const VideoCaptu
 void ImageTransoprt::OnCaptureVideo(std::shared_ptr<VideoFrame>& pVideo)
 {
     //Debug("[%p][ImageTransoprt::OnCaptureVideo] Capture Video time:%llu", this, pVideo->m_lPTS);
-    std::lock_guard<std::mutex> lock(m_CaptureVideoListLock);
-    m_CaptureVideoList.push_back(pVideo);
-
-    while (m_CaptureVideoList.size() > MAX_CAPTURE_VIDEO_NUM)
+    LatencyTracer::GetTracer()->Record(LatencyTracer::STAGE_CAPTURE, pVideo->m_lPTS);
+    if (!m_CaptureVideoQueue.Push(pVideo))
     {
-        auto pVideoFrame = m_CaptureVideoList.front();
-        m_CaptureVideoList.pop_front();
-        Warn("[%p][ImageTransoprt::OnCaptureVideo] Capture Video List  size > %d,discard", this, MAX_CAPTURE_VIDEO_NUM);
+        Warn("[%p][ImageTransoprt::OnCaptureVideo] Capture Video Queue size > %d,discard", this, MAX_CAPTURE_VIDEO_NUM);
     }
+    LatencyTracer::GetTracer()->SetGauge(LatencyTracer::GAUGE_CAPTURE_QUEUE, m_CaptureVideoQueue.Size());
 }
 
 void ImageTransoprt::OnRecvDecodedFrame(std::shared_ptr<VideoFrame>& pVideo)
 {
     //Debug("[%p][ImageTransoprt::OnRecvDecodedFrame] Recv Decoded Video time:%llu", this, pVideo->m_lPTS);
-    std::lock_guard<std::mutex> lock(m_DecodedFrameListLock);
-    while (m_DecodedFrameList.size() > MAX_CAPTURE_VIDEO_NUM)
-    {
-        auto pVideoFrame = m_DecodedFrameList.front();
-        m_DecodedFrameList.pop_front();
-        Warn("[%p][ImageTransoprt::OnRecvDecodedFrame] Decoded Frame List size > %d,discard", this, MAX_CAPTURE_VIDEO_NUM);
-    }
-
+    LatencyTracer::GetTracer()->Record(LatencyTracer::STAGE_DECODED, pVideo->m_lPTS);
     {
         std::lock_guard<std::mutex> lock(m_pOSDLock);
-        if (m_bEnableOSD)
+        //OSD only draws on I420
+        if (m_bEnableOSD && pVideo->m_nFrameType != AV_PIX_FMT_NV12)
         {
             m_cOSD.AddOSD2VideoFrame(pVideo);
         }
     }
-    m_DecodedFrameList.push_back(pVideo);
+    LatencyTracer::GetTracer()->Record(LatencyTracer::STAGE_OSD, pVideo->m_lPTS);
+
+    if (!m_DecodedFrameQueue.Push(pVideo))
+    {
+        Warn("[%p][ImageTransoprt::OnRecvDecodedFrame] Decoded Frame Queue size > %d,discard", this, MAX_DECODED_FRAME_NUM);
+    }
+    LatencyTracer::GetTracer()->SetGauge(LatencyTracer::GAUGE_DECODED_QUEUE, m_DecodedFrameQueue.Size());
 }
 
 void ImageTransoprt::OnRecvEncodedPacket(std::shared_ptr<VideoPacket>& pVideo)
 {
     //Debug("[%p][ImageTransoprt::OnRecvEncodedPacket] Recv Encoded Video time:%llu", this, pVideo->m_lPTS);
-    std::lock_guard<std::mutex> lock(m_EncodedPacketListLock);
-    m_EncodedPacketList.push_back(pVideo);
-
-    while (m_EncodedPacketList.size() > 3)
+    LatencyTracer::GetTracer()->Record(LatencyTracer::STAGE_ENCODED, pVideo->m_lPTS);
+    if (!m_EncodedPacketQueue.Push(pVideo))
     {
-        auto pVideoPacket = m_EncodedPacketList.front();
-        m_EncodedPacketList.pop_front();
-        Warn("[%p][ImageTransoprt::OnRecvEncodedPacket] Encoded Packet List  size > %d,discard", this, 3);
+        Warn("[%p][ImageTransoprt::OnRecvEncodedPacket] Encoded Packet Queue size > %d,discard", this, MAX_ENCODED_PACKET_NUM);
     }
+    LatencyTracer::GetTracer()->SetGauge(LatencyTracer::GAUGE_ENCODED_QUEUE, m_EncodedPacketQueue.Size());
 }
 
 bool ImageTransoprt::SetRtpPacketCallbaclk(ImageTransoprt::RtpPacketCallbaclk callback)
@@ -421,19 +529,235 @@ bool ImageTransoprt::SetRtpPacketCallbaclk(ImageTransoprt::RtpPacketCallbaclk ca
     return true;
 }
 
-void ImageTransoprt::OnRecvRtpPacket(uint8_t* pRtpPacket, uint32_t size)
+int32_t ImageTransoprt::SetCaptureMode(VideoCapture::CaptureMode mode)
+{
+    if (m_pTransoprtThread != nullptr)
+    {
+        Error("[%p][ImageTransoprt::SetCaptureMode] can not change capture mode while transoprting", this);
+        return -1;
+    }
+
+    m_eCaptureMode = mode;
+    return 0;
+}
+
+int32_t ImageTransoprt::SetBitRate(uint32_t bitRate)
+{
+    Trace("[%p][ImageTransoprt::SetBitRate] bitrate:%u", this, bitRate);
+    m_nBitRate = bitRate;
+    if (m_pVideoEncoder == nullptr)
+    {
+        return 0;
+    }
+
+    return m_pVideoEncoder->SetBitRate(bitRate);
+}
+
+int32_t ImageTransoprt::SetRateControl(VideoEncoder::RateControl mode, uint32_t peakBitRate)
+{
+    Trace("[%p][ImageTransoprt::SetRateControl] mode:%d peak:%u", this, mode, peakBitRate);
+    m_eRateControl = mode;
+    if (peakBitRate > 0)
+    {
+        m_nPeakBitRate = peakBitRate;
+    }
+    if (m_pVideoEncoder == nullptr)
+    {
+        return 0;
+    }
+
+    return m_pVideoEncoder->SetRateControl(mode, peakBitRate);
+}
+
+int32_t ImageTransoprt::SetGOP(uint32_t gop)
+{
+    Trace("[%p][ImageTransoprt::SetGOP] gop:%u", this, gop);
+    m_nGOP = gop;
+    if (m_pVideoEncoder == nullptr)
+    {
+        return 0;
+    }
+
+    return m_pVideoEncoder->SetGOP(gop);
+}
+
+//the camera keeps its rate,frames above the target are dropped before the encoder
+int32_t ImageTransoprt::SetFPS(uint32_t fps)
+{
+    Trace("[%p][ImageTransoprt::SetFPS] fps:%u", this, fps);
+    m_nTargetFPS = fps;
+    if (m_pVideoEncoder == nullptr || fps == 0)
+    {
+        return 0;
+    }
+
+    return m_pVideoEncoder->SetFPS(fps);
+}
+
+int32_t ImageTransoprt::RequestKeyFrame()
+{
+    if (m_pVideoEncoder == nullptr)
+    {
+        return -1;
+    }
+
+    return m_pVideoEncoder->RequestKeyFrame();
+}
+
+int32_t ImageTransoprt::SetFECRepairMode(RFC8627FECEncoder::RepairMode mode)
+{
+    Trace("[%p][ImageTransoprt::SetFECRepairMode] mode:%d", this, mode);
+    m_eRepairMode = mode;
+    if (m_pFECEncoder == nullptr)
+    {
+        return 0;
+    }
+
+    return m_pFECEncoder->SetRepairMode(mode);
+}
+
+int32_t ImageTransoprt::SetFECConfig(const FECBlock::Config& config)
+{
+    Trace("[%p][ImageTransoprt::SetFECConfig] fec:%s", this, FECBlock::MakeSdpAttribute(config).c_str());
+    if (m_pFECEncoder == nullptr)
+    {
+        m_FECConfig = config;
+        return 0;
+    }
+
+    //the receivers know the repairs by their payload type,only the geometry can move mid-stream
+    if (config.m_nPayloadType != m_FECConfig.m_nPayloadType)
+    {
+        Error("[%p][ImageTransoprt::SetFECConfig] pt:%d->%d while transoprting", this, m_FECConfig.m_nPayloadType, config.m_nPayloadType);
+        return -1;
+    }
+
+    int32_t ret = m_pFECEncoder->SetConfig(config);
+    if (ret != 0)
+    {
+        Error("[%p][ImageTransoprt::SetFECConfig] RFC8627FECEncoder SetConfig fail,return:%d", this, ret);
+        return -2;
+    }
+
+    m_FECConfig = config;
+    return 0;
+}
+
+int32_t ImageTransoprt::GetFECConfig(FECBlock::Config& config, uint32_t& ssrc)
+{
+    if (m_pFECEncoder == nullptr)
+    {
+        return -1;
+    }
+
+    m_pFECEncoder->GetConfig(config, ssrc);
+    return 0;
+}
+
+std::shared_ptr<Packet> ImageTransoprt::GetCachedRtpPacket(uint16_t seq, double& age)
+{
+    if (m_pFECEncoder == nullptr)
+    {
+        return nullptr;
+    }
+
+    return m_pFECEncoder->GetCachedPacket(seq, age);
+}
+
+uint32_t ImageTransoprt::GetBitRate()
+{
+    uint32_t bitRate = m_nBitRate;
+    if (bitRate > 0)
+    {
+        return bitRate;
+    }
+
+    std::lock_guard<std::mutex> lock(m_EncodParamLock);
+    return m_EncodParam.m_nBitRate;
+}
+
+int32_t ImageTransoprt::SetResolution(uint32_t width, uint32_t height)
+{
+    if (width == 0 || height == 0)
+    {
+        Error("[%p][ImageTransoprt::SetResolution] invalid resolution:%ux%u", this, width, height);
+        return -1;
+    }
+
+    std::lock_guard<std::mutex> lock(m_EncodParamLock);
+    if (width == m_EncodParam.m_nWidth && height == m_EncodParam.m_nHeight)
+    {
+        return 0;
+    }
+    Trace("[%p][ImageTransoprt::SetResolution] %ux%u -> %ux%u", this, m_EncodParam.m_nWidth, m_EncodParam.m_nHeight, width, height);
+    m_EncodParam.m_nWidth = width;
+    m_EncodParam.m_nHeight = height;
+    m_bResolutionChanged = true;
+
+    return 0;
+}
+
+//runs on the encoder thread,so no frame is inside the encoder while it is replaced
+int32_t ImageTransoprt::ReopenEncoder()
 {
-    uint8_t* data = (uint8_t*)malloc(size);
-    if (data == nullptr)
+    VideoEncoder::EncodParam param;
+    {
+        std::lock_guard<std::mutex> lock(m_EncodParamLock);
+        m_bResolutionChanged = false;
+        param = m_EncodParam;
+    }
+    param.m_nBitRate = m_nBitRate > 0 ? m_nBitRate.load() : param.m_nBitRate;
+    param.m_eRateControl = m_eRateControl;
+    param.m_nPeakBitRate = m_nPeakBitRate;
+    param.m_nGOP = m_nGOP > 0 ? m_nGOP.load() : param.m_nGOP;
+    param.m_nFPS = m_nTargetFPS > 0 ? m_nTargetFPS.load() : param.m_nFPS;
+
+    m_pVideoEncoder->CloseEncoder();
+    int32_t ret = m_pVideoEncoder->OpenEncoder(param);
+    if (ret < 0)
+    {
+        Error("[%p][ImageTransoprt::ReopenEncoder] OpenEncoder %ux%u fail,return:%d", this, param.m_nWidth, param.m_nHeight, ret);
+        return -1;
+    }
+
+    if (m_eVideoType == VIDEO_TYPE_H264)
+    {
+        const uint8_t* data = nullptr;
+        uint32_t size = 0;
+
+        data = m_pVideoEncoder->GetSPS(size);
+        if (data != nullptr && size > 0)
+        {
+            ((H264RTPpacketizer*)m_pRTPPacketizer)->SetSPS(data, size);
+        }
+
+        data = m_pVideoEncoder->GetPPS(size);
+        if (data != nullptr && size > 0)
+        {
+            ((H264RTPpacketizer*)m_pRTPPacketizer)->SetPPS(data, size);
+        }
+    }
+    Trace("[%p][ImageTransoprt::ReopenEncoder] encoder reopened at %ux%u bitrate:%u", this, param.m_nWidth, param.m_nHeight, param.m_nBitRate);
+
+    return 0;
+}
+
+void ImageTransoprt::OnRecvRtpPacket(uint8_t* pRtpPacket, uint32_t size, uint8_t priority)
+{
+    LatencyTracer::GetTracer()->RecordRtp(LatencyTracer::STAGE_PACKETIZED, pRtpPacket, size);
+    std::shared_ptr<void> buffer = FramePool::GetPacketPool()->GetBuffer(size);
+    if (buffer == nullptr)
     {
         Error("[%p][ImageTransoprt::OnRecvRtpPacket] malloc data fail", this);
         return;
     }
-    memcpy(data, pRtpPacket, size);
+    memcpy(buffer.get(), pRtpPacket, size);
 
     std::shared_ptr<Packet> pRTPPacke = std::make_shared<Packet>();
-    pRTPPacke->m_pData = data;
+    pRTPPacke->m_pData = (uint8_t*)buffer.get();
     pRTPPacke->m_nLength = size;
+    pRTPPacke->m_nPriority = priority;
+    pRTPPacke->m_pBufferRef = buffer;
     if (m_bEnableFec)
     {
         if (m_pFECEncoder != nullptr)
@@ -452,6 +776,7 @@ void ImageTransoprt::OnRecvRtpPacket(uint8_t* pRtpPacket, uint32_t size)
 
 void ImageTransoprt::OnRecvFECEncoderPacket(const std::shared_ptr<Packet>& packet)
 {
+    LatencyTracer::GetTracer()->RecordRtp(LatencyTracer::STAGE_FEC, packet->m_pData, packet->m_nLength);
     if (m_pRtpPacketCallbaclk == nullptr)
     {
         return;
@@ -468,6 +793,7 @@ int32_t ImageTransoprt::StopTransoprt(std::string device)
         m_pVideoCapture->StopCapture();
     }
     ReleaseAll();
+    m_pRtpPacketCallbaclk = nullptr;
 
     return 0;
 }
@@ -478,23 +804,24 @@ void ImageTransoprt::DecodeThread()
     while (!m_bStopTransoprt)
     {
         std::shared_ptr<VideoFrame> pCaptureVideo = nullptr;
-
+        if (!m_CaptureVideoQueue.Pop(pCaptureVideo, STAGE_WAIT_TIME) || pCaptureVideo == nullptr)
         {
-            std::lock_guard<std::mutex> lock(m_CaptureVideoListLock);
-            if (m_CaptureVideoList.size() > 0)
-            {
-                pCaptureVideo = m_CaptureVideoList.front();
-                m_CaptureVideoList.pop_front();
-            }
+            continue;
         }
 
-        if (pCaptureVideo == nullptr)
+        if (pCaptureVideo->m_nFrameType == V4L2_PIX_FMT_YUV420)
         {
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
-            continue;
+            pCaptureVideo->m_nFrameType = AV_PIX_FMT_YUV420P;
+            pCaptureVideo->SetPackedPlanes();
+            OnRecvDecodedFrame(pCaptureVideo);
         }
-
-        if (pCaptureVideo->m_nFrameType != V4L2_PIX_FMT_YUV420)
+        else if (pCaptureVideo->m_nFrameType == V4L2_PIX_FMT_NV12)
+        {
+            pCaptureVideo->m_nFrameType = AV_PIX_FMT_NV12;
+            pCaptureVideo->SetPackedNV12Planes();
+            OnRecvDecodedFrame(pCaptureVideo);
+        }
+        else
         {
             std::shared_ptr<VideoPacket> pVideoPacket = std::make_shared<VideoPacket>();
             pVideoPacket->m_lDTS = pCaptureVideo->m_lPTS;
@@ -502,14 +829,12 @@ void ImageTransoprt::DecodeThread()
             pVideoPacket->m_nFrameType = pCaptureVideo->m_nFrameType;
             pVideoPacket->m_nLength = pCaptureVideo->m_nLength;
             pVideoPacket->m_pData = pCaptureVideo->m_pData;
+            pVideoPacket->m_pBufferRef = pCaptureVideo->m_pBufferRef;
             pCaptureVideo->m_nLength = 0;
             pCaptureVideo->m_pData = nullptr;
+            pCaptureVideo->m_pBufferRef = nullptr;
             m_pVideoDecoder->RecvVideoPacket(pVideoPacket);
         }
-        else
-        {
-            OnRecvDecodedFrame(pCaptureVideo);
-        }
 
         pCaptureVideo = nullptr;
     }
@@ -523,22 +848,31 @@ void ImageTransoprt::EncoderThread()
     while (!m_bStopTransoprt)
     {
         std::shared_ptr<VideoFrame> m_DecodedFrame = nullptr;
+        if (!m_DecodedFrameQueue.Pop(m_DecodedFrame, STAGE_WAIT_TIME) || m_DecodedFrame == nullptr)
+        {
+            continue;
+        }
 
+        uint32_t fps = m_nTargetFPS;
+        if (fps != m_nEncodeFPS)
         {
-            std::lock_guard<std::mutex> lock(m_DecodedFrameListLock);
-            if (m_DecodedFrameList.size() > 0)
+            m_nEncodeFPS = fps;
+            m_lNextEncodePTS = 0;
+        }
+        if (fps > 0)
+        {
+            uint64_t interval = MEDIA_CLOCK_RATE / fps;
+            if (m_lNextEncodePTS != 0 && m_DecodedFrame->m_lPTS + interval / 4 < m_lNextEncodePTS)
             {
-                m_DecodedFrame = m_DecodedFrameList.front();
-                m_DecodedFrameList.pop_front();
+                continue;
             }
+            m_lNextEncodePTS = std::max(m_lNextEncodePTS, m_DecodedFrame->m_lPTS) + interval;
         }
 
-        if (m_DecodedFrame == nullptr)
+        if (m_bResolutionChanged)
         {
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
-            continue;
+            ReopenEncoder();
         }
-
         m_pVideoEncoder->EncodeFrame(m_DecodedFrame);
 
         m_DecodedFrame = nullptr;
@@ -553,19 +887,13 @@ void ImageTransoprt::TransoprtThread()
     while (!m_bStopTransoprt)
     {
         std::shared_ptr<VideoPacket> pEncodedPacket = nullptr;
-
+        bool bHasPacket = m_EncodedPacketQueue.Pop(pEncodedPacket, STAGE_WAIT_TIME);
+        if (m_pFECEncoder != nullptr)
         {
-            std::lock_guard<std::mutex> lock(m_EncodedPacketListLock);
-            if (m_EncodedPacketList.size() > 0)
-            {
-                pEncodedPacket = m_EncodedPacketList.front();
-                m_EncodedPacketList.pop_front();
-            }
+            m_pFECEncoder->CheckBlockDeadline();
         }
-
-        if (pEncodedPacket == nullptr)
+        if (!bHasPacket || pEncodedPacket == nullptr)
         {
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
             continue;
         }
 
@@ -577,9 +905,67 @@ void ImageTransoprt::TransoprtThread()
     Trace("[%p][ImageTransoprt::TransoprtThread] exit TransoprtThread", this);
 }
 
+//the overlay is part of the encoded picture,so it is the same for every viewer of this transoprt
 int32_t ImageTransoprt::EnableOSD(bool enable)
 {
+    if (enable == m_bEnableOSD)
+    {
+        return 0;
+    }
+
+    if (enable)
+    {
+        Marker::Color color;
+        color.A = 255 * 0; color.R = 255; color.G = 255; color.B = 255;
+
+        AddMarker("pitch");
+        SetMarkKey("pitch", ":", color, 25, g_nCaptureHeight / 2 - 100);
+        AddMarker("roll");
+        SetMarkKey("roll", ":", color, 25, g_nCaptureHeight / 2);
+        AddMarker("yaw");
+        SetMarkKey("yaw", "ƫ:", color, 25, g_nCaptureHeight / 2 + 100);
+
+        AddMarker("vol");
+        SetMarkKey("vol", "ѹ:", color, g_nCaptureWidth - 160, g_nCaptureHeight / 2 - 100);
+        AddMarker("cur");
+        SetMarkKey("cur", ":", color, g_nCaptureWidth - 160, g_nCaptureHeight / 2);
+        AddMarker("rem");
+        SetMarkKey("rem", ":", color, g_nCaptureWidth - 160, g_nCaptureHeight / 2 + 100);
+
+        AddMarker("lat");
+        SetMarkKey("lat", "γ:", color, g_nCaptureWidth / 5 * 0 + 25, g_nCaptureHeight - 45);
+        AddMarker("lon");
+        SetMarkKey("lon", ":", color, g_nCaptureWidth / 5 * 1 + 25, g_nCaptureHeight - 45);
+        AddMarker("alt");
+        SetMarkKey("alt", ":", color, g_nCaptureWidth / 5 * 2 + 25, g_nCaptureHeight - 45);
+        AddMarker("sat");
+        SetMarkKey("sat", ":", color, g_nCaptureWidth / 5 * 3 + 25, g_nCaptureHeight - 45);
+        AddMarker("vel");
+        SetMarkKey("vel", "ٶ:", color, g_nCaptureWidth / 5 * 4 + 25, g_nCaptureHeight - 45);
+    }
+    else
+    {
+        RemoveMarker("pitch");
+        RemoveMarker("roll");
+        RemoveMarker("yaw");
+        RemoveMarker("lat");
+        RemoveMarker("lon");
+        RemoveMarker("alt");
+        RemoveMarker("sat");
+        RemoveMarker("vel");
+        RemoveMarker("vol");
+        RemoveMarker("cur");
+        RemoveMarker("rem");
+    }
+
+    //the overlay is drawn in place,the decoder only pays for its own copy while there is one
+    if (m_pVideoDecoder != nullptr)
+    {
+        m_pVideoDecoder->SetWritableFrame(enable);
+    }
     m_bEnableOSD = enable;
+    Trace("[%p][ImageTransoprt::EnableOSD] enable osd:%d", this, enable);
+
     return 0;
 }
 
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <mutex>
 #include "MediaCapture/VideoCapture.h"
 #include "MediaDecoder/VideoDecoder.h"
@@ -7,20 +8,45 @@
 #include "RTPPacketizer/RTPPacketizer.h"
 #include "OSD/OSD.h"
 #include "FEC/FECEncoder.h"
+#include "CommonTools/BoundedQueue.h"
 
 class ImageTransoprt
 {
 public:
     typedef std::function<void(const std::shared_ptr<Packet>&)> RtpPacketCallbaclk;
 
+    typedef enum CapturePath
+    {
+        CAPTURE_PATH_NONE = 0,
+        CAPTURE_PATH_RAW,           //camera outputs YUV420/NV12,frames go straight to the encoder
+        CAPTURE_PATH_HW_DECODE,     //MJPEG decoded by the v4l2 m2m decoder
+        CAPTURE_PATH_SW_DECODE      //MJPEG decoded in software
+    }CapturePath;
+
 public:
     ImageTransoprt(bool enableFec);
     ~ImageTransoprt();
 
     int32_t StartTransoprt(std::string device, const VideoCapture::VideoCaptureCapability& capability, VideoType type);
     int32_t StopTransoprt(std::string device);
-    bool SetRtpPacketCallbaclk(ImageTransoprt::RtpPacketCallbaclk callback);
+    bool SetRtpPacketCallbaclk(ImageTransoprt::RtpPacketCallbaclk callback);       //before StartTransoprt,kept until StopTransoprt
+    int32_t SetCaptureMode(VideoCapture::CaptureMode mode);
+
+    //encoder control,applied immediately while transoprting,otherwise used at the next start
+    int32_t SetBitRate(uint32_t bitRate);
+    int32_t SetRateControl(VideoEncoder::RateControl mode, uint32_t peakBitRate);      //peakBitRate 0 keeps the current peak
+    int32_t SetGOP(uint32_t gop);
+    int32_t SetFPS(uint32_t fps);
+    int32_t RequestKeyFrame();
+    int32_t SetFECRepairMode(RFC8627FECEncoder::RepairMode mode);
+    int32_t SetFECConfig(const FECBlock::Config& config);      //while transoprting from the next block,under a new repair SSRC
+    int32_t GetFECConfig(FECBlock::Config& config, uint32_t& ssrc);     //the geometry in use and the SSRC of its repairs
+    std::shared_ptr<Packet> GetCachedRtpPacket(uint16_t seq, double& age);   //for retransmission,age ms since sent
+    int32_t SetResolution(uint32_t width, uint32_t height);     //the encoder is reopened before the next frame
+    uint32_t GetBitRate();
     inline bool IsEnableOSD() { return m_bEnableOSD; };
+    inline CapturePath GetCapturePath() { return m_eCapturePath; };
+    static const char* GetCapturePathName(CapturePath path);
 
     int32_t EnableOSD(bool enable);
     int32_t AddMarker(const std::string& name);
@@ -40,11 +66,14 @@ private:
     void OnCaptureVideo(std::shared_ptr<VideoFrame>& pVideo);
     void OnRecvDecodedFrame(std::shared_ptr<VideoFrame>& pVido);
     void OnRecvEncodedPacket(std::shared_ptr<VideoPacket>& pVideo);
-    void OnRecvRtpPacket(uint8_t* pRtpPacket, uint32_t size);
+    void OnRecvRtpPacket(uint8_t* pRtpPacket, uint32_t size, uint8_t priority);
     void OnRecvFECEncoderPacket(const std::shared_ptr<Packet>& packet);
 
     int32_t StartTransoprtH264(std::string device, const VideoCapture::VideoCaptureCapability& capability);
     int32_t StartTransoprtMJPEG(std::string device, const VideoCapture::VideoCaptureCapability& capability);
+    void NegotiateCapturePath(std::string& device, VideoCapture::VideoCaptureCapability& capability);
+    int32_t OpenMJPEGDecoder(uint32_t width, uint32_t height);
+    int32_t ReopenEncoder();
 
 private:
     OSD m_cOSD;
@@ -56,6 +85,22 @@ private:
     RTPPacketizer* m_pRTPPacketizer;
     RFC8627FECEncoder* m_pFECEncoder;
     VideoType m_eVideoType;
+    VideoCapture::CaptureMode m_eCaptureMode;
+    CapturePath m_eCapturePath;
+
+    //set from the rtsp threads,read when the encoder is opened
+    std::atomic<uint32_t> m_nBitRate;
+    std::atomic<VideoEncoder::RateControl> m_eRateControl;
+    std::atomic<uint32_t> m_nPeakBitRate;
+    std::atomic<uint32_t> m_nGOP;
+    std::atomic<uint32_t> m_nTargetFPS;
+    uint32_t m_nEncodeFPS;                      //the target the encoder thread throttles to,it owns these two
+    uint64_t m_lNextEncodePTS;
+    RFC8627FECEncoder::RepairMode m_eRepairMode;
+    FECBlock::Config m_FECConfig;
+    std::mutex m_EncodParamLock;
+    VideoEncoder::EncodParam m_EncodParam;
+    std::atomic<bool> m_bResolutionChanged;
 
     bool m_bStopTransoprt;
     std::thread* m_pDecodeThread;
@@ -63,14 +108,9 @@ private:
     std::thread* m_pTransoprtThread;
     bool m_bEnableFec;
 
-    std::mutex m_CaptureVideoListLock;
-    std::list <std::shared_ptr<VideoFrame>> m_CaptureVideoList;
-
-    std::mutex m_DecodedFrameListLock;
-    std::list <std::shared_ptr<VideoFrame>> m_DecodedFrameList;
-
-    std::mutex m_EncodedPacketListLock;
-    std::list <std::shared_ptr<VideoPacket>> m_EncodedPacketList;
+    BoundedQueue<std::shared_ptr<VideoFrame>> m_CaptureVideoQueue;
+    BoundedQueue<std::shared_ptr<VideoFrame>> m_DecodedFrameQueue;
+    BoundedQueue<std::shared_ptr<VideoPacket>> m_EncodedPacketQueue;
 
     ImageTransoprt::RtpPacketCallbaclk m_pRtpPacketCallbaclk;
 };
@@ -9,9 +9,92 @@
 #include <sys/mman.h>
 #include "VideoCapture.h" 
 #include "Log/Log.h"
+#include "CommonTools/TimeCounter.h"
+#include "CommonTools/FramePool.h"
 
 #define VIDEO_CAPTURN_BUFF (4)
-#define VIDEO_CLOCK_RATE (90000)
+#define VIDEO_LEASE_CAPTURN_BUFF (6)
+
+VideoCapture::BufferPool::BufferPool(int fd)
+{
+    m_nCameraFd = fd;
+    m_pBuffers = nullptr;
+    m_nBufferNum = 0;
+    m_nLeasedNum = 0;
+    m_bStreaming = false;
+}
+
+VideoCapture::BufferPool::~BufferPool()
+{
+    StopStreaming();
+
+    if (m_pBuffers != nullptr)
+    {
+        for (uint32_t i = 0; i < m_nBufferNum; i++)
+        {
+            if (m_pBuffers[i].dmaBufFd != -1)
+            {
+                close(m_pBuffers[i].dmaBufFd);
+            }
+            munmap(m_pBuffers[i].start, m_pBuffers[i].length);
+        }
+        delete[] m_pBuffers;
+        m_pBuffers = nullptr;
+    }
+
+    if (m_nCameraFd != -1)
+    {
+        close(m_nCameraFd);
+        m_nCameraFd = -1;
+    }
+}
+
+int32_t VideoCapture::BufferPool::Requeue(uint32_t index)
+{
+    std::lock_guard<std::mutex> lock(m_PoolLock);
+    if (m_nLeasedNum > 0)
+    {
+        m_nLeasedNum--;
+    }
+
+    if (!m_bStreaming)
+    {
+        return 0;
+    }
+
+    struct v4l2_buffer buf;
+    memset(&buf, 0, sizeof(struct v4l2_buffer));
+    buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    buf.memory = V4L2_MEMORY_MMAP;
+    buf.index = index;
+    if (ioctl(m_nCameraFd, VIDIOC_QBUF, &buf) == -1)
+    {
+        Warn("[%p][VideoCapture::BufferPool::Requeue] Failed to enqueue capture buffer:%u,errno:%d", this, index, errno);
+        return -1;
+    }
+
+    return 0;
+}
+
+int32_t VideoCapture::BufferPool::StopStreaming()
+{
+    std::lock_guard<std::mutex> lock(m_PoolLock);
+    if (!m_bStreaming)
+    {
+        return 0;
+    }
+    m_bStreaming = false;
+
+    enum v4l2_buf_type type;
+    type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    if (ioctl(m_nCameraFd, VIDIOC_STREAMOFF, &type) < 0)
+    {
+        Error("[%p][VideoCapture::BufferPool::StopStreaming] VIDIOC_STREAMOFF error. errno:%d ", this, errno);
+        return -1;
+    }
+
+    return 0;
+}
 
 VideoCapture::VideoCapture()
 {
@@ -20,9 +103,10 @@ VideoCapture::VideoCapture()
     m_pVideoCaptureThread = nullptr;
     m_nCameraFd = -1;
     m_pCaptureVideoCallbaclk = nullptr;
-    m_nVideoBuffNum = 0;
-    m_nFrameTime = 0;
-    m_nTimePerFrame = VIDEO_CLOCK_RATE / 25;
+    m_eCaptureMode = CAPTURE_MODE_COPY;
+    m_lLastPTS = 0;
+    m_bUseDriverTimestamp = true;
+    m_pBufferPool = nullptr;
 }
 
 VideoCapture::~VideoCapture()
@@ -78,7 +162,7 @@ std::string VideoCapture::GetDeviceName(std::string& device)
     return deviceName;
 }
 
-std::list<VideoCapture::VideoCaptureCapability*>* VideoCapture::GetDeviceCapabilities(std::string& device)
+std::list<VideoCapture::VideoCaptureCapability*>* VideoCapture::GetDeviceCapabilities(std::string& device, uint32_t width, uint32_t height)
 {
     int fd = open(device.c_str(), O_RDONLY);
     if (fd == -1)
@@ -93,11 +177,26 @@ std::list<VideoCapture::VideoCaptureCapability*>* VideoCapture::GetDeviceCapabil
     video_fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
     video_fmt.fmt.pix.sizeimage = 0;
 
-    unsigned int videoFormats[] = { V4L2_PIX_FMT_MJPEG,V4L2_PIX_FMT_JPEG,V4L2_PIX_FMT_MPEG,V4L2_PIX_FMT_YUV420 };
+    unsigned int videoFormats[] = { V4L2_PIX_FMT_MJPEG,V4L2_PIX_FMT_JPEG,V4L2_PIX_FMT_MPEG,V4L2_PIX_FMT_YUV420,V4L2_PIX_FMT_NV12 };
     int totalFmts = sizeof(videoFormats) / sizeof(unsigned int);
 
-    unsigned int size[][2] = { {1280, 720},{1920, 1080},{2560,1440},{4096,2160} };
+    unsigned int size[][2] = { {1280, 720},{1920, 1080},{2560,1440},{4096,2160},{width,height} };
     int sizes = sizeof(size) / sizeof(unsigned int) / 2;
+    if (width == 0 || height == 0)
+    {
+        sizes--;
+    }
+    else
+    {
+        for (int i = 0; i < sizes - 1; i++)
+        {
+            if (size[i][0] == width && size[i][1] == height)
+            {
+                sizes--;
+                break;
+            }
+        }
+    }
 
     for (int fmts = 0; fmts < totalFmts; fmts++)
     {
@@ -129,11 +228,42 @@ std::list<VideoCapture::VideoCaptureCapability*>* VideoCapture::GetDeviceCapabil
     return result;
 }
 
+const VideoCapture::VideoCaptureCapability* VideoCapture::FindCapability(const std::list<VideoCaptureCapability*>* capabilities,
+    uint32_t videoType, uint32_t width, uint32_t height)
+{
+    if (capabilities == nullptr)
+    {
+        return nullptr;
+    }
+
+    for (auto& capability : *capabilities)
+    {
+        if (capability->m_nVideoType == videoType && capability->m_nWidth == width && capability->m_nHeight == height)
+        {
+            return capability;
+        }
+    }
+
+    return nullptr;
+}
+
 void VideoCapture::SetCaptureVideoCallbaclk(CaptureVideoCallbaclk callbsck)
 {
     m_pCaptureVideoCallbaclk = callbsck;
 }
 
+int32_t VideoCapture::SetCaptureMode(CaptureMode mode)
+{
+    if (m_pVideoCaptureThread != nullptr)
+    {
+        Error("[%p][VideoCapture::SetCaptureMode] can not change capture mode while capturing", this);
+        return -1;
+    }
+
+    m_eCaptureMode = mode;
+    return 0;
+}
+
 int32_t VideoCapture::StartCapture(std::string& device, VideoCaptureCapability capability)
 {
     if (m_pVideoCaptureThread != nullptr)
@@ -160,6 +290,7 @@ int32_t VideoCapture::StartCapture(std::string& device, VideoCaptureCapability c
     if (ioctl(fd, VIDIOC_S_FMT, &video_fmt) < 0)
     {
         Error("[%p][VideoCapture::StartCapture] Set video format Error,return:%d ", this, errno);
+        close(fd);
         return -2;
     }
 
@@ -182,10 +313,6 @@ int32_t VideoCapture::StartCapture(std::string& device, VideoCaptureCapability c
             {
                 Warn("[%p][VideoCapture::StartCapture] Failed to set the framerate. errno=%d", this, errno);
             }
-            else
-            {
-                m_nTimePerFrame = VIDEO_CLOCK_RATE / capability.m_nFPS;
-            }
         }
     }
 
@@ -193,6 +320,7 @@ int32_t VideoCapture::StartCapture(std::string& device, VideoCaptureCapability c
     if (!AllocateVideoBuffers())
     {
         Error("[%p][VideoCapture::StartCapture] Failed to allocate video capture buffers", this);
+        DeAllocateVideoBuffers();
         return -3;
     }
 
@@ -202,6 +330,8 @@ int32_t VideoCapture::StartCapture(std::string& device, VideoCaptureCapability c
     }
     m_pVideoCaptureCapability = new VideoCaptureCapability(&capability);
 
+    m_lLastPTS = 0;
+    m_bUseDriverTimestamp = true;
     m_bStopCaptureVideo = false;
     m_pVideoCaptureThread = new std::thread(&VideoCapture::VideoCaptureThread, this);
 
@@ -227,12 +357,6 @@ int32_t VideoCapture::StopCapture()
         m_pVideoCaptureCapability = nullptr;
     }
 
-    if (m_nCameraFd != -1)
-    {
-        close(m_nCameraFd);
-        m_nCameraFd = -1;
-    }
-
     DeAllocateVideoBuffers();
 
     return 0;
@@ -245,8 +369,6 @@ void VideoCapture::VideoCaptureThread()
     if (m_pCaptureVideoCallbaclk == nullptr)
     {
         Error("[%p][VideoCapture::VideoCaptureProc] vioed callback is null,can not output frame", this);
-        close(m_nCameraFd);
-        m_nCameraFd = -1;
         return;
     }
 
@@ -258,6 +380,10 @@ void VideoCapture::VideoCaptureThread()
         Error("[%p][VideoCapture::VideoCaptureProc] Failed to turn on stream  error:%s", this, strerror(errno));
         return;
     }
+    {
+        std::lock_guard<std::mutex> lock(m_pBufferPool->m_PoolLock);
+        m_pBufferPool->m_bStreaming = true;
+    }
     Trace("[%p][VideoCapture::VideoCaptureThread] ioctl VIDIOC_STREAMON VIDEO_CAPTURE finish", this);
 
     struct v4l2_buffer buf;
@@ -285,41 +411,91 @@ void VideoCapture::VideoCaptureThread()
         frame->m_nWidth = m_pVideoCaptureCapability->m_nWidth;
         frame->m_nHeight = m_pVideoCaptureCapability->m_nHeight;
         frame->m_nFrameType = m_pVideoCaptureCapability->m_nVideoType;
-        frame->m_pData = (unsigned char*)malloc(buf.bytesused);
-        if (frame->m_pData != nullptr)
+        frame->m_lPTS = GetFrameTime(buf);
+
+        Buffer& buffer = m_pBufferPool->m_pBuffers[buf.index];
+        if (m_eCaptureMode == CAPTURE_MODE_COPY)
+        {
+            //sized by the driver buffer,not bytesused,so a compressed format does not open a free list per frame size
+            frame->m_pBufferRef = FramePool::GetFramePool()->GetBuffer((uint32_t)buffer.length);
+            frame->m_pData = (unsigned char*)frame->m_pBufferRef.get();
+            if (frame->m_pData != nullptr)
+            {
+                frame->m_nLength = buf.bytesused;
+                memcpy(frame->m_pData, buffer.start, buf.bytesused);
+            }
+            m_pBufferPool->Requeue(buf.index);
+        }
+        else
         {
+            std::shared_ptr<BufferPool> pool = m_pBufferPool;
+            uint32_t index = buf.index;
+            {
+                std::lock_guard<std::mutex> lock(pool->m_PoolLock);
+                pool->m_nLeasedNum++;
+                if (pool->m_nLeasedNum == pool->m_nBufferNum)
+                {
+                    Warn("[%p][VideoCapture::VideoCaptureProc] all %u capture buffers are held by consumers", this, pool->m_nBufferNum);
+                }
+            }
+            frame->m_pData = (unsigned char*)buffer.start;
             frame->m_nLength = buf.bytesused;
-            memcpy(frame->m_pData, m_pBuffers[buf.index].start, buf.bytesused);
+            frame->m_nDmaBufFd = buffer.dmaBufFd;
+            frame->m_pBufferRef = std::shared_ptr<void>(buffer.start, [pool, index](void*) { pool->Requeue(index); });
         }
-        frame->m_lPTS = m_nFrameTime;
-        m_nFrameTime += m_nTimePerFrame;
 
         m_pCaptureVideoCallbaclk(frame);
         frame = nullptr;
+    }
 
-        if (ioctl(m_nCameraFd, VIDIOC_QBUF, &buf) == -1)
+exit:
+    Trace("[%p][VideoCapture::VideoCaptureThread] exit VideoCaptureThread", this);
+
+    return;
+}
+
+uint64_t VideoCapture::GetFrameTime(const struct v4l2_buffer& buf)
+{
+    uint64_t time = 0;
+    if (m_bUseDriverTimestamp)
+    {
+        if ((buf.flags & V4L2_BUF_FLAG_TIMESTAMP_MASK) == V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC &&
+            (buf.timestamp.tv_sec != 0 || buf.timestamp.tv_usec != 0))
         {
-            Warn("[%p][VideoCapture::VideoCaptureProc] Failed to enqueue capture buffer", this);
+            time = TimeCounter::MicrosecondsToMediaTime((uint64_t)buf.timestamp.tv_sec * 1000000 + buf.timestamp.tv_usec);
+        }
+        else
+        {
+            Warn("[%p][VideoCapture::GetFrameTime] driver timestamp is not monotonic,flags:0x%x,use dequeue time", this, buf.flags);
+            m_bUseDriverTimestamp = false;
         }
     }
 
-exit:
-    close(m_nCameraFd);
-    m_nCameraFd = -1;
+    if (!m_bUseDriverTimestamp)
+    {
+        time = TimeCounter::GetMediaTime();
+    }
 
-    Trace("[%p][VideoCapture::VideoCaptureThread] exit VideoCaptureThread", this);
+    if (m_lLastPTS != 0 && time <= m_lLastPTS)
+    {
+        time = m_lLastPTS + 1;
+    }
+    m_lLastPTS = time;
 
-    return;
+    return time;
 }
 
 bool VideoCapture::AllocateVideoBuffers()
 {
+    m_pBufferPool = std::make_shared<BufferPool>(m_nCameraFd);
+
+    uint32_t buffNum = (m_eCaptureMode == CAPTURE_MODE_COPY) ? VIDEO_CAPTURN_BUFF : VIDEO_LEASE_CAPTURN_BUFF;
     struct v4l2_requestbuffers rbuffer;
     memset(&rbuffer, 0, sizeof(v4l2_requestbuffers));
 
     rbuffer.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
     rbuffer.memory = V4L2_MEMORY_MMAP;
-    rbuffer.count = VIDEO_CAPTURN_BUFF;
+    rbuffer.count = buffNum;
 
     if (ioctl(m_nCameraFd, VIDIOC_REQBUFS, &rbuffer) < 0)
     {
@@ -327,13 +503,20 @@ bool VideoCapture::AllocateVideoBuffers()
         return false;
     }
 
-    if (rbuffer.count > VIDEO_CAPTURN_BUFF)
+    if (rbuffer.count > buffNum)
+    {
+        rbuffer.count = buffNum;
+    }
+
+    Buffer* pBuffers = new Buffer[rbuffer.count];
+    for (unsigned int i = 0; i < rbuffer.count; i++)
     {
-        rbuffer.count = VIDEO_CAPTURN_BUFF;
+        pBuffers[i].start = MAP_FAILED;
+        pBuffers[i].length = 0;
+        pBuffers[i].dmaBufFd = -1;
     }
-    m_nVideoBuffNum = rbuffer.count;
+    m_pBufferPool->m_pBuffers = pBuffers;
 
-    m_pBuffers = new Buffer[rbuffer.count];
     for (unsigned int i = 0; i < rbuffer.count; i++)
     {
         struct v4l2_buffer buffer;
@@ -348,22 +531,35 @@ bool VideoCapture::AllocateVideoBuffers()
             return false;
         }
 
-        m_pBuffers[i].start = mmap(NULL, buffer.length, PROT_READ | PROT_WRITE, MAP_SHARED, m_nCameraFd, buffer.m.offset);
-
-        if (MAP_FAILED == m_pBuffers[i].start)
+        pBuffers[i].start = mmap(NULL, buffer.length, PROT_READ | PROT_WRITE, MAP_SHARED, m_nCameraFd, buffer.m.offset);
+        if (MAP_FAILED == pBuffers[i].start)
         {
-            for (unsigned int j = 0; j < i; j++)
-            {
-                munmap(m_pBuffers[j].start, m_pBuffers[j].length);
-            }
             Error("[%p][VideoCapture::AllocateVideoBuffers] mmap fail", this);
             return false;
         }
+        pBuffers[i].length = buffer.length;
+        m_pBufferPool->m_nBufferNum = i + 1;
 
-        m_pBuffers[i].length = buffer.length;
+        if (m_eCaptureMode == CAPTURE_MODE_DMABUF)
+        {
+            struct v4l2_exportbuffer expbuf;
+            memset(&expbuf, 0, sizeof(v4l2_exportbuffer));
+            expbuf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+            expbuf.index = i;
+            expbuf.flags = O_CLOEXEC | O_RDONLY;
+            if (ioctl(m_nCameraFd, VIDIOC_EXPBUF, &expbuf) < 0)
+            {
+                Warn("[%p][VideoCapture::AllocateVideoBuffers] VIDIOC_EXPBUF fail,use mmap only. errno:%d", this, errno);
+            }
+            else
+            {
+                pBuffers[i].dmaBufFd = expbuf.fd;
+            }
+        }
 
         if (ioctl(m_nCameraFd, VIDIOC_QBUF, &buffer) < 0)
         {
+            Error("[%p][VideoCapture::AllocateVideoBuffers] VIDIOC_QBUF fail. errno:%d", this, errno);
             return false;
         }
     }
@@ -373,25 +569,27 @@ bool VideoCapture::AllocateVideoBuffers()
 
 bool VideoCapture::DeAllocateVideoBuffers()
 {
-    if (m_pBuffers == nullptr)
+    if (m_pBufferPool == nullptr)
     {
+        if (m_nCameraFd != -1)
+        {
+            close(m_nCameraFd);
+            m_nCameraFd = -1;
+        }
         return true;
     }
 
-    for (uint32_t i = 0; i < m_nVideoBuffNum; i++)
+    m_pBufferPool->StopStreaming();
     {
-        munmap(m_pBuffers[i].start, m_pBuffers[i].length);
+        std::lock_guard<std::mutex> lock(m_pBufferPool->m_PoolLock);
+        if (m_pBufferPool->m_nLeasedNum > 0)
+        {
+            Trace("[%p][VideoCapture::DeAllocateVideoBuffers] %u buffers still leased,release when consumers drop them", this, m_pBufferPool->m_nLeasedNum);
+        }
     }
 
-    delete[] m_pBuffers;
-    m_pBuffers = nullptr;
-
-    enum v4l2_buf_type type;
-    type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    if (ioctl(m_nCameraFd, VIDIOC_STREAMOFF, &type) < 0)
-    {
-        Error("[%p][VideoCapture::DeAllocateVideoBuffers] VIDIOC_STREAMOFF error. errno:%d ", this, errno);
-    }
+    m_pBufferPool = nullptr;
+    m_nCameraFd = -1;
 
     return true;
 }
\ No newline at end of file
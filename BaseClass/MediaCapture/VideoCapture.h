@@ -2,9 +2,12 @@
 #include <list>
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <thread>
 #include "Common.h"
 
+struct v4l2_buffer;
+
 class VideoCapture
 {
 public:
@@ -13,6 +16,12 @@ public:
 
 public:
     typedef std::function<void(std::shared_ptr<VideoFrame>&)> CaptureVideoCallbaclk;
+    typedef enum CaptureMode
+    {
+        CAPTURE_MODE_COPY = 0,
+        CAPTURE_MODE_MMAP,
+        CAPTURE_MODE_DMABUF
+    }CaptureMode;
     typedef struct VideoCaptureCapability
     {
         uint32_t m_nWidth;
@@ -45,31 +54,53 @@ public:
 
     static void ListDevices(std::list<std::string>& devicesList);
     static std::string GetDeviceName(std::string& device);
-    static std::list<VideoCaptureCapability*>* GetDeviceCapabilities(std::string& device);
+    static std::list<VideoCaptureCapability*>* GetDeviceCapabilities(std::string& device, uint32_t width = 0, uint32_t height = 0);
+    static const VideoCaptureCapability* FindCapability(const std::list<VideoCaptureCapability*>* capabilities, uint32_t videoType, uint32_t width, uint32_t height);
 
     void SetCaptureVideoCallbaclk(CaptureVideoCallbaclk callbsck);
+    int32_t SetCaptureMode(CaptureMode mode);
+    inline CaptureMode GetCaptureMode() { return m_eCaptureMode; };
     int32_t StartCapture(std::string& device, VideoCaptureCapability capability);
     int32_t StopCapture();
 
 private:
     void VideoCaptureThread();
+    uint64_t GetFrameTime(const struct v4l2_buffer& buf);
     bool AllocateVideoBuffers();
     bool DeAllocateVideoBuffers();
 
 private:
-    VideoCaptureCapability* m_pVideoCaptureCapability;
-    bool m_bStopCaptureVideo;
-    std::thread* m_pVideoCaptureThread;
-    int m_nCameraFd;
-    CaptureVideoCallbaclk m_pCaptureVideoCallbaclk;
-    uint32_t m_nVideoBuffNum;
-    uint64_t m_nFrameTime;
-    uint64_t m_nTimePerFrame;
-
     typedef struct Buffer
     {
         void* start;
         size_t length;
+        int dmaBufFd;
     }Buffer;
-    Buffer* m_pBuffers;
+
+    //Owns the camera fd and the mmap'd buffers, frames handed out in
+    //CAPTURE_MODE_MMAP/CAPTURE_MODE_DMABUF keep it alive until they are released
+    typedef struct BufferPool
+    {
+        int m_nCameraFd;
+        Buffer* m_pBuffers;
+        uint32_t m_nBufferNum;
+        uint32_t m_nLeasedNum;
+        bool m_bStreaming;
+        std::mutex m_PoolLock;
+
+        BufferPool(int fd);
+        ~BufferPool();
+        int32_t Requeue(uint32_t index);
+        int32_t StopStreaming();
+    }BufferPool;
+
+    VideoCaptureCapability* m_pVideoCaptureCapability;
+    bool m_bStopCaptureVideo;
+    std::thread* m_pVideoCaptureThread;
+    int m_nCameraFd;
+    CaptureVideoCallbaclk m_pCaptureVideoCallbaclk;
+    CaptureMode m_eCaptureMode;
+    uint64_t m_lLastPTS;
+    bool m_bUseDriverTimestamp;
+    std::shared_ptr<BufferPool> m_pBufferPool;
 };
\ No newline at end of file
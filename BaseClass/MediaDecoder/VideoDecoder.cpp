@@ -1,3 +1,4 @@
+#include <cstring>
 #include "VideoDecoder.h"
 #include "Log/Log.h"
 
@@ -14,6 +15,7 @@ VideoDecoder::VideoDecoder()
     m_pPacket = nullptr;
     m_bEnableLowDlay = false;
     m_pVideoFrameCallbaclk = nullptr;
+    m_bWritableFrame = false;
     m_pResampleFrame = nullptr;
     m_pResampleContext = nullptr;
     m_nResampleWidth = 0;
@@ -79,28 +81,18 @@ int32_t VideoDecoder::AddVideoStream(const VideoInfo& info)
             Warn("[%p][VideoDecoder::AddVideoStream] The decoder has already added stream,old decoder will be destroyed", this);
         }
 
-        m_pAVCodec =
+        const AVCodec* pHWCodec =
             info.m_nCodecID == AV_CODEC_ID_H264 ? avcodec_find_decoder_by_name("h264_v4l2m2m") :
-            info.m_nCodecID == AV_CODEC_ID_H265 ? avcodec_find_decoder_by_name("h265_v4l2m2m") : nullptr;
-        if (m_pAVCodec == nullptr)
-        {
-            m_pAVCodec = avcodec_find_decoder((AVCodecID)info.m_nCodecID);
-        }
-        if (m_pAVCodec == nullptr)
+            info.m_nCodecID == AV_CODEC_ID_H265 ? avcodec_find_decoder_by_name("h265_v4l2m2m") :
+            info.m_nCodecID == AV_CODEC_ID_MJPEG ? avcodec_find_decoder_by_name("mjpeg_v4l2m2m") : nullptr;
+        const AVCodec* pSWCodec = avcodec_find_decoder((AVCodecID)info.m_nCodecID);
+        if (pHWCodec == nullptr && pSWCodec == nullptr)
         {
             DestroyDecoder();
             Error("[%p][VideoDecoder::AddVideoStream] Can not find decoder.AVCodecID:%d", this, info.m_nCodecID);
             return -1;
         }
 
-        m_pAVContext = avcodec_alloc_context3(m_pAVCodec);
-        if (m_pAVContext == nullptr)
-        {
-            DestroyDecoder();
-            Error("[%p][VideoDecoder::AddVideoStream] Alloc AVCodecContext fail", this);
-            return -2;
-        }
-
         if ((AVCodecID)info.m_nCodecID == AV_CODEC_ID_H264 || (AVCodecID)info.m_nCodecID == AV_CODEC_ID_HEVC)
         {
             m_pAVParserContext = av_parser_init((AVCodecID)info.m_nCodecID);
@@ -110,47 +102,30 @@ int32_t VideoDecoder::AddVideoStream(const VideoInfo& info)
             }
         }
 
-        m_pAVContext->thread_count = std::max(1, std::min(av_cpu_count(), MAX_CPU_COUNT));
         if (m_bEnableLowDlay)
         {
             m_pAVParserContext->flags |= AV_CODEC_FLAG_LOW_DELAY;
         }
 
-        m_pAVContext->codec_type = AVMEDIA_TYPE_VIDEO;
-        m_pAVContext->pix_fmt = AV_PIX_FMT_YUVJ420P;
-        m_pAVContext->width = info.m_nWidth;
-        m_pAVContext->height = info.m_nHight;
-        m_pAVContext->coded_width = info.m_nWidth;
-        m_pAVContext->coded_height = info.m_nHight;
-
-        if (info.m_pExtraData != nullptr && info.m_uiExtraDataLen > 0)
+        int ret = -1;
+        if (pHWCodec != nullptr)
         {
-            uint8_t* extra = (uint8_t*)av_malloc(info.m_uiExtraDataLen);
-            if (extra != nullptr)
-            {
-                memcpy(extra, info.m_pExtraData, info.m_uiExtraDataLen);
-                m_pAVContext->extradata = extra;
-                m_pAVContext->extradata_size = info.m_uiExtraDataLen;
-            }
-            else
+            ret = OpenCodec(pHWCodec, info);
+            if (ret < 0)
             {
-                Error("[%p][VideoDecoder::AddVideoStream] Malloc extra data fail", this);
+                Warn("[%p][VideoDecoder::AddVideoStream] Open decoder:%s fail,return:%d,fall back to software", this, pHWCodec->name, ret);
             }
         }
-        else
+        if (ret < 0 && pSWCodec != nullptr)
         {
-            Trace("[%p][VideoDecoder::AddVideoStream] No extra data", this);
+            ret = OpenCodec(pSWCodec, info);
         }
-
-        int ret = avcodec_open2(m_pAVContext, m_pAVCodec, nullptr);
         if (ret < 0)
         {
-            char msg[128] = { 0 };
-            av_strerror(ret, msg, sizeof(msg));
-            Error("[%p][VideoDecoder::AddVideoStream] Open decoder fail,err:%s", this, msg);
             DestroyDecoder();
             return -3;
         }
+        Trace("[%p][VideoDecoder::AddVideoStream] Open decoder:%s", this, m_pAVCodec->name);
 
         if (m_pFrame == nullptr)
         {
@@ -185,6 +160,74 @@ int32_t VideoDecoder::AddVideoStream(const VideoInfo& info)
     return 0;
 }
 
+int32_t VideoDecoder::OpenCodec(const AVCodec* codec, const VideoInfo& info)
+{
+    m_pAVCodec = codec;
+    m_pAVContext = avcodec_alloc_context3(m_pAVCodec);
+    if (m_pAVContext == nullptr)
+    {
+        Error("[%p][VideoDecoder::OpenCodec] Alloc AVCodecContext fail", this);
+        return -1;
+    }
+
+    m_pAVContext->thread_count = std::max(1, std::min(av_cpu_count(), MAX_CPU_COUNT));
+    m_pAVContext->codec_type = AVMEDIA_TYPE_VIDEO;
+    m_pAVContext->pix_fmt = AV_PIX_FMT_YUVJ420P;
+    m_pAVContext->width = info.m_nWidth;
+    m_pAVContext->height = info.m_nHight;
+    m_pAVContext->coded_width = info.m_nWidth;
+    m_pAVContext->coded_height = info.m_nHight;
+
+    if (info.m_pExtraData != nullptr && info.m_uiExtraDataLen > 0)
+    {
+        uint8_t* extra = (uint8_t*)av_mallocz(info.m_uiExtraDataLen + AV_INPUT_BUFFER_PADDING_SIZE);
+        if (extra != nullptr)
+        {
+            memcpy(extra, info.m_pExtraData, info.m_uiExtraDataLen);
+            m_pAVContext->extradata = extra;
+            m_pAVContext->extradata_size = info.m_uiExtraDataLen;
+        }
+        else
+        {
+            Error("[%p][VideoDecoder::OpenCodec] Malloc extra data fail", this);
+        }
+    }
+    else
+    {
+        Trace("[%p][VideoDecoder::OpenCodec] No extra data", this);
+    }
+
+    int ret = avcodec_open2(m_pAVContext, m_pAVCodec, nullptr);
+    if (ret < 0)
+    {
+        char msg[128] = { 0 };
+        av_strerror(ret, msg, sizeof(msg));
+        Error("[%p][VideoDecoder::OpenCodec] Open decoder:%s fail,err:%s", this, m_pAVCodec->name, msg);
+        avcodec_free_context(&m_pAVContext);
+        m_pAVCodec = nullptr;
+        return -2;
+    }
+
+    return 0;
+}
+
+const char* VideoDecoder::GetDecoderName()
+{
+    std::lock_guard<std::mutex> lock(m_DecoderLock);
+    return m_pAVCodec != nullptr ? m_pAVCodec->name : "";
+}
+
+bool VideoDecoder::IsHardwareDecoder()
+{
+    std::lock_guard<std::mutex> lock(m_DecoderLock);
+    return m_pAVCodec != nullptr && strstr(m_pAVCodec->name, "_v4l2m2m") != nullptr;
+}
+
+void VideoDecoder::SetWritableFrame(bool writable)
+{
+    m_bWritableFrame = writable;
+}
+
 int32_t VideoDecoder::SetVideoFrameCallBack(VideoFrameCallbaclk callback)
 {
     {
@@ -309,26 +352,35 @@ int32_t VideoDecoder::OutputVideoFrame(const AVFrame* pFrame)
         return -3;
     }
 
-    std::shared_ptr<VideoFrame> pVideoFrame = std::make_shared<VideoFrame>();
-    pVideoFrame->m_pData = (uint8_t*)malloc(pYuv420Frame->width * pYuv420Frame->height * 3 / 2);
-    if (pVideoFrame->m_pData == nullptr)
+    //the decoder keeps referenced pictures in its DPB,drawing on them would smear into the frames predicted
+    //from them,so a frame to draw on is copied
+    AVFrame* pOutFrame = av_frame_alloc();
+    if (pOutFrame == nullptr || av_frame_ref(pOutFrame, pYuv420Frame) != 0)
     {
-        Error("[%p][VideoDecoder::OutputVideoFrame] malloc data faill", this);
+        Error("[%p][VideoDecoder::OutputVideoFrame] ref frame faill", this);
+        av_frame_free(&pOutFrame);
         return -4;
     }
+    else if (m_bWritableFrame && av_frame_make_writable(pOutFrame) != 0)
+    {
+        Error("[%p][VideoDecoder::OutputVideoFrame] make frame writable faill", this);
+        av_frame_free(&pOutFrame);
+        return -5;
+    }
     else
     {
-        pVideoFrame->m_nWidth = pYuv420Frame->width;
-        pVideoFrame->m_nHeight = pYuv420Frame->height;
-
-        memcpy(pVideoFrame->m_pData, pYuv420Frame->data[0], pYuv420Frame->width * pYuv420Frame->height);
-        int uoffset = pYuv420Frame->width * pYuv420Frame->height;
-        memcpy(pVideoFrame->m_pData + uoffset, pYuv420Frame->data[1], pYuv420Frame->width * pYuv420Frame->height / 4);
-        int voffset = pYuv420Frame->width * pYuv420Frame->height * 5 / 4;
-        memcpy(pVideoFrame->m_pData + voffset, pYuv420Frame->data[2], pYuv420Frame->width * pYuv420Frame->height / 4);
-
-        pVideoFrame->m_nLength = pYuv420Frame->width * pYuv420Frame->height * 3 / 2;
-        pVideoFrame->m_nFrameType = pYuv420Frame->format;
+        std::shared_ptr<VideoFrame> pVideoFrame = std::make_shared<VideoFrame>();
+        pVideoFrame->m_pBufferRef = std::shared_ptr<void>(pOutFrame, [](void* p) { AVFrame* frame = (AVFrame*)p; av_frame_free(&frame); });
+        pVideoFrame->m_nWidth = pOutFrame->width;
+        pVideoFrame->m_nHeight = pOutFrame->height;
+        for (int i = 0; i < 3; i++)
+        {
+            pVideoFrame->m_pPlane[i] = pOutFrame->data[i];
+            pVideoFrame->m_nLineSize[i] = pOutFrame->linesize[i];
+        }
+        pVideoFrame->m_pData = pOutFrame->data[0];
+        pVideoFrame->m_nLength = pOutFrame->linesize[0] * pOutFrame->height + (pOutFrame->linesize[1] + pOutFrame->linesize[2]) * (pOutFrame->height / 2);
+        pVideoFrame->m_nFrameType = pOutFrame->format;
         pVideoFrame->m_lPTS = pFrame->pts;
 
         m_pVideoFrameCallbaclk(pVideoFrame);
@@ -402,7 +454,14 @@ int32_t VideoDecoder::Resample(const AVFrame* pFrame)
         m_eResampFormat = (AVPixelFormat)pFrame->format;
     }
 
-    int ret = sws_scale(m_pResampleContext, (uint8_t const**)pFrame->data, pFrame->linesize, 0, m_pResampleFrame->height,
+    int ret = av_frame_make_writable(m_pResampleFrame);
+    if (ret < 0)
+    {
+        Error("[%p][VideoDecoder::Resample] av_frame_make_writable fail,return:%d", this, ret);
+        return -5;
+    }
+
+    ret = sws_scale(m_pResampleContext, (uint8_t const**)pFrame->data, pFrame->linesize, 0, m_pResampleFrame->height,
         m_pResampleFrame->data, m_pResampleFrame->linesize);
     if (ret < 0)
     {
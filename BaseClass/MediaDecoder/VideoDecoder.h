@@ -7,6 +7,7 @@ extern "C" {
 #include "libswscale/swscale.h"
 }
 
+#include <atomic>
 #include <functional>
 #include <memory>
 #include <mutex>
@@ -24,9 +25,13 @@ public:
     int32_t SetVideoFrameCallBack(VideoFrameCallbaclk callback);
     int32_t RecvVideoPacket(std::shared_ptr<VideoPacket>& packet);
     int32_t FlushDecoder();
+    const char* GetDecoderName();
+    bool IsHardwareDecoder();
+    void SetWritableFrame(bool writable);       //frames handed out get buffers of their own,for drawing on
 
 private:
     int32_t DestroyDecoder();
+    int32_t OpenCodec(const AVCodec* codec, const VideoInfo& info);
     int32_t DecodePacket(const AVPacket* pPacket);
     int32_t OutputVideoFrame(const AVFrame* pFrame);
     int32_t Resample(const AVFrame* pFrame);
@@ -43,6 +48,7 @@ private:
 
     bool m_bEnableLowDlay;
     VideoFrameCallbaclk m_pVideoFrameCallbaclk;
+    std::atomic<bool> m_bWritableFrame;
 
     AVFrame* m_pResampleFrame;
     SwsContext*  m_pResampleContext;
@@ -1,5 +1,31 @@
+#include <errno.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/videodev2.h>
 #include "VideoEncoder.h"
 #include "Log/Log.h"
+#include "CommonTools/TimeCounter.h"
+#include "CommonTools/FramePool.h"
+
+static void ListOpenFds(std::set<int32_t>& fds)
+{
+    DIR* dir = opendir("/proc/self/fd");
+    if (dir == nullptr)
+    {
+        return;
+    }
+
+    struct dirent* entry = nullptr;
+    while ((entry = readdir(dir)) != nullptr)
+    {
+        if (entry->d_name[0] >= '0' && entry->d_name[0] <= '9')
+        {
+            fds.insert(atoi(entry->d_name));
+        }
+    }
+    closedir(dir);
+}
 
 
 VideoEncoder::VideoEncoder() :
@@ -13,8 +39,14 @@ VideoEncoder::VideoEncoder() :
     m_pVideoPacketCallback = nullptr;
     m_nResampleSrcWidth = 0;
     m_nResampleSrcHight = 0;
+    m_eResampleSrcFormat = AV_PIX_FMT_NONE;
     m_pResampleContext = nullptr;
-    m_pResampleFrame = nullptr;
+    m_nControlFd = -1;
+    m_bMultiPlane = false;
+    m_bForceKeyFrame = false;
+    m_nGOP = 0;
+    m_nPeakBitRate = 0;
+    m_nFramesSinceKey = 0;
 }
 
 VideoEncoder::~VideoEncoder()
@@ -46,12 +78,15 @@ int32_t VideoEncoder::ReleaseAll()
         sws_freeContext(m_pResampleContext);
         m_pResampleContext = nullptr;
     }
-    if (m_pResampleFrame != nullptr)
-    {
-        av_frame_free(&m_pResampleFrame);
-    }
     m_nResampleSrcWidth = 0;
     m_nResampleSrcHight = 0;
+    m_eResampleSrcFormat = AV_PIX_FMT_NONE;
+    m_nControlFd = -1;
+    m_bMultiPlane = false;
+    m_bForceKeyFrame = false;
+    m_nGOP = 0;
+    m_nPeakBitRate = 0;
+    m_nFramesSinceKey = 0;
 
     return 0;
 }
@@ -97,16 +132,26 @@ int32_t VideoEncoder::OpenEncoder(const EncodParam& param)
         {
             m_pAVContext->codec_id = (AVCodecID)param.m_nCodecID;
             m_pAVContext->codec_type = AVMEDIA_TYPE_VIDEO;
-            m_pAVContext->pix_fmt = AV_PIX_FMT_YUV420P;
+            m_pAVContext->pix_fmt = (AVPixelFormat)param.m_nPixelFormat;
             m_pAVContext->width = param.m_nWidth;
             m_pAVContext->height = param.m_nHeight;
             m_pAVContext->time_base.num = 1;
-            m_pAVContext->time_base.den = 25;
+            m_pAVContext->time_base.den = MEDIA_CLOCK_RATE;
+            m_pAVContext->framerate.num = param.m_nFPS;
+            m_pAVContext->framerate.den = 1;
             m_pAVContext->bit_rate = param.m_nBitRate;
-            m_pAVContext->gop_size = 50;
-            m_pAVContext->qmin = 10;
-            m_pAVContext->qmax = 51;
+            m_pAVContext->gop_size = param.m_nGOP;
+            m_pAVContext->qmin = param.m_nQMin;
+            m_pAVContext->qmax = param.m_nQMax;
             m_pAVContext->max_b_frames = 0;
+            if (param.m_eRateControl == RATE_CONTROL_CBR)
+            {
+                m_pAVContext->rc_max_rate = param.m_nBitRate;
+            }
+            else if (param.m_nPeakBitRate > 0)
+            {
+                m_pAVContext->rc_max_rate = param.m_nPeakBitRate;
+            }
         }
         else if (param.m_nCodecID == AV_CODEC_ID_MJPEG)
         {
@@ -114,18 +159,22 @@ int32_t VideoEncoder::OpenEncoder(const EncodParam& param)
             m_pAVContext->codec_id = (AVCodecID)param.m_nCodecID;
             m_pAVContext->width = param.m_nWidth;;
             m_pAVContext->height = param.m_nHeight;
-            m_pAVContext->time_base = (AVRational){ 1, 15 };
+            m_pAVContext->time_base = (AVRational){ 1, MEDIA_CLOCK_RATE };
+            m_pAVContext->framerate = (AVRational){ (int)param.m_nFPS, 1 };
             m_pAVContext->pix_fmt = AV_PIX_FMT_YUVJ420P;
         }
 
-        AVDictionary* param = 0;
+        AVDictionary* opts = 0;
         if (m_pAVContext->codec_id == AV_CODEC_ID_H264)
         {
-            av_dict_set(&param, "preset", "slow", 0);
-            av_dict_set(&param, "tune", "zerolatency", 0);
+            av_dict_set(&opts, "preset", "slow", 0);
+            av_dict_set(&opts, "tune", "zerolatency", 0);
         }
+        av_dict_free(&opts);
         m_pAVContext->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
 
+        std::set<int32_t> oldFds;
+        ListOpenFds(oldFds);
         if (avcodec_open2(m_pAVContext, m_pAVCodec, nullptr) < 0)
         {
             ReleaseAll();
@@ -133,6 +182,19 @@ int32_t VideoEncoder::OpenEncoder(const EncodParam& param)
             return -4;
         }
 
+        m_nGOP = param.m_nCodecID == AV_CODEC_ID_H264 ? param.m_nGOP : 0;
+        m_nPeakBitRate = param.m_nPeakBitRate;
+        if (param.m_nCodecID == AV_CODEC_ID_H264 && FindControlFd(oldFds) == 0)
+        {
+            //controls must be set before the first frame starts streaming
+            ApplyRateControl(param.m_eRateControl, param.m_nPeakBitRate);
+            if (SetEncoderControl(V4L2_CID_MPEG_VIDEO_H264_I_PERIOD, param.m_nGOP, "i period") == 0)
+            {
+                m_nGOP = 0;
+            }
+        }
+        m_nFramesSinceKey = 0;
+
         if (m_pFrame == nullptr)
         {
             m_pFrame = av_frame_alloc();
@@ -194,117 +256,96 @@ int32_t VideoEncoder::ResampleIfNeed(std::shared_ptr<VideoFrame>& pVideoPacket)
         return 0;
     }
 
-    if (m_nResampleSrcWidth != pVideoPacket->m_nWidth || m_nResampleSrcHight != pVideoPacket->m_nHeight)
+    bool bNV12 = pVideoPacket->m_nFrameType == AV_PIX_FMT_NV12;
+    AVPixelFormat format = bNV12 ? AV_PIX_FMT_NV12 : AV_PIX_FMT_YUVJ420P;
+    if (m_nResampleSrcWidth != pVideoPacket->m_nWidth || m_nResampleSrcHight != pVideoPacket->m_nHeight || m_eResampleSrcFormat != format)
     {
         if (m_pResampleContext != nullptr)
         {
             sws_freeContext(m_pResampleContext);
             m_pResampleContext = nullptr;
         }
-        if (m_pResampleFrame != nullptr)
-        {
-            av_frame_free(&m_pResampleFrame);
-        }
-    }
-
-    if (m_pResampleFrame == nullptr)
-    {
-        m_pResampleFrame = av_frame_alloc();
-        if (m_pResampleFrame == nullptr)
-        {
-            Error("[%p][VideoEncoder::Resample] Alloc frame fail", this);
-            return -1;
-        }
-        m_pResampleFrame->width = m_pVideoInfo->m_nWidth;
-        m_pResampleFrame->height = m_pVideoInfo->m_nHight;
-        m_pResampleFrame->format = AV_PIX_FMT_YUVJ420P;
-        int ret = av_frame_get_buffer(m_pResampleFrame, 32);
-        if (ret != 0)
-        {
-            Error("[%p][VideoEncoder::Resample] av_frame_get_buffer  fail,return:%d", this, ret);
-            av_frame_free(&m_pResampleFrame);
-            return -2;
-        }
     }
 
     if (m_pResampleContext == nullptr)
     {
         m_nResampleSrcWidth = pVideoPacket->m_nWidth;
         m_nResampleSrcHight = pVideoPacket->m_nHeight;
-        m_pResampleContext = sws_getContext(m_nResampleSrcWidth, m_nResampleSrcHight, (AVPixelFormat)AV_PIX_FMT_YUVJ420P,
-            m_pVideoInfo->m_nWidth, m_pVideoInfo->m_nHight, AV_PIX_FMT_YUVJ420P, SWS_FAST_BILINEAR, nullptr, nullptr, nullptr);
+        m_eResampleSrcFormat = format;
+        m_pResampleContext = sws_getContext(m_nResampleSrcWidth, m_nResampleSrcHight, format,
+            m_pVideoInfo->m_nWidth, m_pVideoInfo->m_nHight, format, SWS_FAST_BILINEAR, nullptr, nullptr, nullptr);
         if (m_pResampleContext == nullptr)
         {
             Error("[%p][VideoEncoder::Resample] sws_getContext fail,width:%d height:%d format:%d",
-                this, m_nResampleSrcWidth, m_nResampleSrcHight, AV_PIX_FMT_YUVJ420P);
+                this, m_nResampleSrcWidth, m_nResampleSrcHight, format);
             m_nResampleSrcWidth = 0;
             m_nResampleSrcHight = 0;
+            m_eResampleSrcFormat = AV_PIX_FMT_NONE;
             return -3;
         }
     }
 
-    uint8_t* data[AV_NUM_DATA_POINTERS] = { 0,0,0,0,0,0,0,0 };
-    int linesize[AV_NUM_DATA_POINTERS] = { 0,0,0,0,0,0,0,0 };
-    data[0] = pVideoPacket->m_pData;
-    data[1] = data[0] + (pVideoPacket->m_nWidth * pVideoPacket->m_nHeight);
-    data[2] = data[1] + (pVideoPacket->m_nWidth * pVideoPacket->m_nHeight / 4);
-    linesize[0] = pVideoPacket->m_nWidth;
-    linesize[1] = pVideoPacket->m_nWidth / 2;
-    linesize[2] = pVideoPacket->m_nWidth / 2;
-    int ret = sws_scale(m_pResampleContext, (uint8_t const**)data, linesize, 0, pVideoPacket->m_nHeight,
-        m_pResampleFrame->data, m_pResampleFrame->linesize);
-    if (ret < 0)
+    std::shared_ptr<VideoFrame> pResampleFrame = std::make_shared<VideoFrame>();
+    pResampleFrame->m_nWidth = m_pVideoInfo->m_nWidth;
+    pResampleFrame->m_nHeight = m_pVideoInfo->m_nHight;
+    pResampleFrame->m_nLength = pResampleFrame->m_nWidth * pResampleFrame->m_nHeight * 3 / 2;
+    pResampleFrame->m_pBufferRef = FramePool::GetFramePool()->GetBuffer(pResampleFrame->m_nLength);
+    pResampleFrame->m_pData = (uint8_t*)pResampleFrame->m_pBufferRef.get();
+    if (pResampleFrame->m_pData == nullptr)
     {
-        Error("[%p][VideoEncoder::Resample] sws_scale fail,return:%d", ret);
-        return -4;
+        Error("[%p][VideoEncoder::Resample] malloc data fail VideoPacket fail", this);
+        return -5;
     }
-
-    pVideoPacket->m_nWidth = m_pVideoInfo->m_nWidth;
-    pVideoPacket->m_nHeight = m_pVideoInfo->m_nHight;
-    free(pVideoPacket->m_pData);
-    pVideoPacket->m_pData = (uint8_t*)malloc(pVideoPacket->m_nWidth * pVideoPacket->m_nHeight * 3 / 2);
-    if (pVideoPacket->m_pData == nullptr)
+    if (bNV12)
     {
-        pVideoPacket = nullptr;
-        Error("[%p][VideoEncoder::Resample] malloc data fail VideoPacket fail");
-        return -5;
+        pResampleFrame->SetPackedNV12Planes();
     }
-
-    pVideoPacket->m_nLength = pVideoPacket->m_nWidth * pVideoPacket->m_nHeight * 3 / 2;
-    uint8_t* pY = pVideoPacket->m_pData;
-    uint8_t* pU = pY + m_pResampleFrame->width * m_pResampleFrame->height;
-    uint8_t* pV = pU + m_pResampleFrame->width * m_pResampleFrame->height / 4;
-    int nSrcYOffset = 0;
-    int nDstYOffset = 0;
-    for (int i = 0; i < m_pResampleFrame->height; i++)
+    else
     {
-        memcpy(pY + nDstYOffset, m_pResampleFrame->data[0] + nSrcYOffset, m_pResampleFrame->width);
-        nSrcYOffset += m_pResampleFrame->linesize[0];
-        nDstYOffset += m_pResampleFrame->width;
+        pResampleFrame->SetPackedPlanes();
     }
-    int nSrcUOffset = 0;
-    int nSrcVOffset = 0;
-    int nDstUVOffset = 0;
-    for (int i = 0; i < m_pResampleFrame->height / 2; i++)
+    pResampleFrame->m_nFrameType = pVideoPacket->m_nFrameType;
+    pResampleFrame->m_lPTS = pVideoPacket->m_lPTS;
+
+    int ret = sws_scale(m_pResampleContext, (uint8_t const**)pVideoPacket->m_pPlane, pVideoPacket->m_nLineSize, 0, pVideoPacket->m_nHeight,
+        pResampleFrame->m_pPlane, pResampleFrame->m_nLineSize);
+    if (ret < 0)
     {
-        memcpy(pU + nDstUVOffset, m_pResampleFrame->data[1] + nSrcUOffset, m_pResampleFrame->width / 2);
-        memcpy(pV + nDstUVOffset, m_pResampleFrame->data[2] + nSrcVOffset, m_pResampleFrame->width / 2);
-        nSrcUOffset +=  m_pResampleFrame->linesize[1];
-        nSrcVOffset += m_pResampleFrame->linesize[2];
-        nDstUVOffset += (m_pResampleFrame->width / 2);
+        Error("[%p][VideoEncoder::Resample] sws_scale fail,return:%d", this, ret);
+        return -4;
     }
 
+    pVideoPacket = pResampleFrame;
+
     return 0;
 }
 
+static void ReleaseEncodeFrame(void* opaque, uint8_t* data)
+{
+    delete (std::shared_ptr<VideoFrame>*)opaque;
+}
+
 int32_t VideoEncoder::EncodeFrame(std::shared_ptr<VideoFrame> pVideoPacket)
 {
-    if (pVideoPacket->m_nFrameType != AV_PIX_FMT_YUV420P && pVideoPacket->m_nFrameType != AV_PIX_FMT_YUVJ420P)
+    bool bNV12 = pVideoPacket->m_nFrameType == AV_PIX_FMT_NV12;
+    if (pVideoPacket->m_nFrameType != AV_PIX_FMT_YUV420P && pVideoPacket->m_nFrameType != AV_PIX_FMT_YUVJ420P && !bNV12)
     {
         Error("[%p][VideoEncoder::EncodeFrame] not support FrameType:%d", this, pVideoPacket->m_nFrameType);
         return -1;
     }
 
+    if (pVideoPacket->m_pPlane[0] == nullptr)
+    {
+        if (bNV12)
+        {
+            pVideoPacket->SetPackedNV12Planes();
+        }
+        else
+        {
+            pVideoPacket->SetPackedPlanes();
+        }
+    }
+
     int ret = ResampleIfNeed(pVideoPacket);
     if (ret != 0)
     {
@@ -315,25 +356,35 @@ int32_t VideoEncoder::EncodeFrame(std::shared_ptr<VideoFrame> pVideoPacket)
     {
         std::lock_guard<std::mutex> lock(m_EncoderLock);
 
+        std::shared_ptr<VideoFrame>* pHolder = new std::shared_ptr<VideoFrame>(pVideoPacket);
+        AVBufferRef* pBuffer = av_buffer_create(pVideoPacket->m_pPlane[0], pVideoPacket->m_nLength, ReleaseEncodeFrame, pHolder, AV_BUFFER_FLAG_READONLY);
+        if (pBuffer == nullptr)
+        {
+            delete pHolder;
+            Error("[%p][VideoEncoder::EncodeFrame] av_buffer_create fail", this);
+            return -3;
+        }
+
+        //without a v4l2 control the GOP is kept by forcing key frames
+        if (m_nGOP > 0 && m_nFramesSinceKey >= m_nGOP)
+        {
+            m_bForceKeyFrame = true;
+        }
+        m_pFrame->pict_type = m_bForceKeyFrame ? AV_PICTURE_TYPE_I : AV_PICTURE_TYPE_NONE;
+        m_nFramesSinceKey = m_bForceKeyFrame ? 1 : m_nFramesSinceKey + 1;
+        m_bForceKeyFrame = false;
+
         //m_pFrame->format = pVideoPacket->m_nFrameType;
-        m_pFrame->format = AV_PIX_FMT_YUVJ420P;
+        m_pFrame->format = bNV12 ? AV_PIX_FMT_NV12 : AV_PIX_FMT_YUVJ420P;
         m_pFrame->width = pVideoPacket->m_nWidth;
         m_pFrame->height = pVideoPacket->m_nHeight;
         m_pFrame->pts = pVideoPacket->m_lPTS;
-
-        av_frame_get_buffer(m_pFrame, 0);
-        av_frame_make_writable(m_pFrame);
-
-        av_image_copy_plane(m_pFrame->data[0], m_pFrame->linesize[0], pVideoPacket->m_pData, pVideoPacket->m_nWidth, pVideoPacket->m_nWidth, pVideoPacket->m_nHeight);
-        av_image_copy_plane(m_pFrame->data[1], m_pFrame->linesize[1], pVideoPacket->m_pData + (pVideoPacket->m_nWidth * pVideoPacket->m_nHeight),
-            pVideoPacket->m_nWidth >> 1, pVideoPacket->m_nWidth >> 1, pVideoPacket->m_nHeight >> 1);
-        av_image_copy_plane(m_pFrame->data[2], m_pFrame->linesize[2], pVideoPacket->m_pData + (pVideoPacket->m_nWidth * pVideoPacket->m_nHeight * 5 / 4),
-            pVideoPacket->m_nWidth >> 1, pVideoPacket->m_nWidth >> 1, pVideoPacket->m_nHeight >> 1);
-
-
-        /*memcpy(m_pFrame->data[0], pVideoPacket->m_pData, pVideoPacket->m_nWidth * pVideoPacket->m_nHeight);
-        memcpy(m_pFrame->data[1], pVideoPacket->m_pData + (pVideoPacket->m_nWidth * pVideoPacket->m_nHeight), (pVideoPacket->m_nWidth * pVideoPacket->m_nHeight) >> 2);
-        memcpy(m_pFrame->data[2], pVideoPacket->m_pData + (pVideoPacket->m_nWidth * pVideoPacket->m_nHeight * 5 / 4), (pVideoPacket->m_nWidth * pVideoPacket->m_nHeight) >> 2);*/
+        m_pFrame->buf[0] = pBuffer;
+        for (int i = 0; i < 3; i++)
+        {
+            m_pFrame->data[i] = pVideoPacket->m_pPlane[i];
+            m_pFrame->linesize[i] = pVideoPacket->m_nLineSize[i];
+        }
 
         int nRetSend = avcodec_send_frame(m_pAVContext, m_pFrame);
         av_frame_unref(m_pFrame);
@@ -413,6 +464,224 @@ int32_t VideoEncoder::SetVideoPacketCallback(VideoPacketCallbaclk pCallback)
     return 0;
 }
 
+//libavcodec keeps the v4l2m2m fd private,find it among the fds opened by avcodec_open2.Another thread may
+//open fds in the same window,so every new fd must prove to be an H264 M2M encoder and exactly one may
+int32_t VideoEncoder::FindControlFd(const std::set<int32_t>& oldFds)
+{
+    std::set<int32_t> newFds;
+    ListOpenFds(newFds);
+    int32_t nFoundFd = -1;
+    bool bFoundMultiPlane = false;
+    uint32_t nFoundNum = 0;
+    for (int32_t fd : newFds)
+    {
+        if (oldFds.find(fd) != oldFds.end())
+        {
+            continue;
+        }
+
+        struct v4l2_capability cap;
+        memset(&cap, 0, sizeof(cap));
+        if (ioctl(fd, VIDIOC_QUERYCAP, &cap) != 0)
+        {
+            continue;
+        }
+        uint32_t caps = (cap.capabilities & V4L2_CAP_DEVICE_CAPS) ? cap.device_caps : cap.capabilities;
+        if ((caps & (V4L2_CAP_VIDEO_M2M | V4L2_CAP_VIDEO_M2M_MPLANE)) == 0)
+        {
+            continue;
+        }
+
+        bool bMultiPlane = (caps & V4L2_CAP_VIDEO_M2M_MPLANE) != 0;
+        struct v4l2_format fmt;
+        memset(&fmt, 0, sizeof(fmt));
+        fmt.type = bMultiPlane ? V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE : V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        if (ioctl(fd, VIDIOC_G_FMT, &fmt) != 0)
+        {
+            continue;
+        }
+        uint32_t pixelformat = bMultiPlane ? fmt.fmt.pix_mp.pixelformat : fmt.fmt.pix.pixelformat;
+        if (pixelformat != V4L2_PIX_FMT_H264)
+        {
+            continue;
+        }
+
+        Trace("[%p][VideoEncoder::FindControlFd] encoder:%s fd:%d", this, cap.card, fd);
+        nFoundFd = fd;
+        bFoundMultiPlane = bMultiPlane;
+        nFoundNum++;
+    }
+
+    if (nFoundNum == 0)
+    {
+        Warn("[%p][VideoEncoder::FindControlFd] can not find v4l2m2m encoder fd,runtime control limited", this);
+        return -1;
+    }
+    if (nFoundNum > 1)
+    {
+        Warn("[%p][VideoEncoder::FindControlFd] %u v4l2m2m encoder fds opened meanwhile,can not tell which,runtime control limited", this, nFoundNum);
+        return -2;
+    }
+
+    m_nControlFd = nFoundFd;
+    m_bMultiPlane = bFoundMultiPlane;
+    return 0;
+}
+
+int32_t VideoEncoder::SetEncoderControl(uint32_t id, int32_t value, const char* name)
+{
+    if (m_nControlFd == -1)
+    {
+        return -1;
+    }
+
+    struct v4l2_ext_control ctrl;
+    struct v4l2_ext_controls ctrls;
+    memset(&ctrl, 0, sizeof(ctrl));
+    memset(&ctrls, 0, sizeof(ctrls));
+    ctrl.id = id;
+    ctrl.value = value;
+    ctrls.ctrl_class = V4L2_CTRL_ID2CLASS(id);
+    ctrls.count = 1;
+    ctrls.controls = &ctrl;
+    if (ioctl(m_nControlFd, VIDIOC_S_EXT_CTRLS, &ctrls) != 0)
+    {
+        Warn("[%p][VideoEncoder::SetEncoderControl] set %s:%d fail,errno:%d", this, name, value, errno);
+        return -2;
+    }
+
+    Trace("[%p][VideoEncoder::SetEncoderControl] set %s:%d", this, name, value);
+    return 0;
+}
+
+int32_t VideoEncoder::ApplyRateControl(RateControl mode, uint32_t peakBitRate)
+{
+    int32_t ret = SetEncoderControl(V4L2_CID_MPEG_VIDEO_BITRATE_MODE,
+        mode == RATE_CONTROL_CBR ? V4L2_MPEG_VIDEO_BITRATE_MODE_CBR : V4L2_MPEG_VIDEO_BITRATE_MODE_VBR, "bitrate mode");
+    if (ret != 0)
+    {
+        return ret;
+    }
+
+    if (mode == RATE_CONTROL_VBR && peakBitRate > 0)
+    {
+        ret = SetEncoderControl(V4L2_CID_MPEG_VIDEO_BITRATE_PEAK, peakBitRate, "peak bitrate");
+    }
+
+    return ret;
+}
+
+int32_t VideoEncoder::ApplyFPS(uint32_t fps)
+{
+    if (m_nControlFd == -1)
+    {
+        return -1;
+    }
+
+    struct v4l2_streamparm parm;
+    memset(&parm, 0, sizeof(parm));
+    parm.type = m_bMultiPlane ? V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE : V4L2_BUF_TYPE_VIDEO_OUTPUT;
+    parm.parm.output.timeperframe.numerator = 1;
+    parm.parm.output.timeperframe.denominator = fps;
+    if (ioctl(m_nControlFd, VIDIOC_S_PARM, &parm) != 0)
+    {
+        Warn("[%p][VideoEncoder::ApplyFPS] set fps:%u fail,errno:%d", this, fps, errno);
+        return -2;
+    }
+
+    return 0;
+}
+
+int32_t VideoEncoder::SetBitRate(uint32_t bitRate)
+{
+    std::lock_guard<std::mutex> lock(m_EncoderLock);
+    if (m_pAVContext == nullptr || bitRate == 0)
+    {
+        Error("[%p][VideoEncoder::SetBitRate] encoder not open or bitrate:%u error", this, bitRate);
+        return -1;
+    }
+
+    //software encoders(libx264) pick up a changed bit_rate on the next frame
+    m_pAVContext->bit_rate = bitRate;
+    if (m_nControlFd != -1 && SetEncoderControl(V4L2_CID_MPEG_VIDEO_BITRATE, bitRate, "bitrate") != 0)
+    {
+        return -2;
+    }
+
+    return 0;
+}
+
+int32_t VideoEncoder::SetRateControl(RateControl mode, uint32_t peakBitRate)
+{
+    std::lock_guard<std::mutex> lock(m_EncoderLock);
+    if (m_pAVContext == nullptr)
+    {
+        Error("[%p][VideoEncoder::SetRateControl] encoder not open", this);
+        return -1;
+    }
+
+    //switching the mode alone keeps the cap set before
+    peakBitRate = peakBitRate > 0 ? peakBitRate : m_nPeakBitRate;
+    m_nPeakBitRate = peakBitRate;
+    m_pAVContext->rc_max_rate = mode == RATE_CONTROL_CBR ? m_pAVContext->bit_rate : peakBitRate;
+    if (m_nControlFd == -1)
+    {
+        Warn("[%p][VideoEncoder::SetRateControl] no v4l2 control,mode:%d not applied", this, mode);
+        return -2;
+    }
+
+    //some drivers only accept the mode before streaming
+    if (ApplyRateControl(mode, peakBitRate) != 0)
+    {
+        return -3;
+    }
+
+    return 0;
+}
+
+int32_t VideoEncoder::SetGOP(uint32_t gop)
+{
+    std::lock_guard<std::mutex> lock(m_EncoderLock);
+    if (m_pAVContext == nullptr)
+    {
+        Error("[%p][VideoEncoder::SetGOP] encoder not open", this);
+        return -1;
+    }
+
+    m_pAVContext->gop_size = gop;
+    if (m_nControlFd != -1 && SetEncoderControl(V4L2_CID_MPEG_VIDEO_H264_I_PERIOD, gop, "i period") == 0)
+    {
+        m_nGOP = 0;
+        return 0;
+    }
+
+    m_nGOP = gop;
+    return 0;
+}
+
+int32_t VideoEncoder::SetFPS(uint32_t fps)
+{
+    std::lock_guard<std::mutex> lock(m_EncoderLock);
+    if (m_pAVContext == nullptr || fps == 0)
+    {
+        Error("[%p][VideoEncoder::SetFPS] encoder not open or fps:%u error", this, fps);
+        return -1;
+    }
+
+    //timestamps are in MEDIA_CLOCK_RATE,the frame rate is only a rate control hint
+    m_pAVContext->framerate = (AVRational){ (int)fps, 1 };
+    ApplyFPS(fps);
+
+    return 0;
+}
+
+int32_t VideoEncoder::RequestKeyFrame()
+{
+    std::lock_guard<std::mutex> lock(m_EncoderLock);
+    m_bForceKeyFrame = true;
+    return 0;
+}
+
 int32_t VideoEncoder::OutputVideoPacket()
 {
     if (m_pVideoPacketCallback == nullptr)
@@ -428,12 +697,13 @@ int32_t VideoEncoder::OutputVideoPacket()
         return -2;
     }
 
-    pVideoPacket->m_lDTS = m_pPacket->dts;
     pVideoPacket->m_lPTS = m_pPacket->pts;
+    pVideoPacket->m_lDTS = (m_pPacket->dts != AV_NOPTS_VALUE) ? m_pPacket->dts : m_pPacket->pts;
     pVideoPacket->m_nFrameType = m_pAVContext->codec_id;
     if (m_pAVContext->codec_id == AV_CODEC_ID_H264 || m_pAVContext->codec_id == AV_CODEC_ID_H265)
     {
-        pVideoPacket->m_pData = (uint8_t*)malloc(m_pPacket->size - 4);
+        pVideoPacket->m_pBufferRef = FramePool::GetPacketPool()->GetBuffer(m_pPacket->size - 4);
+        pVideoPacket->m_pData = (uint8_t*)pVideoPacket->m_pBufferRef.get();
         if (pVideoPacket->m_pData == nullptr)
         {
             Error("[%p][VideoEncoder::OutputVideoPacket] malloc video data fail", this);
@@ -445,7 +715,8 @@ int32_t VideoEncoder::OutputVideoPacket()
     }
     else
     {
-        pVideoPacket->m_pData = (uint8_t*)malloc(m_pPacket->size);
+        pVideoPacket->m_pBufferRef = FramePool::GetPacketPool()->GetBuffer(m_pPacket->size);
+        pVideoPacket->m_pData = (uint8_t*)pVideoPacket->m_pBufferRef.get();
         if (pVideoPacket->m_pData == nullptr)
         {
             Error("[%p][VideoEncoder::OutputVideoPacket] malloc video data fail", this);
@@ -13,6 +13,7 @@ extern "C" {
 #include <mutex>
 #include <memory>
 #include <functional>
+#include <set>
 #include "Common.h"
 
 bool FindSPS(uint8_t* data, uint32_t size, uint8_t*& sps, uint32_t& spsSize);
@@ -24,12 +25,25 @@ public:
     VideoEncoder();
     ~VideoEncoder();
 
+    typedef enum RateControl
+    {
+        RATE_CONTROL_VBR = 0,       //capped at m_nPeakBitRate when it is not 0
+        RATE_CONTROL_CBR
+    }RateControl;
+
     typedef struct EncodParam
     {
         uint32_t m_nWidth = 0;
         uint32_t m_nHeight = 0;
         uint32_t m_nBitRate = 0;
+        uint32_t m_nFPS = 25;
         uint32_t m_nCodecID = AV_CODEC_ID_H264;
+        int32_t m_nPixelFormat = AV_PIX_FMT_YUV420P;     //AV_PIX_FMT_NV12 when the camera outputs NV12
+        uint32_t m_nGOP = 50;
+        uint32_t m_nQMin = 10;
+        uint32_t m_nQMax = 51;
+        RateControl m_eRateControl = RATE_CONTROL_VBR;
+        uint32_t m_nPeakBitRate = 0;
     }EncodParam;
     typedef std::function<void(std::shared_ptr<VideoPacket>& pVideo)> VideoPacketCallbaclk;
 
@@ -40,6 +54,13 @@ public:
     int32_t EncodeFrame(const AVFrame* pFrame);
     int32_t SetVideoPacketCallback(VideoPacketCallbaclk pCallback);
 
+    //runtime control,applied to the v4l2m2m encoder without closing the codec
+    int32_t SetBitRate(uint32_t bitRate);
+    int32_t SetRateControl(RateControl mode, uint32_t peakBitRate);        //peakBitRate 0 keeps the current peak
+    int32_t SetGOP(uint32_t gop);
+    int32_t SetFPS(uint32_t fps);
+    int32_t RequestKeyFrame();
+
     const uint8_t* GetSPS(uint32_t& len);
     const uint8_t* GetPPS(uint32_t& len);
 
@@ -47,6 +68,10 @@ private:
     int32_t ReleaseAll();
     int32_t OutputVideoPacket();
     int32_t ResampleIfNeed(std::shared_ptr<VideoFrame>& pVideoPacket);
+    int32_t FindControlFd(const std::set<int32_t>& oldFds);
+    int32_t SetEncoderControl(uint32_t id, int32_t value, const char* name);
+    int32_t ApplyRateControl(RateControl mode, uint32_t peakBitRate);
+    int32_t ApplyFPS(uint32_t fps);
 
 private:
     std::mutex m_EncoderLock;
@@ -59,8 +84,15 @@ private:
 
     int m_nResampleSrcWidth;
     int m_nResampleSrcHight;
+    AVPixelFormat m_eResampleSrcFormat;
     SwsContext* m_pResampleContext;
-    AVFrame* m_pResampleFrame;
 
     VideoPacketCallbaclk m_pVideoPacketCallback;
+
+    int32_t m_nControlFd;       //v4l2m2m encoder fd,owned by libavcodec;-1 for software encoders
+    bool m_bMultiPlane;
+    bool m_bForceKeyFrame;
+    uint32_t m_nGOP;
+    uint32_t m_nPeakBitRate;    //VBR cap,kept across a switch to CBR and back
+    uint32_t m_nFramesSinceKey;
 };
\ No newline at end of file
@@ -334,9 +334,13 @@ bool AddBitmap2VideoFrame(const std::shared_ptr<VideoFrame>& farme, int32_t x, i
     uint8_t U = -0.1687 * color.R - 0.3313 * color.G + 0.5 * color.B + 128;
     uint8_t V = 0.5 * color.R - 0.4187 * color.G - 0.0813 * color.B + 128;
 
-    uint8_t* pY = farme->m_pData;
-    uint8_t* pU = farme->m_pData + (farme->m_nWidth * farme->m_nHeight);
-    uint8_t* pV = farme->m_pData + (farme->m_nWidth * farme->m_nHeight * 5 / 4);
+    if (farme->m_pPlane[0] == nullptr)
+    {
+        farme->SetPackedPlanes();
+    }
+    uint8_t* pY = farme->m_pPlane[0];
+    uint8_t* pU = farme->m_pPlane[1];
+    uint8_t* pV = farme->m_pPlane[2];
 
     uint8_t* pPixY = nullptr;
     uint8_t* pPixU = nullptr;
@@ -360,8 +364,8 @@ bool AddBitmap2VideoFrame(const std::shared_ptr<VideoFrame>& farme, int32_t x, i
                 continue;
             }
 
-            offsetY = line * farme->m_nWidth;
-            offsetUV = (line >> 1) * (farme->m_nWidth >> 1);
+            offsetY = line * farme->m_nLineSize[0];
+            offsetUV = (line >> 1) * farme->m_nLineSize[1];
 
             map->GetBit(i, j, bit);
             if (bit != 0)
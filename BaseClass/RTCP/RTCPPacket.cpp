@@ -0,0 +1,310 @@
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include "RTCPPacket.h"
+#include "Log/Log.h"
+
+#define RTCP_VERSION (2)
+#define RTCP_HEADER_SIZE (4)
+#define RTCP_SR_SIZE (28)
+#define RTCP_RR_SIZE (32)
+#define RTCP_REPORT_BLOCK_SIZE (24)
+#define RTCP_FB_HEADER_SIZE (12)
+#define RTCP_NACK_ITEM_SIZE (4)
+#define RTCP_APP_HEADER_SIZE (12)
+#define RTCP_FEC_CONFIG_NAME "XFEC"
+#define MAX_FEC_CONFIG_SIZE (256)
+#define NTP_UNIX_OFFSET (2208988800ULL)
+
+static void WriteUint32(uint8_t* data, uint32_t value)
+{
+    data[0] = value >> 24;
+    data[1] = (value >> 16) & 0xff;
+    data[2] = (value >> 8) & 0xff;
+    data[3] = value & 0xff;
+}
+
+static uint32_t ReadUint32(const uint8_t* data)
+{
+    return ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) | ((uint32_t)data[2] << 8) | data[3];
+}
+
+static std::shared_ptr<Packet> AllocRtcpPacket(uint32_t size, uint8_t count, uint8_t pt)
+{
+    uint8_t* data = (uint8_t*)malloc(size);
+    if (data == nullptr)
+    {
+        Error("[AllocRtcpPacket] malloc rtcp packet fail,size:%u", size);
+        return nullptr;
+    }
+    memset(data, 0, size);
+
+    uint16_t length = size / 4 - 1;
+    data[0] = (RTCP_VERSION << 6) | (count & 0x1f);
+    data[1] = pt;
+    data[2] = length >> 8;
+    data[3] = length & 0xff;
+
+    std::shared_ptr<Packet> packet = std::make_shared<Packet>();
+    packet->m_pData = data;
+    packet->m_nLength = size;
+    return packet;
+}
+
+std::shared_ptr<Packet> RTCPPacket::MakeSenderReport(const SenderInfo& info)
+{
+    std::shared_ptr<Packet> packet = AllocRtcpPacket(RTCP_SR_SIZE, 0, RTCP_PT_SR);
+    if (packet == nullptr)
+    {
+        return nullptr;
+    }
+
+    uint8_t* data = packet->m_pData;
+    WriteUint32(data + 4, info.m_nSSRC);
+    WriteUint32(data + 8, info.m_lNTPTime >> 32);
+    WriteUint32(data + 12, info.m_lNTPTime & 0xffffffff);
+    WriteUint32(data + 16, info.m_nRtpTime);
+    WriteUint32(data + 20, info.m_nPacketCount);
+    WriteUint32(data + 24, info.m_nOctetCount);
+
+    return packet;
+}
+
+std::shared_ptr<Packet> RTCPPacket::MakeReceiverReport(const ReportBlock& block)
+{
+    std::shared_ptr<Packet> packet = AllocRtcpPacket(RTCP_RR_SIZE, 1, RTCP_PT_RR);
+    if (packet == nullptr)
+    {
+        return nullptr;
+    }
+
+    uint8_t* data = packet->m_pData;
+    WriteUint32(data + 4, block.m_nReporterSSRC);
+    WriteUint32(data + 8, block.m_nSourceSSRC);
+    WriteUint32(data + 12, ((uint32_t)block.m_nFractionLost << 24) | (block.m_nCumulativeLost & 0xffffff));
+    WriteUint32(data + 16, block.m_nHighestSeq);
+    WriteUint32(data + 20, block.m_nJitter);
+    WriteUint32(data + 24, block.m_nLSR);
+    WriteUint32(data + 28, block.m_nDLSR);
+
+    return packet;
+}
+
+//lost in ascending order,each item is a PID and a bitmask of the 16 packets after it
+std::shared_ptr<Packet> RTCPPacket::MakeGenericNack(uint32_t senderSSRC, uint32_t mediaSSRC, const std::list<uint16_t>& lost)
+{
+    std::list<std::pair<uint16_t, uint16_t>> items;
+    for (auto seq : lost)
+    {
+        if (!items.empty())
+        {
+            uint16_t distance = seq - items.back().first;
+            if (distance >= 1 && distance <= 16)
+            {
+                items.back().second |= 1 << (distance - 1);
+                continue;
+            }
+        }
+        items.push_back({ seq, 0 });
+    }
+    if (items.empty())
+    {
+        return nullptr;
+    }
+
+    uint32_t size = RTCP_FB_HEADER_SIZE + items.size() * RTCP_NACK_ITEM_SIZE;
+    std::shared_ptr<Packet> packet = AllocRtcpPacket(size, RTCP_FMT_GENERIC_NACK, RTCP_PT_RTPFB);
+    if (packet == nullptr)
+    {
+        return nullptr;
+    }
+
+    uint8_t* data = packet->m_pData;
+    WriteUint32(data + 4, senderSSRC);
+    WriteUint32(data + 8, mediaSSRC);
+    uint8_t* item = data + RTCP_FB_HEADER_SIZE;
+    for (auto& it : items)
+    {
+        WriteUint32(item, ((uint32_t)it.first << 16) | it.second);
+        item += RTCP_NACK_ITEM_SIZE;
+    }
+
+    return packet;
+}
+
+//the repair SSRC the geometry starts with,then the attribute NUL padded to a word
+std::shared_ptr<Packet> RTCPPacket::MakeFECConfig(uint32_t senderSSRC, uint32_t repairSSRC, const std::string& attribute)
+{
+    if (attribute.size() >= MAX_FEC_CONFIG_SIZE)
+    {
+        Error("[RTCPPacket::MakeFECConfig] attribute size:%u too long", (uint32_t)attribute.size());
+        return nullptr;
+    }
+
+    uint32_t size = RTCP_APP_HEADER_SIZE + 4 + (attribute.size() / 4 + 1) * 4;
+    std::shared_ptr<Packet> packet = AllocRtcpPacket(size, 0, RTCP_PT_APP);
+    if (packet == nullptr)
+    {
+        return nullptr;
+    }
+
+    uint8_t* data = packet->m_pData;
+    WriteUint32(data + 4, senderSSRC);
+    memcpy(data + 8, RTCP_FEC_CONFIG_NAME, 4);
+    WriteUint32(data + RTCP_APP_HEADER_SIZE, repairSSRC);
+    memcpy(data + RTCP_APP_HEADER_SIZE + 4, attribute.data(), attribute.size());
+
+    return packet;
+}
+
+int32_t RTCPPacket::ParseSenderReport(const uint8_t* data, uint32_t size, SenderInfo& info)
+{
+    uint32_t offset = 0;
+    while (offset + RTCP_HEADER_SIZE <= size)
+    {
+        const uint8_t* rtcp = data + offset;
+        uint32_t len = (((rtcp[2] << 8) | rtcp[3]) + 1) * 4;
+        if ((rtcp[0] >> 6) != RTCP_VERSION || offset + len > size)
+        {
+            return -1;
+        }
+
+        if (rtcp[1] == RTCP_PT_SR && len >= RTCP_SR_SIZE)
+        {
+            info.m_nSSRC = ReadUint32(rtcp + 4);
+            info.m_lNTPTime = ((uint64_t)ReadUint32(rtcp + 8) << 32) | ReadUint32(rtcp + 12);
+            info.m_nRtpTime = ReadUint32(rtcp + 16);
+            info.m_nPacketCount = ReadUint32(rtcp + 20);
+            info.m_nOctetCount = ReadUint32(rtcp + 24);
+            return 0;
+        }
+        offset += len;
+    }
+
+    return -2;
+}
+
+//report blocks may also ride on a SR,after the sender info
+int32_t RTCPPacket::ParseReceiverReport(const uint8_t* data, uint32_t size, ReportBlock& block)
+{
+    uint32_t offset = 0;
+    while (offset + RTCP_HEADER_SIZE <= size)
+    {
+        const uint8_t* rtcp = data + offset;
+        uint32_t len = (((rtcp[2] << 8) | rtcp[3]) + 1) * 4;
+        if ((rtcp[0] >> 6) != RTCP_VERSION || offset + len > size)
+        {
+            return -1;
+        }
+
+        uint32_t blockOffset = rtcp[1] == RTCP_PT_RR ? 8 : rtcp[1] == RTCP_PT_SR ? RTCP_SR_SIZE : 0;
+        if (blockOffset != 0 && (rtcp[0] & 0x1f) > 0 && blockOffset + RTCP_REPORT_BLOCK_SIZE <= len)
+        {
+            const uint8_t* report = rtcp + blockOffset;
+            block.m_nReporterSSRC = ReadUint32(rtcp + 4);
+            block.m_nSourceSSRC = ReadUint32(report);
+            block.m_nFractionLost = report[4];
+            int32_t lost = (report[5] << 16) | (report[6] << 8) | report[7];
+            block.m_nCumulativeLost = (lost & 0x800000) ? lost - 0x1000000 : lost;
+            block.m_nHighestSeq = ReadUint32(report + 8);
+            block.m_nJitter = ReadUint32(report + 12);
+            block.m_nLSR = ReadUint32(report + 16);
+            block.m_nDLSR = ReadUint32(report + 20);
+            return 0;
+        }
+        offset += len;
+    }
+
+    return -2;
+}
+
+int32_t RTCPPacket::ParseGenericNack(const uint8_t* data, uint32_t size, std::list<uint16_t>& lost)
+{
+    bool bFind = false;
+    uint32_t offset = 0;
+    while (offset + RTCP_HEADER_SIZE <= size)
+    {
+        const uint8_t* rtcp = data + offset;
+        uint32_t len = (((rtcp[2] << 8) | rtcp[3]) + 1) * 4;
+        if ((rtcp[0] >> 6) != RTCP_VERSION || offset + len > size)
+        {
+            return -1;
+        }
+
+        if (rtcp[1] == RTCP_PT_RTPFB && (rtcp[0] & 0x1f) == RTCP_FMT_GENERIC_NACK && len >= RTCP_FB_HEADER_SIZE)
+        {
+            bFind = true;
+            for (uint32_t i = RTCP_FB_HEADER_SIZE; i + RTCP_NACK_ITEM_SIZE <= len; i += RTCP_NACK_ITEM_SIZE)
+            {
+                uint16_t pid = (rtcp[i] << 8) | rtcp[i + 1];
+                uint16_t blp = (rtcp[i + 2] << 8) | rtcp[i + 3];
+                lost.push_back(pid);
+                for (int bit = 0; bit < 16; bit++)
+                {
+                    if ((blp & (1 << bit)) != 0)
+                    {
+                        lost.push_back(pid + bit + 1);
+                    }
+                }
+            }
+        }
+        offset += len;
+    }
+
+    return bFind ? 0 : -2;
+}
+
+int32_t RTCPPacket::ParseFECConfig(const uint8_t* data, uint32_t size, uint32_t& repairSSRC, std::string& attribute)
+{
+    uint32_t offset = 0;
+    while (offset + RTCP_HEADER_SIZE <= size)
+    {
+        const uint8_t* rtcp = data + offset;
+        uint32_t len = (((rtcp[2] << 8) | rtcp[3]) + 1) * 4;
+        if ((rtcp[0] >> 6) != RTCP_VERSION || offset + len > size)
+        {
+            return -1;
+        }
+
+        if (rtcp[1] == RTCP_PT_APP && len > RTCP_APP_HEADER_SIZE + 4 && memcmp(rtcp + 8, RTCP_FEC_CONFIG_NAME, 4) == 0)
+        {
+            const char* text = (const char*)rtcp + RTCP_APP_HEADER_SIZE + 4;
+            uint32_t textLen = len - RTCP_APP_HEADER_SIZE - 4;
+            repairSSRC = ReadUint32(rtcp + RTCP_APP_HEADER_SIZE);
+            attribute.assign(text, strnlen(text, textLen));
+            return 0;
+        }
+        offset += len;
+    }
+
+    return -2;
+}
+
+uint64_t RTCPPacket::GetNTPTime()
+{
+    auto now = std::chrono::system_clock::now().time_since_epoch();
+    uint64_t us = std::chrono::duration_cast<std::chrono::microseconds>(now).count();
+    uint64_t seconds = us / 1000000 + NTP_UNIX_OFFSET;
+    uint64_t fraction = ((us % 1000000) << 32) / 1000000;
+    return (seconds << 32) | fraction;
+}
+
+uint64_t RTCPPacket::MillisecondsToNTP(uint64_t ms)
+{
+    return ((ms / 1000) << 32) | (((ms % 1000) << 32) / 1000);
+}
+
+int32_t RTCPPacket::GetRoundTripTime(const ReportBlock& block, uint32_t compactNow)
+{
+    if (block.m_nLSR == 0)
+    {
+        return -1;
+    }
+
+    int32_t rtt = (int32_t)(compactNow - block.m_nLSR - block.m_nDLSR);
+    if (rtt < 0)
+    {
+        rtt = 0;
+    }
+    return (int32_t)((int64_t)rtt * 1000 / 65536);
+}
\ No newline at end of file
@@ -0,0 +1,56 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <list>
+#include <string>
+#include "Common.h"
+
+#define RTCP_PT_SR (200)
+#define RTCP_PT_RR (201)
+#define RTCP_PT_APP (204)
+#define RTCP_PT_RTPFB (205)
+#define RTCP_FMT_GENERIC_NACK (1)
+
+//RFC 3550 sender/receiver reports,one report block per packet since every session carries a single video stream,
+//RFC 4585 generic NACK,and an APP packet named XFEC with the FEC geometry the server has moved to
+class RTCPPacket
+{
+public:
+    typedef struct SenderInfo
+    {
+        uint32_t m_nSSRC = 0;
+        uint64_t m_lNTPTime = 0;
+        uint32_t m_nRtpTime = 0;
+        uint32_t m_nPacketCount = 0;
+        uint32_t m_nOctetCount = 0;
+    }SenderInfo;
+
+    typedef struct ReportBlock
+    {
+        uint32_t m_nReporterSSRC = 0;
+        uint32_t m_nSourceSSRC = 0;
+        uint8_t m_nFractionLost = 0;        //lost/expected since the last report,in 1/256
+        int32_t m_nCumulativeLost = 0;
+        uint32_t m_nHighestSeq = 0;         //extended highest sequence number received
+        uint32_t m_nJitter = 0;             //interarrival jitter in RTP timestamp units
+        uint32_t m_nLSR = 0;                //middle 32 bits of the last SR NTP time
+        uint32_t m_nDLSR = 0;               //delay since the last SR,1/65536 seconds
+    }ReportBlock;
+
+public:
+    static std::shared_ptr<Packet> MakeSenderReport(const SenderInfo& info);
+    static std::shared_ptr<Packet> MakeReceiverReport(const ReportBlock& block);
+    static std::shared_ptr<Packet> MakeGenericNack(uint32_t senderSSRC, uint32_t mediaSSRC, const std::list<uint16_t>& lost);
+    static std::shared_ptr<Packet> MakeFECConfig(uint32_t senderSSRC, uint32_t repairSSRC, const std::string& attribute);     //a=x-fec: value
+
+    //walk a compound packet and return the first report found
+    static int32_t ParseSenderReport(const uint8_t* data, uint32_t size, SenderInfo& info);
+    static int32_t ParseReceiverReport(const uint8_t* data, uint32_t size, ReportBlock& block);
+    static int32_t ParseGenericNack(const uint8_t* data, uint32_t size, std::list<uint16_t>& lost);    //every NACK in the compound
+    static int32_t ParseFECConfig(const uint8_t* data, uint32_t size, uint32_t& repairSSRC, std::string& attribute);
+
+    static uint64_t GetNTPTime();
+    static uint64_t MillisecondsToNTP(uint64_t ms);
+    static inline uint32_t GetCompactNTP(uint64_t ntp) { return (uint32_t)(ntp >> 16); };
+    static int32_t GetRoundTripTime(const ReportBlock& block, uint32_t compactNow);     //milliseconds,-1 without a SR
+};
\ No newline at end of file
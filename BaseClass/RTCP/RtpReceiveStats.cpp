@@ -0,0 +1,146 @@
+#include <stdlib.h>
+#include "RtpReceiveStats.h"
+#include "CommonTools/TimeCounter.h"
+#include "Log/Log.h"
+
+#define MAX_DROPOUT (3000)
+#define MAX_MISORDER (100)
+#define MAX_CUMULATIVE_LOST (0x7fffff)
+#define MIN_CUMULATIVE_LOST (-0x800000)
+
+RtpReceiveStats::RtpReceiveStats()
+{
+    m_nReporterSSRC = 0x34567890;
+    m_nIgnorePayloadType = -1;
+    Reset();
+}
+
+RtpReceiveStats::~RtpReceiveStats()
+{
+}
+
+void RtpReceiveStats::SetReporterSSRC(uint32_t ssrc)
+{
+    std::lock_guard<std::mutex> lock(m_StatsLock);
+    m_nReporterSSRC = ssrc;
+}
+
+void RtpReceiveStats::SetIgnorePayloadType(int32_t pt)
+{
+    std::lock_guard<std::mutex> lock(m_StatsLock);
+    m_nIgnorePayloadType = pt;
+}
+
+void RtpReceiveStats::Reset()
+{
+    std::lock_guard<std::mutex> lock(m_StatsLock);
+    m_bRecvFirstPacket = false;
+    m_nSourceSSRC = 0;
+    m_nMaxSeq = 0;
+    m_nCycles = 0;
+    m_nBaseSeq = 0;
+    m_nReceived = 0;
+    m_nExpectedPrior = 0;
+    m_nReceivedPrior = 0;
+    m_bHasTransit = false;
+    m_nLastTransit = 0;
+    m_nJitter = 0;
+    m_nLastSR = 0;
+    m_lLastSRArrival = 0;
+}
+
+//the arrival time is taken in MEDIA_CLOCK_RATE units,which is also the clock rate of the video RTP timestamps
+void RtpReceiveStats::RecvRtpPacket(const uint8_t* rtp, uint32_t size, uint64_t arrival)
+{
+    if (rtp == nullptr || size < 12)
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_StatsLock);
+    if ((rtp[1] & 0x7f) == m_nIgnorePayloadType)
+    {
+        return;
+    }
+
+    uint16_t seq = (rtp[2] << 8) | rtp[3];
+    uint32_t timestamp = ((uint32_t)rtp[4] << 24) | (rtp[5] << 16) | (rtp[6] << 8) | rtp[7];
+    uint32_t ssrc = ((uint32_t)rtp[8] << 24) | (rtp[9] << 16) | (rtp[10] << 8) | rtp[11];
+
+    uint16_t delta = seq - m_nMaxSeq;
+    if (!m_bRecvFirstPacket || ssrc != m_nSourceSSRC || (delta >= MAX_DROPOUT && delta <= 65536 - MAX_MISORDER))
+    {
+        //first packet,new source or the sender restarted its sequence
+        m_bRecvFirstPacket = true;
+        m_nSourceSSRC = ssrc;
+        m_nBaseSeq = seq;
+        m_nMaxSeq = seq;
+        m_nCycles = 0;
+        m_nReceived = 0;
+        m_nExpectedPrior = 0;
+        m_nReceivedPrior = 0;
+        m_bHasTransit = false;
+    }
+    else if (delta < MAX_DROPOUT)
+    {
+        if (seq < m_nMaxSeq)
+        {
+            m_nCycles += 65536;
+        }
+        m_nMaxSeq = seq;
+    }
+    m_nReceived++;
+
+    uint32_t transit = (uint32_t)arrival - timestamp;
+    if (m_bHasTransit)
+    {
+        int32_t d = (int32_t)(transit - m_nLastTransit);
+        if (d < 0)
+        {
+            d = -d;
+        }
+        m_nJitter += d - ((m_nJitter + 8) >> 4);
+    }
+    m_nLastTransit = transit;
+    m_bHasTransit = true;
+}
+
+void RtpReceiveStats::RecvSenderReport(const RTCPPacket::SenderInfo& info, uint64_t arrival)
+{
+    std::lock_guard<std::mutex> lock(m_StatsLock);
+    m_nLastSR = RTCPPacket::GetCompactNTP(info.m_lNTPTime);
+    m_lLastSRArrival = arrival;
+}
+
+bool RtpReceiveStats::MakeReportBlock(RTCPPacket::ReportBlock& block, uint64_t now)
+{
+    std::lock_guard<std::mutex> lock(m_StatsLock);
+    //stay silent through an outage,the sender backs off when the reports stop
+    if (!m_bRecvFirstPacket || m_nReceived == m_nReceivedPrior)
+    {
+        return false;
+    }
+
+    uint32_t extendedMax = m_nCycles + m_nMaxSeq;
+    uint32_t expected = extendedMax - m_nBaseSeq + 1;
+    int64_t lost = (int64_t)expected - m_nReceived;
+    lost = lost > MAX_CUMULATIVE_LOST ? MAX_CUMULATIVE_LOST : lost < MIN_CUMULATIVE_LOST ? MIN_CUMULATIVE_LOST : lost;
+
+    uint32_t expectedInterval = expected - m_nExpectedPrior;
+    uint32_t receivedInterval = m_nReceived - m_nReceivedPrior;
+    m_nExpectedPrior = expected;
+    m_nReceivedPrior = m_nReceived;
+    int64_t lostInterval = (int64_t)expectedInterval - receivedInterval;
+    uint32_t fraction = (expectedInterval == 0 || lostInterval <= 0) ? 0 : (uint32_t)((lostInterval << 8) / expectedInterval);
+
+    block.m_nReporterSSRC = m_nReporterSSRC;
+    block.m_nSourceSSRC = m_nSourceSSRC;
+    block.m_nFractionLost = fraction > 255 ? 255 : fraction;
+    block.m_nCumulativeLost = (int32_t)lost;
+    block.m_nHighestSeq = extendedMax;
+    block.m_nJitter = m_nJitter >> 4;
+    block.m_nLSR = m_nLastSR;
+    block.m_nDLSR = m_nLastSR == 0 ? 0 : (uint32_t)((now - m_lLastSRArrival) * 65536 / MEDIA_CLOCK_RATE);
+
+    return true;
+}
\ No newline at end of file
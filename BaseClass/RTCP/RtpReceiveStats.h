@@ -0,0 +1,41 @@
+#pragma once
+#include <cstdint>
+#include <mutex>
+#include "RTCPPacket.h"
+
+//Receiver side statistics of one RTP stream(RFC 3550 A.1/A.3/A.8),all times in MEDIA_CLOCK_RATE units
+class RtpReceiveStats
+{
+public:
+    RtpReceiveStats();
+    ~RtpReceiveStats();
+
+    void SetReporterSSRC(uint32_t ssrc);
+    void SetIgnorePayloadType(int32_t pt);      //FEC repair packets have their own sequence space
+    void Reset();
+
+    void RecvRtpPacket(const uint8_t* rtp, uint32_t size, uint64_t arrival);
+    void RecvSenderReport(const RTCPPacket::SenderInfo& info, uint64_t arrival);
+    bool MakeReportBlock(RTCPPacket::ReportBlock& block, uint64_t now);   //false when nothing arrived since the last report
+
+private:
+    std::mutex m_StatsLock;
+    uint32_t m_nReporterSSRC;
+    int32_t m_nIgnorePayloadType;
+
+    bool m_bRecvFirstPacket;
+    uint32_t m_nSourceSSRC;
+    uint16_t m_nMaxSeq;
+    uint32_t m_nCycles;
+    uint32_t m_nBaseSeq;
+    uint32_t m_nReceived;
+    uint32_t m_nExpectedPrior;
+    uint32_t m_nReceivedPrior;
+
+    bool m_bHasTransit;
+    uint32_t m_nLastTransit;
+    uint32_t m_nJitter;         //scaled by 16
+
+    uint32_t m_nLastSR;
+    uint64_t m_lLastSRArrival;
+};
\ No newline at end of file
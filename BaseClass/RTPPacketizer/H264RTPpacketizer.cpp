@@ -7,6 +7,18 @@
 extern bool FindSPS(uint8_t* data, uint32_t size, uint8_t*& sps, uint32_t& spsSize);
 extern bool FindPPS(uint8_t* data, uint32_t size, uint8_t*& pps, uint32_t& ppsSize);
 
+static uint8_t GetNaluPriority(uint8_t header)
+{
+    uint8_t type = header & 0x1f;
+    if (type == 5 || type == 7 || type == 8)
+    {
+        return PACKET_PRIORITY_HIGH;
+    }
+
+    //nal_ref_idc 0,nothing is predicted from it
+    return (header & 0x60) == 0 ? PACKET_PRIORITY_LOW : PACKET_PRIORITY_NORMAL;
+}
+
 H264RTPpacketizer::H264RTPpacketizer()
 {
     m_nPayloadType = 96;
@@ -21,6 +33,7 @@ H264RTPpacketizer::H264RTPpacketizer()
 
     m_bHasSendSPSBeforeIFrame = false;
     m_bHasSendPPSBeforeIFrame = false;
+    m_nPriority = PACKET_PRIORITY_NORMAL;
 
     m_pRtpPacketCallbaclk = nullptr;
 }
@@ -176,6 +189,7 @@ int32_t H264RTPpacketizer::RecvPacket(std::shared_ptr<MediaPacket> packet)
 
         {
             std::lock_guard<std::mutex> lock(m_PacketizerLock);
+            m_nPriority = GetNaluPriority(data[0]);
             if (size <= MAX_RTP_LEN)
             {
                 ret = PacketAsSingleNalu(data, size, time);
@@ -224,6 +238,7 @@ int32_t H264RTPpacketizer::PacketSPS(uint32_t time)
     }
 
     int32_t ret = 0;
+    m_nPriority = PACKET_PRIORITY_HIGH;
     if (m_nSPSLen <= MAX_RTP_LEN)
     {
         ret = PacketAsSingleNalu(m_pSPS, m_nSPSLen, time);
@@ -245,6 +260,7 @@ int32_t H264RTPpacketizer::PacketPPS(uint32_t time)
     }
 
     int32_t ret = 0;
+    m_nPriority = PACKET_PRIORITY_HIGH;
     if (m_nPPSLen <= MAX_RTP_LEN)
     {
         ret = PacketAsSingleNalu(m_pPPS, m_nPPSLen, time);
@@ -285,7 +301,7 @@ int32_t H264RTPpacketizer::PacketAsSingleNalu(uint8_t* data, uint32_t size, uint
     memcpy(&m_pRtpBuff[12], data, size);
     if (m_pRtpPacketCallbaclk != nullptr)
     {
-        m_pRtpPacketCallbaclk(m_pRtpBuff, 12U + size);
+        m_pRtpPacketCallbaclk(m_pRtpBuff, 12U + size, m_nPriority);
     }
 
     return 0;
@@ -317,7 +333,7 @@ int32_t H264RTPpacketizer::PacketAsFUAStart(uint8_t* data, uint32_t size, uint8_
     memcpy(&m_pRtpBuff[14], data, size);
     if (m_pRtpPacketCallbaclk != nullptr)
     {
-        m_pRtpPacketCallbaclk(m_pRtpBuff, 14U + size);
+        m_pRtpPacketCallbaclk(m_pRtpBuff, 14U + size, m_nPriority);
     }
 
     return 0;
@@ -349,7 +365,7 @@ int32_t H264RTPpacketizer::PacketAsFUAMiddle(uint8_t* data, uint32_t size, uint8
     memcpy(&m_pRtpBuff[14], data, size);
     if (m_pRtpPacketCallbaclk != nullptr)
     {
-        m_pRtpPacketCallbaclk(m_pRtpBuff, 14U + size);
+        m_pRtpPacketCallbaclk(m_pRtpBuff, 14U + size, m_nPriority);
     }
 
     return 0;
@@ -381,7 +397,7 @@ int32_t H264RTPpacketizer::PacketAsFUAEnd(uint8_t* data, uint32_t size, uint8_t
     memcpy(&m_pRtpBuff[14], data, size);
     if (m_pRtpPacketCallbaclk != nullptr)
     {
-        m_pRtpPacketCallbaclk(m_pRtpBuff, 14U + size);
+        m_pRtpPacketCallbaclk(m_pRtpBuff, 14U + size, m_nPriority);
     }
 
     return 0;
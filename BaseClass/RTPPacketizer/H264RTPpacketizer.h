@@ -45,6 +45,7 @@ private:
 
     bool m_bHasSendSPSBeforeIFrame;
     bool m_bHasSendPPSBeforeIFrame;
+    uint8_t m_nPriority;                //of the NALU being packetized
 
     RTPPacketizer::RtpPacketCallbaclk m_pRtpPacketCallbaclk;
 
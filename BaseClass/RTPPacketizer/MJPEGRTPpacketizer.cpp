@@ -169,7 +169,7 @@ int32_t MJPEGRTPpacketizer::PacketAsSingleNalu(uint8_t* data, uint32_t size, uin
     memcpy(&m_pRtpBuff[13], data, size);
     if (m_pRtpPacketCallbaclk != nullptr)
     {
-        m_pRtpPacketCallbaclk(m_pRtpBuff, 13U + size);
+        m_pRtpPacketCallbaclk(m_pRtpBuff, 13U + size, PACKET_PRIORITY_NORMAL);
     }
 
     return 0;
@@ -201,7 +201,7 @@ int32_t MJPEGRTPpacketizer::PacketAsFUAStart(uint8_t* data, uint32_t size, uint8
     memcpy(&m_pRtpBuff[14], data, size);
     if (m_pRtpPacketCallbaclk != nullptr)
     {
-        m_pRtpPacketCallbaclk(m_pRtpBuff, 14U + size);
+        m_pRtpPacketCallbaclk(m_pRtpBuff, 14U + size, PACKET_PRIORITY_NORMAL);
     }
 
     return 0;
@@ -233,7 +233,7 @@ int32_t MJPEGRTPpacketizer::PacketAsFUAMiddle(uint8_t* data, uint32_t size, uint
     memcpy(&m_pRtpBuff[14], data, size);
     if (m_pRtpPacketCallbaclk != nullptr)
     {
-        m_pRtpPacketCallbaclk(m_pRtpBuff, 14U + size);
+        m_pRtpPacketCallbaclk(m_pRtpBuff, 14U + size, PACKET_PRIORITY_NORMAL);
     }
 
     return 0;
@@ -265,7 +265,7 @@ int32_t MJPEGRTPpacketizer::PacketAsFUAEnd(uint8_t* data, uint32_t size, uint8_t
     memcpy(&m_pRtpBuff[14], data, size);
     if (m_pRtpPacketCallbaclk != nullptr)
     {
-        m_pRtpPacketCallbaclk(m_pRtpBuff, 14U + size);
+        m_pRtpPacketCallbaclk(m_pRtpBuff, 14U + size, PACKET_PRIORITY_NORMAL);
     }
 
     return 0;
@@ -8,7 +8,7 @@
 class RTPPacketizer
 {
 public:
-    typedef std::function<void(uint8_t* pRtpPacket, uint32_t size)> RtpPacketCallbaclk;
+    typedef std::function<void(uint8_t* pRtpPacket, uint32_t size, uint8_t priority)> RtpPacketCallbaclk;     //priority:PacketPriority
 
 public:
     virtual ~RTPPacketizer() {};
@@ -27,4 +27,5 @@ private:
     uint32_t m_nSSRC;
 
     uint32_t m_nLastPackTime;
+    uint64_t m_lMediaTime;
 };
\ No newline at end of file
@@ -7,6 +7,7 @@ MJPEGRTPParser::MJPEGRTPParser()
     m_nPaylodaType = 97;
     m_nSSRC = 0;
     m_nLastPackTime = 0;
+    m_lMediaTime = 0;
 }
 
 MJPEGRTPParser::~MJPEGRTPParser()
@@ -21,6 +22,7 @@ int32_t MJPEGRTPParser::ReleaseAll()
     m_nPaylodaType = 97;
     m_nSSRC = 0;
     m_nLastPackTime = 0;
+    m_lMediaTime = 0;
 
     return 0;
 }
@@ -73,8 +75,8 @@ int32_t MJPEGRTPParser::OutputMediaPacket()
     }
 
     std::shared_ptr<MediaPacket> pMediaPacket = std::make_shared<MediaPacket>();
-    pMediaPacket->m_lDTS = m_nLastPackTime;
-    pMediaPacket->m_lPTS = m_nLastPackTime;
+    pMediaPacket->m_lDTS = m_lMediaTime;
+    pMediaPacket->m_lPTS = m_lMediaTime;
     pMediaPacket->m_nFrameType = 0;
     pMediaPacket->m_nLength = size;
     pMediaPacket->m_pData = data;
@@ -112,6 +114,14 @@ int32_t MJPEGRTPParser::RecvPacket(const std::shared_ptr<Packet>& packet)
     {
         OutputMediaPacket();
         m_PacketBuff.ClearBuff();
+        if (m_lMediaTime == 0)
+        {
+            m_lMediaTime = time;
+        }
+        else
+        {
+            m_lMediaTime += (int32_t)(time - m_nLastPackTime);
+        }
         m_nLastPackTime = time;
     }
 
@@ -26,4 +26,5 @@ private:
     uint32_t m_nSSRC;
 
     uint32_t m_nLastPackTime;
+    uint64_t m_lMediaTime;
 };
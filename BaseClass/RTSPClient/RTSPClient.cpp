@@ -1,13 +1,18 @@
 #include <fcntl.h>
+#include <time.h>
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/epoll.h>
 #include <arpa/inet.h>
 #include <string.h>
 #include "RTSPClient.h"
 #include "Log/Log.h"
 #include "CommonTools/RtspParser.h"
 #include "CommonTools/SdpParser.h"
+#include "CommonTools/LatencyTracer.h"
+#include "CommonTools/FramePool.h"
+#include "RTCP/RTCPPacket.h"
 #include "RTPParser/H264RTPParser.h"
 #include "RTPParser/MJPEGRTPParser.h"
 
@@ -15,6 +20,12 @@
 #define HEART_BEAT_CYCLE (15*1000)
 #define HEART_BEAT_TIMEOUT (60*1000)
 #define RECV_TIMEOUT 10*1000
+#define RECEIVER_REPORT_CYCLE (500)
+#define CLIENT_WAIT_TIME (20)           //ms,longest epoll wait,bounds how long closing takes
+#define MAX_EPOLL_EVENTS (8)
+#define RECV_BATCH_NUM (16)             //datagrams per recvmmsg
+#define RECV_SLOT_SIZE (2048)           //a media datagram is at most MAX_RTP_LEN plus FEC headers
+#define RECV_SLAB_SLOT_NUM (2048)       //enough for the jitter buffer and the FEC blocks to hold on to
 
 RTSPClient::RTSPClient()
 {
@@ -23,10 +34,13 @@ RTSPClient::RTSPClient()
     m_nServerPort = 0;
     m_bCloseClient = true;
     m_pClientThread = nullptr;
+    m_nEpollfd = -1;
     m_bIsPlaying = false;
     m_strPlayUrl = "";
     m_strPlayUrlNoExParam = "";
     m_nSeq = 0;
+    m_nOptionsSeq = -1;
+    m_fRoundTripTime = 0;
     m_bIsRecord = false;
     m_bEnableFec = false;
 
@@ -44,6 +58,10 @@ RTSPClient::RTSPClient()
     m_nVideoRtcpfd = -1;
     m_nAudioRtpfd = -1;
     m_nAudioRtcpfd = -1;
+    m_nVideoServerRtcpPort = 0;
+    m_bKernelTimestamp = false;
+    m_pRecvSlab = nullptr;
+    m_VideoReceiveStats.SetIgnorePayloadType(m_FECConfig.m_nPayloadType);
 
     m_pVideoParser = nullptr;
     m_pFECDecoder = nullptr;
@@ -77,6 +95,13 @@ int32_t RTSPClient::ReleaseAll()
         m_pClientThread = nullptr;
     }
 
+    if (m_nEpollfd != -1)
+    {
+        close(m_nEpollfd);
+        m_nEpollfd = -1;
+    }
+    m_RecvSlots.clear();
+    m_pRecvSlab = nullptr;
     if (m_nClientSocketfd != -1)
     {
         close(m_nClientSocketfd);
@@ -103,6 +128,9 @@ int32_t RTSPClient::ReleaseAll()
         m_nAudioRtcpfd = -1;
     }
 
+    m_nVideoServerRtcpPort = 0;
+    m_VideoReceiveStats.Reset();
+
     m_strClientIP = "";
     m_nClientPort = 0;
     m_strServerIP = "";
@@ -131,6 +159,8 @@ int32_t RTSPClient::ReleaseAll()
         m_RtspResponseMap.clear();
     }
     m_nSeq = 0;
+    m_nOptionsSeq = -1;
+    m_fRoundTripTime = 0;
     m_strSessionId = "";
 
     delete m_pAudioParser;
@@ -152,6 +182,8 @@ int32_t RTSPClient::PlayUrl(const std::string& url, TransportType t)
 {
     Trace("[%p][RTSPClient::PlayUrl] play url:%s TransportType:%d", this, url.c_str(), t);
     CloseClient();
+    //timestamps are stamped by the server clock
+    LatencyTracer::GetTracer()->SetRemoteClock(true);
 
     std::string ip;
     uint16_t port;
@@ -212,6 +244,22 @@ int32_t RTSPClient::PlayUrl(const std::string& url, TransportType t)
     GetLocalIPAndPort(m_nClientSocketfd, m_strClientIP, m_nClientPort);
     GetRemoteIPAndPort(m_nClientSocketfd, m_strServerIP, m_nServerPort);
 
+    m_nEpollfd = epoll_create1(EPOLL_CLOEXEC);
+    if (m_nEpollfd == -1 || AddEpollSocket(m_nClientSocketfd) != 0)
+    {
+        Error("[%p][RTSPClient::PlayUrl] create epoll fail,errno:%d", this, errno);
+        ret = -4;
+        goto fail;
+    }
+    m_pRecvSlab = std::make_shared<PacketSlab>();
+    if (m_pRecvSlab->Init(RECV_SLAB_SLOT_NUM, RECV_SLOT_SIZE) != 0)
+    {
+        Error("[%p][RTSPClient::PlayUrl] init recv slab fail", this);
+        ret = -4;
+        goto fail;
+    }
+    m_RecvSlots.resize(RECV_BATCH_NUM);
+
     m_bCloseClient = false;
     m_pClientThread = new std::thread(&RTSPClient::ClientThread, this);
 
@@ -309,27 +357,39 @@ void RTSPClient::ClientThread()
         return;
     }
 
-    bool m_bNeedWait;
+    struct epoll_event events[MAX_EPOLL_EVENTS];
     m_HeartBeatCycleTimer.MakeTimePoint();
+    m_ReceiverReportTimer.MakeTimePoint();
 
     while (!m_bCloseClient)
     {
-        m_bNeedWait = false;
-        ssize_t len = recv(m_nClientSocketfd, pRecvBuff, RECV_BUFF_SIZE, 0);
-        if (len == -1)
+        int num = epoll_wait(m_nEpollfd, events, MAX_EPOLL_EVENTS, GetWaitTime());
+        if (num < 0 && errno != EINTR)
         {
-            int err = errno;
-            if (err != EAGAIN)
+            Error("[%p][RTSPClient::ClientThread] epoll_wait error:%d", this, errno);
+            break;
+        }
+
+        bool bClosed = false;
+        for (int i = 0; i < num; i++)
+        {
+            int32_t fd = events[i].data.fd;
+            if (fd == m_nClientSocketfd)
             {
-                Error("[%p][RTSPClient::ClientThread]  recv error:%d", this, err);
-                break;
+                bClosed = RecvRtspMsg(pRecvBuff, RECV_BUFF_SIZE) != 0;
+            }
+            else if (fd == m_nVideoRtpfd)
+            {
+                RecvVideoBatch();
+            }
+            else
+            {
+                RecvUDPMedia(fd, pRecvBuff, RECV_BUFF_SIZE);
             }
-            m_bNeedWait = true;
         }
-        else
+        if (bClosed)
         {
-            m_ClientBuff.Append(pRecvBuff, len);
-            HandleMsg();
+            break;
         }
 
         if (m_HeartBeatCycleTimer.GetDuration() > HEART_BEAT_CYCLE)
@@ -338,14 +398,10 @@ void RTSPClient::ClientThread()
             m_HeartBeatCycleTimer.MakeTimePoint();
         }
 
-        if (RecvUDPMedia(pRecvBuff, RECV_BUFF_SIZE) > 0)
-        {
-            m_bNeedWait = false;
-        }
-
-        if (m_bNeedWait)
+        if (m_ReceiverReportTimer.GetDuration() > RECEIVER_REPORT_CYCLE)
         {
-            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            SendReceiverReport();
+            m_ReceiverReportTimer.MakeTimePoint();
         }
     }
 
@@ -359,6 +415,54 @@ void RTSPClient::ClientThread()
     ReleaseThread.detach();
 }
 
+int32_t RTSPClient::AddEpollSocket(int32_t fd)
+{
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    if (epoll_ctl(m_nEpollfd, EPOLL_CTL_ADD, fd, &event) != 0)
+    {
+        Error("[%p][RTSPClient::AddEpollSocket] add fd:%d fail,errno:%d", this, fd, errno);
+        return -1;
+    }
+
+    return 0;
+}
+
+//until the next keepalive or receiver report is due
+int32_t RTSPClient::GetWaitTime()
+{
+    double wait = HEART_BEAT_CYCLE - m_HeartBeatCycleTimer.GetDuration();
+    double report = RECEIVER_REPORT_CYCLE - m_ReceiverReportTimer.GetDuration();
+    wait = report < wait ? report : wait;
+    return wait <= 0 ? 0 : wait >= CLIENT_WAIT_TIME ? CLIENT_WAIT_TIME : (int32_t)wait + 1;
+}
+
+int32_t RTSPClient::RecvRtspMsg(uint8_t* pRecvBuff, int32_t size)
+{
+    ssize_t len = recv(m_nClientSocketfd, pRecvBuff, size, 0);
+    if (len == -1)
+    {
+        int err = errno;
+        if (err != EAGAIN && err != EINTR)
+        {
+            Error("[%p][RTSPClient::RecvRtspMsg]  recv error:%d", this, err);
+            return -1;
+        }
+        return 0;
+    }
+    if (len == 0)
+    {
+        Error("[%p][RTSPClient::RecvRtspMsg] server closed the connection", this);
+        return -2;
+    }
+
+    m_ClientBuff.Append(pRecvBuff, len);
+    HandleMsg();
+    return 0;
+}
+
 bool RTSPClient::IsRtspRequestMsg(uint8_t* const  msg, const uint32_t size)
 {
     bool ret = strcmp((char*)msg, "OPTIONS ") == 0 ? true :
@@ -646,6 +750,16 @@ int32_t RTSPClient::OnRecvRtspResponse(const  std::shared_ptr<RtspParser::RtspRe
     if (rsp->m_FieldsMap.find("CSeq") != rsp->m_FieldsMap.end())
     {
         seq = atoi(rsp->m_FieldsMap.at("CSeq").c_str());
+        if (seq == m_nOptionsSeq)
+        {
+            double rtt = m_OptionsTimer.GetDuration();
+            m_fRoundTripTime = m_fRoundTripTime == 0 ? rtt : (m_fRoundTripTime * 3 + rtt) / 4;
+            m_nOptionsSeq = -1;
+            if (m_pFECDecoder != nullptr)
+            {
+                m_pFECDecoder->SetRoundTripTime(m_fRoundTripTime);
+            }
+        }
         {
             std::lock_guard<std::mutex> lock(m_RtspResponseMapLock);
             m_RtspResponseMap[seq] = rsp;
@@ -663,6 +777,96 @@ int32_t RTSPClient::OnRecvRtspResponse(const  std::shared_ptr<RtspParser::RtspRe
 
 int32_t RTSPClient::OnRecvRtcp(uint8_t* const  msg, const uint32_t size)
 {
+    int32_t trackId = (msg[1] >> 1) + 1;
+    if (trackId == m_nVideoTrackID)
+    {
+        OnRecvVideoRtcp(msg + 4, size - 4);
+    }
+
+    return 0;
+}
+
+int32_t RTSPClient::OnRecvVideoRtcp(const uint8_t* data, const uint32_t size)
+{
+    uint32_t ssrc = 0;
+    std::string attribute;
+    if (m_pFECDecoder != nullptr && RTCPPacket::ParseFECConfig(data, size, ssrc, attribute) == 0)
+    {
+        FECBlock::Config config;
+        int32_t ret = FECBlock::ParseSdpAttribute(attribute, config);
+        if (ret != 0 || m_pFECDecoder->SetConfig(config, ssrc) != 0)
+        {
+            Warn("[%p][RTSPClient::OnRecvVideoRtcp] fec:%s ssrc:%08x not usable", this, attribute.c_str(), ssrc);
+        }
+    }
+
+    RTCPPacket::SenderInfo info;
+    int32_t ret = RTCPPacket::ParseSenderReport(data, size, info);
+    if (ret != 0)
+    {
+        if (ret != -2)
+        {
+            Warn("[%p][RTSPClient::OnRecvVideoRtcp] ParseSenderReport fail,return:%d", this, ret);
+        }
+        return 0;
+    }
+
+    m_VideoReceiveStats.RecvSenderReport(info, TimeCounter::GetMediaTime());
+    return 0;
+}
+
+int32_t RTSPClient::SendReceiverReport()
+{
+    RTCPPacket::ReportBlock block;
+    if (!m_VideoReceiveStats.MakeReportBlock(block, TimeCounter::GetMediaTime()))
+    {
+        return 0;
+    }
+
+    std::shared_ptr<Packet> packet = RTCPPacket::MakeReceiverReport(block);
+    if (packet == nullptr)
+    {
+        Error("[%p][RTSPClient::SendReceiverReport] MakeReceiverReport fail", this);
+        return -1;
+    }
+
+    return SendVideoRtcp(packet);
+}
+
+//RTCP goes where the RTP came from:the server RTCP port,or the odd interleaved channel of the track
+int32_t RTSPClient::SendVideoRtcp(const std::shared_ptr<Packet>& packet)
+{
+    ssize_t ret = -1;
+    if (m_eVideoTransport == TransportType::TCP)
+    {
+        std::vector<uint8_t> buff(packet->m_nLength + 4);
+        buff[0] = 0x24;
+        buff[1] = ((m_nVideoTrackID - 1) << 1) + 1;
+        buff[2] = packet->m_nLength >> 8;
+        buff[3] = packet->m_nLength & 0xff;
+        memcpy(buff.data() + 4, packet->m_pData, packet->m_nLength);
+        ret = send(m_nClientSocketfd, buff.data(), buff.size(), 0);
+    }
+    else if (m_nVideoRtcpfd != -1 && m_nVideoServerRtcpPort != 0)
+    {
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(struct sockaddr_in));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(m_nVideoServerRtcpPort);
+        addr.sin_addr.s_addr = inet_addr(m_strServerIP.c_str());
+        ret = sendto(m_nVideoRtcpfd, packet->m_pData, packet->m_nLength, 0, (sockaddr*)&addr, sizeof(addr));
+    }
+    else
+    {
+        return 0;
+    }
+
+    if (ret < 0)
+    {
+        Warn("[%p][RTSPClient::SendVideoRtcp] send fail,errno:%d", this, errno);
+        return -2;
+    }
+
     return 0;
 }
 
@@ -859,6 +1063,11 @@ int32_t RTSPClient::SendRtspRequest(RtspParser::RtspRequest& req)
 {
     m_nSeq++;
     req.m_FieldsMap["CSeq"] = std::to_string(m_nSeq);
+    if (req.m_RtspMethod == RtspParser::RTSP_METHOD_OPTIONS)
+    {
+        m_nOptionsSeq = m_nSeq;
+        m_OptionsTimer.MakeTimePoint();
+    }
     if (m_strSessionId != "")
     {
         req.m_FieldsMap["Session"] = m_strSessionId;
@@ -943,6 +1152,11 @@ int32_t RTSPClient::Describe()
     RtspParser::RtspRequest req;
     req.m_RtspMethod = RtspParser::RTSP_METHOD_DESCRIBE;
     req.m_FieldsMap["Accept"] = "application/sdp";
+    if (m_eVideoTransport == TransportType::TCP)
+    {
+        //no repairs go over TCP,the server leaves a=x-fec out
+        req.m_FieldsMap["Transport"] = "RTP/AVP/TCP";
+    }
     req.m_StrUrl = m_strPlayUrl;
     int32_t ret = SendRtspRequest(req);
     if (ret != 0)
@@ -1016,6 +1230,16 @@ int32_t RTSPClient::Describe()
             m_nVideoTrackID = description.nTrackID;
             m_nVideoClockRate = description.nClockRate;
 
+            m_FECConfig = FECBlock::Config();
+            auto fec = description.field.find("x-fec");
+            if (fec != description.field.end() && FECBlock::ParseSdpAttribute(fec->second, m_FECConfig) != 0)
+            {
+                Error("[%p][RTSPClient::Describe] parse fec:%s fail", this, fec->second.c_str());
+                return -8;
+            }
+            Trace("[%p][RTSPClient::Describe] fec:%s", this, FECBlock::MakeSdpAttribute(m_FECConfig).c_str());
+            m_VideoReceiveStats.SetIgnorePayloadType(m_FECConfig.m_nPayloadType);
+
             if (m_pVideoReadyCallbaclk != nullptr)
             {
                 VideoInfo info;
@@ -1170,11 +1394,19 @@ int32_t RTSPClient::Setup(int32_t trackid)
         {
             m_nVideoRtpfd = nRtpfd;
             m_nVideoRtcpfd = nRtcpfd;
+            int on = 1;
+            if (m_bKernelTimestamp && setsockopt(nRtpfd, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on)) != 0)
+            {
+                Warn("[%p][RTSPClient::Setup] enable SO_TIMESTAMPNS fail,errno:%d", this, errno);
+            }
+            AddEpollSocket(nRtpfd);
+            AddEpollSocket(nRtcpfd);
         }
         else
         {
             m_nAudioRtpfd = nRtpfd;
             m_nAudioRtcpfd = nRtcpfd;
+            AddEpollSocket(nRtpfd);
         }
 
         req.m_FieldsMap["Transport"] = "RTP/AVP/UDP;unicast;client_port=" +
@@ -1218,6 +1450,18 @@ int32_t RTSPClient::Setup(int32_t trackid)
             m_strSessionId = rsp->m_FieldsMap["Session"];
         }
     }
+
+    //the server answers with "server_port=rtp-rtcp",the receiver reports go to the rtcp one
+    std::string strTransport =
+        rsp->m_FieldsMap.find("Transport") != rsp->m_FieldsMap.end() ? rsp->m_FieldsMap["Transport"] :
+        rsp->m_FieldsMap.find("transport") != rsp->m_FieldsMap.end() ? rsp->m_FieldsMap["transport"] : "";
+    size_t pos = strTransport.find("server_port=");
+    if (trackid == m_nVideoTrackID && pos != std::string::npos)
+    {
+        std::vector<std::string> ports;
+        split(strTransport.substr(pos + strlen("server_port=")), ports, "-");
+        m_nVideoServerRtcpPort = ports.size() < 2 ? 0 : atoi(ports[1].c_str());
+    }
     if (rsp->m_StrErrcode != "200")
     {
         Error("[%p][RTSPClient::Setup] Setup request fail,code:%s", this, rsp->m_StrErrcode.c_str());
@@ -1244,9 +1488,11 @@ int32_t RTSPClient::Setup(int32_t trackid)
             m_pFECDecoder->SetDecoderPacketCallback(pFECDecoderPacketCallback);
             RFC8627FECDecoder::NackPacketCallback pNackPacketCallback = std::bind(&RTSPClient::OnRecvNackPacket, this, std::placeholders::_1);
             m_pFECDecoder->SetNackPacketCallback(pNackPacketCallback);
-            m_pFECDecoder->SetPayloadType(109);
+            m_pFECDecoder->SetPayloadType(m_FECConfig.m_nPayloadType);
+            LatencyTracer::GetTracer()->SetRepairPayloadType(m_FECConfig.m_nPayloadType);
             m_pFECDecoder->SetSSRC(0x23456789);
-            m_pFECDecoder->Init(7, 7, 5);
+            m_pFECDecoder->Init(m_FECConfig);
+            m_pFECDecoder->SetRoundTripTime(m_fRoundTripTime);
         }
     }
     else
@@ -1447,6 +1693,7 @@ int32_t GetRemoteIPAndPort(int32_t fd, std::string& ip, uint16_t& port)
     return 0;
 }
 
+//interleaved on the rtsp connection,the bytes are only borrowed
 int32_t RTSPClient::OnRecvVideo(uint8_t* const  msg, const uint32_t size)
 {
     uint8_t* data = (uint8_t*)malloc(size);
@@ -1460,6 +1707,15 @@ int32_t RTSPClient::OnRecvVideo(uint8_t* const  msg, const uint32_t size)
     packet->m_pData = data;
     packet->m_nLength = size;
 
+    return OnRecvVideoPacket(packet);
+}
+
+int32_t RTSPClient::OnRecvVideoPacket(const std::shared_ptr<Packet>& packet)
+{
+    uint64_t arrival = packet->m_lArrivalTime != 0 ? packet->m_lArrivalTime : TimeCounter::GetMediaTime();
+    m_VideoReceiveStats.RecvRtpPacket(packet->m_pData, packet->m_nLength, arrival);
+    LatencyTracer::GetTracer()->RecordRtp(LatencyTracer::STAGE_CLIENT_RECV, packet->m_pData, packet->m_nLength);
+
     if (m_bEnableFec)
     {
         if (m_pFECDecoder != nullptr)
@@ -1480,6 +1736,7 @@ int32_t RTSPClient::OnRecvVideo(uint8_t* const  msg, const uint32_t size)
 
 void RTSPClient::OnRecvFECDecoderPacket(const std::shared_ptr<Packet>& packet)
 {
+    LatencyTracer::GetTracer()->RecordRtp(LatencyTracer::STAGE_CLIENT_FEC, packet->m_pData, packet->m_nLength);
     if (m_pVideoParser != nullptr)
     {
         m_pVideoParser->RecvPacket(packet);
@@ -1488,7 +1745,7 @@ void RTSPClient::OnRecvFECDecoderPacket(const std::shared_ptr<Packet>& packet)
 
 void RTSPClient::OnRecvNackPacket(const std::shared_ptr<Packet>& packet)
 {
-
+    SendVideoRtcp(packet);
 }
 
 int32_t RTSPClient::OnRecvAudio(uint8_t* const  msg, const uint32_t size)
@@ -1514,28 +1771,122 @@ int32_t RTSPClient::SetVideoReadyCallbaclk(RTSPClient::VideoReadyCallbaclk callb
     return 0;
 }
 
-int32_t RTSPClient::RecvUDPMedia(uint8_t* pRecvBuff, int32_t size)
+int32_t RTSPClient::SetKernelTimestamp(bool enable)
 {
-    int32_t nRecv = 0;
-    if (m_nVideoRtpfd != -1)
+    m_bKernelTimestamp = enable;
+    return 0;
+}
+
+//SO_TIMESTAMPNS is CLOCK_REALTIME,moved onto the media clock by how long ago it was
+static uint64_t GetKernelArrivalTime(struct msghdr* hdr, uint64_t now, const struct timespec& realNow)
+{
+    for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(hdr); cmsg != nullptr; cmsg = CMSG_NXTHDR(hdr, cmsg))
     {
-        ssize_t len = recv(m_nVideoRtpfd, pRecvBuff, size, 0);
-        if (len > 0)
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS)
         {
-            OnRecvVideo(pRecvBuff, len);
-            nRecv += len;
+            struct timespec ts;
+            memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+            int64_t age = ((int64_t)realNow.tv_sec - ts.tv_sec) * 1000000 + ((int64_t)realNow.tv_nsec - ts.tv_nsec) / 1000;
+            uint64_t delta = age > 0 ? TimeCounter::MicrosecondsToMediaTime(age) : 0;
+            return delta < now ? now - delta : now;
         }
     }
 
-    if (m_nAudioRtpfd != -1)
+    return 0;
+}
+
+int32_t RTSPClient::RecvVideoBatch()
+{
+    struct mmsghdr msgs[RECV_BATCH_NUM];
+    struct iovec iovs[RECV_BATCH_NUM];
+    uint8_t control[RECV_BATCH_NUM][CMSG_SPACE(sizeof(struct timespec))];
+    memset(msgs, 0, sizeof(msgs));
+
+    uint32_t num = 0;
+    for (; num < RECV_BATCH_NUM; num++)
+    {
+        std::shared_ptr<void>& slot = m_RecvSlots[num];
+        if (slot == nullptr)
+        {
+            slot = m_pRecvSlab->GetSlot();
+        }
+        if (slot == nullptr)
+        {
+            //every slot is held downstream,borrow from the heap until some come back
+            slot = FramePool::GetPacketPool()->GetBuffer(RECV_SLOT_SIZE);
+        }
+        if (slot == nullptr)
+        {
+            break;
+        }
+
+        iovs[num].iov_base = slot.get();
+        iovs[num].iov_len = RECV_SLOT_SIZE;
+        msgs[num].msg_hdr.msg_iov = &iovs[num];
+        msgs[num].msg_hdr.msg_iovlen = 1;
+        if (m_bKernelTimestamp)
+        {
+            msgs[num].msg_hdr.msg_control = control[num];
+            msgs[num].msg_hdr.msg_controllen = sizeof(control[num]);
+        }
+    }
+    if (num == 0)
+    {
+        Error("[%p][RTSPClient::RecvVideoBatch] no recv buffer", this);
+        return -1;
+    }
+
+    int ret = recvmmsg(m_nVideoRtpfd, msgs, num, MSG_DONTWAIT, nullptr);
+    if (ret <= 0)
     {
-        ssize_t len = recv(m_nAudioRtpfd, pRecvBuff, size, 0);
-        if (len > 0)
+        if (ret < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
         {
-            OnRecvAudio(pRecvBuff, len);
-            nRecv += len;
+            Warn("[%p][RTSPClient::RecvVideoBatch] recvmmsg fail,errno:%d", this, errno);
         }
+        return 0;
+    }
+
+    uint64_t now = TimeCounter::GetMediaTime();
+    struct timespec realNow;
+    clock_gettime(CLOCK_REALTIME, &realNow);
+    for (int i = 0; i < ret; i++)
+    {
+        if (msgs[i].msg_len == 0 || (msgs[i].msg_hdr.msg_flags & MSG_TRUNC) != 0)
+        {
+            Warn("[%p][RTSPClient::RecvVideoBatch] drop datagram,size:%u flags:%d", this, msgs[i].msg_len, msgs[i].msg_hdr.msg_flags);
+            continue;
+        }
+
+        std::shared_ptr<Packet> packet = std::make_shared<Packet>();
+        packet->m_pBufferRef = std::move(m_RecvSlots[i]);
+        packet->m_pData = (uint8_t*)packet->m_pBufferRef.get();
+        packet->m_nLength = msgs[i].msg_len;
+        if (m_bKernelTimestamp)
+        {
+            packet->m_lArrivalTime = GetKernelArrivalTime(&msgs[i].msg_hdr, now, realNow);
+        }
+        OnRecvVideoPacket(packet);
+    }
+
+    return ret;
+}
+
+int32_t RTSPClient::RecvUDPMedia(int32_t fd, uint8_t* pRecvBuff, int32_t size)
+{
+    ssize_t len = recv(fd, pRecvBuff, size, MSG_DONTWAIT);
+    if (len <= 0)
+    {
+        return 0;
+    }
+
+    if (fd == m_nVideoRtcpfd)
+    {
+        OnRecvVideoRtcp(pRecvBuff, len);
+    }
+    else if (fd == m_nAudioRtpfd)
+    {
+        OnRecvAudio(pRecvBuff, len);
     }
 
-    return nRecv;
+    return len;
 }
@@ -7,8 +7,10 @@
 #include "CommonTools/TimeCounter.h"
 #include "CommonTools/ExBuff.h"
 #include "CommonTools/RtspParser.h"
+#include "CommonTools/PacketSlab.h"
 #include "RTPParser/RTPParser.h"
 #include "FEC/FECDecoder.h"
+#include "RTCP/RtpReceiveStats.h"
 
 extern "C" {
 #include "libavcodec/codec.h"
@@ -32,6 +34,7 @@ public:
     int32_t SetVideoPacketCallbaclk(RTPParser::MediaPacketCallbaclk callback);
     int32_t SetVideoReadyCallbaclk(VideoReadyCallbaclk callback);
     int32_t SetAudioPacketCallbaclk(RTPParser::MediaPacketCallbaclk callback);
+    int32_t SetKernelTimestamp(bool enable);        //before PlayUrl,jitter from SO_TIMESTAMPNS arrival times
     inline AVCodecID GetVideoFormat() { return m_eVideoFormat; };
     inline AVCodecID GetAudioFormat() { return m_eAudioFormat; };
 
@@ -39,6 +42,8 @@ private:
     int32_t ReleaseAll();
     bool AnalyzeUrl(const std::string& ulr, std::string& ip, uint16_t& port);
     void ClientThread();
+    int32_t AddEpollSocket(int32_t fd);
+    int32_t GetWaitTime();
 
     int32_t Options();
     int32_t Describe();
@@ -51,6 +56,9 @@ private:
     int32_t OnRecvRtspRequest(const RtspParser::RtspRequest& req);
     int32_t OnRecvRtspResponse(const  std::shared_ptr<RtspParser::RtspResponse>& rsp);
     int32_t OnRecvRtcp(uint8_t* const  msg, const uint32_t size);
+    int32_t OnRecvVideoRtcp(const uint8_t* data, const uint32_t size);
+    int32_t SendReceiverReport();
+    int32_t SendVideoRtcp(const std::shared_ptr<Packet>& packet);
     int32_t OnRecvRtp(uint8_t* const  msg, const uint32_t size);
 
     bool IsRtspRequestMsg(uint8_t* const  msg, const uint32_t size);
@@ -79,8 +87,11 @@ private:
     int32_t SendRtspRequest(RtspParser::RtspRequest& req);
 
     int32_t OnRecvVideo(uint8_t* const  msg, const uint32_t size);
+    int32_t OnRecvVideoPacket(const std::shared_ptr<Packet>& packet);
     int32_t OnRecvAudio(uint8_t* const  msg, const uint32_t size);
-    int32_t RecvUDPMedia(uint8_t* pRecvBuff, int32_t size);
+    int32_t RecvRtspMsg(uint8_t* pRecvBuff, int32_t size);
+    int32_t RecvVideoBatch();
+    int32_t RecvUDPMedia(int32_t fd, uint8_t* pRecvBuff, int32_t size);
 
     void OnRecvFECDecoderPacket(const std::shared_ptr<Packet>& packet);
     void OnRecvNackPacket(const std::shared_ptr<Packet>& packet);
@@ -93,6 +104,7 @@ private:
     uint16_t m_nServerPort;
     bool m_bCloseClient;
     std::thread* m_pClientThread;
+    int32_t m_nEpollfd;                     //the rtsp socket and the udp media sockets,waited on by ClientThread
     bool m_bIsPlaying;
     std::string m_strPlayUrl;
     std::string m_strPlayUrlNoExParam;
@@ -103,6 +115,9 @@ private:
 
     ExBuff m_ClientBuff;
     TimeCounter m_HeartBeatCycleTimer;
+    TimeCounter m_OptionsTimer;
+    int32_t m_nOptionsSeq;                  //OPTIONS cost the server nothing,their response time is the rtt
+    double m_fRoundTripTime;                //ms,0 unknown
 
     std::mutex m_SignalObjectMapLock;
     std::map<int, SignalObject*> m_SignalObjectMap;
@@ -127,9 +142,17 @@ private:
     int32_t m_nVideoRtcpfd;
     int32_t m_nAudioRtpfd;
     int32_t m_nAudioRtcpfd;
+    uint16_t m_nVideoServerRtcpPort;
+    bool m_bKernelTimestamp;
+    std::shared_ptr<PacketSlab> m_pRecvSlab;
+    std::vector<std::shared_ptr<void>> m_RecvSlots;     //one per recvmmsg entry,refilled once handed on
+
+    RtpReceiveStats m_VideoReceiveStats;        //reported back to the server,which adapts the bitrate
+    TimeCounter m_ReceiverReportTimer;
 
     RTPParser* m_pVideoParser;
     RFC8627FECDecoder* m_pFECDecoder;
+    FECBlock::Config m_FECConfig;           //from a=x-fec: of the video media,2D 7x7 for older servers
     RTPParser* m_pAudioParser;
     RTPParser::MediaPacketCallbaclk m_pVideoPacketCallbaclk;
     RTPParser::MediaPacketCallbaclk m_pAudioPacketCallbaclk;
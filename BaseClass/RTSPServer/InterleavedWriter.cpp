@@ -0,0 +1,281 @@
+#include <string.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <linux/sockios.h>
+#include "InterleavedWriter.h"
+#include "Log/Log.h"
+
+#define WRITE_IOV_NUM (64)              //two per entry,header and data
+#define MIN_LATENCY_BYTES (32*1024)     //below this the bytes in flight alone would look like a backlog
+
+static uint32_t ReadUint32(const uint8_t* data)
+{
+    return ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) | ((uint32_t)data[2] << 8) | data[3];
+}
+
+InterleavedWriter::InterleavedWriter(uint32_t latencyTarget)
+{
+    m_nfd = -1;
+    m_nLatencyTarget = latencyTarget;
+    m_nBitRate = 0;
+    m_nPendingBytes = 0;
+    m_nFrontOffset = 0;
+    m_bHasFrame = false;
+    m_nFrameTimestamp = 0;
+    m_bDropFrame = false;
+    m_bIntraOnly = false;
+    m_bWaitKeyFrame = false;
+    m_bKeyFrameRequest = false;
+}
+
+InterleavedWriter::~InterleavedWriter()
+{
+    Close();
+}
+
+void InterleavedWriter::Open(int32_t fd)
+{
+    Close();
+    m_nfd = fd;
+}
+
+void InterleavedWriter::Close()
+{
+    m_nfd = -1;
+    m_EntryList.clear();
+    m_nPendingBytes = 0;
+    m_nFrontOffset = 0;
+    m_bHasFrame = false;
+    m_nFrameTimestamp = 0;
+    m_bDropFrame = false;
+    m_bWaitKeyFrame = false;
+    m_bKeyFrameRequest = false;
+    m_Stats = WriterStats();
+}
+
+void InterleavedWriter::Push(const std::shared_ptr<Packet>& packet, uint8_t channel)
+{
+    Entry entry;
+    entry.m_Header[0] = 0x24;
+    entry.m_Header[1] = channel;
+    entry.m_Header[2] = packet->m_nLength >> 8;
+    entry.m_Header[3] = packet->m_nLength & 0xff;
+    entry.m_nHeaderSize = 4;
+    entry.m_pPacket = packet;
+    m_EntryList.push_back(entry);
+    m_nPendingBytes += 4 + packet->m_nLength;
+}
+
+int32_t InterleavedWriter::WriteData(const uint8_t* data, uint32_t size)
+{
+    std::shared_ptr<Packet> packet = std::make_shared<Packet>();
+    packet->m_pData = (uint8_t*)malloc(size);
+    if (packet->m_pData == nullptr)
+    {
+        Error("[%p][InterleavedWriter::WriteData] malloc fail,size:%u", this, size);
+        return -1;
+    }
+    memcpy(packet->m_pData, data, size);
+    packet->m_nLength = size;
+
+    Entry entry;
+    entry.m_pPacket = packet;
+    m_EntryList.push_back(entry);
+    m_nPendingBytes += size;
+    return 0;
+}
+
+int32_t InterleavedWriter::WritePacket(const std::shared_ptr<Packet>& packet, uint8_t channel)
+{
+    if (packet->m_nLength > 0xffff)
+    {
+        Error("[%p][InterleavedWriter::WritePacket] packet too large,size:%u", this, packet->m_nLength);
+        return -1;
+    }
+
+    Push(packet, channel);
+    return 0;
+}
+
+//a frame is kept or dropped as a whole at its first packet,which for an IDR frame is SPS or IDR slice
+bool InterleavedWriter::WriteMedia(const std::shared_ptr<Packet>& packet, uint8_t channel)
+{
+    if (packet->m_nLength < 12)
+    {
+        return WritePacket(packet, channel) == 0;
+    }
+
+    uint32_t timestamp = ReadUint32(packet->m_pData + 4);
+    if (!m_bHasFrame || (int32_t)(timestamp - m_nFrameTimestamp) > 0)
+    {
+        m_bHasFrame = true;
+        m_nFrameTimestamp = timestamp;
+        m_Stats.m_nBacklog = GetBacklog();
+        if (packet->m_nPriority == PACKET_PRIORITY_HIGH)
+        {
+            //what the receiver recovers from,never dropped
+            m_bDropFrame = false;
+            m_bWaitKeyFrame = false;
+        }
+        else if (m_bWaitKeyFrame)
+        {
+            m_bDropFrame = true;
+        }
+        else
+        {
+            m_bDropFrame = m_Stats.m_nBacklog > GetLatencyBytes();
+            if (m_bDropFrame && packet->m_nPriority != PACKET_PRIORITY_LOW && !m_bIntraOnly)
+            {
+                m_bWaitKeyFrame = true;
+                m_bKeyFrameRequest = true;
+            }
+        }
+        if (m_bDropFrame)
+        {
+            m_Stats.m_nDroppedFrameNum++;
+            Debug("[%p][InterleavedWriter::WriteMedia] backlog:%u bytes %ums,drop frame:%u", this, m_Stats.m_nBacklog,
+                GetBacklogTime(), timestamp);
+        }
+    }
+    else if (timestamp != m_nFrameTimestamp)
+    {
+        //an earlier frame resent,it does not start a new one
+        return WritePacket(packet, channel) == 0;
+    }
+
+    if (m_bDropFrame)
+    {
+        m_Stats.m_nDroppedPacketNum++;
+        return false;
+    }
+
+    return WritePacket(packet, channel) == 0;
+}
+
+int32_t InterleavedWriter::Flush()
+{
+    if (m_nfd == -1)
+    {
+        return -1;
+    }
+
+    while (!m_EntryList.empty())
+    {
+        struct iovec iovs[WRITE_IOV_NUM];
+        uint32_t num = 0;
+        uint32_t offset = m_nFrontOffset;
+        for (auto it = m_EntryList.begin(); it != m_EntryList.end() && num + 2 <= WRITE_IOV_NUM; it++)
+        {
+            if (offset < it->m_nHeaderSize)
+            {
+                iovs[num].iov_base = it->m_Header + offset;
+                iovs[num].iov_len = it->m_nHeaderSize - offset;
+                num++;
+                offset = 0;
+            }
+            else
+            {
+                offset -= it->m_nHeaderSize;
+            }
+            iovs[num].iov_base = it->m_pPacket->m_pData + offset;
+            iovs[num].iov_len = it->m_pPacket->m_nLength - offset;
+            num++;
+            offset = 0;
+        }
+
+        //writev,with the flags a socket wants
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(struct msghdr));
+        msg.msg_iov = iovs;
+        msg.msg_iovlen = num;
+        ssize_t ret = sendmsg(m_nfd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (ret == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                return 0;
+            }
+            Error("[%p][InterleavedWriter::Flush] sendmsg fail,errno:%d", this, errno);
+            return -2;
+        }
+        m_Stats.m_nWriteNum++;
+
+        uint32_t nSend = ret;
+        while (nSend > 0)
+        {
+            Entry& entry = m_EntryList.front();
+            uint32_t left = entry.m_nHeaderSize + entry.m_pPacket->m_nLength - m_nFrontOffset;
+            if (nSend < left)
+            {
+                m_nFrontOffset += nSend;
+                m_nPendingBytes -= nSend;
+                break;
+            }
+
+            nSend -= left;
+            m_nPendingBytes -= left;
+            m_nFrontOffset = 0;
+            m_EntryList.pop_front();
+            m_Stats.m_nPacketNum++;
+        }
+    }
+
+    return 0;
+}
+
+void InterleavedWriter::SetBitRate(uint32_t bitRate)
+{
+    m_nBitRate = bitRate;
+}
+
+void InterleavedWriter::SetIntraOnly(bool intraOnly)
+{
+    m_bIntraOnly = intraOnly;
+}
+
+bool InterleavedWriter::TakeKeyFrameRequest()
+{
+    bool request = m_bKeyFrameRequest;
+    m_bKeyFrameRequest = false;
+    return request;
+}
+
+uint32_t InterleavedWriter::GetLatencyBytes()
+{
+    uint64_t bytes = (uint64_t)m_nBitRate * m_nLatencyTarget / 8000;
+    return bytes > MIN_LATENCY_BYTES ? (uint32_t)bytes : MIN_LATENCY_BYTES;
+}
+
+//what the kernel holds,not sent or not acked yet,and what is still queued here
+uint32_t InterleavedWriter::GetBacklog()
+{
+    int outq = 0;
+    if (m_nfd == -1 || ioctl(m_nfd, SIOCOUTQ, &outq) != 0)
+    {
+        outq = 0;
+    }
+
+    return (uint32_t)outq + m_nPendingBytes;
+}
+
+uint32_t InterleavedWriter::GetBacklogTime()
+{
+    if (m_nBitRate == 0)
+    {
+        return 0;
+    }
+
+    return (uint32_t)((uint64_t)GetBacklog() * 8000 / m_nBitRate);
+}
+
+InterleavedWriter::WriterStats InterleavedWriter::GetStats()
+{
+    return m_Stats;
+}
\ No newline at end of file
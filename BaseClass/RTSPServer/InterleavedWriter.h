@@ -0,0 +1,69 @@
+#pragma once
+#include <deque>
+#include <memory>
+#include <cstdint>
+#include "Common.h"
+
+//Everything written to an rtsp connection,in order:rtsp text and RTP/RTCP interleaved with the 4 byte
+//'$' header.The packets are not copied,what is queued goes out gathered in one sendmsg per Flush.
+//When the bytes the kernel has not got rid of plus the queue exceed the latency target at the current
+//bitrate,the next frame is dropped whole unless it is an IDR frame,a frame already started always
+//finishes.Once a reference frame is dropped the rest of the GOP is too,up to the next IDR frame,
+//and a key frame is asked for.Used from one thread.
+class InterleavedWriter
+{
+public:
+    typedef struct WriterStats
+    {
+        uint64_t m_nWriteNum = 0;           //sendmsg calls
+        uint64_t m_nPacketNum = 0;          //entries they carried
+        uint32_t m_nDroppedFrameNum = 0;
+        uint32_t m_nDroppedPacketNum = 0;
+        uint32_t m_nBacklog = 0;            //bytes at the last frame start,socket and queue
+    }WriterStats;
+
+public:
+    InterleavedWriter(uint32_t latencyTarget);      //ms
+    ~InterleavedWriter();
+
+    void Open(int32_t fd);
+    void Close();
+    int32_t WriteData(const uint8_t* data, uint32_t size);
+    int32_t WritePacket(const std::shared_ptr<Packet>& packet, uint8_t channel);
+    bool WriteMedia(const std::shared_ptr<Packet>& packet, uint8_t channel);        //false if its frame is dropped
+    int32_t Flush();                                    //negative on a hard error,what the socket did not take stays queued
+    void SetBitRate(uint32_t bitRate);
+    void SetIntraOnly(bool intraOnly);                  //every frame decodes on its own,MJPEG
+    bool TakeKeyFrameRequest();                         //true once after a reference frame is dropped
+    inline uint32_t GetPendingBytes() { return m_nPendingBytes; };
+    uint32_t GetBacklog();
+    uint32_t GetBacklogTime();                          //ms at the current bitrate
+    WriterStats GetStats();
+
+private:
+    typedef struct Entry
+    {
+        uint8_t m_Header[4];
+        uint8_t m_nHeaderSize = 0;          //0 for rtsp text
+        std::shared_ptr<Packet> m_pPacket;
+    }Entry;
+
+    void Push(const std::shared_ptr<Packet>& packet, uint8_t channel);
+    uint32_t GetLatencyBytes();
+
+private:
+    int32_t m_nfd;
+    uint32_t m_nLatencyTarget;
+    uint32_t m_nBitRate;
+    std::deque<Entry> m_EntryList;
+    uint32_t m_nPendingBytes;
+    uint32_t m_nFrontOffset;                //bytes of the first entry already sent
+
+    bool m_bHasFrame;
+    uint32_t m_nFrameTimestamp;             //RTP timestamp of the frame being written
+    bool m_bDropFrame;
+    bool m_bIntraOnly;
+    bool m_bWaitKeyFrame;                   //a reference frame was dropped,nothing decodes before the next IDR
+    bool m_bKeyFrameRequest;
+    WriterStats m_Stats;
+};
\ No newline at end of file
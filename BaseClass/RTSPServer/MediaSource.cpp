@@ -0,0 +1,303 @@
+#include <algorithm>
+#include "MediaSource.h"
+#include "Log/Log.h"
+
+MediaSource::MediaSource(const std::string& key, bool enableFec, const FECBlock::Config& fecConfig)
+{
+    m_strKey = key;
+    m_strDevice = "";
+    m_bEnableFec = enableFec;
+    m_FECConfig = fecConfig;
+    m_pImageTransoprt = nullptr;
+    m_eVideoType = VIDEO_TYPE_NONE;
+    m_nMaxBitRate = 0;
+}
+
+MediaSource::~MediaSource()
+{
+    Stop();
+}
+
+int32_t MediaSource::Start(std::string device, const VideoCapture::VideoCaptureCapability& capability, VideoType type)
+{
+    if (m_pImageTransoprt != nullptr)
+    {
+        Error("[%p][MediaSource::Start] source:%s already started", this, m_strKey.c_str());
+        return -1;
+    }
+
+    m_pImageTransoprt = new ImageTransoprt(m_bEnableFec);
+    m_pImageTransoprt->SetFECConfig(m_FECConfig);
+    //the transport thread reads it as soon as it starts
+    ImageTransoprt::RtpPacketCallbaclk callback = std::bind(&MediaSource::OnRecvRtpPacket, this, std::placeholders::_1);
+    m_pImageTransoprt->SetRtpPacketCallbaclk(callback);
+    int32_t ret = m_pImageTransoprt->StartTransoprt(device, capability, type);
+    if (ret != 0)
+    {
+        Error("[%p][MediaSource::Start] StartTransoprt fail,source:%s return:%d", this, m_strKey.c_str(), ret);
+        delete m_pImageTransoprt;
+        m_pImageTransoprt = nullptr;
+        return -2;
+    }
+
+    m_strDevice = device;
+    m_eVideoType = type;
+    m_Capability = capability;
+    m_nMaxBitRate = m_pImageTransoprt->GetBitRate();
+    m_AppliedTarget.m_nEncoderBitRate = m_nMaxBitRate;
+    m_AppliedTarget.m_eRepairMode = RFC8627FECEncoder::REPAIR_MODE_ROW_AND_COLUMN;
+    m_AppliedTarget.m_nResolutionLevel = 0;
+    Trace("[%p][MediaSource::Start] source:%s started", this, m_strKey.c_str());
+
+    return 0;
+}
+
+int32_t MediaSource::Stop()
+{
+    if (m_pImageTransoprt == nullptr)
+    {
+        return 0;
+    }
+
+    m_pImageTransoprt->StopTransoprt(m_strDevice);
+    delete m_pImageTransoprt;
+    m_pImageTransoprt = nullptr;
+    Trace("[%p][MediaSource::Stop] source:%s stopped", this, m_strKey.c_str());
+
+    return 0;
+}
+
+uint32_t MediaSource::AddSubscriber(void* subscriber, PacketCallbaclk callback)
+{
+    std::lock_guard<std::mutex> lock(m_SubscriberLock);
+    m_SubscriberMap[subscriber] = callback;
+    return m_SubscriberMap.size();
+}
+
+uint32_t MediaSource::RemoveSubscriber(void* subscriber)
+{
+    RemoveRateTarget(subscriber);
+
+    std::lock_guard<std::mutex> lock(m_SubscriberLock);
+    m_SubscriberMap.erase(subscriber);
+    return m_SubscriberMap.size();
+}
+
+uint32_t MediaSource::GetSubscriberNum()
+{
+    std::lock_guard<std::mutex> lock(m_SubscriberLock);
+    return m_SubscriberMap.size();
+}
+
+int32_t MediaSource::UpdateRateTarget(void* subscriber, const RateController::Target& target)
+{
+    if (m_pImageTransoprt == nullptr)
+    {
+        return -1;
+    }
+
+    std::lock_guard<std::mutex> lock(m_RateLock);
+    m_RateTargetMap[subscriber] = target;
+    ApplyRateTarget();
+
+    return 0;
+}
+
+void MediaSource::RemoveRateTarget(void* subscriber)
+{
+    std::lock_guard<std::mutex> lock(m_RateLock);
+    if (m_RateTargetMap.erase(subscriber) > 0 && m_pImageTransoprt != nullptr)
+    {
+        ApplyRateTarget();
+    }
+}
+
+void MediaSource::SetMaxBitRate(uint32_t bitRate)
+{
+    std::lock_guard<std::mutex> lock(m_RateLock);
+    m_nMaxBitRate = bitRate;
+    if (m_pImageTransoprt == nullptr)
+    {
+        return;
+    }
+
+    if (m_RateTargetMap.empty())
+    {
+        m_pImageTransoprt->SetBitRate(bitRate);
+        m_AppliedTarget.m_nEncoderBitRate = bitRate;
+    }
+    else
+    {
+        ApplyRateTarget();
+    }
+}
+
+//lowest bitrate,strongest repair and smallest picture asked for by any subscriber,
+//back to the configured stream when nobody adapts any more
+void MediaSource::ApplyRateTarget()
+{
+    RateController::Target target;
+    target.m_nEncoderBitRate = UINT32_MAX;
+    target.m_eRepairMode = m_RateTargetMap.empty() ? RFC8627FECEncoder::REPAIR_MODE_ROW_AND_COLUMN : RFC8627FECEncoder::REPAIR_MODE_NONE;
+    target.m_nResolutionLevel = 0;
+    for (auto& it : m_RateTargetMap)
+    {
+        target.m_nEncoderBitRate = std::min(target.m_nEncoderBitRate, it.second.m_nEncoderBitRate);
+        target.m_eRepairMode = std::max(target.m_eRepairMode, it.second.m_eRepairMode);
+        target.m_nResolutionLevel = std::max(target.m_nResolutionLevel, it.second.m_nResolutionLevel);
+    }
+    target.m_nEncoderBitRate = std::min(target.m_nEncoderBitRate, m_nMaxBitRate);
+
+    if (target.m_nEncoderBitRate != m_AppliedTarget.m_nEncoderBitRate)
+    {
+        m_pImageTransoprt->SetBitRate(target.m_nEncoderBitRate);
+    }
+    if (m_bEnableFec && target.m_eRepairMode != m_AppliedTarget.m_eRepairMode)
+    {
+        m_pImageTransoprt->SetFECRepairMode(target.m_eRepairMode);
+    }
+    if (target.m_nResolutionLevel != m_AppliedTarget.m_nResolutionLevel)
+    {
+        uint32_t width = 0;
+        uint32_t height = 0;
+        RateController::GetScaledResolution(target.m_nResolutionLevel, m_Capability.m_nWidth, m_Capability.m_nHeight, width, height);
+        Trace("[%p][MediaSource::ApplyRateTarget] source:%s resolution level:%u %ux%u", this, m_strKey.c_str(), target.m_nResolutionLevel, width, height);
+        m_pImageTransoprt->SetResolution(width, height);
+    }
+    m_AppliedTarget = target;
+}
+
+//every subscriber gets a reference to the same packet,the payload is never copied
+void MediaSource::OnRecvRtpPacket(const std::shared_ptr<Packet>& packet)
+{
+    std::lock_guard<std::mutex> lock(m_SubscriberLock);
+    for (auto& it : m_SubscriberMap)
+    {
+        it.second(packet);
+    }
+}
+
+MediaSourceRegistry::MediaSourceRegistry()
+{
+    m_bEnableOSD = false;
+}
+
+MediaSourceRegistry::~MediaSourceRegistry()
+{
+    std::map<std::string, std::shared_ptr<MediaSource>> sources;
+    {
+        std::lock_guard<std::mutex> lock(m_RegistryLock);
+        sources.swap(m_SourceMap);
+    }
+
+    for (auto& it : sources)
+    {
+        it.second->Stop();
+    }
+}
+
+std::string MediaSourceRegistry::MakeKey(const std::string& device, const VideoCapture::VideoCaptureCapability& capability, VideoType type, bool enableFec)
+{
+    return device + "|" + std::to_string(type) + "|" + std::to_string(capability.m_nWidth) + "x" + std::to_string(capability.m_nHeight) +
+        "|" + std::to_string(capability.m_nFPS) + (enableFec ? "|fec" : "");
+}
+
+std::shared_ptr<MediaSource> MediaSourceRegistry::Subscribe(std::string device, const VideoCapture::VideoCaptureCapability& capability, VideoType type,
+    bool enableFec, void* subscriber, MediaSource::PacketCallbaclk callback)
+{
+    std::string key = MakeKey(device, capability, type, enableFec);
+
+    std::lock_guard<std::mutex> lock(m_RegistryLock);
+    if (enableFec)
+    {
+        //sessions described with another fec scheme must not share the encoder
+        key += "|" + FECBlock::MakeSdpAttribute(m_FECConfig);
+    }
+    std::shared_ptr<MediaSource> source = nullptr;
+    bool bShared = false;
+    auto it = m_SourceMap.find(key);
+    if (it != m_SourceMap.end())
+    {
+        source = it->second;
+        bShared = true;
+    }
+    else
+    {
+        source = std::make_shared<MediaSource>(key, enableFec, m_FECConfig);
+        int32_t ret = source->Start(device, capability, type);
+        if (ret != 0)
+        {
+            Error("[%p][MediaSourceRegistry::Subscribe] start source:%s fail,return:%d", this, key.c_str(), ret);
+            return nullptr;
+        }
+        source->GetImageTransoprt()->EnableOSD(m_bEnableOSD);
+        m_SourceMap[key] = source;
+    }
+
+    uint32_t num = source->AddSubscriber(subscriber, callback);
+    Trace("[%p][MediaSourceRegistry::Subscribe] source:%s subscriber:%p num:%u", this, key.c_str(), subscriber, num);
+    if (bShared && source->GetVideoType() == VIDEO_TYPE_H264)
+    {
+        //a late subscriber can not decode before the next IDR
+        source->GetImageTransoprt()->RequestKeyFrame();
+    }
+
+    return source;
+}
+
+int32_t MediaSourceRegistry::Unsubscribe(std::shared_ptr<MediaSource>& source, void* subscriber)
+{
+    if (source == nullptr)
+    {
+        return -1;
+    }
+
+    uint32_t num = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_RegistryLock);
+        num = source->RemoveSubscriber(subscriber);
+        Trace("[%p][MediaSourceRegistry::Unsubscribe] source:%s subscriber:%p num:%u", this, source->GetKey().c_str(), subscriber, num);
+        if (num == 0)
+        {
+            m_SourceMap.erase(source->GetKey());
+        }
+    }
+
+    //out of the map nobody can subscribe to it any more,stopping joins its threads and must not hold up the other sessions
+    if (num == 0)
+    {
+        source->Stop();
+    }
+    source = nullptr;
+
+    return 0;
+}
+
+uint32_t MediaSourceRegistry::GetSourceNum()
+{
+    std::lock_guard<std::mutex> lock(m_RegistryLock);
+    return m_SourceMap.size();
+}
+
+void MediaSourceRegistry::SetFECConfig(const FECBlock::Config& config)
+{
+    Trace("[%p][MediaSourceRegistry::SetFECConfig] fec:%s", this, FECBlock::MakeSdpAttribute(config).c_str());
+    std::lock_guard<std::mutex> lock(m_RegistryLock);
+    m_FECConfig = config;
+}
+
+void MediaSourceRegistry::EnableOSD(bool enable)
+{
+    std::lock_guard<std::mutex> lock(m_RegistryLock);
+    m_bEnableOSD = enable;
+    for (auto& it : m_SourceMap)
+    {
+        it.second->GetImageTransoprt()->EnableOSD(enable);
+    }
+}
+
+FECBlock::Config MediaSourceRegistry::GetFECConfig()
+{
+    std::lock_guard<std::mutex> lock(m_RegistryLock);
+    return m_FECConfig;
+}
\ No newline at end of file
@@ -0,0 +1,80 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include "ImageTransoprt/ImageTransoprt.h"
+#include "RateControl/RateController.h"
+
+//One capture+encode pipeline shared by every session that plays the same device/codec/resolution/fps
+class MediaSource
+{
+public:
+    typedef std::function<void(const std::shared_ptr<Packet>&)> PacketCallbaclk;
+
+public:
+    MediaSource(const std::string& key, bool enableFec, const FECBlock::Config& fecConfig);
+    ~MediaSource();
+
+    int32_t Start(std::string device, const VideoCapture::VideoCaptureCapability& capability, VideoType type);
+    int32_t Stop();
+    inline const std::string& GetKey() { return m_strKey; };
+    inline VideoType GetVideoType() { return m_eVideoType; };
+    inline ImageTransoprt* GetImageTransoprt() { return m_pImageTransoprt; };
+
+    uint32_t AddSubscriber(void* subscriber, PacketCallbaclk callback);     //return subscriber num
+    uint32_t RemoveSubscriber(void* subscriber);
+    uint32_t GetSubscriberNum();
+
+    //the encoder is shared,so it follows the worst link among the subscribers
+    int32_t UpdateRateTarget(void* subscriber, const RateController::Target& target);
+    void RemoveRateTarget(void* subscriber);
+    void SetMaxBitRate(uint32_t bitRate);
+    inline uint32_t GetMaxBitRate() { return m_nMaxBitRate; };
+    inline const VideoCapture::VideoCaptureCapability& GetCapability() { return m_Capability; };
+
+private:
+    void OnRecvRtpPacket(const std::shared_ptr<Packet>& packet);
+    void ApplyRateTarget();
+
+private:
+    std::string m_strKey;
+    std::string m_strDevice;
+    VideoType m_eVideoType;
+    bool m_bEnableFec;
+    FECBlock::Config m_FECConfig;
+    ImageTransoprt* m_pImageTransoprt;
+
+    std::mutex m_SubscriberLock;
+    std::map<void*, PacketCallbaclk> m_SubscriberMap;
+
+    VideoCapture::VideoCaptureCapability m_Capability;
+    uint32_t m_nMaxBitRate;
+    std::mutex m_RateLock;
+    std::map<void*, RateController::Target> m_RateTargetMap;
+    RateController::Target m_AppliedTarget;
+};
+
+class MediaSourceRegistry
+{
+public:
+    MediaSourceRegistry();
+    ~MediaSourceRegistry();
+
+    std::shared_ptr<MediaSource> Subscribe(std::string device, const VideoCapture::VideoCaptureCapability& capability, VideoType type,
+        bool enableFec, void* subscriber, MediaSource::PacketCallbaclk callback);
+    int32_t Unsubscribe(std::shared_ptr<MediaSource>& source, void* subscriber);
+    uint32_t GetSourceNum();
+    void SetFECConfig(const FECBlock::Config& config);     //used by the sources started after this
+    FECBlock::Config GetFECConfig();
+    void EnableOSD(bool enable);        //drawn into the shared picture,so for every source and every viewer
+
+    static std::string MakeKey(const std::string& device, const VideoCapture::VideoCaptureCapability& capability, VideoType type, bool enableFec);
+
+private:
+    std::mutex m_RegistryLock;
+    std::map<std::string, std::shared_ptr<MediaSource>> m_SourceMap;
+    FECBlock::Config m_FECConfig;
+    bool m_bEnableOSD;
+};
\ No newline at end of file
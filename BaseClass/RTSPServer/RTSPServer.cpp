@@ -4,15 +4,16 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <string.h>
+#include <sys/epoll.h>
 #include "RTSPServer.h"
 #include "Log/Log.h"
 
+#define REMOVE_SESSION_CYCLE (1000)
+
 RTSPServer::RTSPServer()
 {
     m_nServerSocketfd = -1;
-    m_bCloseServer = true;
-    m_pServerThread = nullptr;
-    m_bEnableOSD = false;
+    m_nRemoveTimerId = 0;
 }
 
 RTSPServer::~RTSPServer()
@@ -22,19 +23,16 @@ RTSPServer::~RTSPServer()
 
 int32_t RTSPServer::ReleaseAll()
 {
-    m_bCloseServer = true;
-    if (m_pServerThread != nullptr)
+    //nothing runs on the sessions once the reactor has stopped
+    m_Reactor.Stop();
+    if (m_nRemoveTimerId > 0)
     {
-        if (m_pServerThread->joinable())
-        {
-            m_pServerThread->join();
-        }
-        delete m_pServerThread;
-        m_pServerThread = nullptr;
+        m_Reactor.RemoveTimer(m_nRemoveTimerId);
+        m_nRemoveTimerId = 0;
     }
-
     if (m_nServerSocketfd != -1)
     {
+        m_Reactor.RemoveSocket(m_nServerSocketfd);
         close(m_nServerSocketfd);
         m_nServerSocketfd = -1;
     }
@@ -50,7 +48,6 @@ int32_t RTSPServer::ReleaseAll()
         }
         m_RTSPServerSessionSet.clear();
     }
-    m_bEnableOSD = false;
 
     return 0;
 }
@@ -92,8 +89,26 @@ int32_t RTSPServer::OpenServer(uint16_t port)
         return -4;
     }
 
-    m_bCloseServer = false;
-    m_pServerThread = new std::thread(&RTSPServer::ServerThread, this);
+    ret = listen(m_nServerSocketfd, SOMAXCONN);
+    if (ret == -1)
+    {
+        Error("[%p][RTSPServer::OpenServer] listen error:%d", this, errno);
+        return -5;
+    }
+
+    ret = m_Reactor.Start();
+    if (ret != 0)
+    {
+        Error("[%p][RTSPServer::OpenServer] start reactor fail,return:%d", this, ret);
+        return -6;
+    }
+    ret = m_Reactor.AddSocket(m_nServerSocketfd, EPOLLIN, [this](uint32_t events) { OnServerEvent(events); });
+    if (ret != 0)
+    {
+        Error("[%p][RTSPServer::OpenServer] add server socket fail,return:%d", this, ret);
+        return -7;
+    }
+    m_nRemoveTimerId = m_Reactor.AddTimer(REMOVE_SESSION_CYCLE, true, [this]() { RemoveFinishedSession(); });
 
     return 0;
 }
@@ -121,66 +136,54 @@ void RTSPServer::RemoveFinishedSession()
     }
 }
 
-void RTSPServer::ServerThread()
+void RTSPServer::OnServerEvent(uint32_t events)
 {
-    Trace("[%p][RTSPServer::ServerThread]  start ServerThread", this);
-
-    int ret = listen(m_nServerSocketfd, SOMAXCONN);
-    if (ret == -1)
-    {
-        Error("[%p][RTSPServer::ServerThread]  listen error:%d", this, errno);
-        m_bCloseServer = true;
-        return;
-    }
-
     struct sockaddr clientAddr;
-    socklen_t len = sizeof(clientAddr);
-    while (!m_bCloseServer)
+    while (true)
     {
-        RemoveFinishedSession();
+        socklen_t len = sizeof(clientAddr);
         int clientfd = accept(m_nServerSocketfd, (struct sockaddr*)&clientAddr, &len);
         if (clientfd == -1)
         {
             int err = errno;
-            if (err != EAGAIN)
+            if (err != EAGAIN && err != EWOULDBLOCK && err != EINTR)
             {
-                Error("[%p][RTSPServer::ServerThread]  accept error:%d", this, err);
-                return;
+                Error("[%p][RTSPServer::OnServerEvent]  accept error:%d", this, err);
             }
-
-            std::this_thread::sleep_for(std::chrono::milliseconds(25));
-            continue;
+            if (err == EINTR)
+            {
+                continue;
+            }
+            return;
         }
 
         sockaddr_in* addr = (sockaddr_in*)&clientAddr;
         std::string strClientIP = inet_ntoa(addr->sin_addr);
 
-        RTSPServerSession* pRTSPServerSession = new RTSPServerSession(clientfd, strClientIP);
-        ret = pRTSPServerSession->StartSession();
+        RTSPServerSession* pRTSPServerSession = new RTSPServerSession(clientfd, strClientIP, &m_MediaSourceRegistry, &m_Reactor);
+        int ret = pRTSPServerSession->StartSession();
         if (ret == 0)
         {
-            pRTSPServerSession->EnableOSD(m_bEnableOSD);
             std::lock_guard<std::mutex> lock(m_RTSPServerSessionSetLock);
             m_RTSPServerSessionSet.insert(pRTSPServerSession);
         }
         else
         {
-            Error("[%p][RTSPServer::ServerThread]  StartSession fail return:%d", this, ret);
+            Error("[%p][RTSPServer::OnServerEvent]  StartSession fail return:%d", this, ret);
             delete pRTSPServerSession;
         }
     }
-
-    Trace("[%p][RTSPServer::ServerThread]  exit ServerThread", this);
 }
 
 int32_t RTSPServer::EnableOSD(bool enable)
 {
-    m_bEnableOSD = enable;
-    std::lock_guard<std::mutex> lock(m_RTSPServerSessionSetLock);
-    for (auto item : m_RTSPServerSessionSet)
-    {
-        item->EnableOSD(enable);
-    }
+    m_MediaSourceRegistry.EnableOSD(enable);
+    return 0;
+}
+
+int32_t RTSPServer::SetFECConfig(const FECBlock::Config& config)
+{
+    m_MediaSourceRegistry.SetFECConfig(config);
     return 0;
 }
 
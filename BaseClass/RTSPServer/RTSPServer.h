@@ -4,6 +4,8 @@
 #include <mutex>
 #include <thread>
 #include "RTSPServerSession.h"
+#include "CommonTools/EventReactor.h"
+#include "MediaSource.h"
 
 class RTSPServer
 {
@@ -14,21 +16,22 @@ public:
     int32_t OpenServer(uint16_t port);
     int32_t CloseServer();
     int32_t EnableOSD(bool enable);
+    int32_t SetFECConfig(const FECBlock::Config& config);     //sessions described after this
     int32_t SetAttitude(float pitch, float roll, float yaw);
     int32_t SetGPS(int32_t lat, int32_t lon, int32_t alt, uint8_t satellites, uint16_t vel);
     int32_t SetSysStatus(uint16_t voltage, int16_t current, int8_t batteryRemaining);
 
 private:
     int32_t ReleaseAll();
-    void ServerThread();
+    void OnServerEvent(uint32_t events);
     void RemoveFinishedSession();
 
 private:
     int32_t m_nServerSocketfd;
-    bool m_bCloseServer;
-    std::thread* m_pServerThread;
-    bool m_bEnableOSD;
+    EventReactor m_Reactor;             //accepts and serves every session
+    int32_t m_nRemoveTimerId;
 
     std::mutex m_RTSPServerSessionSetLock;
     std::set<RTSPServerSession*> m_RTSPServerSessionSet;
+    MediaSourceRegistry m_MediaSourceRegistry;
 };
\ No newline at end of file
@@ -1,24 +1,46 @@
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <arpa/inet.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
 #include <linux/videodev2.h>
 #include "RTSPServerSession.h"
 #include "Log/Log.h"
 #include "MediaCapture/VideoCapture.h"
+#include "CommonTools/LatencyTracer.h"
+#include "RTCP/RTCPPacket.h"
 
 #define RECV_BUFF_SIZE (1024*4)
 #define HEART_BEAT_CYCLE (15*1000)
 #define HEART_BEAT_TIMEOUT (60*1000)
 #define MAX_RTP_CACHE_NUM (200)
-#define MAX_PACKET_SIZE 1600
-extern int g_nCaptureWidth;
-extern int g_nCaptureHeight;
+#define SESSION_TIMER_CYCLE (100)
+#define SEND_BATCH_NUM (32)             //packets taken off the queue and sent with one sendmmsg
+#define SENDER_REPORT_CYCLE (1000)
+#define RATE_CHECK_CYCLE (500)
+#define VIDEO_SSRC (0x12345678)
+#define RETRANSMIT_SHARE (0.2)          //of the send rate a session may spend on retransmission
+#define RETRANSMIT_MAX_BURST (200)      //ms of budget that may pile up
+#define RETRANSMIT_MAX_AGE (300)        //ms,the receiver has skipped the hole before an older packet lands
+#define PACING_FACTOR (2.5f)            //of the target bitrate,an IDR drains in well under a frame at the average rate
+#define TCP_LATENCY_TARGET (200)        //ms a TCP viewer may fall behind before frames are dropped,IDR frames never
+
+static Pacer::Config GetPacerConfig()
+{
+    Pacer::Config config;
+    config.m_fPacingFactor = PACING_FACTOR;
+    config.m_nCapacity = MAX_RTP_CACHE_NUM;
+    return config;
+}
 
-RTSPServerSession::RTSPServerSession(uint32_t fd, std::string strRemoteIP)
+RTSPServerSession::RTSPServerSession(uint32_t fd, std::string strRemoteIP, MediaSourceRegistry* registry, EventReactor* reactor) :
+    m_SessionWriter(TCP_LATENCY_TARGET),
+    m_VideoPacer(GetPacerConfig())
 {
     m_nSessionfd = fd;
     m_strSessionId = "";
@@ -26,7 +48,8 @@ RTSPServerSession::RTSPServerSession(uint32_t fd, std::string strRemoteIP)
     m_strUrl = "";
 
     m_bStopSession = true;
-    m_pSessionThread = nullptr;
+    m_pReactor = reactor;
+    m_nSessionTimerId = 0;
 
     m_strResouceType = "";
     m_strResouce = "";
@@ -44,54 +67,75 @@ RTSPServerSession::RTSPServerSession(uint32_t fd, std::string strRemoteIP)
     m_eVideoTransport = UDP;
     m_eAudioTransport = UDP;
     m_nVideoRtpfd = -1;
-    m_nVideoRtcpfd = 1;
+    m_nVideoRtcpfd = -1;
     m_nAudioRtpfd = -1;
     m_nAudioRtcpfd = -1;
 
+    m_pMediaSourceRegistry = registry;
+    m_pMediaSource = nullptr;
     m_pImageTransoprt = nullptr;
     m_bStopSendMedia = true;
-    m_pSendMediaThread = nullptr;
+    m_nSendEventfd = -1;
+    m_bSendNotified = false;
+    m_nSendTimerId = 0;
     m_bSessionFinished = false;
-    m_bEnableOSD = false;
-    m_pSendBuff = nullptr;
+    m_nReleaseTimerId = 0;
+    m_nSendQueueGauge = 0;
+
+    m_pRateController = nullptr;
+    m_bEnableAbr = true;
+    m_nSendPacketNum = 0;
+    m_nSendOctetNum = 0;
+    m_lSendBytes = 0;
+    m_lLastFeedbackBytes = 0;
+    m_lLastFeedbackTime = 0;
+
+    m_nRtt = 0;
+    m_fRetransmitToken = 0;
+    m_lLastTokenTime = 0;
+    m_nRetransmitNum = 0;
+    m_nRetransmitLateNum = 0;
+    m_nRetransmitLimitNum = 0;
+
+    m_nFECPayloadType = m_pMediaSourceRegistry->GetFECConfig().m_nPayloadType;
+    m_nAnnouncedFECSSRC = 0;
 }
 
 RTSPServerSession::~RTSPServerSession()
 {
+    //the server deletes a session on the reactor thread or after the reactor has stopped,so no
+    //release can start behind this;a stopped reactor may still hold the timer that starts one
+    if (m_nReleaseTimerId > 0)
+    {
+        m_pReactor->RemoveTimer(m_nReleaseTimerId);
+        m_nReleaseTimerId = 0;
+    }
+    if (m_ReleaseThread.joinable())
+    {
+        m_ReleaseThread.join();
+    }
     ReleaseAll();
 }
 
 int32_t RTSPServerSession::ReleaseAll()
 {
-    if (m_pImageTransoprt != nullptr)
+    DetachReactor();
+    if (m_pMediaSource != nullptr)
     {
-        delete m_pImageTransoprt;
-        m_pImageTransoprt = nullptr;
+        m_pMediaSourceRegistry->Unsubscribe(m_pMediaSource, this);
     }
+    m_pImageTransoprt = nullptr;
 
     m_bStopSendMedia = true;
-    if (m_pSendMediaThread != nullptr)
-    {
-        if (m_pSendMediaThread->joinable())
-        {
-            m_pSendMediaThread->join();
-        }
-        delete m_pSendMediaThread;
-        m_pSendMediaThread = nullptr;
-    }
-
+    m_VideoPacer.Close();
     m_bStopSession = true;
-    m_pSessionThread = nullptr;
-    /*if (m_pSessionThread != nullptr)
-    {
-        if (m_pSessionThread->joinable())
-        {
-            m_pSessionThread->join();
-        }
-        delete m_pSessionThread;
-        m_pSessionThread = nullptr;
-    }*/
 
+    //no source callback can come any more
+    if (m_nSendEventfd != -1)
+    {
+        close(m_nSendEventfd);
+        m_nSendEventfd = -1;
+    }
     if (m_nSessionfd != -1)
     {
         close(m_nSessionfd);
@@ -119,6 +163,10 @@ int32_t RTSPServerSession::ReleaseAll()
     }
 
     m_SessionBuff.ClearBuff(0);
+    m_SessionWriter.Close();
+    m_SendBatch.clear();
+    LatencyTracer::GetTracer()->AddGauge(LatencyTracer::GAUGE_SEND_QUEUE, -(int32_t)m_nSendQueueGauge);
+    m_nSendQueueGauge = 0;
     m_nSeq = 0;
     m_strUrl = "";
     m_strResouceType = "";
@@ -131,16 +179,30 @@ int32_t RTSPServerSession::ReleaseAll()
     m_nAudioTrackId = -1;
     m_eVideoTransport = UDP;
     m_eAudioTransport = UDP;
-    m_bEnableOSD = false;
-    free(m_pSendBuff);
-    m_pSendBuff = nullptr;
+    m_VideoPacer.Clear();
+    m_VideoPacer.SetBitRate(0);
+
+    delete m_pRateController;
+    m_pRateController = nullptr;
+    m_nSendPacketNum = 0;
+    m_nSendOctetNum = 0;
+    m_lSendBytes = 0;
+    m_lLastFeedbackBytes = 0;
+    m_lLastFeedbackTime = 0;
+
+    m_nRtt = 0;
+    m_fRetransmitToken = 0;
+    m_lLastTokenTime = 0;
+    m_nRetransmitNum = 0;
+    m_nRetransmitLateNum = 0;
+    m_nRetransmitLimitNum = 0;
 
     return 0;
 }
 
 int32_t RTSPServerSession::StartSession()
 {
-    if (m_pSessionThread != nullptr)
+    if (!m_bStopSession)
     {
         Error("[%p][RTSPServer::StartSession] RTSPServerSession has been started", this);
         return -1;
@@ -154,65 +216,183 @@ int32_t RTSPServerSession::StartSession()
         return -2;
     }
 
+    m_SessionWriter.Open(m_nSessionfd);
+    m_nSendEventfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_nSendEventfd == -1)
+    {
+        Error("[%p][RTSPServer::StartSession] create eventfd fail,errno:%d", this, errno);
+        return -4;
+    }
+
+    m_HeartBeatimeoutTimer.MakeTimePoint();
+    m_RateCheckTimer.MakeTimePoint();
     m_bStopSession = false;
-    m_pSessionThread = new std::thread(&RTSPServerSession::SessionThread, this);
-    m_pSessionThread->detach();
+    if (m_pReactor->AddSocket(m_nSessionfd, EPOLLIN, [this](uint32_t events) { OnSessionEvent(events); }) != 0 ||
+        m_pReactor->AddSocket(m_nSendEventfd, EPOLLIN, [this](uint32_t events) { OnSendEvent(events); }) != 0)
+    {
+        Error("[%p][RTSPServer::StartSession] add socket to reactor fail", this);
+        DetachReactor();
+        m_bStopSession = true;
+        return -5;
+    }
+    m_nSessionTimerId = m_pReactor->AddTimer(SESSION_TIMER_CYCLE, true, [this]() { OnSessionTimer(); });
 
     return 0;
 }
 
-void RTSPServerSession::SessionThread()
+//idempotent,after it returns the reactor calls nothing of this session
+void RTSPServerSession::DetachReactor()
 {
-    Trace("[%p][RTSPServer::SessionThread] start SessionThread", this);
-    uint8_t* pRecvBuff = (uint8_t*)malloc(RECV_BUFF_SIZE);
-    if (pRecvBuff == nullptr)
+    if (m_nSessionTimerId > 0)
+    {
+        m_pReactor->RemoveTimer(m_nSessionTimerId);
+        m_nSessionTimerId = 0;
+    }
+    if (m_nSendTimerId > 0)
+    {
+        m_pReactor->RemoveTimer(m_nSendTimerId);
+        m_nSendTimerId = 0;
+    }
+    if (m_nSessionfd != -1)
+    {
+        m_pReactor->RemoveSocket(m_nSessionfd);
+    }
+    if (m_nSendEventfd != -1)
+    {
+        m_pReactor->RemoveSocket(m_nSendEventfd);
+    }
+    if (m_nVideoRtpfd != -1)
+    {
+        m_pReactor->RemoveSocket(m_nVideoRtpfd);
+    }
+    if (m_nVideoRtcpfd != -1)
+    {
+        m_pReactor->RemoveSocket(m_nVideoRtcpfd);
+    }
+}
+
+//on the reactor thread:the session stops taking events at once,the release,which waits for the media
+//source,runs on a thread of its own once the current callback has returned;the destructor joins it
+void RTSPServerSession::CloseSession()
+{
+    if (m_bStopSession)
     {
-        Error("[%p][RTSPServer::SessionThread] malloc recv buff fail", this);
         return;
     }
 
-    m_HeartBeatimeoutTimer.MakeTimePoint();
+    m_bStopSession = true;
+    m_bStopSendMedia = true;
+    m_VideoPacer.Close();
+    DetachReactor();
+    m_nReleaseTimerId = m_pReactor->AddTimer(0, false, [this]()
+        {
+            m_nReleaseTimerId = 0;
+            m_ReleaseThread = std::thread([this]() { StopSession(); });
+        });
+}
 
-    bool m_bNeedWait;
-    while (!m_bStopSession)
+void RTSPServerSession::OnSessionEvent(uint32_t events)
+{
+    if (events & (EPOLLIN | EPOLLERR | EPOLLHUP))
     {
-        m_bNeedWait = false;
-
-        ssize_t len = recv(m_nSessionfd, pRecvBuff, RECV_BUFF_SIZE, 0);
-        if (len == -1)
+        uint8_t pRecvBuff[RECV_BUFF_SIZE];
+        while (!m_bStopSession)
         {
-            int err = errno;
-            if (err != EAGAIN)
+            ssize_t len = recv(m_nSessionfd, pRecvBuff, RECV_BUFF_SIZE, 0);
+            if (len > 0)
+            {
+                m_SessionBuff.Append(pRecvBuff, len);
+                HandleMsg();
+                continue;
+            }
+            if (len == -1 && errno == EINTR)
+            {
+                continue;
+            }
+            if (len == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
             {
-                Error("[%p][RTSPServer::ServerThread]  recv error:%d", this, err);
-                m_bStopSession = true;
                 break;
             }
 
-            m_bNeedWait = true;
+            if (len == 0)
+            {
+                Trace("[%p][RTSPServer::OnSessionEvent] session closed by peer", this);
+            }
+            else
+            {
+                Error("[%p][RTSPServer::OnSessionEvent]  recv error:%d", this, errno);
+            }
+            CloseSession();
+            return;
         }
-        else
+    }
+
+    if ((events & EPOLLOUT) && !m_bStopSession)
+    {
+        if (FlushSessionData() != 0)
         {
-            m_SessionBuff.Append(pRecvBuff, len);
-            HandleMsg();
+            CloseSession();
+            return;
         }
+        SendVideo();
+    }
+}
 
-        if (m_HeartBeatimeoutTimer.GetDuration() > HEART_BEAT_TIMEOUT)
+void RTSPServerSession::OnVideoRtcpEvent(uint32_t events)
+{
+    uint8_t pRecvBuff[RECV_BUFF_SIZE];
+    while (!m_bStopSession)
+    {
+        ssize_t len = recv(m_nVideoRtcpfd, pRecvBuff, RECV_BUFF_SIZE, MSG_DONTWAIT);
+        if (len > 0)
         {
-            Error("[%p][RTSPServer::ServerThread]  recv heart timeout:%d", this, HEART_BEAT_TIMEOUT);
-            m_bStopSession = true;
-            break;
+            OnRecvVideoRtcp(pRecvBuff, len);
+            continue;
         }
-
-        if (m_bNeedWait)
+        if (len == -1 && errno == EINTR)
         {
-            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            continue;
         }
+        break;
+    }
+
+    //retransmissions asked for above
+    SendVideo();
+}
+
+void RTSPServerSession::OnVideoRtpEvent(uint32_t events)
+{
+    if (events & EPOLLOUT)
+    {
+        m_pReactor->ModifySocket(m_nVideoRtpfd, 0);
+        SendVideo();
     }
+}
 
-    free(pRecvBuff);
-    Trace("[%p][RTSPServer::SessionThread] exit SessionThread", this);
-    StopSession();
+void RTSPServerSession::OnSendEvent(uint32_t events)
+{
+    uint64_t value;
+    while (read(m_nSendEventfd, &value, sizeof(value)) > 0);
+    m_bSendNotified = false;
+    SendVideo();
+}
+
+void RTSPServerSession::OnSessionTimer()
+{
+    CheckRateTimeout();
+
+    if (m_HeartBeatimeoutTimer.GetDuration() > HEART_BEAT_TIMEOUT)
+    {
+        Error("[%p][RTSPServer::OnSessionTimer]  recv heart timeout:%d", this, HEART_BEAT_TIMEOUT);
+        CloseSession();
+        return;
+    }
+
+    if (!m_bStopSendMedia && m_SenderReportTimer.GetDuration() >= SENDER_REPORT_CYCLE)
+    {
+        m_SenderReportTimer.MakeTimePoint();
+        SendSenderReport();
+    }
 }
 
 int32_t RTSPServerSession::StopSession()
@@ -255,14 +435,15 @@ bool RTSPServerSession::IsRtspResponseMsg(uint8_t* const  msg, const uint32_t si
     return ret;
 }
 
+//interleaved channels:RTP on the even one,RTCP on the odd one
 bool RTSPServerSession::IsRtcpMsg(uint8_t* const  msg, const uint32_t size)
 {
-    return (msg[0] == 0x24 && (msg[1] % 2 == 0));
+    return (msg[0] == 0x24 && (msg[1] % 2 == 1));
 }
 
 bool RTSPServerSession::IsRtpMsg(uint8_t* const  msg, const uint32_t size)
 {
-    return (msg[0] == 0x24 && (msg[1] % 2 == 1));
+    return (msg[0] == 0x24 && (msg[1] % 2 == 0));
 }
 
 bool RTSPServerSession::FindRtspMsg(uint8_t* const  msg, const uint32_t size, uint32_t& msgSize)
@@ -326,7 +507,7 @@ int32_t RTSPServerSession::HandleMsg()
     uint32_t nDataSize;
     bool handed = false;
 
-    while (true)
+    while (!m_bStopSession)
     {
         handed = false;
         m_SessionBuff.GetRawData(pRawData, nDataSize);
@@ -517,9 +698,172 @@ int32_t RTSPServerSession::OnRecvRtspResponse(const RtspParser::RtspResponse& rs
 
 int32_t RTSPServerSession::OnRecvRtcp(uint8_t* const  msg, const uint32_t size)
 {
+    if (size <= 4 || msg[1] != 0x01)
+    {
+        return 0;
+    }
+
+    return OnRecvVideoRtcp(msg + 4, size - 4);
+}
+
+int32_t RTSPServerSession::OnRecvVideoRtcp(const uint8_t* data, const uint32_t size)
+{
+    std::list<uint16_t> lost;
+    if (RTCPPacket::ParseGenericNack(data, size, lost) == 0)
+    {
+        OnRecvNack(lost);
+    }
+
+    RTCPPacket::ReportBlock block;
+    int32_t ret = RTCPPacket::ParseReceiverReport(data, size, block);
+    if (ret != 0)
+    {
+        if (ret != -2)
+        {
+            Warn("[%p][RTSPServerSession::OnRecvVideoRtcp] ParseReceiverReport fail,return:%d", this, ret);
+        }
+        return 0;
+    }
+
+    int32_t rtt = RTCPPacket::GetRoundTripTime(block, RTCPPacket::GetCompactNTP(RTCPPacket::GetNTPTime()));
+    if (rtt >= 0)
+    {
+        m_nRtt = rtt;
+    }
+
+    if (m_pRateController == nullptr || m_pMediaSource == nullptr || !m_bEnableAbr)
+    {
+        return 0;
+    }
+
+    uint64_t now = TimeCounter::GetMediaTime() * 1000 / MEDIA_CLOCK_RATE;
+    uint64_t sendBytes = m_lSendBytes;
+    RateController::Feedback feedback;
+    feedback.m_lTime = now;
+    feedback.m_fLossRate = block.m_nFractionLost / 256.0f;
+    feedback.m_nRtt = rtt;
+    feedback.m_nJitter = (uint32_t)((uint64_t)block.m_nJitter * 1000 / MEDIA_CLOCK_RATE);
+    if (m_lLastFeedbackTime != 0 && now > m_lLastFeedbackTime)
+    {
+        feedback.m_nSendBitRate = (uint32_t)((sendBytes - m_lLastFeedbackBytes) * 8 * 1000 / (now - m_lLastFeedbackTime));
+    }
+    m_lLastFeedbackTime = now;
+    m_lLastFeedbackBytes = sendBytes;
+
+    const RateController::Target& target = m_pRateController->OnFeedback(feedback);
+    UpdatePacingRate();
+    Debug("[%p][RTSPServerSession::OnRecvVideoRtcp] loss:%.1f%% rtt:%d jitter:%u send:%u -> %s bitrate:%u encoder:%u fec:%d level:%u", this,
+        feedback.m_fLossRate * 100, feedback.m_nRtt, feedback.m_nJitter, feedback.m_nSendBitRate, RateController::GetStateName(m_pRateController->GetState()),
+        target.m_nBitRate, target.m_nEncoderBitRate, target.m_eRepairMode, target.m_nResolutionLevel);
+
+    return m_pMediaSource->UpdateRateTarget(this, target);
+}
+
+//a token bucket filled at RETRANSMIT_SHARE of the rate the link is given,so retransmission never
+//pushes the session past what the rate control allows
+int32_t RTSPServerSession::OnRecvNack(const std::list<uint16_t>& lost)
+{
+    if (m_pImageTransoprt == nullptr || m_pMediaSource == nullptr)
+    {
+        return 0;
+    }
+
+    double rate = GetTargetBitRate() * RETRANSMIT_SHARE / 8;
+    double burst = rate * RETRANSMIT_MAX_BURST / 1000;
+    uint64_t now = TimeCounter::GetMediaTime();
+    m_fRetransmitToken = m_lLastTokenTime == 0 ? burst : m_fRetransmitToken + rate * (now - m_lLastTokenTime) / MEDIA_CLOCK_RATE;
+    m_fRetransmitToken = m_fRetransmitToken > burst ? burst : m_fRetransmitToken;
+    m_lLastTokenTime = now;
+
+    for (auto seq : lost)
+    {
+        double age = 0;
+        std::shared_ptr<Packet> packet = m_pImageTransoprt->GetCachedRtpPacket(seq, age);
+        if (packet == nullptr || age + m_nRtt / 2.0 > RETRANSMIT_MAX_AGE)
+        {
+            m_nRetransmitLateNum++;
+            continue;
+        }
+        if (m_fRetransmitToken < packet->m_nLength)
+        {
+            m_nRetransmitLimitNum++;
+            continue;
+        }
+
+        m_fRetransmitToken -= packet->m_nLength;
+        if (!m_VideoPacer.Push(packet, Pacer::PACKET_CLASS_RETRANSMIT))
+        {
+            Warn("[%p][RTSPServerSession::OnRecvNack] RtpPacketList Packet List  size > %d,discard", this, MAX_RTP_CACHE_NUM);
+            continue;
+        }
+        m_nRetransmitNum++;
+    }
+
+    Debug("[%p][RTSPServerSession::OnRecvNack] nack:%d rtt:%d,retransmit:%u late:%u limit:%u", this, (int)lost.size(), m_nRtt,
+        m_nRetransmitNum, m_nRetransmitLateNum, m_nRetransmitLimitNum);
     return 0;
 }
 
+void RTSPServerSession::CheckRateTimeout()
+{
+    if (m_pRateController == nullptr || m_pMediaSource == nullptr || !m_bEnableAbr || m_RateCheckTimer.GetDuration() < RATE_CHECK_CYCLE)
+    {
+        return;
+    }
+    m_RateCheckTimer.MakeTimePoint();
+
+    //the source only touches the encoder when the aggregate changes
+    uint64_t now = TimeCounter::GetMediaTime() * 1000 / MEDIA_CLOCK_RATE;
+    const RateController::Target& target = m_pRateController->CheckTimeout(now);
+    UpdatePacingRate();
+    m_pMediaSource->UpdateRateTarget(this, target);
+}
+
+//what the link is given,FEC included
+uint32_t RTSPServerSession::GetTargetBitRate()
+{
+    if (m_pMediaSource == nullptr)
+    {
+        return 0;
+    }
+
+    return m_pRateController != nullptr && m_bEnableAbr ? m_pRateController->GetTarget().m_nBitRate : m_pMediaSource->GetMaxBitRate();
+}
+
+void RTSPServerSession::UpdatePacingRate()
+{
+    uint32_t bitRate = GetTargetBitRate();
+    m_VideoPacer.SetBitRate(bitRate);
+    m_SessionWriter.SetBitRate(bitRate);
+}
+
+//the encoder's share is what is left after the repairs the FEC in use sends,the next rate check
+//passes it on to the source
+void RTSPServerSession::UpdateRepairOverhead()
+{
+    FECBlock::Config config;
+    uint32_t ssrc = 0;
+    if (m_pRateController == nullptr || m_pImageTransoprt == nullptr || m_pImageTransoprt->GetFECConfig(config, ssrc) != 0)
+    {
+        return;
+    }
+
+    FECBlock* pFECBlock = FECBlock::CreateBlock(config, config.m_nPayloadType);
+    if (pFECBlock == nullptr)
+    {
+        Error("[%p][RTSPServerSession::UpdateRepairOverhead] create FECBlock fail", this);
+        return;
+    }
+    //1D geometry sends no row repairs whatever the mode
+    float column = pFECBlock->GetRepairOverhead(false, true);
+    float rowAndColumn = config.m_eScheme == FECBlock::SCHEME_2D_XOR && config.m_nDimension == 1 ? column : pFECBlock->GetRepairOverhead(true, true);
+    delete pFECBlock;
+
+    Debug("[%p][RTSPServerSession::UpdateRepairOverhead] fec:%s overhead col:%.3f row+col:%.3f", this,
+        FECBlock::MakeSdpAttribute(config).c_str(), column, rowAndColumn);
+    m_pRateController->SetRepairOverhead(column, rowAndColumn);
+}
+
 int32_t RTSPServerSession::OnRecvRtp(uint8_t* const  msg, const uint32_t size)
 {
     return 0;
@@ -543,7 +887,7 @@ int32_t RTSPServerSession::SendRtspRequest(RtspParser::RtspRequest& req)
         return -1;
     }
 
-    ret = send(m_nSessionfd, strMsg.c_str(), strMsg.length(), 0);
+    ret = SendSessionData((const uint8_t*)strMsg.c_str(), strMsg.length());
     if (ret < 0)
     {
         Error("[%p][RTSPClient::SendRtspResponse] send error,errno:%d", this, errno);
@@ -562,7 +906,7 @@ int32_t RTSPServerSession::SendRtspResponse(const RtspParser::RtspResponse& rsp)
         return -1;
     }
 
-    ret = send(m_nSessionfd, strMsg.c_str(), strMsg.length(), 0);
+    ret = SendSessionData((const uint8_t*)strMsg.c_str(), strMsg.length());
     if (ret < 0)
     {
         Error("[%p][RTSPServer::SendRtspResponse] send error,errno:%d", this, errno);
@@ -572,6 +916,36 @@ int32_t RTSPServerSession::SendRtspResponse(const RtspParser::RtspResponse& rsp)
     return 0;
 }
 
+//everything on the rtsp connection goes through the writer in order,what the socket does not take now
+//is sent on EPOLLOUT
+int32_t RTSPServerSession::SendSessionData(const uint8_t* data, uint32_t size)
+{
+    if (m_SessionWriter.WriteData(data, size) != 0)
+    {
+        return -1;
+    }
+
+    return FlushSessionData();
+}
+
+int32_t RTSPServerSession::FlushSessionData()
+{
+    if (m_SessionWriter.Flush() != 0)
+    {
+        return -1;
+    }
+
+    if (m_SessionWriter.GetPendingBytes() > 0)
+    {
+        WaitWritable(m_nSessionfd);
+    }
+    else
+    {
+        m_pReactor->ModifySocket(m_nSessionfd, EPOLLIN);
+    }
+    return 0;
+}
+
 int32_t RTSPServerSession::SetVideoType(const std::string& type)
 {
     Trace("[%p][RTSPServer::SetVideoType] set video type:%s", this, type.c_str());
@@ -805,10 +1179,11 @@ int32_t RTSPServerSession::HandlePlayRequest(const RtspParser::RtspRequest& req)
     }
 
     m_bStopSendMedia = false;
-    if (m_pSendMediaThread == nullptr)
-    {
-        m_pSendMediaThread = new std::thread(&RTSPServerSession::SendMediaThread, this);
-    }
+    m_VideoPacer.Open();
+    //over TCP the pacer keeps every media packet,the writer drops whole frames
+    m_VideoPacer.SetDropMedia(m_eVideoTransport == UDP);
+    m_SessionWriter.SetIntraOnly(m_eVideoType != VIDEO_TYPE_H264);
+    m_SenderReportTimer.MakeTimePoint();
 
     VideoCapture::VideoCaptureCapability capability;
     capability.m_nWidth = m_nVideoWidth;
@@ -817,30 +1192,43 @@ int32_t RTSPServerSession::HandlePlayRequest(const RtspParser::RtspRequest& req)
     capability.m_bInterlaced = false;
     capability.m_nVideoType = V4L2_PIX_FMT_MJPEG;
 
-    delete m_pImageTransoprt;
-    bool bIsEnableFec = m_eVideoTransport == UDP ? true : false;
-    m_pImageTransoprt = new ImageTransoprt(bIsEnableFec);
-    int ret = m_pImageTransoprt->StartTransoprt(m_strResouce, capability, m_eVideoType);
-    if (ret != 0)
+    if (m_pMediaSource != nullptr)
     {
-        delete m_pImageTransoprt;
+        m_pMediaSourceRegistry->Unsubscribe(m_pMediaSource, this);
         m_pImageTransoprt = nullptr;
-
+    }
+    bool bIsEnableFec = m_eVideoTransport == UDP ? true : false;
+    MediaSource::PacketCallbaclk callback = std::bind(&RTSPServerSession::OnRecvVideoPacket, this, std::placeholders::_1);
+    m_pMediaSource = m_pMediaSourceRegistry->Subscribe(m_strResouce, capability, m_eVideoType, bIsEnableFec, this, callback);
+    int ret = 0;
+    if (m_pMediaSource == nullptr)
+    {
         m_bStopSendMedia = true;
-        m_pSendMediaThread->join();
-        delete m_pSendMediaThread;
-        m_pSendMediaThread = nullptr;
+        m_VideoPacer.Close();
 
         rsp.m_StrErrcode = "400";
         rsp.m_StrReason = "Open media fail";
-        Error("[%p][RTSPServer::HandlePlayRequest] ImageTransopr StartTransoprt fail,return:%d ", this, ret);
+        Error("[%p][RTSPServer::HandlePlayRequest] subscribe media source fail", this);
         ret = -1;
     }
     else
     {
-        EnableOSD(m_bEnableOSD);
-        ImageTransoprt::RtpPacketCallbaclk callback = std::bind(&RTSPServerSession::OnRecvVideoPacket, this, std::placeholders::_1);
-        m_pImageTransoprt->SetRtpPacketCallbaclk(callback);
+        m_pImageTransoprt = m_pMediaSource->GetImageTransoprt();
+        m_nAnnouncedFECSSRC = 0;
+
+        RateController::Config config;
+        config.m_nMaxBitRate = m_pMediaSource->GetMaxBitRate();
+        config.m_nWidth = m_nVideoWidth;
+        config.m_nHeight = m_nVideoHight;
+        config.m_nFPS = m_nFps > 0 ? m_nFps : 25;
+        config.m_bEnableFec = bIsEnableFec;
+        delete m_pRateController;
+        m_pRateController = new RateController(config);
+        UpdateRepairOverhead();
+        m_lLastFeedbackBytes = m_lSendBytes;
+        m_lLastFeedbackTime = 0;
+        m_VideoPacer.SetFrameBudget(1000 / config.m_nFPS);
+        UpdatePacingRate();
 
         rsp.m_StrErrcode = "200";
         rsp.m_StrReason = "OK";
@@ -984,8 +1372,137 @@ int32_t RTSPServerSession::HandleSetupdRequest(const RtspParser::RtspRequest& re
     return ret;
 }
 
+//body is text/parameters,one "name: value" per line,e.g. "bitrate: 4000000\r\nidr: 1"
 int32_t RTSPServerSession::HandleSetParameterRequest(const RtspParser::RtspRequest& req)
 {
+    m_HeartBeatimeoutTimer.MakeTimePoint();
+
+    RtspParser::RtspResponse rsp;
+    rsp.m_StrVersion = "RTSP/1.0";
+    rsp.m_StrErrcode = "200";
+    rsp.m_StrReason = "OK";
+    if (req.m_FieldsMap.find("CSeq") != req.m_FieldsMap.end())
+    {
+        rsp.m_FieldsMap["CSeq"] = req.m_FieldsMap.at("CSeq");
+    }
+    if (req.m_FieldsMap.find("Session") != req.m_FieldsMap.end())
+    {
+        rsp.m_FieldsMap["Session"] = req.m_FieldsMap.at("Session");
+    }
+
+    std::vector<std::string> lines;
+    split(req.m_StrContent, lines, "\r\n");
+    for (auto& line : lines)
+    {
+        size_t pos = line.find(":");
+        if (pos == std::string::npos)
+        {
+            continue;
+        }
+        std::string key = line.substr(0, pos);
+        std::string value = line.substr(pos + 1);
+        value.erase(0, value.find_first_not_of(" "));
+
+        if (m_pImageTransoprt == nullptr)
+        {
+            rsp.m_StrErrcode = "455";
+            rsp.m_StrReason = "Method Not Valid in This State";
+            break;
+        }
+
+        int32_t ret = SetEncoderParame(key, value);
+        if (ret != 0)
+        {
+            Error("[%p][RTSPServer::HandleSetParameterRequest] set key:%s value:%s fail,return:%d", this, key.c_str(), value.c_str(), ret);
+            rsp.m_StrErrcode = ret == -999 ? "451" : "400";
+            rsp.m_StrReason = ret == -999 ? "Parameter Not Understood" : "Bad Request";
+        }
+    }
+
+    return SendRtspResponse(rsp);
+}
+
+//the media source is shared,so the change applies to every session watching it
+int32_t RTSPServerSession::SetEncoderParame(const std::string& key, const std::string& value)
+{
+    Trace("[%p][RTSPServer::SetEncoderParame] set %s:%s", this, key.c_str(), value.c_str());
+    char* end = nullptr;
+    unsigned long num = strtoul(value.c_str(), &end, 10);
+    bool bIsNum = isdigit((unsigned char)value[0]) && end[strspn(end, " ")] == '\0' && num <= UINT32_MAX;
+    //0 would mean no IDR after the first,or no frame throttling,never what a typo should turn on
+    if ((key == "bitrate" || key == "gop" || key == "fps" || key == "peak_bitrate") && (!bIsNum || num == 0))
+    {
+        Error("[%p][RTSPServer::SetEncoderParame] invalid %s:%s", this, key.c_str(), value.c_str());
+        return -1;
+    }
+
+    int32_t ret =
+        key == "bitrate" ? SetMaxBitRate(num) :
+        key == "abr" && value == "on" ? EnableAbr(true) :
+        key == "abr" && value == "off" ? EnableAbr(false) :
+        key == "gop" ? m_pImageTransoprt->SetGOP(num) :
+        key == "fps" ? m_pImageTransoprt->SetFPS(num) :
+        key == "idr" ? m_pImageTransoprt->RequestKeyFrame() :
+        key == "rate_control" && value == "cbr" ? m_pImageTransoprt->SetRateControl(VideoEncoder::RATE_CONTROL_CBR, 0) :
+        key == "rate_control" && value == "vbr" ? m_pImageTransoprt->SetRateControl(VideoEncoder::RATE_CONTROL_VBR, 0) :
+        key == "peak_bitrate" ? m_pImageTransoprt->SetRateControl(VideoEncoder::RATE_CONTROL_VBR, num) :
+        key == "fec" ? SetFECConfig(value) : -999;
+
+    return ret;
+}
+
+//same syntax as a=x-fec:,the keys it leaves out keep the values in use,without pt= the repairs keep the
+//session's payload type
+int32_t RTSPServerSession::SetFECConfig(const std::string& attribute)
+{
+    FECBlock::Config config;
+    uint32_t ssrc = 0;
+    if (m_pImageTransoprt->GetFECConfig(config, ssrc) != 0)
+    {
+        config = m_pMediaSourceRegistry->GetFECConfig();
+    }
+    int32_t ret = FECBlock::ParseSdpAttribute(attribute, config);
+    if (ret != 0)
+    {
+        Error("[%p][RTSPServerSession::SetFECConfig] parse fec:%s fail,return:%d", this, attribute.c_str(), ret);
+        return -1;
+    }
+    if (attribute.find("pt=") == std::string::npos)
+    {
+        config.m_nPayloadType = m_nFECPayloadType;
+    }
+
+    return m_pImageTransoprt->SetFECConfig(config);
+}
+
+//with adaptation on the requested bitrate is the ceiling,the link decides how much of it is used
+int32_t RTSPServerSession::SetMaxBitRate(uint32_t bitRate)
+{
+    if (m_pMediaSource == nullptr)
+    {
+        return m_pImageTransoprt->SetBitRate(bitRate);
+    }
+
+    m_pMediaSource->SetMaxBitRate(bitRate);
+    if (m_pRateController != nullptr)
+    {
+        m_pRateController->SetMaxBitRate(bitRate);
+    }
+    UpdatePacingRate();
+
+    return 0;
+}
+
+int32_t RTSPServerSession::EnableAbr(bool enable)
+{
+    Trace("[%p][RTSPServerSession::EnableAbr] abr:%s", this, enable ? "on" : "off");
+    m_bEnableAbr = enable;
+    if (!enable && m_pMediaSource != nullptr)
+    {
+        m_pMediaSource->RemoveRateTarget(this);
+    }
+    UpdatePacingRate();
+
     return 0;
 }
 
@@ -1005,7 +1522,7 @@ int32_t RTSPServerSession::HandleTeardownRequest(const RtspParser::RtspRequest&
     rsp.m_StrReason = "OK";
 
     SendRtspResponse(rsp);
-    StopSession();
+    CloseSession();
     return 0;
 }
 
@@ -1087,6 +1604,15 @@ int32_t RTSPServerSession::MakeDeviceSdp(std::string& sdp, const std::string dev
         m_eVideoType == VIDEO_TYPE_MJPG ? "MJPG" : "H264";
     sdp += type;
     sdp += "/90000\r\n";
+    //repairs only go over UDP,a TCP session is known once it is set up or when the client says so up front
+    bool bIsTcp = m_eVideoTransport == TCP ||
+        (req.m_FieldsMap.find("Transport") != req.m_FieldsMap.end() && req.m_FieldsMap.at("Transport").find("TCP") != std::string::npos);
+    if (!bIsTcp)
+    {
+        sdp += "a=x-fec:";
+        sdp += FECBlock::MakeSdpAttribute(m_pMediaSourceRegistry->GetFECConfig());
+        sdp += "\r\n";
+    }
     m_nVideoTrackId = 1;
 
     return 0;
@@ -1225,6 +1751,14 @@ int32_t RTSPServerSession::SetupVideo(const RtspParser::RtspRequest& req)
             Error("[%p][RTSPServer::SetupVideo] AllocUdpSocket fail", this);
             return -5;
         }
+
+        //the rtp socket is only watched while a batch waits for room
+        if (m_pReactor->AddSocket(m_nVideoRtcpfd, EPOLLIN, [this](uint32_t events) { OnVideoRtcpEvent(events); }) != 0 ||
+            m_pReactor->AddSocket(m_nVideoRtpfd, 0, [this](uint32_t events) { OnVideoRtpEvent(events); }) != 0)
+        {
+            Error("[%p][RTSPServer::SetupVideo] add socket to reactor fail", this);
+            return -6;
+        }
     }
 
     return 0;
@@ -1238,178 +1772,275 @@ int32_t RTSPServerSession::SetupAudio(const RtspParser::RtspRequest& req)
 
 void RTSPServerSession::OnRecvVideoPacket(const std::shared_ptr<Packet>& packet)
 {
-    bool bHasDiscard = false;
+    //called from the shared source thread,only queue here so a slow client does not stall the others
+    Pacer::PacketClass packetClass = packet->m_nLength > 12 && (packet->m_pData[1] & 0x7f) == m_nFECPayloadType ?
+        Pacer::PACKET_CLASS_REPAIR : Pacer::PACKET_CLASS_MEDIA;
+    if (!m_VideoPacer.Push(packet, packetClass))
     {
-        std::lock_guard<std::mutex> lock(m_VideoRtpPacketListLock);
-        m_VideoRtpPacketList.push_back(packet);
-
-        if (m_VideoRtpPacketList.size() > (MAX_RTP_CACHE_NUM))
-        {
-            m_VideoRtpPacketList.clear();
-        }
+        Warn("[%p][RTSPServerSession::OnRecvRtpPacket] RtpPacketList Packet List  size > %d,discard", this, MAX_RTP_CACHE_NUM);
     }
 
-    if (bHasDiscard)
+    //one wakeup until the reactor has taken it
+    uint64_t value = 1;
+    if (!m_bSendNotified.exchange(true) && write(m_nSendEventfd, &value, sizeof(value)) < 0 && errno != EAGAIN)
     {
-        Warn("[%p][RTSPServerSession::OnRecvRtpPacket] RtpPacketList Packet List  size > %d,discard", this, MAX_RTP_CACHE_NUM);
+        Warn("[%p][RTSPServerSession::OnRecvVideoPacket] notify fail,errno:%d", this, errno);
     }
 }
 
-void RTSPServerSession::SendMediaThread()
+//the RTP timestamps come from the same clock as TimeCounter::GetMediaTime,so "now" maps directly
+int32_t RTSPServerSession::SendSenderReport()
 {
-    if (m_pSendBuff == nullptr)
+    RTCPPacket::SenderInfo info;
+    info.m_nSSRC = VIDEO_SSRC;
+    info.m_lNTPTime = RTCPPacket::GetNTPTime();
+    info.m_nRtpTime = (uint32_t)TimeCounter::GetMediaTime();
+    info.m_nPacketCount = m_nSendPacketNum;
+    info.m_nOctetCount = m_nSendOctetNum;
+
+    std::shared_ptr<Packet> packet = RTCPPacket::MakeSenderReport(info);
+    if (packet == nullptr)
     {
-        m_pSendBuff = (uint8_t*)malloc(MAX_PACKET_SIZE);
-        if (m_pSendBuff == nullptr)
-        {
-            Error("[%p][RTSPServer::StartSession] maloc send buff fail", this);
-            return;
-        }
+        Error("[%p][RTSPServerSession::SendSenderReport] MakeSenderReport fail", this);
+        return -1;
     }
 
-    while (!m_bStopSendMedia)
+    int32_t ret = SendVideoPacket(packet, true);
+    if (m_nAnnouncedFECSSRC != 0)
     {
-        bool bHasSendVideo;
-        SendVideo(bHasSendVideo);
-        bool bHasSendAudio;
-        SendAudio(bHasSendAudio);
+        SendFECConfig();
+    }
 
-        if ((!bHasSendVideo) && (!bHasSendAudio))
-        {
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
-        }
+    //the latency paid for not bursting
+    Pacer::PacerStats stats = m_VideoPacer.GetStats();
+    LatencyTracer::GetTracer()->SetGauge(LatencyTracer::GAUGE_PACING_DELAY, (uint32_t)(stats.m_fMaxDelay + 0.5));
+    Debug("[%p][RTSPServerSession::SendSenderReport] pacing delay avg:%.1fms max:%.1fms budget:%u queue:%u/%llu dropped:%llu", this,
+        stats.m_fAvgDelay, stats.m_fMaxDelay, stats.m_nBudgetNum, stats.m_nQueueNum, (unsigned long long)stats.m_lQueueBytes,
+        (unsigned long long)stats.m_nDroppedNum);
+
+    if (m_eVideoTransport == TCP)
+    {
+        InterleavedWriter::WriterStats writerStats = m_SessionWriter.GetStats();
+        uint32_t backlog = m_SessionWriter.GetBacklogTime();
+        LatencyTracer::GetTracer()->SetGauge(LatencyTracer::GAUGE_TCP_BACKLOG, backlog);
+        Debug("[%p][RTSPServerSession::SendSenderReport] tcp backlog:%ums pending:%u writes:%llu packets:%llu dropped frames:%u packets:%u", this,
+            backlog, m_SessionWriter.GetPendingBytes(), (unsigned long long)writerStats.m_nWriteNum, (unsigned long long)writerStats.m_nPacketNum,
+            writerStats.m_nDroppedFrameNum, writerStats.m_nDroppedPacketNum);
     }
+    return ret;
 }
 
-int32_t RTSPServerSession::SendVideo(bool& bHasSend)
+//ahead of the first repair of a new geometry,and again with every SR in case that one is lost
+int32_t RTSPServerSession::SendFECConfig()
 {
-    std::shared_ptr<Packet> packet = nullptr;
+    FECBlock::Config config;
+    uint32_t ssrc = 0;
+    if (m_pImageTransoprt == nullptr || m_pImageTransoprt->GetFECConfig(config, ssrc) != 0)
     {
-        std::lock_guard<std::mutex> lock(m_VideoRtpPacketListLock);
-        if (m_VideoRtpPacketList.size() > 0)
-        {
-            packet = m_VideoRtpPacketList.front();
-            m_VideoRtpPacketList.pop_front();
-        }
+        return 0;
     }
 
+    std::shared_ptr<Packet> packet = RTCPPacket::MakeFECConfig(VIDEO_SSRC, ssrc, FECBlock::MakeSdpAttribute(config));
     if (packet == nullptr)
     {
-        bHasSend = false;
-        return 0;
+        Error("[%p][RTSPServerSession::SendFECConfig] MakeFECConfig fail", this);
+        return -1;
     }
 
-    bHasSend = true;
-    int nSendfd = m_nVideoRtpfd;
-
-    int32_t size = 0;
-    if (m_eVideoTransport == TCP)
-    {
-        nSendfd = m_nSessionfd;
-        m_pSendBuff[0] = 0x24;
-        m_pSendBuff[1] = 0x00;
-        m_pSendBuff[2] = packet->m_nLength >> 8;
-        m_pSendBuff[3] = packet->m_nLength & 0xff;
-        size = 4;
-    }
-    memcpy(m_pSendBuff + size, packet->m_pData, packet->m_nLength);
-    size += packet->m_nLength;
+    return SendVideoPacket(packet, true);
+}
 
-    int nSend = 0;
-    int ret = 0;
-    while (nSend < size)
+//on the reactor thread,drains what the pacer lets out until it has to wait for tokens or,over UDP,for
+//the socket;over UDP a batch goes out in one sendmmsg,over TCP the writer queues it and drops whole
+//frames when the connection falls behind
+int32_t RTSPServerSession::SendVideo()
+{
+    while (!m_bStopSendMedia)
     {
-    send:        
-        ret = send(nSendfd, m_pSendBuff + nSend, size - nSend, 0);
-        if(ret == -1)
+        if (m_SendBatch.empty())
         {
-            if (errno == EAGAIN)
+            if (m_VideoPacer.PopBatch(m_SendBatch, SEND_BATCH_NUM, 0) == 0)
             {
-                std::this_thread::sleep_for(std::chrono::milliseconds(1));
-                goto send;
+                int64_t wait = m_VideoPacer.GetWaitTime();
+                if (wait > 0 && m_nSendTimerId == 0)
+                {
+                    int32_t id = m_pReactor->AddTimer((uint32_t)((wait + 999) / 1000), false, [this]()
+                        {
+                            m_nSendTimerId = 0;
+                            SendVideo();
+                        });
+                    m_nSendTimerId = id > 0 ? id : 0;
+                }
+                break;
+            }
+
+            for (auto& packet : m_SendBatch)
+            {
+                if (packet->m_nLength > 12 && (packet->m_pData[1] & 0x7f) == m_nFECPayloadType)
+                {
+                    uint32_t ssrc = (packet->m_pData[8] << 24) | (packet->m_pData[9] << 16) | (packet->m_pData[10] << 8) | packet->m_pData[11];
+                    if (ssrc != m_nAnnouncedFECSSRC)
+                    {
+                        m_nAnnouncedFECSSRC = ssrc;
+                        SendFECConfig();
+                        UpdateRepairOverhead();
+                    }
+                }
             }
-            Error("[%p][RTSPServerSession::SendVideo] send packet fail,errno:%d", this, errno);
-            break;
+        }
+
+        bool bBlocked = false;
+        uint32_t nDoneNum = 0;
+        int32_t nWaitfd = m_nVideoRtpfd;
+        if (m_eVideoTransport == UDP)
+        {
+            nDoneNum = SendUdpBatch(m_nVideoRtpfd, m_SendBatch, bBlocked);
         }
         else
         {
-            nSend += ret;
+            //queued whole and gathered into one write,a frame the writer drops is not counted as sent
+            nWaitfd = m_nSessionfd;
+            for (auto& packet : m_SendBatch)
+            {
+                bool bQueued = packet->m_nLength > 12 && (packet->m_pData[1] & 0x7f) == m_nFECPayloadType ?
+                    m_SessionWriter.WritePacket(packet, 0x00) == 0 : m_SessionWriter.WriteMedia(packet, 0x00);
+                if (bQueued)
+                {
+                    m_SendBatch[nDoneNum++] = packet;
+                }
+            }
+            m_SendBatch.resize(nDoneNum);
+            if (m_SessionWriter.TakeKeyFrameRequest() && m_pImageTransoprt != nullptr)
+            {
+                m_pImageTransoprt->RequestKeyFrame();
+            }
+            if (FlushSessionData() != 0)
+            {
+                //the connection is gone,the session event closes it
+                m_bStopSendMedia = true;
+            }
         }
+
+        for (uint32_t i = 0; i < nDoneNum; i++)
+        {
+            const std::shared_ptr<Packet>& packet = m_SendBatch[i];
+            LatencyTracer::GetTracer()->RecordRtp(LatencyTracer::STAGE_SENT, packet->m_pData, packet->m_nLength);
+            m_lSendBytes += packet->m_nLength;
+            if (packet->m_nLength > 12 && (packet->m_pData[1] & 0x7f) != m_nFECPayloadType)
+            {
+                m_nSendPacketNum++;
+                m_nSendOctetNum += packet->m_nLength - 12;
+            }
+        }
+        m_SendBatch.erase(m_SendBatch.begin(), m_SendBatch.begin() + nDoneNum);
+        uint32_t nQueueNum = m_VideoPacer.Size() + m_SendBatch.size();
+        LatencyTracer::GetTracer()->AddGauge(LatencyTracer::GAUGE_SEND_QUEUE, (int32_t)nQueueNum - (int32_t)m_nSendQueueGauge);
+        m_nSendQueueGauge = nQueueNum;
+
+        if (bBlocked)
+        {
+            WaitWritable(nWaitfd);
+            break;
+        }
+        //a hard error drops the rest of the batch
+        m_SendBatch.clear();
     }
 
     return 0;
+}
+
+//straight from the packets,no copy;returns how many from the front went out,bBlocked when the socket
+//buffer is full and the rest should wait for EPOLLOUT
+uint32_t RTSPServerSession::SendUdpBatch(int32_t fd, const std::vector<std::shared_ptr<Packet>>& packets, bool& bBlocked)
+{
+    struct mmsghdr msgs[SEND_BATCH_NUM];
+    struct iovec iovs[SEND_BATCH_NUM];
+    uint32_t num = packets.size() < SEND_BATCH_NUM ? packets.size() : SEND_BATCH_NUM;
+    bBlocked = false;
+    if (fd == -1)
+    {
+        return 0;
+    }
+
+    memset(msgs, 0, sizeof(struct mmsghdr) * num);
+    for (uint32_t i = 0; i < num; i++)
+    {
+        iovs[i].iov_base = packets[i]->m_pData;
+        iovs[i].iov_len = packets[i]->m_nLength;
+        msgs[i].msg_hdr.msg_iov = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    uint32_t nSendNum = 0;
+    while (nSendNum < num)
+    {
+        int ret = sendmmsg(fd, msgs + nSendNum, num - nSendNum, MSG_DONTWAIT);
+        if (ret > 0)
+        {
+            nSendNum += ret;
+            continue;
+        }
+        if (ret == -1 && errno == EINTR)
+        {
+            continue;
+        }
+        if (ret == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            bBlocked = true;
+            break;
+        }
+
+        Error("[%p][RTSPServerSession::SendUdpBatch] sendmmsg %u of %u fail,errno:%d", this, nSendNum, num, errno);
+        break;
+    }
 
+    return nSendNum;
 }
 
-int32_t RTSPServerSession::SendAudio(bool& bHasSend)
+//instead of retrying on a timer,the reactor calls back when the socket buffer has room
+void RTSPServerSession::WaitWritable(int32_t fd)
 {
-    bHasSend = false;
-    return 0;
+    m_pReactor->ModifySocket(fd, fd == m_nSessionfd ? EPOLLIN | EPOLLOUT : EPOLLOUT);
 }
 
-int32_t RTSPServerSession::EnableOSD(bool enable)
+//RTP and RTCP of the video track,on its own UDP sockets or interleaved on channel 0/1
+int32_t RTSPServerSession::SendVideoPacket(const std::shared_ptr<Packet>& packet, bool isRtcp)
 {
-    if (m_pImageTransoprt == nullptr)
+    if (m_eVideoTransport == TCP)
     {
-        Trace("[%p][RTSPServerSession::EnableOSD] m_pImageTransoprt is null", this);
-        m_bEnableOSD = enable;
-        return 0;
+        if (m_SessionWriter.WritePacket(packet, isRtcp ? 0x01 : 0x00) != 0)
+        {
+            return -1;
+        }
+        return FlushSessionData() == 0 ? 0 : -2;
     }
 
-    if (enable)
+    int nSendfd = isRtcp ? m_nVideoRtcpfd : m_nVideoRtpfd;
+    if (nSendfd == -1)
     {
-        Marker::Color color;
-        color.A = 255 * 0; color.R = 255; color.G = 255; color.B = 255;
-
-        m_pImageTransoprt->AddMarker("pitch");
-        m_pImageTransoprt->SetMarkKey("pitch", ":", color, 25, g_nCaptureHeight / 2 - 100);
-        m_pImageTransoprt->AddMarker("roll");
-        m_pImageTransoprt->SetMarkKey("roll", ":", color, 25, g_nCaptureHeight / 2);
-        m_pImageTransoprt->AddMarker("yaw");
-        m_pImageTransoprt->SetMarkKey("yaw", "ƫ:", color, 25, g_nCaptureHeight / 2 + 100);
-
-        m_pImageTransoprt->AddMarker("vol");
-        m_pImageTransoprt->SetMarkKey("vol", "ѹ:", color, g_nCaptureWidth - 160, g_nCaptureHeight / 2 - 100);
-        m_pImageTransoprt->AddMarker("cur");
-        m_pImageTransoprt->SetMarkKey("cur", ":", color, g_nCaptureWidth - 160, g_nCaptureHeight / 2);
-        m_pImageTransoprt->AddMarker("rem");
-        m_pImageTransoprt->SetMarkKey("rem", ":", color, g_nCaptureWidth - 160, g_nCaptureHeight / 2 + 100);
-
-        m_pImageTransoprt->AddMarker("lat");
-        m_pImageTransoprt->SetMarkKey("lat", "γ:", color, g_nCaptureWidth / 5 * 0 + 25, g_nCaptureHeight - 45);
-        m_pImageTransoprt->AddMarker("lon");
-        m_pImageTransoprt->SetMarkKey("lon", ":", color, g_nCaptureWidth / 5 * 1 + 25, g_nCaptureHeight - 45);
-        m_pImageTransoprt->AddMarker("alt");
-        m_pImageTransoprt->SetMarkKey("alt", ":", color, g_nCaptureWidth / 5 * 2 + 25, g_nCaptureHeight - 45);
-        m_pImageTransoprt->AddMarker("sat");
-        m_pImageTransoprt->SetMarkKey("sat", ":", color, g_nCaptureWidth / 5 * 3 + 25, g_nCaptureHeight - 45);
-        m_pImageTransoprt->AddMarker("vel");
-        m_pImageTransoprt->SetMarkKey("vel", "ٶ:", color, g_nCaptureWidth / 5 * 4 + 25, g_nCaptureHeight - 45);
+        return -1;
     }
-    else
+
+    //an RTCP packet that finds the buffer full is not worth waiting for
+    int ret = send(nSendfd, packet->m_pData, packet->m_nLength, MSG_DONTWAIT);
+    if (ret == -1 && errno != EAGAIN && errno != EWOULDBLOCK)
     {
-        m_pImageTransoprt->RemoveMarker("pitch");
-        m_pImageTransoprt->RemoveMarker("roll");
-        m_pImageTransoprt->RemoveMarker("yaw");
-        m_pImageTransoprt->RemoveMarker("lat");
-        m_pImageTransoprt->RemoveMarker("lon");
-        m_pImageTransoprt->RemoveMarker("alt");
-        m_pImageTransoprt->RemoveMarker("sat");
-        m_pImageTransoprt->RemoveMarker("vel");
-        m_pImageTransoprt->RemoveMarker("vol");
-        m_pImageTransoprt->RemoveMarker("cur");
-        m_pImageTransoprt->RemoveMarker("rem");
+        Error("[%p][RTSPServerSession::SendVideoPacket] send packet fail,errno:%d", this, errno);
+        return -2;
     }
 
-    m_pImageTransoprt->EnableOSD(enable);
-    Trace("[%p][RTSPServerSession::EnableOSD] enable osd:%d", this, enable);
+    return 0;
+}
 
+int32_t RTSPServerSession::SendAudio(bool& bHasSend)
+{
+    bHasSend = false;
     return 0;
 }
 
 int32_t RTSPServerSession::SetAttitude(float pitch, float roll, float yaw)
 {
-    if (m_bEnableOSD && m_pImageTransoprt != nullptr && m_pImageTransoprt->IsEnableOSD())
+    if (m_pImageTransoprt != nullptr && m_pImageTransoprt->IsEnableOSD())
     {
         Marker::Color color;
         color.A = 255 * 0; color.R = 255; color.G = 255; color.B = 255;
@@ -1422,7 +2053,7 @@ int32_t RTSPServerSession::SetAttitude(float pitch, float roll, float yaw)
 
 int32_t RTSPServerSession::SetGPS(int32_t lat, int32_t lon, int32_t alt, uint8_t satellites, uint16_t vel)
 {
-    if (m_bEnableOSD && m_pImageTransoprt != nullptr && m_pImageTransoprt->IsEnableOSD())
+    if (m_pImageTransoprt != nullptr && m_pImageTransoprt->IsEnableOSD())
     {
         Marker::Color color;
         color.A = 255 * 0; color.R = 255; color.G = 255; color.B = 255;
@@ -1437,7 +2068,7 @@ int32_t RTSPServerSession::SetGPS(int32_t lat, int32_t lon, int32_t alt, uint8_t
 
 int32_t RTSPServerSession::SetSysStatus(uint16_t voltage, int16_t current, int8_t batteryRemaining)
 {
-    if (m_bEnableOSD && m_pImageTransoprt != nullptr && m_pImageTransoprt->IsEnableOSD())
+    if (m_pImageTransoprt != nullptr && m_pImageTransoprt->IsEnableOSD())
     {
         Marker::Color color;
         color.A = 255 * 0; color.R = 255; color.G = 255; color.B = 255;
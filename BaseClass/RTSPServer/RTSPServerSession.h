@@ -1,20 +1,26 @@
 #pragma once
+#include <list>
+#include <atomic>
+#include <vector>
 #include <thread>
 #include "CommonTools/ExBuff.h"
 #include "CommonTools/RtspParser.h"
 #include "CommonTools/TimeCounter.h"
-#include "ImageTransoprt/ImageTransoprt.h"
+#include "CommonTools/EventReactor.h"
+#include "InterleavedWriter.h"
+#include "MediaSource.h"
+#include "RateControl/RateController.h"
+#include "RateControl/Pacer.h"
 
 class RTSPServerSession
 {
 public:
-    RTSPServerSession(uint32_t fd, std::string strRemoteIP);
+    RTSPServerSession(uint32_t fd, std::string strRemoteIP, MediaSourceRegistry* registry, EventReactor* reactor);
     ~RTSPServerSession();
 
     int32_t StartSession();
     int32_t StopSession();
     inline bool IsSessionFinished() { return m_bSessionFinished; };
-    int32_t EnableOSD(bool enable);
     //OSD
     int32_t SetAttitude(float pitch, float roll, float yaw);
     int32_t SetGPS(int32_t lat, int32_t lon, int32_t alt, uint8_t satellites, uint16_t vel);
@@ -22,7 +28,13 @@ public:
 
 private:
     int32_t ReleaseAll();
-    void SessionThread();
+    void DetachReactor();
+    void CloseSession();
+    void OnSessionEvent(uint32_t events);
+    void OnVideoRtcpEvent(uint32_t events);
+    void OnVideoRtpEvent(uint32_t events);
+    void OnSendEvent(uint32_t events);
+    void OnSessionTimer();
 
     int32_t HandleDescribeRequest(const RtspParser::RtspRequest& req);
     int32_t HandleAnnounceRequest(const RtspParser::RtspRequest& req);
@@ -38,11 +50,15 @@ private:
 
     int32_t SendRtspResponse(const RtspParser::RtspResponse& rsp);
     int32_t SendRtspRequest(RtspParser::RtspRequest& req);
+    int32_t SendSessionData(const uint8_t* data, uint32_t size);
+    int32_t FlushSessionData();
 
     int32_t HandleMsg();
     int32_t OnRecvRtspRequest(const RtspParser::RtspRequest& req);
     int32_t OnRecvRtspResponse(const RtspParser::RtspResponse& rsp);
     int32_t OnRecvRtcp(uint8_t* const  msg, const uint32_t size);
+    int32_t OnRecvVideoRtcp(const uint8_t* data, const uint32_t size);
+    int32_t OnRecvNack(const std::list<uint16_t>& lost);
     int32_t OnRecvRtp(uint8_t* const  msg, const uint32_t size);
 
     bool IsRtspRequestMsg(uint8_t* const  msg, const uint32_t size);
@@ -62,14 +78,26 @@ private:
     int32_t SetupAudio(const RtspParser::RtspRequest& req);
 
     void OnRecvVideoPacket(const std::shared_ptr<Packet>& packet);
-    void SendMediaThread();
-    int32_t SendVideo(bool& bHasSend);
+    int32_t SendVideo();
+    int32_t SendSenderReport();
+    int32_t SendFECConfig();
+    int32_t SendVideoPacket(const std::shared_ptr<Packet>& packet, bool isRtcp);
+    uint32_t SendUdpBatch(int32_t fd, const std::vector<std::shared_ptr<Packet>>& packets, bool& bBlocked);
+    void WaitWritable(int32_t fd);
+    void CheckRateTimeout();
+    uint32_t GetTargetBitRate();
+    void UpdatePacingRate();
+    void UpdateRepairOverhead();
     int32_t SendAudio(bool& bHasSend);
 
     int32_t ParseExtendedParame(const std::string& param);
     int32_t SetVideoType(const std::string& type);
     int32_t SetResolution(const std::string& resolution);
     int32_t SetFps(const std::string& fps);
+    int32_t SetEncoderParame(const std::string& key, const std::string& value);
+    int32_t SetMaxBitRate(uint32_t bitRate);
+    int32_t EnableAbr(bool enable);
+    int32_t SetFECConfig(const std::string& attribute);
 
 private:
     int32_t m_nSessionfd;
@@ -79,7 +107,9 @@ private:
     std::string m_strUrl;
     TimeCounter m_HeartBeatimeoutTimer;
     bool m_bStopSession;
-    std::thread* m_pSessionThread;
+    EventReactor* m_pReactor;                   //owned by the server,every socket and timer of the session is served on it
+    int32_t m_nSessionTimerId;
+    InterleavedWriter m_SessionWriter;          //rtsp text and interleaved media,what the connection did not take yet is kept
 
     std::string m_strResouceType;
     std::string m_strResouce;
@@ -100,15 +130,42 @@ private:
     int32_t m_nAudioRtpfd;
     int32_t m_nAudioRtcpfd;
 
-    bool m_bEnableOSD;
-    ImageTransoprt* m_pImageTransoprt;
+    MediaSourceRegistry* m_pMediaSourceRegistry;
+    std::shared_ptr<MediaSource> m_pMediaSource;
+    ImageTransoprt* m_pImageTransoprt;      //owned by m_pMediaSource
 
-    std::mutex m_VideoRtpPacketListLock;
-    std::list <std::shared_ptr<Packet>> m_VideoRtpPacketList;
+    Pacer m_VideoPacer;                         //smooths frames onto the link,retransmissions and repair first
     bool m_bStopSendMedia;
-    std::thread* m_pSendMediaThread;
-    bool m_bSessionFinished;
-    uint8_t* m_pSendBuff;
+    int32_t m_nSendEventfd;                     //the source thread wakes the reactor for new packets
+    std::atomic<bool> m_bSendNotified;
+    int32_t m_nSendTimerId;                     //pending wait for pacer tokens,0 none
+    std::atomic<bool> m_bSessionFinished;
+    int32_t m_nReleaseTimerId;                  //CloseSession's wait for the callback to return,0 none
+    std::thread m_ReleaseThread;                //started by that timer,joined before the session is deleted
+    std::vector<std::shared_ptr<Packet>> m_SendBatch;
+    uint32_t m_nSendQueueGauge;                 //this session's share of GAUGE_SEND_QUEUE
+
+    //adaptive bitrate,driven by the receiver reports of this session
+    RateController* m_pRateController;
+    bool m_bEnableAbr;
+    std::atomic<uint32_t> m_nSendPacketNum;     //media only,for the SR
+    std::atomic<uint32_t> m_nSendOctetNum;
+    std::atomic<uint64_t> m_lSendBytes;         //FEC included,for the send rate
+    uint64_t m_lLastFeedbackBytes;
+    uint64_t m_lLastFeedbackTime;
+    TimeCounter m_SenderReportTimer;
+    TimeCounter m_RateCheckTimer;
+
+    //retransmission for the receiver's NACKs,paid from a share of the send rate
+    int32_t m_nRtt;                             //ms from the last receiver report,0 unknown
+    double m_fRetransmitToken;                  //bytes that may be resent now
+    uint64_t m_lLastTokenTime;                  //media time,0 before the first NACK
+    uint32_t m_nRetransmitNum;
+    uint32_t m_nRetransmitLateNum;              //gone from the cache or too old to land in time
+    uint32_t m_nRetransmitLimitNum;             //over the budget
+
+    uint8_t m_nFECPayloadType;
+    uint32_t m_nAnnouncedFECSSRC;               //repair SSRC whose geometry the receiver was told of,0 none
 };
 
 static int32_t ConnectUdpSocket(const std::string& ip, uint16_t port);
@@ -0,0 +1,245 @@
+#include <string.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <time.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "SendBenchmark.h"
+#include "Common.h"
+
+#define BENCHMARK_PACKET_NUM (300000)
+#define BENCHMARK_MIN_SIZE (1000)
+#define BENCHMARK_MAX_SIZE (1400)
+#define BENCHMARK_RUN_NUM (3)
+#define BENCHMARK_BATCH_NUM (32)            //SEND_BATCH_NUM of RTSPServerSession
+#define BENCHMARK_SOCKET_BUFF (4*1024*1024)
+#define BENCHMARK_DRAIN_TIME (200)          //ms the sink gets to empty its buffer between runs
+
+typedef struct SendResult
+{
+    double m_fRate;         //packets per second
+    double m_fCpuTime;      //us of sender CPU per packet
+    double m_fReceived;     //share the sink got,loopback drops when it falls behind
+}SendResult;
+
+static uint64_t GetThreadCpuTime()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+//what SendVideo did per packet before batching
+static int32_t SendByCopy(int32_t fd, const std::vector<std::shared_ptr<Packet>>& packets, uint8_t* buff)
+{
+    for (auto& packet : packets)
+    {
+        memcpy(buff, packet->m_pData, packet->m_nLength);
+        int32_t size = packet->m_nLength;
+        int32_t nSend = 0;
+        while (nSend < size)
+        {
+            int ret = send(fd, buff + nSend, size - nSend, 0);
+            if (ret == -1)
+            {
+                if (errno == EAGAIN)
+                {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                    continue;
+                }
+                return -1;
+            }
+            nSend += ret;
+        }
+    }
+
+    return 0;
+}
+
+//the loop of RTSPServerSession::SendUdpBatch,with poll standing in for the reactor's EPOLLOUT
+static int32_t SendByBatch(int32_t fd, const std::vector<std::shared_ptr<Packet>>& packets)
+{
+    struct mmsghdr msgs[BENCHMARK_BATCH_NUM];
+    struct iovec iovs[BENCHMARK_BATCH_NUM];
+    uint32_t nIndex = 0;
+    while (nIndex < packets.size())
+    {
+        uint32_t num = packets.size() - nIndex < BENCHMARK_BATCH_NUM ? packets.size() - nIndex : BENCHMARK_BATCH_NUM;
+        memset(msgs, 0, sizeof(struct mmsghdr) * num);
+        for (uint32_t i = 0; i < num; i++)
+        {
+            iovs[i].iov_base = packets[nIndex + i]->m_pData;
+            iovs[i].iov_len = packets[nIndex + i]->m_nLength;
+            msgs[i].msg_hdr.msg_iov = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        uint32_t nSendNum = 0;
+        while (nSendNum < num)
+        {
+            int ret = sendmmsg(fd, msgs + nSendNum, num - nSendNum, MSG_DONTWAIT);
+            if (ret > 0)
+            {
+                nSendNum += ret;
+                continue;
+            }
+            if (ret == -1 && errno == EINTR)
+            {
+                continue;
+            }
+            if (ret == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            {
+                struct pollfd pfd = { fd, POLLOUT, 0 };
+                poll(&pfd, 1, 100);
+                continue;
+            }
+            return -1;
+        }
+        nIndex += num;
+    }
+
+    return 0;
+}
+
+int32_t SendBenchmark::RunBenchmark(FILE* out)
+{
+    //sized like the RTP packets of video frames
+    std::vector<std::shared_ptr<Packet>> packets(BENCHMARK_PACKET_NUM);
+    uint32_t seed = 0x12345678;
+    for (auto& packet : packets)
+    {
+        seed = seed * 1103515245 + 12345;
+        packet = std::make_shared<Packet>();
+        packet->m_nLength = BENCHMARK_MIN_SIZE + (seed >> 16) % (BENCHMARK_MAX_SIZE - BENCHMARK_MIN_SIZE + 1);
+        packet->m_pData = (uint8_t*)malloc(packet->m_nLength);
+        if (packet->m_pData == nullptr)
+        {
+            return -1;
+        }
+        memset(packet->m_pData, seed >> 24, packet->m_nLength);
+    }
+    std::vector<uint8_t> buff(BENCHMARK_MAX_SIZE);
+
+    int32_t nSinkfd = socket(AF_INET, SOCK_DGRAM, 0);
+    int32_t nSendfd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (nSinkfd == -1 || nSendfd == -1)
+    {
+        fprintf(out, "create socket fail,errno:%d\n", errno);
+        close(nSinkfd);
+        close(nSendfd);
+        return -1;
+    }
+
+    int32_t nBuffSize = BENCHMARK_SOCKET_BUFF;
+    setsockopt(nSinkfd, SOL_SOCKET, SO_RCVBUF, &nBuffSize, sizeof(nBuffSize));
+    setsockopt(nSendfd, SOL_SOCKET, SO_SNDBUF, &nBuffSize, sizeof(nBuffSize));
+    struct timeval timeout = { 0, 50 * 1000 };
+    setsockopt(nSinkfd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    struct sockaddr_in addr;
+    socklen_t addrLen = sizeof(addr);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    if (bind(nSinkfd, (struct sockaddr*)&addr, sizeof(addr)) != 0 ||
+        getsockname(nSinkfd, (struct sockaddr*)&addr, &addrLen) != 0 ||
+        connect(nSendfd, (struct sockaddr*)&addr, sizeof(addr)) != 0)
+    {
+        fprintf(out, "set up loopback sink fail,errno:%d\n", errno);
+        close(nSinkfd);
+        close(nSendfd);
+        return -1;
+    }
+
+    //the sink only counts,so it stays ahead of either sender as long as it can
+    std::atomic<bool> bStopSink(false);
+    std::atomic<uint64_t> lReceived(0);
+    std::thread sink([&]()
+    {
+        struct mmsghdr msgs[BENCHMARK_BATCH_NUM];
+        struct iovec iovs[BENCHMARK_BATCH_NUM];
+        std::vector<uint8_t> recvBuff(BENCHMARK_BATCH_NUM * BENCHMARK_MAX_SIZE);
+        memset(msgs, 0, sizeof(msgs));
+        for (uint32_t i = 0; i < BENCHMARK_BATCH_NUM; i++)
+        {
+            iovs[i].iov_base = recvBuff.data() + i * BENCHMARK_MAX_SIZE;
+            iovs[i].iov_len = BENCHMARK_MAX_SIZE;
+            msgs[i].msg_hdr.msg_iov = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+        while (!bStopSink)
+        {
+            int ret = recvmmsg(nSinkfd, msgs, BENCHMARK_BATCH_NUM, 0, nullptr);
+            if (ret > 0)
+            {
+                lReceived += ret;
+            }
+        }
+    });
+
+    fprintf(out, "%u packets of %u-%u bytes to 127.0.0.1:%u,batches of %u\n", BENCHMARK_PACKET_NUM, BENCHMARK_MIN_SIZE,
+        BENCHMARK_MAX_SIZE, ntohs(addr.sin_port), BENCHMARK_BATCH_NUM);
+    fprintf(out, "%-10s %4s %10s %12s %9s\n", "path", "run", "kpkt/s", "cpu us/pkt", "received");
+
+    const char* names[2] = { "copy+send", "sendmmsg" };
+    SendResult total[2];
+    memset(total, 0, sizeof(total));
+    int32_t ret = 0;
+    for (uint32_t run = 0; run < BENCHMARK_RUN_NUM && ret == 0; run++)
+    {
+        for (uint32_t path = 0; path < 2; path++)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(BENCHMARK_DRAIN_TIME));
+            lReceived = 0;
+
+            uint64_t lCpuStart = GetThreadCpuTime();
+            auto start = std::chrono::steady_clock::now();
+            ret = path == 0 ? SendByCopy(nSendfd, packets, buff.data()) : SendByBatch(nSendfd, packets);
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            uint64_t lCpuTime = GetThreadCpuTime() - lCpuStart;
+            if (ret != 0)
+            {
+                fprintf(out, "%s send fail,errno:%d\n", names[path], errno);
+                ret = -2;
+                break;
+            }
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(BENCHMARK_DRAIN_TIME));
+            SendResult result;
+            result.m_fRate = BENCHMARK_PACKET_NUM / elapsed.count();
+            result.m_fCpuTime = lCpuTime / 1000.0 / BENCHMARK_PACKET_NUM;
+            result.m_fReceived = (double)lReceived / BENCHMARK_PACKET_NUM;
+            total[path].m_fRate += result.m_fRate / BENCHMARK_RUN_NUM;
+            total[path].m_fCpuTime += result.m_fCpuTime / BENCHMARK_RUN_NUM;
+            total[path].m_fReceived += result.m_fReceived / BENCHMARK_RUN_NUM;
+            fprintf(out, "%-10s %4u %10.1f %12.2f %8.1f%%\n", names[path], run + 1, result.m_fRate / 1000,
+                result.m_fCpuTime, result.m_fReceived * 100);
+        }
+    }
+
+    if (ret == 0)
+    {
+        for (uint32_t path = 0; path < 2; path++)
+        {
+            fprintf(out, "%-10s %4s %10.1f %12.2f %8.1f%%\n", names[path], "mean", total[path].m_fRate / 1000,
+                total[path].m_fCpuTime, total[path].m_fReceived * 100);
+        }
+        fprintf(out, "sendmmsg:%.2fx packets per second,%.2fx CPU per packet\n", total[1].m_fRate / total[0].m_fRate,
+            total[1].m_fCpuTime / total[0].m_fCpuTime);
+    }
+
+    bStopSink = true;
+    sink.join();
+    close(nSinkfd);
+    close(nSendfd);
+    return ret;
+}
\ No newline at end of file
@@ -0,0 +1,394 @@
+#include <algorithm>
+#include <string.h>
+#include "LinkSimulator.h"
+#include "RTCP/RTCPPacket.h"
+#include "RTCP/RtpReceiveStats.h"
+#include "CommonTools/TimeCounter.h"
+#include "Log/Log.h"
+
+#define SIM_MEDIA_PT (96)
+#define SIM_REPAIR_PT (109)
+#define SIM_MEDIA_SSRC (0x12345678)
+#define SIM_RTP_HEADER_SIZE (12)
+#define SIM_MAX_PAYLOAD (1200)
+#define SIM_IDR_FRAME_SCALE (3)
+#define SIM_NTP_BASE (1000*1000)            //keeps the compact NTP of the first SR away from 0
+#define SIM_SAMPLE_INTERVAL (1000)
+#define SIM_SETTLE_QUEUE_DELAY (100)
+
+LinkSimulator::LinkSimulator(const Scenario& scenario)
+{
+    m_Scenario = scenario;
+    m_nRandom = scenario.m_nSeed;
+    m_nMediaSeq = 0;
+    m_nRepairSeq = 0;
+    m_nTablePacketNum = 0;
+    m_lSentBytes = 0;
+    m_lQueuedBytes = 0;
+    m_lDrainCredit = 0;
+    m_nQueueHead = 0;
+    m_nInFlightHead = 0;
+}
+
+LinkSimulator::~LinkSimulator()
+{
+}
+
+const LinkSimulator::Step& LinkSimulator::GetStep(uint64_t now)
+{
+    size_t index = 0;
+    for (size_t i = 0; i < m_Scenario.m_Steps.size(); i++)
+    {
+        if (m_Scenario.m_Steps[i].m_lTime <= now)
+        {
+            index = i;
+        }
+    }
+    return m_Scenario.m_Steps[index];
+}
+
+//LCG from Numerical Recipes,the same seed always gives the same run
+uint32_t LinkSimulator::NextRandom()
+{
+    m_nRandom = m_nRandom * 1664525 + 1013904223;
+    return m_nRandom;
+}
+
+static void MakeRtpHeader(uint8_t* header, uint8_t pt, bool marker, uint16_t seq, uint32_t timestamp, uint32_t ssrc)
+{
+    header[0] = 0x80;
+    header[1] = (marker ? 0x80 : 0) | pt;
+    header[2] = seq >> 8;
+    header[3] = seq & 0xff;
+    header[4] = timestamp >> 24;
+    header[5] = (timestamp >> 16) & 0xff;
+    header[6] = (timestamp >> 8) & 0xff;
+    header[7] = timestamp & 0xff;
+    header[8] = ssrc >> 24;
+    header[9] = (ssrc >> 16) & 0xff;
+    header[10] = (ssrc >> 8) & 0xff;
+    header[11] = ssrc & 0xff;
+}
+
+void LinkSimulator::SendPacket(uint64_t now, const SimPacket& packet)
+{
+    m_lSentBytes += packet.m_nSize;
+
+    const Step& step = GetStep(now);
+    if (step.m_nCapacity == 0 || (m_lQueuedBytes + packet.m_nSize) * 8 * 1000 / step.m_nCapacity > m_Scenario.m_nQueueLimit)
+    {
+        return;
+    }
+
+    SimPacket queued = packet;
+    queued.m_lTime = now;
+    m_Queue.push_back(queued);
+    m_lQueuedBytes += packet.m_nSize;
+}
+
+//frame sizes follow the encoder target,IDR frames are larger and the P frames make up for it
+void LinkSimulator::SendFrame(uint64_t now, uint32_t frameIndex, RateController& controller)
+{
+    const RateController::Config& config = m_Scenario.m_Config;
+    const RateController::Target& target = controller.GetTarget();
+    uint32_t fps = std::max(config.m_nFPS, 1U);
+    uint32_t gop = fps * 2;
+    uint64_t average = (uint64_t)target.m_nEncoderBitRate / 8 / fps;
+    uint64_t frameBytes = frameIndex % gop == 0 ? average * SIM_IDR_FRAME_SCALE : average * (gop - SIM_IDR_FRAME_SCALE) / (gop - 1);
+    uint32_t timestamp = (uint32_t)(now * MEDIA_CLOCK_RATE / 1000);
+    uint32_t repairNum = config.m_nFECRow * config.m_nFECColumn;
+
+    while (frameBytes > 0)
+    {
+        uint32_t payload = (uint32_t)std::min(frameBytes, (uint64_t)SIM_MAX_PAYLOAD);
+        frameBytes -= payload;
+
+        SimPacket packet;
+        packet.m_nSize = payload + SIM_RTP_HEADER_SIZE;
+        packet.m_bIsMedia = true;
+        MakeRtpHeader(packet.m_Header, SIM_MEDIA_PT, frameBytes == 0, m_nMediaSeq++, timestamp, SIM_MEDIA_SSRC);
+        SendPacket(now, packet);
+
+        if (target.m_eRepairMode == RFC8627FECEncoder::REPAIR_MODE_NONE || repairNum == 0)
+        {
+            m_nTablePacketNum = 0;
+            continue;
+        }
+
+        //repair packets are as large as the largest protected packet plus the FEC header
+        SimPacket repair;
+        repair.m_nSize = SIM_MAX_PAYLOAD + SIM_RTP_HEADER_SIZE * 2;
+        m_nTablePacketNum++;
+        if (target.m_eRepairMode == RFC8627FECEncoder::REPAIR_MODE_ROW_AND_COLUMN && m_nTablePacketNum % config.m_nFECColumn == 0)
+        {
+            MakeRtpHeader(repair.m_Header, SIM_REPAIR_PT, false, m_nRepairSeq++, timestamp, 0x23456789);
+            SendPacket(now, repair);
+        }
+        if (m_nTablePacketNum == repairNum)
+        {
+            for (uint32_t i = 0; i < config.m_nFECColumn; i++)
+            {
+                MakeRtpHeader(repair.m_Header, SIM_REPAIR_PT, false, m_nRepairSeq++, timestamp, 0x23456789);
+                SendPacket(now, repair);
+            }
+            m_nTablePacketNum = 0;
+        }
+    }
+}
+
+int32_t LinkSimulator::Run(std::vector<Sample>& samples)
+{
+    if (m_Scenario.m_Steps.empty())
+    {
+        Error("[%p][LinkSimulator::Run] scenario:%s has no step", this, m_Scenario.m_strName.c_str());
+        return -1;
+    }
+
+    RateController controller(m_Scenario.m_Config);
+    RtpReceiveStats receiver;
+    receiver.SetIgnorePayloadType(SIM_REPAIR_PT);
+
+    std::vector<std::pair<uint64_t, std::shared_ptr<Packet>>> reports;     //receiver reports on the uncongested way back
+    size_t reportHead = 0;
+    uint32_t fps = std::max(m_Scenario.m_Config.m_nFPS, 1U);
+    uint32_t frameIndex = 0;
+    uint64_t nextFrameTime = 0;
+    uint64_t lastFeedbackTime = 0;
+    uint64_t lastFeedbackBytes = 0;
+    uint64_t deliveredBits = 0;
+    RTCPPacket::ReportBlock lastBlock;
+    int32_t lastRtt = -1;
+
+    for (uint64_t now = 0; now < m_Scenario.m_lDuration; now++)
+    {
+        //sender
+        while (nextFrameTime <= now)
+        {
+            SendFrame(now, frameIndex++, controller);
+            nextFrameTime = (uint64_t)frameIndex * 1000 / fps;
+        }
+        if (m_Scenario.m_nSenderReportInterval > 0 && now % m_Scenario.m_nSenderReportInterval == 0)
+        {
+            RTCPPacket::SenderInfo info;
+            info.m_nSSRC = SIM_MEDIA_SSRC;
+            info.m_lNTPTime = RTCPPacket::MillisecondsToNTP(now + SIM_NTP_BASE);
+            info.m_nRtpTime = (uint32_t)(now * MEDIA_CLOCK_RATE / 1000);
+            std::shared_ptr<Packet> sr = RTCPPacket::MakeSenderReport(info);
+
+            SimPacket packet;
+            packet.m_nSize = sr->m_nLength;
+            packet.m_bIsSenderReport = true;
+            memcpy(packet.m_Header, sr->m_pData, std::min((uint32_t)sizeof(packet.m_Header), sr->m_nLength));
+            SendPacket(now, packet);
+        }
+
+        //bottleneck
+        const Step& step = GetStep(now);
+        m_lDrainCredit += step.m_nCapacity;
+        while (m_nQueueHead < m_Queue.size() && m_lDrainCredit >= (uint64_t)m_Queue[m_nQueueHead].m_nSize * 8 * 1000)
+        {
+            SimPacket& packet = m_Queue[m_nQueueHead++];
+            m_lDrainCredit -= (uint64_t)packet.m_nSize * 8 * 1000;
+            m_lQueuedBytes -= packet.m_nSize;
+            if (step.m_fLossRate > 0 && NextRandom() < (uint32_t)(step.m_fLossRate * UINT32_MAX))
+            {
+                continue;
+            }
+            packet.m_lTime = now + m_Scenario.m_nOneWayDelay;
+            m_InFlight.push_back(packet);
+        }
+        if (m_nQueueHead == m_Queue.size())
+        {
+            m_Queue.clear();
+            m_nQueueHead = 0;
+            m_lDrainCredit = 0;     //an idle link does not bank capacity
+        }
+
+        //receiver
+        while (m_nInFlightHead < m_InFlight.size() && m_InFlight[m_nInFlightHead].m_lTime <= now)
+        {
+            SimPacket& packet = m_InFlight[m_nInFlightHead++];
+            uint64_t arrival = now * MEDIA_CLOCK_RATE / 1000;
+            if (packet.m_bIsSenderReport)
+            {
+                RTCPPacket::SenderInfo info;
+                if (RTCPPacket::ParseSenderReport(packet.m_Header, packet.m_nSize, info) == 0)
+                {
+                    receiver.RecvSenderReport(info, arrival);
+                }
+                continue;
+            }
+
+            receiver.RecvRtpPacket(packet.m_Header, packet.m_nSize, arrival);
+            if (packet.m_bIsMedia)
+            {
+                deliveredBits += (uint64_t)(packet.m_nSize - SIM_RTP_HEADER_SIZE) * 8;
+            }
+        }
+        if (m_nInFlightHead == m_InFlight.size())
+        {
+            m_InFlight.clear();
+            m_nInFlightHead = 0;
+        }
+        if (now > 0 && now % m_Scenario.m_nReportInterval == 0)
+        {
+            RTCPPacket::ReportBlock block;
+            if (receiver.MakeReportBlock(block, now * MEDIA_CLOCK_RATE / 1000))
+            {
+                reports.push_back({ now + m_Scenario.m_nOneWayDelay, RTCPPacket::MakeReceiverReport(block) });
+            }
+        }
+
+        //sender feedback
+        bool bRecvFeedback = false;
+        while (reportHead < reports.size() && reports[reportHead].first <= now)
+        {
+            std::shared_ptr<Packet> rr = reports[reportHead++].second;
+            RTCPPacket::ReportBlock block;
+            if (rr == nullptr || RTCPPacket::ParseReceiverReport(rr->m_pData, rr->m_nLength, block) != 0)
+            {
+                continue;
+            }
+
+            RateController::Feedback feedback;
+            feedback.m_lTime = now;
+            feedback.m_fLossRate = block.m_nFractionLost / 256.0f;
+            feedback.m_nRtt = RTCPPacket::GetRoundTripTime(block, RTCPPacket::GetCompactNTP(RTCPPacket::MillisecondsToNTP(now + SIM_NTP_BASE)));
+            feedback.m_nJitter = block.m_nJitter * 1000 / MEDIA_CLOCK_RATE;
+            feedback.m_nSendBitRate = now > lastFeedbackTime ? (uint32_t)((m_lSentBytes - lastFeedbackBytes) * 8 * 1000 / (now - lastFeedbackTime)) : 0;
+            lastFeedbackTime = now;
+            lastFeedbackBytes = m_lSentBytes;
+            lastBlock = block;
+            lastRtt = feedback.m_nRtt;
+            controller.OnFeedback(feedback);
+            bRecvFeedback = true;
+        }
+        if (!bRecvFeedback)
+        {
+            controller.CheckTimeout(now);
+        }
+
+        if ((now + 1) % SIM_SAMPLE_INTERVAL == 0)
+        {
+            const RateController::Target& target = controller.GetTarget();
+            Sample sample;
+            sample.m_lTime = now + 1;
+            sample.m_nCapacity = step.m_nCapacity;
+            sample.m_fLinkLossRate = step.m_fLossRate;
+            sample.m_nTargetBitRate = target.m_nBitRate;
+            sample.m_nEncoderBitRate = target.m_nEncoderBitRate;
+            sample.m_eRepairMode = target.m_eRepairMode;
+            sample.m_nResolutionLevel = target.m_nResolutionLevel;
+            sample.m_fReportedLossRate = lastBlock.m_nFractionLost / 256.0f;
+            sample.m_nRtt = lastRtt;
+            sample.m_nQueueDelay = step.m_nCapacity == 0 ? 0 : (uint32_t)(m_lQueuedBytes * 8 * 1000 / step.m_nCapacity);
+            sample.m_nGoodput = (uint32_t)(deliveredBits * 1000 / SIM_SAMPLE_INTERVAL);
+            samples.push_back(sample);
+            deliveredBits = 0;
+        }
+    }
+
+    return 0;
+}
+
+//first second after the step where the target sits between half the usable capacity and the capacity with a short queue
+uint64_t LinkSimulator::GetSettleTime(const Scenario& scenario, const std::vector<Sample>& samples, size_t step)
+{
+    if (step >= scenario.m_Steps.size())
+    {
+        return UINT64_MAX;
+    }
+
+    uint64_t start = scenario.m_Steps[step].m_lTime;
+    uint64_t end = step + 1 < scenario.m_Steps.size() ? scenario.m_Steps[step + 1].m_lTime : scenario.m_lDuration;
+    uint32_t usable = std::min(scenario.m_Steps[step].m_nCapacity, scenario.m_Config.m_nMaxBitRate);
+    for (auto& sample : samples)
+    {
+        if (sample.m_lTime <= start || sample.m_lTime > end)
+        {
+            continue;
+        }
+        if (sample.m_nTargetBitRate >= usable / 2 && sample.m_nTargetBitRate <= scenario.m_Steps[step].m_nCapacity &&
+            sample.m_nQueueDelay < SIM_SETTLE_QUEUE_DELAY)
+        {
+            return sample.m_lTime - start;
+        }
+    }
+
+    return UINT64_MAX;
+}
+
+std::vector<LinkSimulator::Scenario> LinkSimulator::GetBuiltinScenarios()
+{
+    std::vector<Scenario> scenarios;
+
+    Scenario bandwidth;
+    bandwidth.m_strName = "bandwidth steps";
+    bandwidth.m_lDuration = 90 * 1000;
+    bandwidth.m_Steps = { {0,8000000,0.002f},{20000,3000000,0.002f},{40000,1000000,0.002f},{60000,5000000,0.002f} };
+    scenarios.push_back(bandwidth);
+
+    Scenario loss;
+    loss.m_strName = "loss steps";
+    loss.m_lDuration = 75 * 1000;
+    loss.m_nSeed = 7;
+    loss.m_Steps = { {0,8000000,0},{15000,8000000,0.03f},{30000,8000000,0.12f},{45000,8000000,0.01f},{60000,8000000,0} };
+    scenarios.push_back(loss);
+
+    Scenario outage;
+    outage.m_strName = "outage";
+    outage.m_lDuration = 45 * 1000;
+    outage.m_nSeed = 3;
+    outage.m_Steps = { {0,4000000,0.005f},{20000,0,0},{23000,4000000,0.005f} };
+    scenarios.push_back(outage);
+
+    return scenarios;
+}
+
+static const char* GetRepairModeName(RFC8627FECEncoder::RepairMode mode)
+{
+    return mode == RFC8627FECEncoder::REPAIR_MODE_ROW_AND_COLUMN ? "row+col" :
+        mode == RFC8627FECEncoder::REPAIR_MODE_COLUMN ? "col" : "none";
+}
+
+int32_t LinkSimulator::RunBuiltinScenarios(FILE* out)
+{
+    for (auto& scenario : GetBuiltinScenarios())
+    {
+        LinkSimulator simulator(scenario);
+        std::vector<Sample> samples;
+        if (simulator.Run(samples) != 0)
+        {
+            return -1;
+        }
+
+        fprintf(out, "== %s ==\n", scenario.m_strName.c_str());
+        fprintf(out, "%5s %8s %6s %8s %8s %7s %4s %7s %6s %6s %8s\n", "t(s)", "cap", "loss%", "target", "encoder", "fec", "res",
+            "rxloss%", "rtt", "queue", "goodput");
+        for (auto& sample : samples)
+        {
+            fprintf(out, "%5llu %8u %6.1f %8u %8u %7s %4u %7.1f %6d %6u %8u\n", (unsigned long long)(sample.m_lTime / 1000),
+                sample.m_nCapacity / 1000, sample.m_fLinkLossRate * 100, sample.m_nTargetBitRate / 1000, sample.m_nEncoderBitRate / 1000,
+                GetRepairModeName(sample.m_eRepairMode), sample.m_nResolutionLevel, sample.m_fReportedLossRate * 100, sample.m_nRtt,
+                sample.m_nQueueDelay, sample.m_nGoodput / 1000);
+        }
+        for (size_t i = 0; i < scenario.m_Steps.size(); i++)
+        {
+            uint64_t settle = GetSettleTime(scenario, samples, i);
+            if (settle == UINT64_MAX)
+            {
+                fprintf(out, "step %u at %llus,capacity %u kbps loss %.1f%%:not settled\n", (uint32_t)i,
+                    (unsigned long long)(scenario.m_Steps[i].m_lTime / 1000), scenario.m_Steps[i].m_nCapacity / 1000, scenario.m_Steps[i].m_fLossRate * 100);
+            }
+            else
+            {
+                fprintf(out, "step %u at %llus,capacity %u kbps loss %.1f%%:settled after %llus\n", (uint32_t)i,
+                    (unsigned long long)(scenario.m_Steps[i].m_lTime / 1000), scenario.m_Steps[i].m_nCapacity / 1000, scenario.m_Steps[i].m_fLossRate * 100,
+                    (unsigned long long)(settle / 1000));
+            }
+        }
+        fprintf(out, "\n");
+    }
+
+    return 0;
+}
\ No newline at end of file
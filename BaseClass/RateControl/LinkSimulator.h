@@ -0,0 +1,86 @@
+#pragma once
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "RateController.h"
+
+//Deterministic bottleneck link for exercising RateController offline:tail drop queue,fixed propagation delay,
+//seeded random loss,and the real RTCP SR/RR path on both ends.No sockets or threads,time advances in 1 ms ticks.
+class LinkSimulator
+{
+public:
+    typedef struct Step
+    {
+        uint64_t m_lTime = 0;           //milliseconds from the start
+        uint32_t m_nCapacity = 0;       //bits per second
+        float m_fLossRate = 0;          //random loss on top of queue drops
+    }Step;
+
+    typedef struct Scenario
+    {
+        std::string m_strName;
+        std::vector<Step> m_Steps;
+        uint64_t m_lDuration = 60 * 1000;
+        uint32_t m_nOneWayDelay = 20;           //milliseconds
+        uint32_t m_nQueueLimit = 300;           //milliseconds of capacity before tail drop
+        uint32_t m_nReportInterval = 500;
+        uint32_t m_nSenderReportInterval = 1000;
+        uint32_t m_nSeed = 1;
+        RateController::Config m_Config;
+    }Scenario;
+
+    typedef struct Sample
+    {
+        uint64_t m_lTime = 0;
+        uint32_t m_nCapacity = 0;
+        float m_fLinkLossRate = 0;
+        uint32_t m_nTargetBitRate = 0;
+        uint32_t m_nEncoderBitRate = 0;
+        RFC8627FECEncoder::RepairMode m_eRepairMode = RFC8627FECEncoder::REPAIR_MODE_NONE;
+        uint32_t m_nResolutionLevel = 0;
+        float m_fReportedLossRate = 0;
+        int32_t m_nRtt = -1;
+        uint32_t m_nQueueDelay = 0;
+        uint32_t m_nGoodput = 0;                //media bits per second delivered
+    }Sample;
+
+public:
+    LinkSimulator(const Scenario& scenario);
+    ~LinkSimulator();
+
+    int32_t Run(std::vector<Sample>& samples);      //one sample per second
+
+    static std::vector<Scenario> GetBuiltinScenarios();
+    static int32_t RunBuiltinScenarios(FILE* out);
+    static uint64_t GetSettleTime(const Scenario& scenario, const std::vector<Sample>& samples, size_t step);
+
+private:
+    typedef struct SimPacket
+    {
+        uint64_t m_lTime = 0;           //enqueue time,then arrival time once it left the queue
+        uint32_t m_nSize = 0;
+        bool m_bIsMedia = false;
+        bool m_bIsSenderReport = false;
+        uint8_t m_Header[28] = { 0 };
+    }SimPacket;
+
+    const Step& GetStep(uint64_t now);
+    uint32_t NextRandom();
+    void SendFrame(uint64_t now, uint32_t frameIndex, RateController& controller);
+    void SendPacket(uint64_t now, const SimPacket& packet);
+
+private:
+    Scenario m_Scenario;
+    uint32_t m_nRandom;
+    uint16_t m_nMediaSeq;
+    uint16_t m_nRepairSeq;
+    uint32_t m_nTablePacketNum;
+    uint64_t m_lSentBytes;
+    uint64_t m_lQueuedBytes;
+    uint64_t m_lDrainCredit;            //bit credit of the link,in bits*1000
+    std::vector<SimPacket> m_Queue;
+    size_t m_nQueueHead;
+    std::vector<SimPacket> m_InFlight;
+    size_t m_nInFlightHead;
+};
\ No newline at end of file
@@ -0,0 +1,281 @@
+#include <chrono>
+#include "Pacer.h"
+#include "Log/Log.h"
+#include "CommonTools/TimeCounter.h"
+
+#define MIN_BURST_BYTES (1500)          //the bucket always holds at least one full packet
+#define MIN_DRAIN_TIME (1.0)            //ms,a frame past its budget goes out as fast as the socket takes it
+#define MIN_TOKEN_WAIT (200)            //us,no point sleeping for less
+#define DELAY_SMOOTH_FACTOR (16)
+
+Pacer::Pacer(const Config& config)
+{
+    m_Config = config;
+    m_Config.m_nCapacity = m_Config.m_nCapacity > 0 ? m_Config.m_nCapacity : 1;
+    m_nQueueNum = 0;
+    m_lQueueBytes = 0;
+    m_bClosed = false;
+    m_nBitRate = 0;
+    m_fToken = 0;
+    m_lLastTokenTime = 0;
+}
+
+Pacer::~Pacer()
+{
+    Close();
+    Clear();
+}
+
+bool Pacer::Push(const std::shared_ptr<Packet>& packet, PacketClass packetClass)
+{
+    std::shared_ptr<Packet> dropped = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(m_PacerLock);
+        if (m_bClosed || packetClass >= PACKET_CLASS_NUM)
+        {
+            m_Stats.m_nDroppedNum++;
+            return false;
+        }
+
+        if (m_nQueueNum >= m_Config.m_nCapacity && !m_Config.m_bDropMedia)
+        {
+            //one packet of a frame is as bad as the whole frame,only repair or a retransmission is refused
+            if (packetClass != PACKET_CLASS_MEDIA)
+            {
+                m_Stats.m_nDroppedNum++;
+                return false;
+            }
+        }
+        else if (m_nQueueNum >= m_Config.m_nCapacity)
+        {
+            //old media is worth less than anything newer,and repair or a retransmission is not worth a media packet
+            std::deque<QueueItem>& media = m_Queues[PACKET_CLASS_MEDIA];
+            m_Stats.m_nDroppedNum++;
+            if (media.empty())
+            {
+                return false;
+            }
+            dropped = media.front().m_pPacket;
+            media.pop_front();
+            m_nQueueNum--;
+            m_lQueueBytes -= dropped->m_nLength;
+        }
+
+        QueueItem item;
+        item.m_pPacket = packet;
+        item.m_lPushTime = TimeCounter::GetMediaTime();
+        m_Queues[packetClass].push_back(item);
+        m_nQueueNum++;
+        m_lQueueBytes += packet->m_nLength;
+    }
+    m_PacerCondition.notify_one();
+
+    //dropped is released here,outside the lock
+    return dropped == nullptr;
+}
+
+//bytes per second,0 unpaced
+double Pacer::GetPacingRate(uint64_t now, bool& boosted)
+{
+    boosted = false;
+    if (m_nBitRate == 0)
+    {
+        return 0;
+    }
+
+    double rate = m_nBitRate * (double)m_Config.m_fPacingFactor / 8;
+    const std::deque<QueueItem>& media = m_Queues[PACKET_CLASS_MEDIA];
+    if (media.empty() || m_Config.m_nFrameBudget == 0)
+    {
+        return rate;
+    }
+
+    //the queue has to be empty by the time the oldest frame runs out of budget,a longer queue
+    //means the pacer is a frame behind already
+    uint64_t deadline = media.front().m_lPushTime + (uint64_t)m_Config.m_nFrameBudget * MEDIA_CLOCK_RATE / 1000;
+    double left = deadline > now ? (double)(deadline - now) * 1000 / MEDIA_CLOCK_RATE : 0;
+    left = left < MIN_DRAIN_TIME ? MIN_DRAIN_TIME : left;
+    double needed = (double)m_lQueueBytes * 1000 / left;
+    if (needed > rate)
+    {
+        boosted = true;
+        return needed;
+    }
+
+    return rate;
+}
+
+void Pacer::RefillToken(uint64_t now, double rate)
+{
+    double burst = rate * m_Config.m_nMaxBurst / 1000;
+    burst = burst < MIN_BURST_BYTES ? MIN_BURST_BYTES : burst;
+    m_fToken = m_lLastTokenTime == 0 ? burst : m_fToken + rate * (now - m_lLastTokenTime) / MEDIA_CLOCK_RATE;
+    m_fToken = m_fToken > burst ? burst : m_fToken;
+    m_lLastTokenTime = now;
+}
+
+//waits for the first packet and for its tokens,then takes what the bucket allows
+uint32_t Pacer::PopBatch(std::vector<std::shared_ptr<Packet>>& packets, uint32_t maxNum, int64_t milliseconds)
+{
+    std::chrono::steady_clock::time_point timeout = std::chrono::steady_clock::now() + std::chrono::milliseconds(milliseconds);
+    std::unique_lock<std::mutex> lock(m_PacerLock);
+    while (!m_bClosed)
+    {
+        if (m_nQueueNum == 0)
+        {
+            if (m_PacerCondition.wait_until(lock, timeout) == std::cv_status::timeout && m_nQueueNum == 0)
+            {
+                return 0;
+            }
+            continue;
+        }
+
+        uint64_t now = TimeCounter::GetMediaTime();
+        bool boosted = false;
+        double rate = GetPacingRate(now, boosted);
+        RefillToken(now, rate);
+        if (rate > 0 && m_fToken <= 0)
+        {
+            std::chrono::steady_clock::time_point ready = std::chrono::steady_clock::now() +
+                std::chrono::microseconds((int64_t)(-m_fToken * 1000000 / rate) + MIN_TOKEN_WAIT);
+            if (ready > timeout)
+            {
+                m_PacerCondition.wait_until(lock, timeout);
+                return 0;
+            }
+            m_PacerCondition.wait_until(lock, ready);
+            continue;
+        }
+
+        uint32_t num = 0;
+        while (num < maxNum && m_nQueueNum > 0 && (rate == 0 || m_fToken > 0))
+        {
+            int32_t index = 0;
+            while (m_Queues[index].empty())
+            {
+                index++;
+            }
+            QueueItem& item = m_Queues[index].front();
+            uint32_t length = item.m_pPacket->m_nLength;
+            double delay = (double)(now - item.m_lPushTime) * 1000 / MEDIA_CLOCK_RATE;
+            packets.push_back(item.m_pPacket);
+            m_Queues[index].pop_front();
+
+            m_nQueueNum--;
+            m_lQueueBytes -= length;
+            if (rate > 0)
+            {
+                m_fToken -= length;
+            }
+            m_Stats.m_nSentNum++;
+            m_Stats.m_fAvgDelay += (delay - m_Stats.m_fAvgDelay) / DELAY_SMOOTH_FACTOR;
+            m_Stats.m_fMaxDelay = delay > m_Stats.m_fMaxDelay ? delay : m_Stats.m_fMaxDelay;
+            num++;
+        }
+
+        if (boosted)
+        {
+            m_Stats.m_nBudgetNum++;
+        }
+        return num;
+    }
+
+    return 0;
+}
+
+int64_t Pacer::GetWaitTime()
+{
+    std::lock_guard<std::mutex> lock(m_PacerLock);
+    if (m_nQueueNum == 0)
+    {
+        return -1;
+    }
+
+    uint64_t now = TimeCounter::GetMediaTime();
+    bool boosted = false;
+    double rate = GetPacingRate(now, boosted);
+    RefillToken(now, rate);
+    if (rate == 0 || m_fToken > 0)
+    {
+        return 0;
+    }
+
+    return (int64_t)(-m_fToken * 1000000 / rate) + MIN_TOKEN_WAIT;
+}
+
+void Pacer::SetBitRate(uint32_t bitRate)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_PacerLock);
+        if (bitRate == m_nBitRate)
+        {
+            return;
+        }
+        Debug("[%p][Pacer::SetBitRate] bitrate:%u->%u pacing:%.0f", this, m_nBitRate, bitRate, bitRate * (double)m_Config.m_fPacingFactor);
+        m_nBitRate = bitRate;
+    }
+    m_PacerCondition.notify_all();
+}
+
+void Pacer::SetFrameBudget(uint32_t milliseconds)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_PacerLock);
+        m_Config.m_nFrameBudget = milliseconds;
+    }
+    m_PacerCondition.notify_all();
+}
+
+void Pacer::SetDropMedia(bool dropMedia)
+{
+    std::lock_guard<std::mutex> lock(m_PacerLock);
+    m_Config.m_bDropMedia = dropMedia;
+}
+
+void Pacer::Close()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_PacerLock);
+        m_bClosed = true;
+    }
+    m_PacerCondition.notify_all();
+}
+
+void Pacer::Open()
+{
+    std::lock_guard<std::mutex> lock(m_PacerLock);
+    m_bClosed = false;
+}
+
+void Pacer::Clear()
+{
+    std::deque<QueueItem> queues[PACKET_CLASS_NUM];
+    {
+        std::lock_guard<std::mutex> lock(m_PacerLock);
+        for (int32_t i = 0; i < PACKET_CLASS_NUM; i++)
+        {
+            queues[i].swap(m_Queues[i]);
+        }
+        m_nQueueNum = 0;
+        m_lQueueBytes = 0;
+        m_fToken = 0;
+        m_lLastTokenTime = 0;
+    }
+}
+
+uint32_t Pacer::Size()
+{
+    std::lock_guard<std::mutex> lock(m_PacerLock);
+    return m_nQueueNum;
+}
+
+Pacer::PacerStats Pacer::GetStats()
+{
+    std::lock_guard<std::mutex> lock(m_PacerLock);
+    PacerStats stats = m_Stats;
+    stats.m_nQueueNum = m_nQueueNum;
+    stats.m_lQueueBytes = m_lQueueBytes;
+    m_Stats.m_fMaxDelay = 0;
+    m_Stats.m_nBudgetNum = 0;
+    return stats;
+}
\ No newline at end of file
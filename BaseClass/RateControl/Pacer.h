@@ -0,0 +1,85 @@
+#pragma once
+#include <deque>
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <condition_variable>
+#include "Common.h"
+
+//Token bucket between the packetizer and the socket,so an IDR frame goes onto the radio link as a
+//stream at a multiple of the target bitrate instead of one burst that overflows its queue.Packets
+//leave by class,retransmissions first and FEC repair before media,and in order within a class.
+//A frame never waits longer than the frame budget:when the media at the head would,the rate is
+//raised to drain the queue by then.One thread pops,any thread pushes.
+class Pacer
+{
+public:
+    typedef enum PacketClass
+    {
+        PACKET_CLASS_RETRANSMIT = 0,
+        PACKET_CLASS_REPAIR,
+        PACKET_CLASS_MEDIA,
+        PACKET_CLASS_NUM
+    }PacketClass;
+
+    typedef struct Config
+    {
+        float m_fPacingFactor = 2.5f;       //pacing rate as a multiple of the target bitrate
+        uint32_t m_nFrameBudget = 40;       //ms the oldest media packet may wait
+        uint32_t m_nMaxBurst = 5;           //ms of the pacing rate that may go out back to back
+        uint32_t m_nCapacity = 200;         //packets,media is dropped oldest first beyond it
+        bool m_bDropMedia = true;           //false:media is queued past the capacity,the consumer drops whole frames
+    }Config;
+
+    typedef struct PacerStats
+    {
+        uint64_t m_nSentNum = 0;
+        uint64_t m_nDroppedNum = 0;
+        uint32_t m_nQueueNum = 0;
+        uint64_t m_lQueueBytes = 0;
+        double m_fAvgDelay = 0;             //ms from push to pop,smoothed
+        double m_fMaxDelay = 0;             //ms,since the last GetStats
+        uint32_t m_nBudgetNum = 0;          //pops sped up by the frame budget,since the last GetStats
+    }PacerStats;
+
+public:
+    Pacer(const Config& config);
+    ~Pacer();
+
+    bool Push(const std::shared_ptr<Packet>& packet, PacketClass packetClass);     //return false if a packet was dropped
+    uint32_t PopBatch(std::vector<std::shared_ptr<Packet>>& packets, uint32_t maxNum, int64_t milliseconds);
+    int64_t GetWaitTime();                  //us until PopBatch has something to take,-1 when empty
+    void SetBitRate(uint32_t bitRate);      //target,FEC included;0 sends unpaced
+    void SetFrameBudget(uint32_t milliseconds);
+    void SetDropMedia(bool dropMedia);
+    void Close();
+    void Open();
+    void Clear();
+    uint32_t Size();
+    PacerStats GetStats();
+
+private:
+    typedef struct QueueItem
+    {
+        std::shared_ptr<Packet> m_pPacket;
+        uint64_t m_lPushTime = 0;           //media time
+    }QueueItem;
+
+    double GetPacingRate(uint64_t now, bool& boosted);     //boosted when the frame budget raised it
+    void RefillToken(uint64_t now, double rate);
+
+private:
+    Config m_Config;
+    std::mutex m_PacerLock;
+    std::condition_variable m_PacerCondition;
+    std::deque<QueueItem> m_Queues[PACKET_CLASS_NUM];
+    uint32_t m_nQueueNum;
+    uint64_t m_lQueueBytes;
+    bool m_bClosed;
+
+    uint32_t m_nBitRate;
+    double m_fToken;                        //bytes that may go out now,negative after a packet larger than the rest
+    uint64_t m_lLastTokenTime;              //media time,0 before the first pop
+    PacerStats m_Stats;
+};
\ No newline at end of file
@@ -0,0 +1,289 @@
+#include <algorithm>
+#include "RateController.h"
+#include "Log/Log.h"
+
+#define LOSS_INCREASE_THRESHOLD (0.02f)
+#define LOSS_CONGESTION_THRESHOLD (0.25f)
+#define LOSS_SMOOTH_FACTOR (0.3f)
+#define INCREASE_FACTOR (1.08f)
+#define NEAR_CONVERGENCE_INCREASE_FACTOR (1.02f)
+#define DECREASE_FACTOR (0.85f)
+#define MAX_SEND_BITRATE_FACTOR (1.5f)
+#define OVERUSE_QUEUE_DELAY (60)            //ms above the base rtt,on two reports in a row
+#define STRONG_OVERUSE_QUEUE_DELAY (120)    //ms above the base rtt,on a single report
+#define OVERUSE_JITTER (50)                 //ms above the base jitter
+#define MIN_HOLD_TIME (1000)
+#define MIN_WINDOW_TIME (10*1000)
+#define FEEDBACK_TIMEOUT (2000)
+#define FEC_COLUMN_LOSS (0.005f)
+#define FEC_ROW_AND_COLUMN_LOSS (0.04f)
+#define FEC_HOLD_TIME (5*1000)
+#define RESOLUTION_DOWN_BPP (0.03f)
+#define RESOLUTION_UP_BPP (0.06f)
+#define RESOLUTION_DOWN_HOLD_TIME (5*1000)
+#define RESOLUTION_UP_HOLD_TIME (10*1000)
+
+RateController::RateController(const Config& config)
+{
+    m_Config = config;
+    m_Config.m_nMaxBitRate = std::max(m_Config.m_nMaxBitRate, m_Config.m_nMinBitRate);
+    m_nBitRate = m_Config.m_nStartBitRate > 0 ? m_Config.m_nStartBitRate : m_Config.m_nMaxBitRate;
+    m_nBitRate = std::min(std::max(m_nBitRate, m_Config.m_nMinBitRate), m_Config.m_nMaxBitRate);
+    m_eState = STATE_HOLD;
+    m_nLastDecreaseBitRate = 0;
+    m_lLastDecreaseTime = 0;
+    m_lLastFeedbackTime = 0;
+    m_bRecvFeedback = false;
+
+    m_fSmoothedLoss = 0;
+    m_nSmoothedRtt = -1;
+    m_nQueueDelay = 0;
+    m_nOveruseCount = 0;
+    m_nMinRtt[0] = m_nMinRtt[1] = INT32_MAX;
+    m_nMinJitter[0] = m_nMinJitter[1] = UINT32_MAX;
+    m_lMinWindowStart = 0;
+
+    m_lRepairModeTime = 0;
+    m_lResolutionTime = 0;
+    m_Target.m_eRepairMode = m_Config.m_bEnableFec ? RFC8627FECEncoder::REPAIR_MODE_ROW_AND_COLUMN : RFC8627FECEncoder::REPAIR_MODE_NONE;
+    m_Target.m_nResolutionLevel = 0;
+    for (int i = RFC8627FECEncoder::REPAIR_MODE_NONE; i <= RFC8627FECEncoder::REPAIR_MODE_ROW_AND_COLUMN; i++)
+    {
+        m_fRepairOverhead[i] = GetRepairOverhead((RFC8627FECEncoder::RepairMode)i, m_Config.m_nFECRow, m_Config.m_nFECColumn);
+    }
+    UpdateTarget();
+}
+
+RateController::~RateController()
+{
+}
+
+const char* RateController::GetStateName(State state)
+{
+    switch (state)
+    {
+    case STATE_INCREASE:
+        return "increase";
+    case STATE_DECREASE:
+        return "decrease";
+    default:
+        return "hold";
+    }
+}
+
+//repair packets per media packet:one per row and/or one per column of the row x col table
+float RateController::GetRepairOverhead(RFC8627FECEncoder::RepairMode mode, uint8_t row, uint8_t col)
+{
+    if (row == 0 || col == 0)
+    {
+        return 0;
+    }
+
+    switch (mode)
+    {
+    case RFC8627FECEncoder::REPAIR_MODE_COLUMN:
+        return (float)col / (row * col);
+    case RFC8627FECEncoder::REPAIR_MODE_ROW_AND_COLUMN:
+        return (float)(row + col) / (row * col);
+    default:
+        return 0;
+    }
+}
+
+void RateController::GetScaledResolution(uint32_t level, uint32_t width, uint32_t height, uint32_t& scaledWidth, uint32_t& scaledHeight)
+{
+    static const uint32_t scales[RESOLUTION_LEVEL_NUM] = { 4,3,2 };     //quarters
+    uint32_t scale = scales[std::min(level, (uint32_t)RESOLUTION_LEVEL_NUM - 1)];
+    scaledWidth = (width * scale / 4) & ~1U;
+    scaledHeight = (height * scale / 4) & ~1U;
+}
+
+void RateController::SetMaxBitRate(uint32_t bitRate)
+{
+    m_Config.m_nMaxBitRate = std::max(bitRate, m_Config.m_nMinBitRate);
+    m_nBitRate = std::min(m_nBitRate, m_Config.m_nMaxBitRate);
+    UpdateTarget();
+}
+
+//a geometry other than the config's row x col,or a switch to another one mid-stream
+void RateController::SetRepairOverhead(float column, float rowAndColumn)
+{
+    m_fRepairOverhead[RFC8627FECEncoder::REPAIR_MODE_NONE] = 0;
+    m_fRepairOverhead[RFC8627FECEncoder::REPAIR_MODE_COLUMN] = column;
+    m_fRepairOverhead[RFC8627FECEncoder::REPAIR_MODE_ROW_AND_COLUMN] = rowAndColumn;
+    UpdateTarget();
+}
+
+const RateController::Target& RateController::OnFeedback(const Feedback& feedback)
+{
+    m_lLastFeedbackTime = feedback.m_lTime;
+    m_bRecvFeedback = true;
+    m_fSmoothedLoss = m_fSmoothedLoss * (1 - LOSS_SMOOTH_FACTOR) + feedback.m_fLossRate * LOSS_SMOOTH_FACTOR;
+
+    bool overuse = IsOveruse(feedback);
+    UpdateBitRate(feedback, overuse);
+    UpdateRepairMode(feedback.m_lTime);
+    UpdateTarget();
+    UpdateResolution(feedback.m_lTime);
+
+    return m_Target;
+}
+
+const RateController::Target& RateController::CheckTimeout(uint64_t now)
+{
+    if (!m_bRecvFeedback || now < m_lLastFeedbackTime + FEEDBACK_TIMEOUT || now < m_lLastDecreaseTime + FEEDBACK_TIMEOUT)
+    {
+        return m_Target;
+    }
+
+    //nothing came back,the link is most likely saturated or gone
+    m_nBitRate = std::max(m_nBitRate / 2, m_Config.m_nMinBitRate);
+    m_nLastDecreaseBitRate = m_nBitRate;
+    m_lLastDecreaseTime = now;
+    m_eState = STATE_DECREASE;
+    UpdateTarget();
+    UpdateResolution(now);
+    Warn("[%p][RateController::CheckTimeout] no feedback for %llu ms,bitrate:%u", this,
+        (unsigned long long)(now - m_lLastFeedbackTime), m_nBitRate);
+
+    return m_Target;
+}
+
+//queueing shows up as rtt and jitter above what the idle link gives.A single IDR burst also delays the SR
+//behind it,so a moderate rise has to last two reports before it counts.
+bool RateController::IsOveruse(const Feedback& feedback)
+{
+    if (feedback.m_lTime >= m_lMinWindowStart + MIN_WINDOW_TIME)
+    {
+        m_lMinWindowStart = feedback.m_lTime;
+        m_nMinRtt[1] = m_nMinRtt[0];
+        m_nMinRtt[0] = INT32_MAX;
+        m_nMinJitter[1] = m_nMinJitter[0];
+        m_nMinJitter[0] = UINT32_MAX;
+    }
+    m_nMinJitter[0] = std::min(m_nMinJitter[0], feedback.m_nJitter);
+    uint32_t baseJitter = std::min(m_nMinJitter[0], m_nMinJitter[1]);
+
+    bool overuse = feedback.m_nJitter > baseJitter + OVERUSE_JITTER;
+    if (feedback.m_nRtt >= 0)
+    {
+        m_nMinRtt[0] = std::min(m_nMinRtt[0], feedback.m_nRtt);
+        int32_t baseRtt = std::min(m_nMinRtt[0], m_nMinRtt[1]);
+        m_nSmoothedRtt = m_nSmoothedRtt < 0 ? feedback.m_nRtt : (m_nSmoothedRtt * 3 + feedback.m_nRtt) / 4;
+        m_nQueueDelay = feedback.m_nRtt - baseRtt;
+        m_nOveruseCount = m_nQueueDelay > OVERUSE_QUEUE_DELAY ? m_nOveruseCount + 1 : 0;
+        overuse = overuse || m_nQueueDelay > STRONG_OVERUSE_QUEUE_DELAY || m_nOveruseCount >= 2;
+    }
+
+    return overuse;
+}
+
+void RateController::UpdateBitRate(const Feedback& feedback, bool overuse)
+{
+    uint64_t now = feedback.m_lTime;
+    uint32_t holdTime = std::max((int32_t)MIN_HOLD_TIME, m_nSmoothedRtt * 2);
+    uint32_t bitRate = m_nBitRate;
+
+    //loss without queueing is taken as the radio rather than congestion and left to FEC,
+    //unless it is so heavy that nothing else explains it
+    if (overuse || feedback.m_fLossRate > LOSS_CONGESTION_THRESHOLD)
+    {
+        if (now >= m_lLastDecreaseTime + holdTime)
+        {
+            //what got through is the best guess of the capacity
+            uint32_t delivered = (uint32_t)(feedback.m_nSendBitRate * (1 - feedback.m_fLossRate));
+            uint32_t base = feedback.m_nSendBitRate > 0 ? std::min(m_nBitRate, delivered) : m_nBitRate;
+            bitRate = (uint32_t)(base * DECREASE_FACTOR);
+            m_eState = STATE_DECREASE;
+        }
+        else
+        {
+            m_eState = STATE_HOLD;
+        }
+    }
+    else if (feedback.m_fLossRate < LOSS_INCREASE_THRESHOLD && now >= m_lLastDecreaseTime + holdTime)
+    {
+        bool nearConvergence = m_nLastDecreaseBitRate > 0 && m_nBitRate > m_nLastDecreaseBitRate * 0.9f && m_nBitRate < m_nLastDecreaseBitRate * 1.3f;
+        bitRate = (uint32_t)(m_nBitRate * (nearConvergence ? NEAR_CONVERGENCE_INCREASE_FACTOR : INCREASE_FACTOR));
+        //do not run away from what the encoder really produces
+        if (feedback.m_nSendBitRate > 0)
+        {
+            bitRate = std::min(bitRate, std::max(m_nBitRate, (uint32_t)(feedback.m_nSendBitRate * MAX_SEND_BITRATE_FACTOR)));
+        }
+        m_eState = STATE_INCREASE;
+    }
+    else
+    {
+        m_eState = STATE_HOLD;
+    }
+
+    if (m_eState == STATE_DECREASE && bitRate < m_nBitRate)
+    {
+        m_nLastDecreaseBitRate = bitRate;
+        m_lLastDecreaseTime = now;
+    }
+    m_nBitRate = std::min(std::max(bitRate, m_Config.m_nMinBitRate), m_Config.m_nMaxBitRate);
+}
+
+//more repair as the loss goes up,drop it again only after the link has been clean for a while
+void RateController::UpdateRepairMode(uint64_t now)
+{
+    if (!m_Config.m_bEnableFec)
+    {
+        m_Target.m_eRepairMode = RFC8627FECEncoder::REPAIR_MODE_NONE;
+        return;
+    }
+
+    RFC8627FECEncoder::RepairMode mode =
+        m_fSmoothedLoss > FEC_ROW_AND_COLUMN_LOSS ? RFC8627FECEncoder::REPAIR_MODE_ROW_AND_COLUMN :
+        m_fSmoothedLoss > FEC_COLUMN_LOSS ? RFC8627FECEncoder::REPAIR_MODE_COLUMN : RFC8627FECEncoder::REPAIR_MODE_NONE;
+
+    if (mode > m_Target.m_eRepairMode)
+    {
+        m_Target.m_eRepairMode = mode;
+        m_lRepairModeTime = now;
+    }
+    else if (mode < m_Target.m_eRepairMode)
+    {
+        float lower = m_Target.m_eRepairMode == RFC8627FECEncoder::REPAIR_MODE_ROW_AND_COLUMN ? FEC_ROW_AND_COLUMN_LOSS : FEC_COLUMN_LOSS;
+        if (m_fSmoothedLoss < lower / 2 && now >= m_lRepairModeTime + FEC_HOLD_TIME)
+        {
+            m_Target.m_eRepairMode = (RFC8627FECEncoder::RepairMode)(m_Target.m_eRepairMode - 1);
+            m_lRepairModeTime = now;
+        }
+    }
+}
+
+float RateController::GetBitsPerPixel(uint32_t bitRate, uint32_t level)
+{
+    uint32_t width = 0;
+    uint32_t height = 0;
+    GetScaledResolution(level, m_Config.m_nWidth, m_Config.m_nHeight, width, height);
+    uint64_t pixels = (uint64_t)width * height * std::max(m_Config.m_nFPS, 1U);
+    return pixels == 0 ? 0 : (float)bitRate / pixels;
+}
+
+//a smaller picture looks better than a starved one,switch with a wide hysteresis since every switch costs an IDR
+void RateController::UpdateResolution(uint64_t now)
+{
+    uint32_t level = m_Target.m_nResolutionLevel;
+    if (level + 1 < RESOLUTION_LEVEL_NUM && GetBitsPerPixel(m_Target.m_nEncoderBitRate, level) < RESOLUTION_DOWN_BPP &&
+        now >= m_lResolutionTime + RESOLUTION_DOWN_HOLD_TIME)
+    {
+        m_Target.m_nResolutionLevel = level + 1;
+        m_lResolutionTime = now;
+    }
+    else if (level > 0 && m_eState != STATE_DECREASE && GetBitsPerPixel(m_Target.m_nEncoderBitRate, level - 1) > RESOLUTION_UP_BPP &&
+        now >= m_lResolutionTime + RESOLUTION_UP_HOLD_TIME && now >= m_lLastDecreaseTime + RESOLUTION_UP_HOLD_TIME)
+    {
+        m_Target.m_nResolutionLevel = level - 1;
+        m_lResolutionTime = now;
+    }
+}
+
+void RateController::UpdateTarget()
+{
+    float overhead = m_fRepairOverhead[m_Target.m_eRepairMode];
+    m_Target.m_nBitRate = m_nBitRate;
+    m_Target.m_nEncoderBitRate = (uint32_t)(m_nBitRate / (1 + overhead));
+}
\ No newline at end of file
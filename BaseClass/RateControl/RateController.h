@@ -0,0 +1,95 @@
+#pragma once
+#include <cstdint>
+#include "FEC/FECEncoder.h"
+
+#define RESOLUTION_LEVEL_NUM (3)        //full,3/4,1/2
+
+//Loss and delay based sender side estimator.Feed it one Feedback per receiver report,it returns the total
+//bitrate the link can take and how to split it between the encoder and FEC repair.
+class RateController
+{
+public:
+    typedef struct Config
+    {
+        uint32_t m_nMinBitRate = 256 * 1024;
+        uint32_t m_nMaxBitRate = 6 * 1024 * 1024;
+        uint32_t m_nStartBitRate = 0;       //0 starts at m_nMaxBitRate
+        uint32_t m_nWidth = 1280;
+        uint32_t m_nHeight = 720;
+        uint32_t m_nFPS = 25;
+        uint8_t m_nFECRow = 7;              //the overhead charged until SetRepairOverhead
+        uint8_t m_nFECColumn = 7;
+        bool m_bEnableFec = true;
+    }Config;
+
+    typedef struct Feedback
+    {
+        uint64_t m_lTime = 0;               //milliseconds
+        float m_fLossRate = 0;              //0~1,media packets lost before FEC repair
+        int32_t m_nRtt = -1;                //milliseconds,-1 unknown
+        uint32_t m_nJitter = 0;             //milliseconds
+        uint32_t m_nSendBitRate = 0;        //actually sent since the last feedback,FEC included
+    }Feedback;
+
+    typedef enum State
+    {
+        STATE_HOLD = 0,
+        STATE_INCREASE,
+        STATE_DECREASE
+    }State;
+
+    typedef struct Target
+    {
+        uint32_t m_nBitRate = 0;            //FEC included
+        uint32_t m_nEncoderBitRate = 0;
+        RFC8627FECEncoder::RepairMode m_eRepairMode = RFC8627FECEncoder::REPAIR_MODE_ROW_AND_COLUMN;
+        uint32_t m_nResolutionLevel = 0;    //see GetScaledResolution
+    }Target;
+
+public:
+    RateController(const Config& config);
+    ~RateController();
+
+    const Target& OnFeedback(const Feedback& feedback);
+    const Target& CheckTimeout(uint64_t now);       //back off when the receiver reports stop coming
+    void SetMaxBitRate(uint32_t bitRate);
+    void SetRepairOverhead(float column, float rowAndColumn);       //repair packets per media packet of the FEC in use
+    inline const Target& GetTarget() { return m_Target; };
+    inline State GetState() { return m_eState; };
+    inline float GetSmoothedLossRate() { return m_fSmoothedLoss; };
+    inline int32_t GetQueueDelay() { return m_nQueueDelay; };
+
+    static const char* GetStateName(State state);
+    static float GetRepairOverhead(RFC8627FECEncoder::RepairMode mode, uint8_t row, uint8_t col);
+    static void GetScaledResolution(uint32_t level, uint32_t width, uint32_t height, uint32_t& scaledWidth, uint32_t& scaledHeight);
+
+private:
+    bool IsOveruse(const Feedback& feedback);
+    void UpdateBitRate(const Feedback& feedback, bool overuse);
+    void UpdateRepairMode(uint64_t now);
+    void UpdateResolution(uint64_t now);
+    void UpdateTarget();
+    float GetBitsPerPixel(uint32_t bitRate, uint32_t level);
+
+private:
+    Config m_Config;
+    Target m_Target;
+    float m_fRepairOverhead[RFC8627FECEncoder::REPAIR_MODE_ROW_AND_COLUMN + 1];     //by repair mode
+    State m_eState;
+    uint32_t m_nBitRate;
+    uint32_t m_nLastDecreaseBitRate;    //where the link last pushed back,increase slowly around it
+    uint64_t m_lLastDecreaseTime;
+    uint64_t m_lLastFeedbackTime;
+    bool m_bRecvFeedback;
+
+    float m_fSmoothedLoss;
+    int32_t m_nSmoothedRtt;
+    int32_t m_nQueueDelay;
+    uint32_t m_nOveruseCount;
+    int32_t m_nMinRtt[2];               //current and previous window,so the base follows route changes
+    uint32_t m_nMinJitter[2];
+    uint64_t m_lMinWindowStart;
+
+    uint64_t m_lRepairModeTime;
+    uint64_t m_lResolutionTime;
+};
\ No newline at end of file
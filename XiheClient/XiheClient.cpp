@@ -1,5 +1,6 @@
 #include"XiheClient.h"
 #include "Log/Log.h"
+#include "CommonTools/LatencyTracer.h"
 
 XIheClient::XIheClient(const std::string& ip, const uint16_t port)
 {
@@ -85,6 +86,7 @@ int32_t XIheClient::PlayFile(const std::string& file)
 void XIheClient::OnRecvVideoPacket(std::shared_ptr<MediaPacket>& video)
 {
     //Debug("[%p][XIheClient::OnRecvVideoPacket] Recv Video Packet time:%llu", this, video->m_lPTS);
+    LatencyTracer::GetTracer()->Record(LatencyTracer::STAGE_CLIENT_DEPACKETIZED, video->m_lPTS);
     std::lock_guard<std::mutex> lock(m_pVideoDecoderLock);
     if (m_pVideoDecoder != nullptr)
     {
@@ -95,6 +97,7 @@ void XIheClient::OnRecvVideoPacket(std::shared_ptr<MediaPacket>& video)
 void XIheClient::OnRecvVideoFrame(std::shared_ptr<VideoFrame>& video)
 {
    //Debug("[%p][XIheClient::OnRecvVideoPacket] Recv Video Frame time:%llu", this, video->m_lPTS);
+    LatencyTracer::GetTracer()->Record(LatencyTracer::STAGE_CLIENT_DECODED, video->m_lPTS);
     if (m_pVideoFrameCallback != nullptr)
     {
         m_pVideoFrameCallback(video);
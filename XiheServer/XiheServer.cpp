@@ -39,6 +39,7 @@ int32_t XiheServer::OpenRTSPServer(uint16_t port)
         ret = -2; goto fail;
     }
     m_pRTSPServer->EnableOSD(true);
+    m_pRTSPServer->SetFECConfig(m_FECConfig);
 
     return 0;
 fail:
@@ -46,6 +47,16 @@ fail:
     return ret;
 }
 
+int32_t XiheServer::SetFECConfig(const FECBlock::Config& config)
+{
+    m_FECConfig = config;
+    if (m_pRTSPServer != nullptr)
+    {
+        return m_pRTSPServer->SetFECConfig(config);
+    }
+    return 0;
+}
+
 int32_t XiheServer::CloseRTSPServer()
 {
     delete m_pRTSPServer;
@@ -11,6 +11,7 @@ public:
 
     int32_t OpenRTSPServer(uint16_t port);
     int32_t CloseRTSPServer();
+    int32_t SetFECConfig(const FECBlock::Config& config);
     int32_t OpenDigitalTransport();
     int32_t CloseDigitalTransport();
     int32_t InitControllerTransport(const std::string protocol, void* param);
@@ -30,5 +31,6 @@ private:
 
 private:
     RTSPServer* m_pRTSPServer;
+    FECBlock::Config m_FECConfig;
     DigitalTransport* m_pDigitalTransport;
 };
@@ -1,9 +1,35 @@
 #include <thread>
+#include <cstring>
 #include "XiheServer.h"
 #include "Log/Log.h"
+#include "RateControl/LinkSimulator.h"
+#include "FEC/XORKernel.h"
+#include "FEC/FECSimulator.h"
+#include "RTSPServer/SendBenchmark.h"
 
-int main(void)
+int main(int argc, char* argv[])
 {
+    //run the bitrate controller against the simulated links and exit
+    if (argc > 1 && strcmp(argv[1], "--abr-sim") == 0)
+    {
+        return LinkSimulator::RunBuiltinScenarios(stdout);
+    }
+    if (argc > 1 && strcmp(argv[1], "--xor-bench") == 0)
+    {
+        return XORKernel::RunBenchmark(stdout);
+    }
+    //--fec-sim [dump],every FEC setting over the simulated channels,synthetic stream without a dump
+    if (argc > 1 && strcmp(argv[1], "--fec-sim") == 0)
+    {
+        SetLogLevel(ERROR);
+        return FECSimulator::RunBuiltinScenarios(stdout, argc > 2 ? argv[2] : "");
+    }
+    //the old copy+send loop against sendmmsg,into a loopback sink
+    if (argc > 1 && strcmp(argv[1], "--send-bench") == 0)
+    {
+        return SendBenchmark::RunBenchmark(stdout);
+    }
+
     InitLog("/usr/XiheServer.txt");
     SetLogLevel(TRACE);
     //˲һκʱǰ
@@ -11,6 +37,25 @@ int main(void)
     mbstowcs(nullptr, "", 0);
 
     XiheServer* pXiheServer = new XiheServer();
+    //--fec "scheme=rs;k=20;m=5;pt=109;depth=5",same syntax as the a=x-fec: sdp attribute,"fec:" in a SET_PARAMETER
+    //moves a running source to another geometry
+    //--rtx-cache 2097152,bytes of sent packets kept to answer NACKs
+    FECBlock::Config config;
+    for (int i = 1; i + 1 < argc; i++)
+    {
+        if (strcmp(argv[i], "--fec") == 0)
+        {
+            FECBlock::ParseSdpAttribute(argv[i + 1], config);       //left as it was when invalid
+        }
+    }
+    for (int i = 1; i + 1 < argc; i++)
+    {
+        if (strcmp(argv[i], "--rtx-cache") == 0)
+        {
+            config.m_nCacheSize = strtoul(argv[i + 1], nullptr, 10);
+        }
+    }
+    pXiheServer->SetFECConfig(config);
     pXiheServer->OpenRTSPServer(7777);
 
     pXiheServer->OpenDigitalTransport();